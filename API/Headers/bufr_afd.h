@@ -49,10 +49,12 @@ typedef struct
    {
    int            count;
    AF_Definition *defs;
+   int            refcount;   /* NUMBER OF HOLDERS, CHANGED ATOMICALLY */
    } BufrAFD;
 
 extern BufrAFD          *bufr_create_afd     ( const int *bdefs, int count );
 extern BufrAFD          *bufr_duplicate_afd  ( const BufrAFD * );
+extern BufrAFD          *bufr_share_afd      ( BufrAFD * );
 extern void              bufr_free_afd       ( BufrAFD * );
 
 #ifdef __cplusplus
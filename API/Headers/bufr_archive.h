@@ -0,0 +1,107 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_ARCHIVE.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR SPATIO-TEMPORAL INDEX OF BUFR ARCHIVES
+ *
+ *
+ */
+
+#ifndef _bufr_archive_h
+#define _bufr_archive_h
+
+#include <stdio.h>
+#include "bufr_array.h"
+#include "bufr_message.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  ARCHIVE_HAS_LOCATION   0x1
+#define  ARCHIVE_HAS_TIME       0x2    /* FROM THE SUBSETS, ELSE FROM SECTION 1 */
+
+#define  ARCHIVE_STATION_LEN    64
+
+#define  ARCHIVE_GRID_DEGREES   10
+#define  ARCHIVE_GRID_LAT       (180/ARCHIVE_GRID_DEGREES)
+#define  ARCHIVE_GRID_LON       (360/ARCHIVE_GRID_DEGREES)
+#define  ARCHIVE_GRID_CELLS     (ARCHIVE_GRID_LAT*ARCHIVE_GRID_LON)
+
+/*
+ * extent of one message of an archive
+ */
+typedef struct
+   {
+   long             offset;       /* OF THE MESSAGE IN ITS FILE */
+   int              length;
+   int              flags;
+   double           lat_min, lat_max;
+   double           lon_min, lon_max;
+   int64_t          time_min, time_max;   /* SECONDS SINCE 1970-01-01 UTC */
+   char           **stations;
+   int              nb_stations;
+   } BufrArchiveEntry;
+
+/*
+ * entries of each cell of a latitude-longitude grid sorted by time_min,
+ * the last cell holds the entries without location
+ */
+typedef struct
+   {
+   ArrayPtr         entries;      /* BufrArchiveEntry */
+   int             *cells;
+   int             *first;        /* OFFSET IN cells OF EACH CELL, ARCHIVE_GRID_CELLS+2 */
+   int64_t          max_span;     /* LONGEST time_max - time_min */
+   } BufrArchiveIndex;
+
+extern BufrArchiveIndex *bufr_create_archive_index    ( void );
+extern void              bufr_free_archive_index      ( BufrArchiveIndex *idx );
+extern int               bufr_archive_index_add_message ( BufrArchiveIndex *idx, BUFR_Message *msg,
+                                                          BUFR_Tables *tables, long offset );
+extern int               bufr_archive_index_add_dataset ( BufrArchiveIndex *idx, BUFR_Message *msg,
+                                                          BUFR_Dataset *dts, long offset );
+extern int               bufr_archive_index_add_file  ( BufrArchiveIndex *idx, FILE *fp, BUFR_Tables *tables );
+extern int               bufr_archive_index_query     ( BufrArchiveIndex *idx,
+                                                        double lat_min, double lat_max,
+                                                        double lon_min, double lon_max,
+                                                        int64_t time_from, int64_t time_to,
+                                                        const char *station, long **offsets );
+extern int               bufr_archive_index_write     ( BufrArchiveIndex *idx, FILE *fp );
+extern BufrArchiveIndex *bufr_archive_index_read      ( FILE *fp );
+extern void              bufr_archive_station_id      ( char *dst, const char *str );
+extern int64_t           bufr_archive_time            ( int year, int month, int day,
+                                                        int hour, int minute, int second );
+extern int64_t           bufr_archive_hour            ( const char *str );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
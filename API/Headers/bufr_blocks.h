@@ -0,0 +1,93 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_BLOCKS.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR LOCATING THE BLOCKS OF A COMPRESSED MESSAGE
+ *
+ *
+ */
+
+#ifndef _bufr_blocks_h
+#define _bufr_blocks_h
+
+#include "bufr_message.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  BLOCK_NUMERIC     0
+#define  BLOCK_STRING      1
+#define  BLOCK_IEEE_FP     2
+#define  BLOCK_AF          3
+
+/*
+ * one block of a compressed section 4: R0, NBINC then one increment
+ * per subset
+ */
+typedef struct
+   {
+   BufrDescriptor  *bd;          /* OF THE FIRST SUBSET, HOLDS THE ENCODING */
+   int              pos;         /* POSITION OF bd IN A SUBSET */
+   int              kind;
+   int              nbits;       /* WIDTH OF R0 */
+   int              nbinc;       /* AS STORED IN THE BLOCK */
+   int              inc_nbits;   /* WIDTH OF THE INCREMENTS, 0 IF NONE */
+   uint64_t         r0;          /* NUMERIC AND AF ONLY */
+   uint64_t         r0pos;       /* BIT POSITIONS IN SECTION 4 */
+   uint64_t         incpos;
+   } BufrBlock;
+
+typedef struct
+   {
+   BUFR_Message    *msg;
+   BUFR_Dataset    *layout;      /* FIRST SUBSET ONLY */
+   BufrBlock       *blocks;
+   int              nb_blocks;
+   int              nb_subsets;
+   int             *value_block; /* BLOCK OF THE VALUE AT EACH POSITION, -1 IF NONE */
+   int             *af_block;    /* BLOCK OF THE ASSOCIATED FIELD, -1 IF NONE */
+   int              nb_positions;
+   } BufrBlockIndex;
+
+extern BufrBlockIndex  *bufr_create_block_index     ( BUFR_Message *msg, BUFR_Tables *tables );
+extern void             bufr_free_block_index       ( BufrBlockIndex *idx );
+extern int              bufr_block_bounds           ( BufrBlockIndex *idx, int blk, double *vmin, double *vmax );
+extern int              bufr_block_index_may_match  ( BufrBlockIndex *idx, BufrDescValue *keys, int nb );
+extern int              bufr_block_index_candidates ( BufrBlockIndex *idx, BufrDescValue *keys, int nb,
+                                                      char *candidates );
+extern int              bufr_block_index_find_descriptor ( BufrBlockIndex *idx, int descriptor, int startpos );
+extern double           bufr_block_index_get_dvalue ( BufrBlockIndex *idx, int subset, int pos );
+extern BufrDescriptor  *bufr_block_index_get_descriptor ( BufrBlockIndex *idx, int subset, int pos );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_BLOOM.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR BLOOM FILTERS OF STATIONS AND TIMES
+ *
+ *
+ */
+
+#ifndef _bufr_bloom_h
+#define _bufr_bloom_h
+
+#include <stdio.h>
+#include "bufr_archive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  BLOOM_MAX_HOURS    48     /* LONGER MESSAGES ARE KEPT FOR ANY HOUR */
+#define  BLOOM_ANY_TIME     INT64_MIN
+
+typedef struct
+   {
+   unsigned char   *bits;
+   int              nbits;
+   int              nb_hashes;
+   } BufrBloom;
+
+/*
+ * bloom filters of a file, and optionally of each of its messages
+ */
+typedef struct
+   {
+   BufrBloom       *file;
+   int              nb_messages;
+   long            *offsets;
+   BufrBloom      **messages;
+   } BufrBloomSidecar;
+
+extern BufrBloom        *bufr_create_bloom          ( int nb_keys, double fp_rate );
+extern void              bufr_free_bloom            ( BufrBloom *bloom );
+extern void              bufr_bloom_add             ( BufrBloom *bloom, const char *key );
+extern int               bufr_bloom_may_contain     ( BufrBloom *bloom, const char *key );
+extern void              bufr_bloom_add_entry       ( BufrBloom *bloom, BufrArchiveEntry *entry );
+extern int               bufr_bloom_may_hold        ( BufrBloom *bloom, const char *station, int64_t time );
+
+extern BufrBloomSidecar *bufr_archive_index_sidecar ( BufrArchiveIndex *idx, int per_message, double fp_rate );
+extern void              bufr_free_bloom_sidecar    ( BufrBloomSidecar *sc );
+extern int               bufr_sidecar_may_hold      ( BufrBloomSidecar *sc, long offset,
+                                                      const char *station, int64_t time );
+extern int               bufr_write_bloom_sidecar   ( BufrBloomSidecar *sc, FILE *fp );
+extern BufrBloomSidecar *bufr_read_bloom_sidecar    ( FILE *fp );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,109 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ *  file      :  BUFR_BUNDLER.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR BUNDLING SUBSETS INTO MESSAGES AS THEY ARRIVE
+ *
+ *
+ */
+
+#ifndef _bufr_bundler_h
+#define _bufr_bundler_h
+
+#include <time.h>
+#include "bufr_array.h"
+#include "bufr_template.h"
+#include "bufr_message.h"
+#include "bufr_dataset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * receives each message completed by the bundler, the message
+ * is freed by the bundler once the call returns
+ */
+typedef void (*bufr_bundle_output)( BUFR_Message *msg, void *client_data );
+
+/*
+ * running range of the encoded values of one position of a compressed bundle
+ */
+typedef struct
+   {
+   uint64_t         min, max;
+   int              nb_missing;
+   } BufrBundleStats;
+
+/*
+ * one message being filled, subsets of a compressed bundle are kept
+ * in dts and share the same structure; those of an uncompressed one are
+ * encoded into msg as they arrive
+ */
+typedef struct
+   {
+   BUFR_Template   *tmplte;
+   BufrSection1     s1;
+   int              data_flag;
+   uint64_t         signature;   /* STRUCTURE OF THE SUBSETS, COMPRESSED ONLY */
+   BUFR_Dataset    *dts;
+   BUFR_Message    *msg;
+   BufrBundleStats *stats;       /* ONE PER POSITION, COMPRESSED ONLY */
+   int              nb_stats;
+   int              nb_subsets;
+   uint64_t         nbits;       /* SECTION 4 SIZE, ESTIMATED WHEN COMPRESSED */
+   time_t           opened;
+   } BufrBundle;
+
+typedef struct
+   {
+   int                 x_compress;
+   int                 max_subsets;   /* 0 IS NO LIMIT */
+   int                 max_octets;    /* SECTION 4 SIZE THAT FLUSHES, 0 IS NO LIMIT */
+   int                 max_seconds;   /* SINCE THE FIRST SUBSET, 0 IS NO LIMIT */
+   ArrayPtr            bundles;       /* ARRAY OF BufrBundle * */
+   bufr_bundle_output  output;
+   void               *client_data;
+   } BUFR_Bundler;
+
+extern BUFR_Bundler    *bufr_create_bundler         ( int x_compress, bufr_bundle_output output, void *client_data );
+extern void             bufr_free_bundler           ( BUFR_Bundler *bundler );
+extern void             bufr_bundler_set_limits     ( BUFR_Bundler *bundler, int max_subsets, int max_octets, int max_seconds );
+
+extern int              bufr_bundler_add_subset     ( BUFR_Bundler *bundler, BUFR_Dataset *dts, int pos );
+extern int              bufr_bundler_add_dataset    ( BUFR_Bundler *bundler, BUFR_Dataset *dts );
+extern int              bufr_bundler_add_bits       ( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1,
+                                                      const unsigned char *data, uint64_t bitpos, uint64_t nbits );
+extern int              bufr_bundler_expire         ( BUFR_Bundler *bundler, time_t now );
+extern int              bufr_bundler_flush          ( BUFR_Bundler *bundler );
+extern int              bufr_bundler_count          ( BUFR_Bundler *bundler );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
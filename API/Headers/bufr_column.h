@@ -0,0 +1,88 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ *  file      :  BUFR_COLUMN.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR ENCODING COLUMNS OF VALUES WITHOUT A DATASET
+ *
+ *
+ */
+
+#ifndef _bufr_column_h
+#define _bufr_column_h
+
+#include "bufr_template.h"
+#include "bufr_message.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+   {
+   BUFR_COLUMN_NONE=0,      /* use the template value, or missing */
+   BUFR_COLUMN_DOUBLE,      /* const double *   */
+   BUFR_COLUMN_INT32,       /* const int32_t *  */
+   BUFR_COLUMN_SCALED,      /* const int64_t *, value * 10^scale */
+   BUFR_COLUMN_STRING       /* const char **, NULL is missing */
+   } BufrColumnType;
+
+/*
+ * values of one template position for every subset,
+ * missing is an optional mask where non zero marks a missing value
+ */
+typedef struct
+   {
+   BufrColumnType   type;
+   const void      *values;
+   const char      *missing;
+   } BufrColumn;
+
+/*
+ * template expanded once with Table C applied, reused for every message
+ */
+typedef struct
+   {
+   BUFR_Template        *tmplte;
+   BufrDescriptorArray   descs;
+   int                   nbits;      /* bits per uncompressed subset */
+   } BufrEncodePlan;
+
+extern BufrEncodePlan  *bufr_create_encode_plan     ( BUFR_Template *tmplt );
+extern void             bufr_free_encode_plan       ( BufrEncodePlan *plan );
+extern int              bufr_encode_plan_count      ( BufrEncodePlan *plan );
+extern BufrDescriptor  *bufr_encode_plan_descriptor ( BufrEncodePlan *plan, int pos );
+extern int              bufr_encode_plan_find       ( BufrEncodePlan *plan, int descriptor, int startpos );
+
+extern void             bufr_init_column            ( BufrColumn *col );
+extern BUFR_Message    *bufr_encode_columns         ( BufrEncodePlan *plan, BufrSection1 *s1,
+                                                      BufrColumn *columns, int nb_subsets, int x_compress );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -103,10 +103,29 @@ typedef struct bufr_dataset
    char                 *header_string;
    } BUFR_Dataset;
 
+/*
+ * sorted positions of each descriptor of a datasubset, shared by
+ * datasubsets of the same structure
+ */
+typedef struct
+   {
+   int                 *descriptors;  /* DISTINCT, SORTED */
+   int                 *first;        /* OFFSET IN positions OF EACH DESCRIPTOR, nb_descriptors+1 */
+   int                 *positions;
+   int                  nb_descriptors;
+   int                  count;        /* DESCRIPTORS OF THE DATASUBSET WHEN BUILT */
+   int                  refcount;     /* SUBSETS SHARING IT, MAY BE IN SEVERAL THREADS */
+   } BufrPositionIndex;
+
 typedef struct bufr_datasubset
    {
    BufrDescriptorArray  data;
    BufrDPBM            *dpbm;
+   uint64_t             signature;  /* STRUCTURE HASH WITHOUT THE COUNTS, 0 UNTIL COMPUTED */
+   int                  sig_stamp;  /* STRUCTURE STAMP WHEN COMPUTED */
+   int                 *count_pos;  /* POSITIONS OF THE DELAYED COUNTS */
+   int                  nb_count_pos;
+   BufrPositionIndex   *index;      /* NULL UNTIL BUILT */
    } DataSubset;
 
 
@@ -124,22 +143,42 @@ extern int              bufr_count_datasubset       ( BUFR_Dataset *dts );
 
 extern int              bufr_dataset_compressible   ( BUFR_Dataset *dts );
 
+extern int              bufr_dataset_group_subsets  ( BUFR_Dataset *dts, int *groups );
+
+extern uint64_t         bufr_datasubset_signature   ( DataSubset *subset );
+
+extern int              bufr_datasubset_same_structure( DataSubset *ss1, DataSubset *ss2 );
+
+extern int              bufr_datasubset_build_index  ( DataSubset *subset );
+extern int              bufr_dataset_build_index     ( BUFR_Dataset *dts );
+extern int              bufr_datasubset_find_positions( DataSubset *subset, int descriptor, int startpos,
+                                                        const int **positions );
+
 extern int              bufr_add_datasubset         ( BUFR_Dataset *dts, BUFR_Sequence *bcl, BufrDDOp * );
 
 extern int              bufr_datasubset_count_descriptor  ( DataSubset *subset );
 
 extern BufrDescriptor  *bufr_datasubset_get_descriptor    ( DataSubset *ss, int pos );
 extern BufrDescriptor  *bufr_datasubset_next_descriptor   ( DataSubset *ss, int *pos );
+extern int              bufr_expand_qualifiers            ( DataSubset *dss );
+
+extern int              bufr_dataset_get_scaled_column    ( BUFR_Dataset *dts, int pos, int64_t *values, int64_t missing );
+extern int              bufr_dataset_set_dvalue_column    ( BUFR_Dataset *dts, int pos, const double *values, const char *missing );
+extern int              bufr_dataset_set_ivalue_column    ( BUFR_Dataset *dts, int pos, const int32_t *values, const char *missing );
+extern int              bufr_dataset_set_svalue_column    ( BUFR_Dataset *dts, int pos, const char * const *values, const char *missing );
 
 
 extern BUFR_Dataset    *bufr_decode_message         ( BUFR_Message *msg, BUFR_Tables *local_tables );
 extern BUFR_Message    *bufr_encode_message         ( BUFR_Dataset *dts , int x_compress );
+extern void             bufr_encode_datasubset      ( BUFR_Message *msg, DataSubset *subset );
 extern BUFR_Dataset    *bufr_decode_message_subsets ( BUFR_Message *msg, BUFR_Tables *local_tables, int subset_from, int subset_to );
 
 
 extern int              bufr_merge_dataset          ( BUFR_Dataset *dest, int dest_pos, 
                                                       BUFR_Dataset *src,  int src_pos, int nb );
 
+extern int              bufr_move_datasubset        ( BUFR_Dataset *dest, BUFR_Dataset *src, int src_pos );
+
 extern int              bufr_expand_datasubset      ( BUFR_Dataset *dts, int pos );
 
 extern int              bufr_load_dataset           ( BUFR_Dataset *dts, const char *infile );
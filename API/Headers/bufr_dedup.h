@@ -0,0 +1,97 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_DEDUP.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR DETECTING DUPLICATE AND CORRECTED BULLETINS
+ *
+ *
+ */
+
+#ifndef _bufr_dedup_h
+#define _bufr_dedup_h
+
+#include <stdio.h>
+#include "bufr_message.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  DEDUP_NEW            0
+#define  DEDUP_DUPLICATE      1    /* SAME SECTIONS 3 AND 4 AS A RECENT MESSAGE */
+#define  DEDUP_CORRECTION     2    /* HIGHER UPDATE SEQUENCE NUMBER OF A RECENT MESSAGE */
+#define  DEDUP_STALE          3    /* LOWER UPDATE SEQUENCE NUMBER THAN A RECENT MESSAGE */
+
+#define  DEDUP_DEFAULT_CAPACITY   65536
+#define  DEDUP_DEFAULT_WINDOW     (24*3600)
+
+/*
+ * what is kept of a recent message
+ */
+typedef struct
+   {
+   uint64_t         fingerprint;  /* OF SECTIONS 3 AND 4 */
+   uint64_t         identity;     /* OF SECTION 1 KEYS AND BULLETIN HEADING */
+   int              upd_seq_no;
+   int64_t          seen;         /* TIME OF ARRIVAL IN SECONDS */
+   long             id;
+   int              next_fp;      /* CHAINS OF THE HASH TABLES */
+   int              next_id;
+   } BufrDedupEntry;
+
+/*
+ * ring of the most recent messages within a time window
+ */
+typedef struct
+   {
+   BufrDedupEntry  *entries;
+   int              capacity;
+   int              first;
+   int              count;
+   int              nb_buckets;
+   int             *fp_heads;
+   int             *id_heads;
+   int64_t          window;
+   long             nb_checked;
+   long             nb_duplicates;
+   long             nb_stale;
+   long             nb_corrections;
+   } BufrDedup;
+
+extern BufrDedup  *bufr_create_dedup          ( int capacity, int64_t window );
+extern void        bufr_free_dedup            ( BufrDedup *dd );
+extern uint64_t    bufr_message_fingerprint   ( BUFR_Message *msg );
+extern uint64_t    bufr_message_identity      ( BUFR_Message *msg );
+extern int         bufr_dedup_message         ( BufrDedup *dd, BUFR_Message *msg, int64_t now,
+                                                long id, long *superseded );
+extern int         bufr_dedup_read_message    ( BufrDedup *dd, FILE *fp, BUFR_Message **rtrn );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -71,8 +71,12 @@ typedef ArrayPtr  BufrDescriptorArray;
 
 extern BufrDescriptor *bufr_create_descriptor         ( BUFR_Tables *tbls, int desc );
 extern BufrDescriptor *bufr_dupl_descriptor           ( BufrDescriptor *dup );
+extern BufrDescriptor *bufr_share_descriptor          ( BufrDescriptor *dup );
 extern void            bufr_free_descriptor           ( BufrDescriptor * );
 extern void            bufr_copy_descriptor           ( BufrDescriptor *dest, BufrDescriptor *src );
+extern void            bufr_descriptor_set_encoding   ( BufrDescriptor *bdsc, const BufrValueEncoding *be );
+extern int             bufr_structure_stamp           ( void );
+extern void            bufr_structure_changed         ( void );
 extern BufrValue      *bufr_mkval_for_descriptor      ( BufrDescriptor * );
 extern void            bufr_print_descriptor          ( char *str, BufrDescriptor *bdsc );
 extern int             bufr_print_dscptr_value        ( char *outstr, BufrDescriptor *cb );
@@ -86,11 +90,14 @@ extern int             bufr_descriptor_set_dvalue     ( BufrDescriptor *bdsc,  d
 extern int             bufr_descriptor_set_ivalue     ( BufrDescriptor *bdsc,  int    val );
 extern int             bufr_descriptor_set_svalue     ( BufrDescriptor *bdsc,  const char  *val );
 extern int             bufr_descriptor_set_bitsvalue  ( BufrDescriptor *bdsc,  uint64_t ival );
+extern int             bufr_descriptor_set_scaled     ( BufrDescriptor *bdsc,  int64_t scaled );
 
 extern float           bufr_descriptor_get_fvalue     ( BufrDescriptor *bdsc );
 extern double          bufr_descriptor_get_dvalue     ( BufrDescriptor *bdsc );
 extern int             bufr_descriptor_get_ivalue     ( BufrDescriptor *bdsc );
 extern char           *bufr_descriptor_get_svalue     ( BufrDescriptor *bdsc, int *len );
+extern int             bufr_descriptor_get_scaled     ( BufrDescriptor *bdsc, int64_t *scaled );
+extern int             bufr_descriptor_get_bitsvalue  ( BufrDescriptor *bdsc, uint64_t *bits );
 extern void            bufr_set_value_af              ( BufrValue *bv, const BufrDescriptor *bc );
 
 extern float           bufr_descriptor_get_location   ( BufrDescriptor *bdsc, int desc );
@@ -62,9 +62,10 @@ extern int            bufr_decode_sect3    ( BUFR_Message *bufr );
 
 extern void           bufr_alloc_sect4     ( BUFR_Message *bufr, unsigned int len );
 
-/* TODO: FIND A USE OF BITSTREAM, PROBABLY FOR THE AF BITS >64 BITS UPTO 256 BITS */
-/*       IMPLEMENTING THE bufr_get_bitstream() */
+/* TODO: IMPLEMENTING THE bufr_get_bitstream() */
 extern void           bufr_put_bitstream   ( BUFR_Message *bufr, const unsigned char *val, int nbbits );
+extern void           bufr_put_bitrange    ( BUFR_Message *bufr, const unsigned char *data,
+                                             uint64_t bitpos, uint64_t nbbits );
 /*
  * FUNCTIONS FOR ERRORS HANDLING AND DEBUGGING
  */
@@ -66,6 +66,9 @@ typedef struct
 	ListNode *last; 
 	int	nb_node; 
    char     *name;
+   ListNode **index;     /* NOEUDS PAR POSITION, SEULS LES nb_index PREMIERS SONT VALIDES */
+   int       nb_index;
+   int       max_index;
    } LinkedList;
 
 /***************************************************************************/
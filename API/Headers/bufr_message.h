@@ -169,6 +169,7 @@ typedef struct _DBufr
    char *header_string;
    int   header_len;
    BUFR_Enforcement  enforce;
+   long  offset;          /* WHERE IT STARTS IN THE FILE READ, -1 IF UNKNOWN */
    } BUFR_Message;
 
 /*
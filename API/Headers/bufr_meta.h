@@ -67,6 +67,7 @@ typedef struct
    int            len_expansion;
 	struct bufr_desc** qualifiers;	/* same as BufrDescriptor */
 	int            nb_qualifiers;
+   int            refcount;   /* HOLDERS MAY BE IN SEVERAL THREADS */
    } BufrRTMD;
 
 typedef ArrayPtr LocationEncodingArray;
@@ -76,6 +77,8 @@ extern BufrRTMD     *bufr_create_rtmd     ( int count );
 extern BufrRTMD     *bufr_duplicate_rtmd  ( BufrRTMD * );
 extern void          bufr_copy_rtmd       ( BufrRTMD *dest, BufrRTMD *src );
 extern void          bufr_free_rtmd       ( BufrRTMD * );
+extern BufrRTMD     *bufr_share_rtmd      ( BufrRTMD * );
+extern BufrRTMD     *bufr_unshare_rtmd    ( BufrRTMD * );
 
 extern void          bufr_print_rtmd_data      ( char *outstr, BufrRTMD *bm );
 extern void          bufr_print_rtmd_repl      ( char *outstr, BufrRTMD *bm );
@@ -0,0 +1,106 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_QUERY.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR COMPILED SEARCH QUERIES ON DATASUBSETS
+ *
+ *
+ */
+
+#ifndef _bufr_query_h
+#define _bufr_query_h
+
+#include "bufr_array.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  QUERY_KEY_ANY     0
+#define  QUERY_KEY_IN      1
+#define  QUERY_KEY_RANGE   2
+
+/*
+ * values of a plain key converted once for the types of BufrValue
+ */
+typedef struct
+   {
+   BufrDescValue   *key;
+   int              kind;
+   int32_t         *ivals;
+   float           *fvals;
+   double          *dvals;
+   } BufrQueryKey;
+
+/*
+ * a sequence of keys as given to bufr_subset_find_values
+ */
+typedef struct
+   {
+   BufrDescValue   *keys;        /* NOT OWNED BY THE QUERY */
+   int              nb_keys;
+   int              group;       /* TERMS OF A GROUP ARE AND-ED, GROUPS ARE OR-ED */
+   BufrQueryKey    *ckeys;       /* NULL IF A KEY IS ON A QUALIFIER, LOCATION OR CALLBACK */
+   } BufrQueryTerm;
+
+/*
+ * positions where the descriptors of each term match in sequence,
+ * for one structure of datasubset
+ */
+typedef struct
+   {
+   uint64_t         signature;
+   int              count;       /* DESCRIPTORS OF THE STRUCTURE */
+   int             *first;       /* OFFSET IN starts OF EACH TERM, nb_terms+1 */
+   int             *starts;
+   } BufrQueryPlan;
+
+typedef struct
+   {
+   ArrayPtr         terms;       /* BufrQueryTerm */
+   int              nb_groups;
+   ArrayPtr         plans;       /* BufrQueryPlan * */
+   int              last_plan;
+   } BufrQuery;
+
+extern BufrQuery  *bufr_create_query         ( void );
+extern void        bufr_free_query           ( BufrQuery *query );
+extern int         bufr_query_add_term       ( BufrQuery *query, BufrDescValue *keys, int nb );
+extern int         bufr_query_or             ( BufrQuery *query );
+extern int         bufr_query_match          ( BufrQuery *query, DataSubset *subset );
+extern int         bufr_query_select         ( BufrQuery *query, BUFR_Dataset *dts, char *selected );
+extern int         bufr_query_may_match_blocks ( BufrQuery *query, BufrBlockIndex *idx );
+extern int         bufr_query_block_candidates ( BufrQuery *query, BufrBlockIndex *idx, char *candidates );
+extern int         bufr_message_may_match    ( BUFR_Message *msg, BUFR_Tables *tbls, BufrQuery *query );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
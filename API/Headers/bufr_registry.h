@@ -0,0 +1,84 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_REGISTRY.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR HOT RELOADABLE BUFR TABLES REGISTRY
+ *
+ *
+ */
+
+#ifndef _bufr_registry_h
+#define _bufr_registry_h
+
+#include "bufr_tables.h"
+#include "bufr_linklist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * an immutable generation of loaded tables, shared by readers
+ * and reclaimed when the last of them releases it
+ */
+typedef struct
+   {
+   LinkedList    *tables_list;
+   int            generation;
+   int            refcount;
+   } BufrTablesSnapshot;
+
+struct bufr_registry_priv;
+
+typedef struct
+   {
+   char                      *path;
+   int                       *tbnos;
+   int                        nb_tbnos;
+   char                      *ltableb_fn;
+   char                      *ltabled_fn;
+   BufrTablesSnapshot        *current;
+   int                        generation;
+   struct bufr_registry_priv *priv;
+   } BUFR_TablesRegistry;
+
+extern BUFR_TablesRegistry *bufr_create_tables_registry ( const char *path, int tbnos[], int nb );
+extern void                 bufr_free_tables_registry   ( BUFR_TablesRegistry *reg );
+extern void                 bufr_registry_set_local     ( BUFR_TablesRegistry *reg,
+                                                          const char *tableb_fn, const char *tabled_fn );
+extern int                  bufr_registry_reload        ( BUFR_TablesRegistry *reg );
+extern BufrTablesSnapshot  *bufr_registry_acquire       ( BUFR_TablesRegistry *reg );
+extern void                 bufr_registry_release       ( BUFR_TablesRegistry *reg, BufrTablesSnapshot *snap );
+extern int                  bufr_registry_generation    ( BUFR_TablesRegistry *reg );
+extern int                  bufr_registry_watch         ( BUFR_TablesRegistry *reg );
+extern void                 bufr_registry_unwatch       ( BUFR_TablesRegistry *reg );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -105,6 +105,7 @@ extern ListNode           *bufr_getnode_sequence           ( BUFR_Sequence *, in
 extern void                bufr_add_descriptor_to_sequence ( BUFR_Sequence *, BufrDescriptor * );
 
 extern BUFR_Sequence      *bufr_copy_sequence              ( BUFR_Sequence * );
+extern BUFR_Sequence      *bufr_share_sequence             ( BUFR_Sequence * );
 
 extern LinkedList         *bufr_expand_node_descriptor     ( LinkedList *, ListNode *, int, BUFR_Tables *, int *, int *, BUFR_DecodeInfo *s4 );
 extern int                 bufr_expand_sequence            ( BUFR_Sequence *lst, int flag, BUFR_Tables * );
@@ -0,0 +1,156 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_SNAPSHOT.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR BINARY SNAPSHOTS OF DECODED DATASETS
+ *
+ *
+ */
+
+#ifndef _bufr_snapshot_h
+#define _bufr_snapshot_h
+
+#include <stdio.h>
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define  SNAPSHOT_MAGIC         "BUFRSNP"
+#define  SNAPSHOT_VERSION       1
+#define  SNAPSHOT_BYTE_ORDER    0x01020304
+
+#define  SNAPSHOT_HAS_QUALIFIERS   0x1
+
+/*
+ * a snapshot holds one dataset, a file is a sequence of snapshots;
+ * offsets are from the start of the snapshot, in the byte order and
+ * layout of the machine that wrote it
+ */
+typedef struct
+   {
+   char             magic[8];
+   uint32_t         version;
+   uint32_t         byte_order;
+   uint32_t         record_size;  /* sizeof(BufrSnapRecord) */
+   int32_t          edition;
+   int32_t          data_flag;
+   int32_t          s1[18];       /* SECTION 1, SEE bufr_write_snapshot */
+   int32_t          header_string;/* IN strings, -1 IF NONE */
+   int32_t          nb_codes;
+   int32_t          nb_subsets;
+   int64_t          nb_records;
+   int64_t          aux_len;      /* IN int32 */
+   int64_t          strings_len;
+   int64_t          codes_offset;
+   int64_t          subsets_offset;
+   int64_t          records_offset;
+   int64_t          aux_offset;
+   int64_t          strings_offset;
+   int64_t          size;         /* OF THE WHOLE SNAPSHOT, MULTIPLE OF 8 */
+   } BufrSnapshotHeader;
+
+/*
+ * a descriptor of the template, its values are records
+ */
+typedef struct
+   {
+   int32_t          descriptor;
+   int32_t          nbval;
+   int64_t          first_value;
+   } BufrSnapCode;
+
+typedef struct
+   {
+   int64_t          first;        /* RECORD */
+   int32_t          count;
+   int32_t          flags;
+   } BufrSnapSubset;
+
+/*
+ * a descriptor of a datasubset with its value
+ */
+typedef struct
+   {
+   int32_t          descriptor;
+   int32_t          s_descriptor;
+   int32_t          repl_rank;
+   int32_t          meta;         /* RTMD IN aux, -1 IF NONE */
+   int32_t          af;           /* ASSOCIATED FIELD OF THE VALUE IN aux, -1 IF NONE */
+   int32_t          afd;          /* ASSOCIATED FIELD DEFINITION IN aux, -1 IF NONE */
+   int32_t          enc_type;
+   int32_t          enc_scale;
+   int32_t          enc_reference;
+   int32_t          enc_nbits;
+   uint8_t          enc_af_nbits;
+   uint8_t          enc_ref_nbits;
+   uint8_t          flags;
+   uint8_t          value_type;   /* VALTYPE_UNDEFINE IF NO VALUE */
+   int16_t          scale;
+   int8_t           has_scaled;
+   int8_t           unused;
+   int32_t          len;          /* OF A STRING */
+   int64_t          ivalue;       /* INTEGER, SCALED OR OFFSET OF A STRING IN strings */
+   double           dvalue;
+   } BufrSnapRecord;
+
+/*
+ * a snapshot once mapped, its pointers fixed up
+ */
+typedef struct
+   {
+   BufrSnapshotHeader *header;
+   BufrSnapCode       *codes;
+   BufrSnapSubset     *subsets;
+   BufrSnapRecord     *records;
+   int32_t            *aux;
+   char               *strings;
+   } BufrSnapDataset;
+
+typedef struct
+   {
+   char               *base;
+   size_t              size;
+   int                 mapped;
+   int                 nb_datasets;
+   BufrSnapDataset    *datasets;
+   } BufrSnapshot;
+
+extern int               bufr_write_snapshot       ( BUFR_Dataset *dts, FILE *fp );
+extern BufrSnapshot     *bufr_open_snapshot        ( const char *filename );
+extern void              bufr_close_snapshot       ( BufrSnapshot *snap );
+extern BufrSnapRecord   *bufr_snapshot_records     ( BufrSnapDataset *sd, int pos, int *count );
+extern const char       *bufr_snapshot_string      ( BufrSnapDataset *sd, BufrSnapRecord *rec, int *len );
+extern BUFR_Dataset     *bufr_snapshot_to_dataset  ( BufrSnapDataset *sd, BUFR_Tables *tables );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
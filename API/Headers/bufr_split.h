@@ -0,0 +1,54 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_SPLIT.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR EXTRACTING SUBSETS OF A MESSAGE AT THE BIT LEVEL
+ *
+ *
+ */
+
+#ifndef _bufr_split_h
+#define _bufr_split_h
+
+#include "bufr_message.h"
+#include "bufr_tables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int             bufr_subset_boundaries   ( BUFR_Message *msg, BUFR_Tables *tables, uint64_t *bitpos );
+extern BUFR_Message   *bufr_extract_subsets     ( BUFR_Message *msg, BUFR_Tables *tables,
+                                                  int subset_from, int subset_to );
+extern BUFR_Message  **bufr_split_message       ( BUFR_Message *msg, BUFR_Tables *tables,
+                                                  int max_subsets, int *nb_parts );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
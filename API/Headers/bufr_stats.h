@@ -0,0 +1,80 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ *  file      :  BUFR_STATS.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR STATISTICS OF ELEMENT VALUES
+ *
+ *
+ */
+
+#ifndef _bufr_stats_h
+#define _bufr_stats_h
+
+#include "bufr_array.h"
+#include "bufr_message.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * statistics of the numeric values of one element descriptor
+ */
+typedef struct
+   {
+   int              descriptor;
+   int              count;       /* VALUES NOT MISSING */
+   int              nb_missing;
+   double           min, max;
+   double           sum;
+   } BufrElementStats;
+
+typedef struct
+   {
+   ArrayPtr         elems;       /* OF BufrElementStats, IN ORDER OF APPEARANCE */
+   int              nb_messages;
+   int              nb_subsets;
+   } BufrStats;
+
+extern BufrStats        *bufr_create_stats           ( void );
+extern void              bufr_free_stats             ( BufrStats *stats );
+extern int               bufr_stats_add_message      ( BufrStats *stats, BUFR_Message *msg, BUFR_Tables *tables );
+extern int               bufr_stats_add_block_index  ( BufrStats *stats, BufrBlockIndex *idx );
+extern int               bufr_stats_add_dataset      ( BufrStats *stats, BUFR_Dataset *dts );
+extern int               bufr_stats_count            ( BufrStats *stats );
+extern BufrElementStats *bufr_stats_get              ( BufrStats *stats, int pos );
+extern BufrElementStats *bufr_stats_find             ( BufrStats *stats, int descriptor );
+extern void              bufr_print_stats            ( BufrStats *stats, void (*print_proc)(const char *) );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
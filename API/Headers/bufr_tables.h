@@ -125,8 +125,8 @@ typedef struct _TblsBufr
    BufrTablesSet local;
    int        data_cat;
    char       data_cat_desc[65];
-   EntryTableBArray   tableB_cache;
-   EntryTableB       *last_searched;
+   EntryTableB      **tableB_cache;     /* ENTRIES ALREADY FOUND, BY X AND Y */
+   ArrayPtr           tableD_expansions;
    } BUFR_Tables;
 
 extern EntryTableB   *bufr_fetch_tableB           ( BUFR_Tables *, int desc );
@@ -178,9 +178,15 @@ extern uint32_t       bufr_cvt_fval_to_i32        ( int desc, BufrValueEncoding
 extern uint64_t       bufr_cvt_dval_to_i64        ( int desc, BufrValueEncoding *be, double fval );
 extern float          bufr_cvt_i32_to_fval        ( BufrValueEncoding *be, uint32_t ival );
 extern double         bufr_cvt_i64_to_dval        ( BufrValueEncoding *be, int64_t lval );
+extern int            bufr_cvt_i64_to_dval_array  ( BufrValueEncoding *be, const int64_t *ivals,
+                                                    double *dvals, int count );
+extern int            bufr_cvt_dval_to_i64_array  ( int desc, BufrValueEncoding *be, const double *dvals,
+                                                    uint64_t *ivals, int count );
+extern double         bufr_pow10                  ( int scale );
 
 extern int            bufr_get_tberror            ( BufrValueEncoding *be, int *reference, int *nbits );
 extern int            bufr_table_is_empty         ( BUFR_Tables *tbls );
+extern void           bufr_clear_tabled_expansions( BUFR_Tables *tbls );
 
 #ifdef __cplusplus
 }
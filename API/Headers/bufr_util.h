@@ -19,6 +19,8 @@
 #ifndef _bufr_util_h_
 #define _bufr_util_h_
 
+#include <stddef.h>
+
 extern char *strimdup              ( char *dest, const char *src, int maxlen );
 
 extern char *str_schar2oct         ( char *str, int *len, int *bsize );
@@ -29,6 +31,9 @@ extern void  append_char_to_string ( char **str, int *size, int *pos, unsigned c
 
 extern void  str_trimchar          ( char *str, char c );
 
+extern char *bufr_map_file         ( const char *filename, size_t *size, int *mapped );
+extern void  bufr_unmap_file       ( char *base, size_t size, int mapped );
+
 
 #if defined(__MINGW32__)
 
@@ -76,12 +76,14 @@ extern int            bufr_value_set_double     ( BufrValue *bv, double val );
 extern int            bufr_value_set_float      ( BufrValue *bv, float val );
 extern int            bufr_value_set_int32      ( BufrValue *bv, int32_t  val );
 extern int            bufr_value_set_int64      ( BufrValue *bv, int64_t  val );
+extern int            bufr_value_set_scaled     ( BufrValue *bv, int64_t scaled, int scale, double dval );
 
 extern const char    *bufr_value_get_string     ( const BufrValue *bv, int *len );
 extern double         bufr_value_get_double     ( const BufrValue *bv );
 extern int64_t        bufr_value_get_int64      ( const BufrValue *bv );
 extern float          bufr_value_get_float      ( const BufrValue *bv );
 extern int32_t        bufr_value_get_int32      ( const BufrValue *bv );
+extern int            bufr_value_get_scaled     ( const BufrValue *bv, int64_t *scaled, int *scale );
 
 
 extern int            bufr_print_value          ( char *str, const BufrValue * );
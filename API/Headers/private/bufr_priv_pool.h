@@ -0,0 +1,65 @@
+/*
+ *
+ *  file      :  BUFR_PRIV_POOL.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR PRIVATE POOLS OF FIXED SIZE CELLS
+ *
+ *
+ */
+
+#ifndef _bufr_priv_pool_h
+#define _bufr_priv_pool_h
+
+#include <stddef.h>
+#include <pthread.h>
+#include "private/bufr_priv_thread.h"
+
+/*
+ * a free cell; the head cell of a batch also links the next batch
+ */
+typedef struct bufr_pool_cell
+   {
+   struct bufr_pool_cell  *next;      /* NEXT FREE CELL */
+   struct bufr_pool_cell  *batch;     /* NEXT BATCH OF FREE CELLS */
+   long                    count;     /* NUMBER OF CELLS IN THE BATCH */
+   } BufrPoolCell;
+
+typedef struct bufr_pool
+   {
+   size_t           cell_size;   /* SIZE OF A CELL */
+   long             chunk_cells; /* NUMBER OF CELLS ALLOCATED AT ONCE */
+   pthread_mutex_t  lock;
+   BufrPoolCell    *batches;     /* FREE CELLS GIVEN BACK BY THREADS */
+   long             nchunks;     /* NUMBER OF CHUNKS ALLOCATED */
+   int              has_key;
+   pthread_key_t    key;
+   } BufrPool;
+
+/*
+ * free cells of one thread, to be declared BUFR_THREAD_LOCAL
+ */
+typedef struct bufr_pool_cache
+   {
+   BufrPoolCell    *free;        /* FREE CELLS OF THE THREAD */
+   long             nfree;       /* NUMBER OF THEM */
+   BufrPool        *pool;        /* POOL THEY ARE GIVEN BACK TO */
+   } BufrPoolCache;
+
+#define BUFR_POOL_CELL_SIZE(size) \
+   (((size) > sizeof(BufrPoolCell)) ? (size) : sizeof(BufrPoolCell))
+
+#define BUFR_POOL_INITIALIZER(size,chunk) \
+   { BUFR_POOL_CELL_SIZE(size), (chunk), PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 }
+
+extern void   *bufr_pool_alloc  ( BufrPool *pool, BufrPoolCache *cache );
+extern void    bufr_pool_free   ( BufrPool *pool, BufrPoolCache *cache, void *cell );
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ *
+ *  file      :  BUFR_PRIV_THREAD.H
+ *
+ *  author    :  Souvanlasy ViengSavanh
+ *
+ *  revision  :
+ *
+ *  status    :  DEVELOPMENT
+ *
+ *  language  :  C
+ *
+ *  object    :  HEADERS FILE FOR PRIVATE THREADING HELPERS OF THE LIBRARY
+ *
+ *
+ */
+
+#ifndef _bufr_priv_thread_h
+#define _bufr_priv_thread_h
+
+/*
+ * storage private to each thread, the free lists of the pools rely on it
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#define BUFR_THREAD_LOCAL  _Thread_local
+#elif defined(__GNUC__)
+#define BUFR_THREAD_LOCAL  __thread
+#else
+#error "thread local storage is required by the pools of the library"
+#endif
+
+/*
+ * reference counters of objects that may be shared between threads
+ * BUFR_ATOMIC_DECR returns the count left after the decrement
+ */
+#if defined(__ATOMIC_ACQ_REL)
+#define BUFR_ATOMIC_INCR(p)   __atomic_add_fetch( (p), 1, __ATOMIC_RELAXED )
+#define BUFR_ATOMIC_DECR(p)   __atomic_sub_fetch( (p), 1, __ATOMIC_ACQ_REL )
+#define BUFR_ATOMIC_LOAD(p)   __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define BUFR_ATOMIC_STORE(p,v)  __atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#elif defined(__GNUC__)
+#define BUFR_ATOMIC_INCR(p)   __sync_add_and_fetch( (p), 1 )
+#define BUFR_ATOMIC_DECR(p)   __sync_sub_and_fetch( (p), 1 )
+#define BUFR_ATOMIC_LOAD(p)   __sync_add_and_fetch( (p), 0 )
+#define BUFR_ATOMIC_STORE(p,v)  do { __sync_synchronize(); *(p) = (v); } while (0)
+#else
+#error "atomic builtins are required to share reference counted objects between threads"
+#endif
+
+#endif
@@ -49,19 +49,33 @@ typedef struct
    float              value;
    } ValueFLT32;
 
+/*
+ * scaled holds value * 10^scale as an integer when it is known exactly,
+ * ie. decoded bits plus reference or set with bufr_value_set_scaled
+ */
 typedef struct
    {
    ValueType         type;
    BufrAF            *af;
    double            value;
+   int64_t           scaled;
+   int16_t           scale;
+   int8_t            has_scaled;
    } ValueFLT64;
 
+/*
+ * strings up to this length are kept in the value itself, value then
+ * points to small
+ */
+#define VALSTRING_SMALL_LEN   15
+
 typedef struct
    {
    ValueType         type;
    BufrAF            *af;
    char             *value;
    int16_t           len;
+   char              small[VALSTRING_SMALL_LEN+1];
    } ValueSTRING;
 
 #endif
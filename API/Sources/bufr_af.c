@@ -33,6 +33,7 @@ This file is part of libECBUFR.
 #include "bufr_afd.h"
 #include "bufr_value.h"
 #include "bufr_i18n.h"
+#include "private/bufr_priv_thread.h"
 
 static void bufr_copy_af( BufrAF *dest, const BufrAF *src );
 static void bufr_copy_afd( BufrAFD *dest, const BufrAFD *src );
@@ -204,6 +205,7 @@ BufrAFD  *bufr_create_afd( const int *blens, int count )
 
    afd = (BufrAFD *)malloc(sizeof(BufrAFD));
    afd->count       = count;
+   afd->refcount    = 1;
    afd->defs = (AF_Definition *)malloc( count * sizeof(AF_Definition));
 
    nbits = 0;
@@ -249,6 +251,26 @@ BufrAFD  *bufr_duplicate_afd( const BufrAFD *dup )
 
 /**
  * @english
+ * add a reference to an BufrAFD structure, it is never modified once
+ * created so descriptors of the same template can hold the same one
+ * @param  afd     pointer to  BufrAFD
+ * @return the same pointer
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+BufrAFD  *bufr_share_afd( BufrAFD *afd )
+   {
+   if (afd) BUFR_ATOMIC_INCR( &(afd->refcount) );
+   return afd;
+   }
+
+/**
+ * @english
+ * release a reference to an BufrAFD, freeing it with the last one
  * @param  afd     pointer to  BufrAFD
  * @endenglish
  * @francais
@@ -259,6 +281,8 @@ BufrAFD  *bufr_duplicate_afd( const BufrAFD *dup )
  */
 void bufr_free_afd( BufrAFD *afd )
    {
+   if (BUFR_ATOMIC_DECR( &(afd->refcount) ) > 0) return;
+
    if (afd->defs)
       {
       free( afd->defs );
@@ -44,6 +44,7 @@ This file is part of libECBUFR.
 #define   FLAG_BITS (TLC_FLAG_BIT|QUAL_FLAG_BIT|CB_FLAG_BIT)
 
 int  bufr_meta_enabled=1;
+int  bufr_nb_threads=1;
 
 typedef struct {
 	BufrValue val;
@@ -51,6 +52,19 @@ typedef struct {
 	void* data;
 } ValueCallback;
 
+/*
+ * search keys split by kind, as positions in the keys given
+ */
+#define   FIND_KEYS_MAX     16
+
+typedef struct {
+	BufrDescValue *codes;
+	int *tlc, *qual, *desc;
+	int nb_tlc, nb_qual, nb_desc;
+} FindKeys;
+
+static int bufr_match_sequence( BufrDescriptor **pcb, const FindKeys *keys );
+
 /**
  * @english
  * Initializes mathematical constants, calls bufr_init_limits.
@@ -136,10 +150,28 @@ void bufr_enable_meta(int mode)
    bufr_meta_enabled = mode;
    }
 
+/**
+ * bufr_set_threads
+ * @english
+ * set the number of threads the library may use to encode a message,
+ * 1 (the default) encodes serially
+ * @endenglish
+ * @francais
+ * nombre de fils d'execution utilises pour encoder un message
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup api
+ */
+void bufr_set_threads(int nb)
+   {
+   bufr_nb_threads = (nb > 1) ? nb : 1;
+   }
+
 /**
  * bufr_subset_find_descriptor
  * @english
- * find the position of a descriptor in a data subset
+ * find the position of a descriptor in a data subset, looked up in its
+ * position index when built by bufr_datasubset_build_index
  * @endenglish
  * @francais
  * Trouver la position d'un descripteur dans un sous-jeu (subset) de donnes
@@ -150,6 +182,7 @@ void bufr_enable_meta(int mode)
 int bufr_subset_find_descriptor( DataSubset *dts, int descriptor, int startpos )
    {
    BufrDescriptor  **pcb, *cb;
+   const int        *positions;
    int  count;
    int  i;
 
@@ -158,6 +191,11 @@ int bufr_subset_find_descriptor( DataSubset *dts, int descriptor, int startpos )
    if (startpos < 0) startpos = 0;
 
    if (startpos >= count) return -1;
+/*
+ * an indexed datasubset knows the positions of the descriptor
+ */
+   i = bufr_datasubset_find_positions( dts, descriptor, startpos, &positions );
+   if (i >= 0) return (i > 0) ? positions[0] : -1;
 
    pcb = (BufrDescriptor **)arr_get( dts->data, 0 );
    for (i = startpos; i < count ; i++)
@@ -180,8 +218,9 @@ int bufr_subset_find_descriptor( DataSubset *dts, int descriptor, int startpos )
  * codes that are part of the search keys, and those values must be found
  * in the codes for this to be a successful call. All of the codes in the
  * sequence must be found in order for this to be a successful call, no
- * other values may be inserted.
- * @warning Not thread-safe
+ * other values may be inserted. When the datasubset is indexed by
+ * bufr_datasubset_build_index, only the positions of the first descriptor
+ * are tried. This call is thread-safe.
  * @return Int, If the values are all found, it is greater to or equal to
  * 0, else nothing is found.
  * @endenglish
@@ -196,7 +235,7 @@ int bufr_subset_find_descriptor( DataSubset *dts, int descriptor, int startpos )
  * tre retrouves dans les codes pour que l'appel  la fonction russisse. Tous les codes
  * dans la squence de recherche doivent tre trouvs pour que l'appel russisse, aucune
  * autre valeur ne peut tre insre.
- * @warning Le fil d'excution n'est pas scuris (not thread-safe)
+ * Le fil d'excution de cet appel est scuris (thread-safe).
  * @return Int Une valeur positive ou gale  zro indique le succs. 
  * @endfrancais
  * @author Vanh Souvanlasy
@@ -204,15 +243,13 @@ int bufr_subset_find_descriptor( DataSubset *dts, int descriptor, int startpos )
  */
 int bufr_subset_find_values( DataSubset *dts, BufrDescValue *codes, int nb, int startpos )
    {
-   BufrDescriptor  **pcb, *cb;
-   int         count;
-   int         i, j, lj, k, jj;
-   double      scale;
-   double      epsilon;
-	int nb_tlc = 0, nb_qual = 0, nb_desc = 0;
-	BufrDescValue* tlc = NULL;
-	BufrDescValue* qual = NULL;
-	BufrDescValue* desc = NULL;
+   BufrDescriptor  **pcb;
+   FindKeys          keys;
+   int               buf[3*FIND_KEYS_MAX];
+   int              *kbuf;
+   const int        *positions;
+   int               count;
+   int               i, j, n, pos;
 
    if (dts == NULL) return -1;
    count = arr_count( dts->data );
@@ -224,195 +261,171 @@ int bufr_subset_find_values( DataSubset *dts, BufrDescValue *codes, int nb, int
       return -1;
    if (nb == 0) return startpos;
 
-	/* Break the query keys into three lists. We check TLC and qualifiers
-	 * against every element, and check descriptors sequentially.
+	/* Break the query keys into three lists of positions in codes. We check
+	 * TLC and qualifiers against every element, and check descriptors
+	 * sequentially. Nothing static nor shared is written, small lists stay
+	 * on the stack.
 	 */
+   kbuf = (nb <= FIND_KEYS_MAX) ? buf : (int *)malloc( 3 * nb * sizeof(int) );
+   if (kbuf == NULL) return -1;
+   keys.codes = codes;
+   keys.tlc   = kbuf;
+   keys.qual  = kbuf + nb;
+   keys.desc  = kbuf + 2 * nb;
+   keys.nb_tlc = keys.nb_qual = keys.nb_desc = 0;
 	for( j = 0; j < nb; j ++ )
 		{
 		if( codes[j].descriptor & TLC_FLAG_BIT )
-			{
-			/* NOTE: we're overallocating, but we're nicely bounded by nb */
-			if( tlc == NULL ) tlc = calloc(nb,sizeof(BufrDescValue));
-			if( tlc == NULL ) return -1;
-			memcpy(&tlc[nb_tlc], &codes[j], sizeof(BufrDescValue));
-			tlc[nb_tlc].descriptor &= ~TLC_FLAG_BIT;
-			nb_tlc ++;
-			}
+			keys.tlc[keys.nb_tlc++] = j;
 		else if( codes[j].descriptor & QUAL_FLAG_BIT )
-			{
-			if( qual == NULL ) qual = calloc(nb,sizeof(BufrDescValue));
-			if( qual == NULL ) return -1;
-			memcpy(&qual[nb_qual], &codes[j], sizeof(BufrDescValue));
-			/* Note: leave CB_FLAG_BIT alone */
-			qual[nb_qual].descriptor &= ~QUAL_FLAG_BIT;
-			nb_qual ++;
-			}
+			keys.qual[keys.nb_qual++] = j;
 		else
-			{
-			if( desc == NULL ) desc = calloc(nb,sizeof(BufrDescValue));
-			if( desc == NULL ) return -1;
-			memcpy(&desc[nb_desc++], &codes[j], sizeof(BufrDescValue));
-			}
+			keys.desc[keys.nb_desc++] = j;
 		}
 
-	/* Basic strategy for searching and handling searching failures...
-	 * When we find a "first" match for the sequence, we want jj to
-	 * indicate this starting position. j indicates which descriptor in
-	 * the search list we're currently supposed to see in the subset, and
-	 * this gets incremented for each subsequent match.
-	 * We return jj once we've found all nb_desc descriptors.
-	 * When we fail a match, jj has to be cleared. _But_ we don't want
-	 * to just continue the search at the current "i" position. We
-	 * actually want to bounce back to jj+1, which is accomplished
-	 * by assigning i=jj and letting the loop increment.
-	 * Note that the trivial case, nb_desc==0, pretty much bypasses the
-	 * loop and we return startpos.
+	/* The first position from startpos where every descriptor key matches
+	 * in sequence, no other descriptor inserted. When the datasubset is
+	 * indexed, only the positions of the first key are tried.
+	 * Note that the trivial case, nb_desc==0, returns startpos.
 	 */
+   pos = -1;
+   if (keys.nb_desc == 0)
+      {
+      pos = startpos;
+      }
+   else
+      {
+      pcb = (BufrDescriptor **)arr_get( dts->data, 0 );
+      n = bufr_datasubset_find_positions( dts, codes[keys.desc[0]].descriptor&(~FLAG_BITS),
+                                          startpos, &positions );
+      if (n >= 0)
+         {
+         for (i = 0; (i < n)&&(positions[i] + keys.nb_desc <= count) ; i++)
+            {
+            if (bufr_match_sequence( pcb + positions[i], &keys ))
+               {
+               pos = positions[i];
+               break;
+               }
+            }
+         }
+      else
+         {
+         for (i = startpos; i + keys.nb_desc <= count ; i++)
+            {
+            if (bufr_match_sequence( pcb + i, &keys ))
+               {
+               pos = i;
+               break;
+               }
+            }
+         }
+      }
 
-   pcb = (BufrDescriptor **)arr_get( dts->data, 0 );
-   lj = j = 0;
-   jj = startpos;
-   for (i = startpos; j < nb_desc && i < count ; i++)
+   if (kbuf != buf) free( kbuf );
+   return pos;
+   }
+
+/**
+ * @english
+ * check that the descriptor keys match in sequence from the first
+ * descriptor given, with the TLC and qualifier keys on each
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_match_sequence( BufrDescriptor **pcb, const FindKeys *keys )
+   {
+   BufrDescriptor  *cb;
+   BufrDescValue   *key;
+   int              j, k;
+   double           scale;
+   double           epsilon;
+
+   for (j = 0; j < keys->nb_desc ; j++)
       {
-      cb = pcb[i];
+      cb = pcb[j];
+      key = &(keys->codes[keys->desc[j]]);
 
 		/* this is a cheap test... do it before we check the lists */
-      if (cb->descriptor != (desc[j].descriptor&(~FLAG_BITS))) 
-			{
-			if( jj>=0 ) i = jj;
-			jj = -1;
-			j = 0;
-			continue;
-			}
+      if (cb->descriptor != (key->descriptor&(~FLAG_BITS))) return 0;
 
 		/* check TLC. Note that if we're looking for a TLC code and the
 		 * descriptor has no meta-data, it becomes a fail.
 		 */
-		for( k=0; cb->meta && k<nb_tlc; k++ )
+		if( keys->nb_tlc > 0 && cb->meta == NULL ) return 0;
+		for( k=0; k<keys->nb_tlc; k++ )
 			{
-			float v1 = bufr_value_get_float( tlc[k].values[0] );
-			float v2 = bufr_fetch_rtmd_location( tlc[k].descriptor, cb->meta );
-         if( v1 != v2 )
-				{
-				break;
-				}
-			}
-		if( k<nb_tlc )
-			{
-			if( jj>=0 ) i = jj;
-			jj = -1;
-			j = 0;
-			continue;
+			BufrDescValue* tlc = &(keys->codes[keys->tlc[k]]);
+			float v1 = bufr_value_get_float( tlc->values[0] );
+			float v2 = bufr_fetch_rtmd_location( tlc->descriptor&(~TLC_FLAG_BIT), cb->meta );
+         if( v1 != v2 ) return 0;
 			}
 
 		/* check qualifiers (and non TLC meta-data) */
-		for( k=0; k<nb_qual; k++ )
+		for( k=0; k<keys->nb_qual; k++ )
 			{
-			if( qual[k].descriptor & CB_FLAG_BIT )
+			BufrDescValue* qual = &(keys->codes[keys->qual[k]]);
+			if( qual->descriptor & CB_FLAG_BIT )
 				{
-				ValueCallback* bv = (ValueCallback*) qual[k].values[0];
-				if( bv== NULL || bv->valcmp(bv->data, cb) ) break;
+				ValueCallback* bv = (ValueCallback*) qual->values[0];
+				if( bv== NULL || bv->valcmp(bv->data, cb) ) return 0;
 				}
 			else if(cb->meta)
 				{
 				BufrDescriptor* qd = bufr_fetch_rtmd_qualifier(
-					qual[k].descriptor&(~FLAG_BITS), cb->meta);
-				if( qd == NULL ) break;
+					qual->descriptor&(~FLAG_BITS), cb->meta);
+				if( qd == NULL ) return 0;
 
-				scale = cb->encoding.scale ? pow(10,(double)cb->encoding.scale) : 1;
+				scale = bufr_pow10( cb->encoding.scale );
 				epsilon = 0.5 / scale;
 					
-				if( bufr_compare_value( qd->value, qual[k].values[0], epsilon ) )
-					{
-					break;
-					}
+				if( bufr_compare_value( qd->value, qual->values[0], epsilon ) )
+					return 0;
 				}
 			else
 				{
-				break;
+				return 0;
 				}
 			}
-		if( k<nb_qual )
-			{
-			if( jj>=0 ) i = jj;
-			jj = -1;
-			j = 0;
-			continue;
-			}
 
 		/* If we got here, all our qualifiers match. Now it's just straight
 		 * value checking. If there's no value defined for the match, it's
 		 * obviously good. Otherwise, we get into the weeds.
 		 */
-
-		/* if we find a match, j should be incremented. If it isn't, no match,
-		 * and we don't have to pepper failure handling in all our conditions.
-		 */
-		lj = j;
-
-		if( desc[j].descriptor&CB_FLAG_BIT && desc[j].nbval>0 )
+		if( key->descriptor&CB_FLAG_BIT && key->nbval>0 )
 			{
-			/* callback match */
-			ValueCallback* bv = (ValueCallback*) desc[j].values[0];
-			if( 0 == bv->valcmp(bv->data, cb) )
-				{
-				/* callback returned zero, so it's a match */
-				++j;
-				}
+			/* callback match, returns zero on a match */
+			ValueCallback* bv = (ValueCallback*) key->values[0];
+			if( bv->valcmp(bv->data, cb) ) return 0;
 			}
-		else if (desc[j].nbval > 0)
+		else if (key->nbval > 0)
 			{
-			scale = cb->encoding.scale ? pow(10, (double)cb->encoding.scale) : 1;
+			scale = bufr_pow10( cb->encoding.scale );
 			epsilon = 0.5 / scale;
 
-			if (cb->value)
+			if (cb->value == NULL) return 0;
+			if (key->nbval != 2)
 				{
-				if (desc[j].nbval != 2)
-					{
-					for (k = 0 ; k < desc[j].nbval ; k++)
-						{
-						if (bufr_compare_value( cb->value, desc[j].values[k],
-								epsilon ) == 0)
-							{
-							++j;
-							break;
-							}
-						}
-					}
-				else if (desc[j].nbval == 2)
+				for (k = 0 ; k < key->nbval ; k++)
 					{
-					if (bufr_between_values( desc[j].values[0], cb->value,
-							desc[j].values[1] ) == 1)
-						{
-						++j;
-						}
+					if (bufr_compare_value( cb->value, key->values[k],
+							epsilon ) == 0)
+						break;
 					}
+				if (k == key->nbval) return 0;
+				}
+			else if (bufr_between_values( key->values[0], cb->value,
+						key->values[1] ) != 1)
+				{
+				return 0;
 				}
-			}
-		else
-			{
-			++j;
-			}
-
-		if( lj == j )
-			{
-			/* j never got incremented, which means we failed to match */
-			if( jj>=0 ) i = jj;
-			jj = -1;
-			j = 0;
-			}
-		else
-			{
-			/* we had a match */
-			if( jj<0 ) jj = i;
 			}
       }
-
-	if( desc ) free(desc);
-	if( qual ) free(qual);
-	if( tlc ) free(tlc);
-
-   return (j==nb_desc) ? jj : -1;
+   return 1;
    }
 
 /**
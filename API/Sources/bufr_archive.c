@@ -0,0 +1,977 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_archive.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: index spatio-temporel d'archives de messages BUFR
+ *
+ * Each message of an archive is recorded with its offset, the bounding
+ * box of its latitudes (005001, 005002) and longitudes (006001, 006002),
+ * the time range of its subsets (004001 to 004006, else section 1) and
+ * its station identifiers (001001 and 001002, else the first class 01
+ * string). Compressed messages are read from their blocks without being
+ * decoded. Messages are found by a grid of 10 degrees cells, each cell
+ * sorted by start time, so that a query only compares messages near the
+ * box and time window. Longitudes are not wrapped around 180.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+#include "bufr_archive.h"
+#include "bufr_api.h"
+#include "bufr_i18n.h"
+
+/*
+ * elements of the subset being scanned
+ */
+typedef struct
+   {
+   BufrArchiveEntry  *entry;
+   int                parts[6];       /* YEAR, MONTH, DAY, HOUR, MINUTE, SECOND */
+   int                s1parts[6];
+   int                block, number;
+   char               station[ARCHIVE_STATION_LEN];
+   } ArchiveScan;
+
+/*
+ * an entry of a grid cell, while sorting
+ */
+typedef struct
+   {
+   int64_t            time_min;
+   int                entry;
+   } ArchiveCellItem;
+
+static void     bufr_archive_begin_subset ( ArchiveScan *scan );
+static void     bufr_archive_element      ( ArchiveScan *scan, int descriptor, double dval, const char *str );
+static void     bufr_archive_end_subset   ( ArchiveScan *scan );
+static void     bufr_archive_add_station  ( BufrArchiveEntry *entry, const char *str );
+static int      bufr_archive_scan_blocks  ( ArchiveScan *scan, BUFR_Message *msg, BUFR_Tables *tables );
+static void     bufr_archive_scan_subsets ( ArchiveScan *scan, BUFR_Dataset *dts );
+static void     bufr_archive_begin_entry  ( ArchiveScan *scan, BufrArchiveEntry *entry,
+                                            BUFR_Message *msg, long offset );
+static int      bufr_archive_end_entry    ( BufrArchiveIndex *idx, ArchiveScan *scan );
+static void     bufr_archive_build_grid   ( BufrArchiveIndex *idx );
+static int      bufr_archive_cell         ( double lat, double lon );
+static int      compare_cell_items        ( const void *p1, const void *p2 );
+static int      bufr_archive_entry_match  ( BufrArchiveEntry *e, double lat_min, double lat_max,
+                                            double lon_min, double lon_max,
+                                            int64_t time_from, int64_t time_to, const char *station );
+
+/**
+ * @english
+ * @brief create an empty archive index
+ * @return the index, to free with bufr_free_archive_index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_add_file, bufr_archive_index_query
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrArchiveIndex *bufr_create_archive_index( void )
+   {
+   BufrArchiveIndex  *idx;
+
+   idx = (BufrArchiveIndex *)malloc( sizeof(BufrArchiveIndex) );
+   idx->entries  = arr_create( 256, sizeof(BufrArchiveEntry), 256 );
+   idx->cells    = NULL;
+   idx->first    = NULL;
+   idx->max_span = 0;
+   return idx;
+   }
+
+/**
+ * @english
+ * @brief free an archive index
+ * @param idx  the index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_free_archive_index( BufrArchiveIndex *idx )
+   {
+   BufrArchiveEntry  *entries;
+   int                i, k, count;
+
+   if (idx == NULL) return;
+
+   count = arr_count( idx->entries );
+   entries = (BufrArchiveEntry *)arr_get( idx->entries, 0 );
+   for (i = 0; i < count ; i++)
+      {
+      for (k = 0; k < entries[i].nb_stations ; k++)
+         free( entries[i].stations[k] );
+      if (entries[i].stations) free( entries[i].stations );
+      }
+   arr_free( &(idx->entries) );
+   if (idx->cells) free( idx->cells );
+   if (idx->first) free( idx->first );
+   free( idx );
+   }
+
+/**
+ * @english
+ * @brief add the extent of a message to an archive index
+ *
+ * A compressed message is read from its blocks, any other message is
+ * decoded. A message that cannot be read keeps the time of section 1
+ * and no location, it is then a candidate of any query on its time.
+ * @param idx  the index
+ * @param msg  the message
+ * @param tables  tables used to decode it
+ * @param offset  position of the message in its file
+ * @return number of entries of the index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_add_file
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_archive_index_add_message( BufrArchiveIndex *idx, BUFR_Message *msg, BUFR_Tables *tables, long offset )
+   {
+   BufrArchiveEntry   entry;
+   ArchiveScan        scan;
+   BUFR_Dataset      *dts;
+   int                rtrn;
+
+   if ((idx == NULL)||(msg == NULL)) return -1;
+
+   bufr_archive_begin_entry( &scan, &entry, msg, offset );
+   rtrn = -1;
+   if (BUFR_IS_COMPRESSED( msg ))
+      rtrn = bufr_archive_scan_blocks( &scan, msg, tables );
+   if (rtrn < 0)
+      {
+      dts = bufr_decode_message( msg, tables );
+      if (dts != NULL)
+         {
+         bufr_archive_scan_subsets( &scan, dts );
+         bufr_free_dataset( dts );
+         }
+      }
+   return bufr_archive_end_entry( idx, &scan );
+   }
+
+/**
+ * @english
+ * @brief add the extent of an already decoded message to an archive index
+ *
+ * To be used while decoding an archive, the message is not read again.
+ * @param idx  the index
+ * @param msg  the message
+ * @param dts  its decoded dataset, or NULL if it could not be decoded
+ * @param offset  position of the message in its file
+ * @return number of entries of the index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_add_message
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_archive_index_add_dataset( BufrArchiveIndex *idx, BUFR_Message *msg, BUFR_Dataset *dts, long offset )
+   {
+   BufrArchiveEntry   entry;
+   ArchiveScan        scan;
+
+   if ((idx == NULL)||(msg == NULL)) return -1;
+
+   bufr_archive_begin_entry( &scan, &entry, msg, offset );
+   if (dts != NULL)
+      bufr_archive_scan_subsets( &scan, dts );
+   return bufr_archive_end_entry( idx, &scan );
+   }
+
+/**
+ * @english
+ * @brief add every message of a file to an archive index
+ * @param idx  the index
+ * @param fp  the file, read from its current position
+ * @param tables  tables used to decode the messages
+ * @return number of messages added, -1 if the file is not seekable
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_add_message
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_archive_index_add_file( BufrArchiveIndex *idx, FILE *fp, BUFR_Tables *tables )
+   {
+   BUFR_Message  *msg;
+   int            count;
+
+   if ((idx == NULL)||(fp == NULL)) return -1;
+   if (ftell( fp ) < 0) return -1;
+
+   count = 0;
+   while (bufr_read_message( fp, &msg ) > 0)
+      {
+      bufr_archive_index_add_message( idx, msg, tables, msg->offset );
+      bufr_free_message( msg );
+      ++count;
+      }
+   return count;
+   }
+
+/**
+ * @english
+ * @brief find the messages that may hold subsets in a box and time window
+ *
+ * Messages are candidates when their extents overlap the box and the
+ * window, any of their subsets may be outside. Messages without location
+ * are candidates of any box.
+ * @param idx  the index
+ * @param lat_min  south limit of the box
+ * @param lat_max  north limit of the box
+ * @param lon_min  west limit of the box, in -180 to 180
+ * @param lon_max  east limit of the box, in -180 to 180
+ * @param time_from  start of the window, as given by bufr_archive_time
+ * @param time_to  end of the window
+ * @param station  station identifier to find, or NULL for any
+ * @param offsets  receives the offsets of the messages in the order they
+ * were added, to free
+ * @return number of messages found
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_add_file
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_archive_index_query( BufrArchiveIndex *idx, double lat_min, double lat_max,
+                              double lon_min, double lon_max, int64_t time_from, int64_t time_to,
+                              const char *station, long **offsets )
+   {
+   BufrArchiveEntry  *entries, *e;
+   char              *found;
+   char               name[ARCHIVE_STATION_LEN];
+   int                count, nb, i, j, c, lo, hi, mid;
+   int                c0, c1;
+   int64_t            earliest;
+
+   *offsets = NULL;
+   if (idx == NULL) return -1;
+   count = arr_count( idx->entries );
+   if (count == 0) return 0;
+
+   if (idx->first == NULL) bufr_archive_build_grid( idx );
+   if (station)
+      {
+      bufr_archive_station_id( name, station );
+      station = name;
+      }
+
+   entries = (BufrArchiveEntry *)arr_get( idx->entries, 0 );
+   earliest = (time_from > INT64_MIN + idx->max_span) ? time_from - idx->max_span : INT64_MIN;
+   found = (char *)calloc( count, 1 );
+   c0 = bufr_archive_cell( lat_min, lon_min );
+   c1 = bufr_archive_cell( lat_max, lon_max );
+   for (c = 0; c <= ARCHIVE_GRID_CELLS ; c++)
+      {
+/*
+ * cells of the box, then those without location
+ */
+      if ((c < ARCHIVE_GRID_CELLS)&&
+          ((c / ARCHIVE_GRID_LON < c0 / ARCHIVE_GRID_LON)||(c / ARCHIVE_GRID_LON > c1 / ARCHIVE_GRID_LON)||
+           (c % ARCHIVE_GRID_LON < c0 % ARCHIVE_GRID_LON)||(c % ARCHIVE_GRID_LON > c1 % ARCHIVE_GRID_LON)))
+         continue;
+/*
+ * the first entry that can still end within the window
+ */
+      lo = idx->first[c];
+      hi = idx->first[c+1];
+      while (lo < hi)
+         {
+         mid = (lo + hi) / 2;
+         if (entries[idx->cells[mid]].time_min < earliest)
+            lo = mid + 1;
+         else
+            hi = mid;
+         }
+      for (j = lo; j < idx->first[c+1] ; j++)
+         {
+         i = idx->cells[j];
+         e = &(entries[i]);
+         if (e->time_min > time_to) break;
+         if (found[i]) continue;
+         found[i] = bufr_archive_entry_match( e, lat_min, lat_max, lon_min, lon_max,
+                                              time_from, time_to, station );
+         }
+      }
+
+   nb = 0;
+   for (i = 0; i < count ; i++)
+      if (found[i]) ++nb;
+   if (nb > 0)
+      {
+      *offsets = (long *)malloc( nb * sizeof(long) );
+      for (i = 0, j = 0; i < count ; i++)
+         if (found[i]) (*offsets)[j++] = entries[i].offset;
+      }
+   free( found );
+   return nb;
+   }
+
+/**
+ * @english
+ * @brief write an archive index as text, one message per line
+ * @param idx  the index
+ * @param fp  the file
+ * @return number of messages written
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_read
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_archive_index_write( BufrArchiveIndex *idx, FILE *fp )
+   {
+   BufrArchiveEntry  *e;
+   int                i, k, count;
+
+   if ((idx == NULL)||(fp == NULL)) return -1;
+
+   count = arr_count( idx->entries );
+   fprintf( fp, "BUFR_ARCHIVE_INDEX 1 %d\n", count );
+   for (i = 0; i < count ; i++)
+      {
+      e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+      fprintf( fp, "%ld %d %d %.5f %.5f %.5f %.5f %lld %lld %d",
+               e->offset, e->length, e->flags, e->lat_min, e->lat_max, e->lon_min, e->lon_max,
+               (long long)e->time_min, (long long)e->time_max, e->nb_stations );
+      for (k = 0; k < e->nb_stations ; k++)
+         fprintf( fp, " %s", e->stations[k] );
+      fprintf( fp, "\n" );
+      }
+   return count;
+   }
+
+/**
+ * @english
+ * @brief read an archive index written by bufr_archive_index_write
+ * @param fp  the file
+ * @return the index, NULL if the file is not an index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_index_write
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrArchiveIndex *bufr_archive_index_read( FILE *fp )
+   {
+   BufrArchiveIndex  *idx;
+   BufrArchiveEntry   entry;
+   char               name[ARCHIVE_STATION_LEN];
+   char               namefmt[16];
+   long long          tmin, tmax;
+   int                version, count, i, k, nb;
+
+   if (fp == NULL) return NULL;
+/*
+ * station names are read at most as long as they were written
+ */
+   snprintf( namefmt, sizeof(namefmt), " %%%ds", ARCHIVE_STATION_LEN - 1 );
+   if ((fscanf( fp, "BUFR_ARCHIVE_INDEX %d %d", &version, &count ) != 2)||(version != 1))
+      {
+      bufr_print_debug( _("Error: not an archive index\n") );
+      return NULL;
+      }
+
+   idx = bufr_create_archive_index();
+   for (i = 0; i < count ; i++)
+      {
+      memset( &entry, 0, sizeof(BufrArchiveEntry) );
+      if (fscanf( fp, "%ld %d %d %lf %lf %lf %lf %lld %lld %d",
+                  &(entry.offset), &(entry.length), &(entry.flags),
+                  &(entry.lat_min), &(entry.lat_max), &(entry.lon_min), &(entry.lon_max),
+                  &tmin, &tmax, &nb ) != 10)
+         {
+         bufr_print_debug( _("Error: archive index is truncated\n") );
+         bufr_free_archive_index( idx );
+         return NULL;
+         }
+      entry.time_min = tmin;
+      entry.time_max = tmax;
+      for (k = 0; k < nb ; k++)
+         {
+         if (fscanf( fp, namefmt, name ) != 1) break;
+         bufr_archive_add_station( &entry, name );
+         }
+      if (entry.time_max - entry.time_min > idx->max_span)
+         idx->max_span = entry.time_max - entry.time_min;
+      arr_add( idx->entries, (char *)&entry );
+      }
+   return idx;
+   }
+
+/**
+ * @english
+ * @brief seconds since 1970-01-01 UTC of a date and time
+ * @return the time, in the proleptic gregorian calendar
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int64_t bufr_archive_time( int year, int month, int day, int hour, int minute, int second )
+   {
+   int64_t  y, era, yoe, doy, doe, days;
+   int      m;
+
+   y = year - ((month <= 2) ? 1 : 0);
+   m = month;
+   era = ((y >= 0) ? y : y - 399) / 400;
+   yoe = y - era * 400;
+   doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   days = era * 146097 + doe - 719468;
+   return ((days * 24 + hour) * 60 + minute) * 60 + second;
+   }
+
+/**
+ * @english
+ * @brief the time of an hour given as YYYYMMDDHH
+ *
+ * Meant for the hour searched with the Bloom filters of a sidecar.
+ * @param str  the hour
+ * @return the time as given by bufr_archive_time, or INT64_MIN, which is
+ * BLOOM_ANY_TIME, if str is not an hour
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_archive_time
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int64_t bufr_archive_hour( const char *str )
+   {
+   int  year, month, day, hour;
+
+   if ((str == NULL)||(sscanf( str, "%4d%2d%2d%2d", &year, &month, &day, &hour ) != 4))
+      return INT64_MIN;
+   return bufr_archive_time( year, month, day, hour, 0, 0 );
+   }
+
+/**
+ * @english
+ * @brief a station identifier as kept by the index
+ *
+ * Leading and trailing blanks are removed, inner blanks and non
+ * printable characters are replaced by underscores.
+ * @param dst  receives the identifier, of ARCHIVE_STATION_LEN characters
+ * @param str  the identifier as given or decoded
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_archive_station_id( char *dst, const char *str )
+   {
+   int  i, len;
+
+   while (isspace( (unsigned char)*str )) ++str;
+   len = strlen( str );
+   while ((len > 0)&&isspace( (unsigned char)str[len-1] )) --len;
+   if (len >= ARCHIVE_STATION_LEN) len = ARCHIVE_STATION_LEN - 1;
+   for (i = 0; i < len ; i++)
+      dst[i] = (isspace( (unsigned char)str[i] )||!isprint( (unsigned char)str[i] )) ? '_' : str[i];
+   dst[len] = '\0';
+   }
+
+/**
+ * @english
+ * start scanning a subset, time parts are unknown
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_begin_subset( ArchiveScan *scan )
+   {
+   int  i;
+
+   for (i = 0; i < 6 ; i++)
+      scan->parts[i] = -1;
+   scan->block  = -1;
+   scan->number = -1;
+   scan->station[0] = '\0';
+   }
+
+/**
+ * @english
+ * record one element of the subset being scanned, dval is
+ * bufr_get_max_double() if missing, str is NULL if not a string
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_element( ArchiveScan *scan, int descriptor, double dval, const char *str )
+   {
+   BufrArchiveEntry  *e = scan->entry;
+
+   if (str != NULL)
+      {
+      if ((descriptor / 1000 == 1)&&(scan->station[0] == '\0'))
+         bufr_archive_station_id( scan->station, str );
+      return;
+      }
+   if (dval == bufr_get_max_double()) return;
+
+   switch( descriptor )
+      {
+      case 1001 :
+         if (scan->block < 0) scan->block = (int)dval;
+         break;
+      case 1002 :
+         if (scan->number < 0) scan->number = (int)dval;
+         break;
+      case 4001 : case 4002 : case 4003 :
+      case 4004 : case 4005 : case 4006 :
+         if (scan->parts[descriptor-4001] < 0) scan->parts[descriptor-4001] = (int)dval;
+         break;
+      case 5001 :
+      case 5002 :
+         if (!(e->flags & ARCHIVE_HAS_LOCATION))
+            {
+            e->lat_min = e->lon_min = 1.0e9;
+            e->lat_max = e->lon_max = -1.0e9;
+            e->flags |= ARCHIVE_HAS_LOCATION;
+            }
+         if (dval < e->lat_min) e->lat_min = dval;
+         if (dval > e->lat_max) e->lat_max = dval;
+         break;
+      case 6001 :
+      case 6002 :
+         if (!(e->flags & ARCHIVE_HAS_LOCATION))
+            {
+            e->lat_min = e->lon_min = 1.0e9;
+            e->lat_max = e->lon_max = -1.0e9;
+            e->flags |= ARCHIVE_HAS_LOCATION;
+            }
+         if (dval < e->lon_min) e->lon_min = dval;
+         if (dval > e->lon_max) e->lon_max = dval;
+         break;
+      default :
+         break;
+      }
+   }
+
+/**
+ * @english
+ * add the time and station of the scanned subset to its message,
+ * missing date parts are taken from section 1
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_end_subset( ArchiveScan *scan )
+   {
+   BufrArchiveEntry  *e = scan->entry;
+   char               str[ARCHIVE_STATION_LEN];
+   int64_t            t;
+   int                i;
+
+   if ((scan->block >= 0)&&(scan->number >= 0))
+      {
+      snprintf( str, sizeof(str), "%02d%03d", scan->block, scan->number );
+      bufr_archive_add_station( e, str );
+      }
+   else if (scan->station[0] != '\0')
+      {
+      bufr_archive_add_station( e, scan->station );
+      }
+
+   if (scan->parts[0] < 0) return;
+   for (i = 1; i < 6 ; i++)
+      if (scan->parts[i] < 0) scan->parts[i] = (i < 3) ? scan->s1parts[i] : 0;
+   t = bufr_archive_time( scan->parts[0], scan->parts[1], scan->parts[2],
+                          scan->parts[3], scan->parts[4], scan->parts[5] );
+   if (!(e->flags & ARCHIVE_HAS_TIME))
+      {
+      e->time_min = e->time_max = t;
+      e->flags |= ARCHIVE_HAS_TIME;
+      }
+   if (t < e->time_min) e->time_min = t;
+   if (t > e->time_max) e->time_max = t;
+   }
+
+/**
+ * @english
+ * add a station to a message if it does not hold it yet
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_add_station( BufrArchiveEntry *entry, const char *str )
+   {
+   int  k;
+
+   if (str[0] == '\0') return;
+   for (k = 0; k < entry->nb_stations ; k++)
+      if (strcmp( entry->stations[k], str ) == 0) return;
+
+   entry->stations = (char **)realloc( entry->stations, (entry->nb_stations + 1) * sizeof(char *) );
+   entry->stations[entry->nb_stations++] = strdup( str );
+   }
+
+/**
+ * @english
+ * scan the subsets of a compressed message from its blocks,
+ * only the positions of the indexed descriptors are read
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_archive_scan_blocks( ArchiveScan *scan, BUFR_Message *msg, BUFR_Tables *tables )
+   {
+   BufrBlockIndex   *idx;
+   BufrDescriptor   *bd;
+   DataSubset       *layout;
+   int              *positions;
+   int               i, k, s, nb, len;
+   char             *str;
+
+   idx = bufr_create_block_index( msg, tables );
+   if (idx == NULL) return -1;
+
+   layout = bufr_get_datasubset( idx->layout, 0 );
+   positions = (int *)malloc( idx->nb_positions * sizeof(int) );
+   nb = 0;
+   for (i = 0; i < idx->nb_positions ; i++)
+      {
+      bd = bufr_datasubset_get_descriptor( layout, i );
+      if ((bd->descriptor / 1000 == 1)||((bd->descriptor >= 4001)&&(bd->descriptor <= 4006))||
+          (bd->descriptor == 5001)||(bd->descriptor == 5002)||
+          (bd->descriptor == 6001)||(bd->descriptor == 6002))
+         positions[nb++] = i;
+      }
+
+   for (s = 0; s < idx->nb_subsets ; s++)
+      {
+      bufr_archive_begin_subset( scan );
+      for (k = 0; k < nb ; k++)
+         {
+         bd = bufr_datasubset_get_descriptor( layout, positions[k] );
+         if (bd->encoding.type == TYPE_CCITT_IA5)
+            {
+            bd = bufr_block_index_get_descriptor( idx, s, positions[k] );
+            if (bd == NULL) continue;
+            str = bufr_descriptor_get_svalue( bd, &len );
+            if (str && (bd->value != NULL) && !bufr_value_is_missing( bd->value ))
+               bufr_archive_element( scan, bd->descriptor, 0.0, str );
+            bufr_free_descriptor( bd );
+            }
+         else
+            {
+            bufr_archive_element( scan, bd->descriptor,
+                                  bufr_block_index_get_dvalue( idx, s, positions[k] ), NULL );
+            }
+         }
+      bufr_archive_end_subset( scan );
+      }
+
+   free( positions );
+   bufr_free_block_index( idx );
+   return 1;
+   }
+
+/**
+ * @english
+ * start the entry of a message, its section 1 time is kept in case
+ * the subsets have none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_begin_entry( ArchiveScan *scan, BufrArchiveEntry *entry,
+                                      BUFR_Message *msg, long offset )
+   {
+   int  year;
+
+   memset( entry, 0, sizeof(BufrArchiveEntry) );
+   entry->offset = offset;
+   entry->length = msg->len_msg;
+
+   scan->entry = entry;
+/*
+ * year of century before edition 4
+ */
+   year = msg->s1.year;
+   if (year <= 100) year += (year == 100) ? 1900 : ((year > 70) ? 1900 : 2000);
+   scan->s1parts[0] = year;
+   scan->s1parts[1] = msg->s1.month;
+   scan->s1parts[2] = msg->s1.day;
+   scan->s1parts[3] = msg->s1.hour;
+   scan->s1parts[4] = msg->s1.minute;
+   scan->s1parts[5] = (msg->edition >= 4) ? msg->s1.second : 0;
+   }
+
+/**
+ * @english
+ * add the scanned entry to the index, with the time of section 1
+ * if its subsets have none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_archive_end_entry( BufrArchiveIndex *idx, ArchiveScan *scan )
+   {
+   BufrArchiveEntry  *entry = scan->entry;
+
+   if (!(entry->flags & ARCHIVE_HAS_TIME))
+      {
+      entry->time_min = entry->time_max = bufr_archive_time( scan->s1parts[0], scan->s1parts[1],
+            scan->s1parts[2], scan->s1parts[3], scan->s1parts[4], scan->s1parts[5] );
+      }
+   if (entry->time_max - entry->time_min > idx->max_span)
+      idx->max_span = entry->time_max - entry->time_min;
+
+   arr_add( idx->entries, (char *)entry );
+/*
+ * the grid is rebuilt at the next query
+ */
+   if (idx->cells) free( idx->cells );
+   if (idx->first) free( idx->first );
+   idx->cells = idx->first = NULL;
+   return arr_count( idx->entries );
+   }
+
+/**
+ * @english
+ * scan the subsets of a decoded message
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_scan_subsets( ArchiveScan *scan, BUFR_Dataset *dts )
+   {
+   DataSubset       *subset;
+   BufrDescriptor   *bd;
+   int               i, s, count, nbsubset, len;
+   char             *str;
+
+   nbsubset = bufr_count_datasubset( dts );
+   for (s = 0; s < nbsubset ; s++)
+      {
+      subset = bufr_get_datasubset( dts, s );
+      count = bufr_datasubset_count_descriptor( subset );
+      bufr_archive_begin_subset( scan );
+      for (i = 0; i < count ; i++)
+         {
+         bd = bufr_datasubset_get_descriptor( subset, i );
+         if ((bd->value == NULL)||bufr_value_is_missing( bd->value )) continue;
+         if (bd->encoding.type == TYPE_CCITT_IA5)
+            {
+            str = bufr_descriptor_get_svalue( bd, &len );
+            if (str) bufr_archive_element( scan, bd->descriptor, 0.0, str );
+            }
+         else if (bd->descriptor < 7000)
+            {
+            bufr_archive_element( scan, bd->descriptor, bufr_descriptor_get_dvalue( bd ), NULL );
+            }
+         }
+      bufr_archive_end_subset( scan );
+      }
+   }
+
+/**
+ * @english
+ * the grid cell of a location, clamped to the grid
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_archive_cell( double lat, double lon )
+   {
+   int  row, col;
+
+   row = (lat < -90.0) ? 0 : (int)((lat + 90.0) / ARCHIVE_GRID_DEGREES);
+   col = (lon < -180.0) ? 0 : (int)((lon + 180.0) / ARCHIVE_GRID_DEGREES);
+   if (row >= ARCHIVE_GRID_LAT) row = ARCHIVE_GRID_LAT - 1;
+   if (col >= ARCHIVE_GRID_LON) col = ARCHIVE_GRID_LON - 1;
+   return row * ARCHIVE_GRID_LON + col;
+   }
+
+/**
+ * @english
+ * order the entries of a cell by start time, then as added
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int compare_cell_items( const void *p1, const void *p2 )
+   {
+   const ArchiveCellItem *c1 = (const ArchiveCellItem *)p1;
+   const ArchiveCellItem *c2 = (const ArchiveCellItem *)p2;
+
+   if (c1->time_min != c2->time_min) return (c1->time_min < c2->time_min) ? -1 : 1;
+   return c1->entry - c2->entry;
+   }
+
+/**
+ * @english
+ * put each entry in the cells of its bounding box, or in the last
+ * cell if it has no location, then sort each cell by time_min
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_archive_build_grid( BufrArchiveIndex *idx )
+   {
+   BufrArchiveEntry  *entries, *e;
+   ArchiveCellItem   *items=NULL;
+   int               *fill;
+   int                i, c, c0, c1, row, col, count, pass;
+
+   count = arr_count( idx->entries );
+   entries = (BufrArchiveEntry *)arr_get( idx->entries, 0 );
+   idx->first = (int *)calloc( ARCHIVE_GRID_CELLS + 2, sizeof(int) );
+   fill = (int *)calloc( ARCHIVE_GRID_CELLS + 1, sizeof(int) );
+/*
+ * count the entries of each cell, then fill them
+ */
+   for (pass = 0; pass < 2 ; pass++)
+      {
+      for (i = 0; i < count ; i++)
+         {
+         e = &(entries[i]);
+         if (!(e->flags & ARCHIVE_HAS_LOCATION))
+            {
+            c = ARCHIVE_GRID_CELLS;
+            if (pass == 0) idx->first[c+1]++; else items[idx->first[c] + fill[c]++].entry = i;
+            continue;
+            }
+         c0 = bufr_archive_cell( e->lat_min, e->lon_min );
+         c1 = bufr_archive_cell( e->lat_max, e->lon_max );
+         for (row = c0 / ARCHIVE_GRID_LON; row <= c1 / ARCHIVE_GRID_LON ; row++)
+            for (col = c0 % ARCHIVE_GRID_LON; col <= c1 % ARCHIVE_GRID_LON ; col++)
+               {
+               c = row * ARCHIVE_GRID_LON + col;
+               if (pass == 0) idx->first[c+1]++; else items[idx->first[c] + fill[c]++].entry = i;
+               }
+         }
+      if (pass == 0)
+         {
+         for (c = 0; c <= ARCHIVE_GRID_CELLS ; c++)
+            idx->first[c+1] += idx->first[c];
+         items = (ArchiveCellItem *)malloc( (idx->first[ARCHIVE_GRID_CELLS+1] + 1) * sizeof(ArchiveCellItem) );
+         }
+      }
+   free( fill );
+
+   for (i = 0; i < idx->first[ARCHIVE_GRID_CELLS+1] ; i++)
+      items[i].time_min = entries[items[i].entry].time_min;
+   for (c = 0; c <= ARCHIVE_GRID_CELLS ; c++)
+      qsort( items + idx->first[c], idx->first[c+1] - idx->first[c], sizeof(ArchiveCellItem),
+             compare_cell_items );
+
+   idx->cells = (int *)malloc( (idx->first[ARCHIVE_GRID_CELLS+1] + 1) * sizeof(int) );
+   for (i = 0; i < idx->first[ARCHIVE_GRID_CELLS+1] ; i++)
+      idx->cells[i] = items[i].entry;
+   free( items );
+   }
+
+/**
+ * @english
+ * check the extent of a message against a query
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_archive_entry_match( BufrArchiveEntry *e, double lat_min, double lat_max,
+                                     double lon_min, double lon_max,
+                                     int64_t time_from, int64_t time_to, const char *station )
+   {
+   int  k;
+
+   if ((e->time_max < time_from)||(e->time_min > time_to)) return 0;
+   if (e->flags & ARCHIVE_HAS_LOCATION)
+      {
+      if ((e->lat_max < lat_min)||(e->lat_min > lat_max)) return 0;
+      if ((e->lon_max < lon_min)||(e->lon_min > lon_max)) return 0;
+      }
+   if (station == NULL) return 1;
+   for (k = 0; k < e->nb_stations ; k++)
+      if (strcmp( e->stations[k], station ) == 0) return 1;
+   return 0;
+   }
@@ -0,0 +1,948 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_blocks.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: index des blocs d'un message compresse
+ *
+ * Only the first subset of a compressed message is decoded, it gives the
+ * layout of section 4. The R0 and NBINC of every block are then read to
+ * know where the increments of each block start. R0 and NBINC bound the
+ * values of all subsets, which allows messages to be rejected by a search
+ * key without unpacking any increment.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_tables.h"
+#include "bufr_template.h"
+#include "bufr_dataset.h"
+#include "bufr_ieee754.h"
+#include "bufr_blocks.h"
+#include "bufr_query.h"
+#include "bufr_i18n.h"
+
+static int          bufr_add_block           ( BufrBlockIndex *idx, BufrDescriptor *bd, int pos, int kind,
+                                               int nbits, uint64_t *bitpos );
+static uint64_t     bufr_block_getbits       ( BUFR_Message *msg, uint64_t bitpos, int nbits, int *errcode );
+static void         bufr_block_string        ( BufrBlockIndex *idx, uint64_t bitpos, int len, char *str );
+static uint64_t     bufr_block_subset_bits   ( BufrBlockIndex *idx, BufrBlock *blk, int subset );
+static BufrBlock   *bufr_block_at            ( BufrBlockIndex *idx, int subset, int pos );
+static int          bufr_block_may_hold      ( BufrBlockIndex *idx, int blk, BufrDescValue *key );
+static int          bufr_block_holds         ( BufrBlockIndex *idx, BufrBlock *blk, int subset,
+                                               BufrDescValue *key, char *str );
+static int          bufr_key_double_match    ( BufrDescValue *key, double lo, double hi, double eps );
+static int          bufr_key_value_match     ( BufrDescValue *key, const BufrValue *model, double dval, double eps );
+static int          bufr_key_string_match    ( BufrDescValue *key, const char *str, int len );
+static int          bufr_key_is_plain        ( BufrDescValue *key );
+static int          bufr_key_has_missing     ( BufrDescValue *key );
+static int          bufr_desc_has_no_block   ( BufrBlockIndex *idx, int descriptor );
+
+/**
+ * @english
+ * @brief locate the blocks of a compressed message
+ *
+ * The first subset is decoded to learn the layout of section 4, then only
+ * R0 and NBINC of every block are read. The message must not be freed
+ * while the index is in use.
+ * @param msg  a compressed message
+ * @param tables  tables used to decode it
+ * @return the index, NULL on error or if msg is not compressed
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_may_match, bufr_free_block_index
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+BufrBlockIndex *bufr_create_block_index( BUFR_Message *msg, BUFR_Tables *tables )
+   {
+   BufrBlockIndex  *idx;
+   DataSubset      *subset;
+   BufrDescriptor  *bd;
+   unsigned char   *current;
+   unsigned short   bitno;
+   uint64_t         bitpos;
+   int              j, count, kind;
+   int              errcode;
+
+   if ((msg == NULL)||!BUFR_IS_COMPRESSED( msg )) return NULL;
+
+   idx = (BufrBlockIndex *)malloc( sizeof(BufrBlockIndex) );
+   idx->msg        = msg;
+   idx->blocks     = NULL;
+   idx->nb_blocks  = 0;
+   idx->value_block  = NULL;
+   idx->af_block     = NULL;
+   idx->nb_positions = 0;
+   idx->nb_subsets = msg->s3.no_data_subsets;
+
+   current = msg->s4.current;
+   bitno = msg->s4.bitno;
+   msg->s4.current = msg->s4.data;
+   msg->s4.bitno = 0;
+   idx->layout = bufr_decode_message_subsets( msg, tables, 1, 1 );
+   msg->s4.current = current;
+   msg->s4.bitno = bitno;
+   if ((idx->layout == NULL)||(idx->layout->data_flag & BUFR_FLAG_INVALID)||
+       (bufr_count_datasubset( idx->layout ) < 1))
+      {
+      bufr_print_debug( _("Error: cannot index the blocks of an invalid compressed message\n") );
+      bufr_free_block_index( idx );
+      return NULL;
+      }
+
+   subset = bufr_get_datasubset( idx->layout, 0 );
+   count = bufr_datasubset_count_descriptor( subset );
+   idx->blocks = (BufrBlock *)malloc( 2 * count * sizeof(BufrBlock) );
+   idx->value_block = (int *)malloc( count * sizeof(int) );
+   idx->af_block = (int *)malloc( count * sizeof(int) );
+   idx->nb_positions = count;
+   for (j = 0; j < count ; j++)
+      {
+      idx->value_block[j] = -1;
+      idx->af_block[j] = -1;
+      }
+
+   errcode = 0;
+   bitpos = 0;
+   for (j = 0; (j < count)&&(errcode >= 0) ; j++)
+      {
+      bd = bufr_datasubset_get_descriptor( subset, j );
+      if (bd->flags & FLAG_SKIPPED) continue;
+/*
+ * associated fields come before the value, as when decoding
+ */
+      if (bd->encoding.af_nbits > 0)
+         {
+         idx->af_block[j] = idx->nb_blocks;
+         errcode = bufr_add_block( idx, bd, j, BLOCK_AF, bd->encoding.af_nbits, &bitpos );
+         if (errcode < 0) break;
+         }
+
+      switch (bd->encoding.type)
+         {
+         case TYPE_CCITT_IA5 :
+            kind = BLOCK_STRING;
+            break;
+         case TYPE_IEEE_FP :
+            kind = BLOCK_IEEE_FP;
+            break;
+         case TYPE_NUMERIC :
+         case TYPE_CODETABLE :
+         case TYPE_FLAGTABLE :
+         case TYPE_CHNG_REF_VAL_OP :
+            kind = BLOCK_NUMERIC;
+            break;
+         default :
+            continue;
+         }
+      idx->value_block[j] = idx->nb_blocks;
+      errcode = bufr_add_block( idx, bd, j, kind, bd->encoding.nbits, &bitpos );
+      }
+
+   if (errcode < 0)
+      {
+      bufr_free_block_index( idx );
+      return NULL;
+      }
+   return idx;
+   }
+
+/**
+ * @english
+ * @brief free a block index, the message is not freed
+ * @param idx  the index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+void bufr_free_block_index( BufrBlockIndex *idx )
+   {
+   if (idx == NULL) return;
+
+   if (idx->layout) bufr_free_dataset( idx->layout );
+   if (idx->blocks) free( idx->blocks );
+   if (idx->value_block) free( idx->value_block );
+   if (idx->af_block) free( idx->af_block );
+   free( idx );
+   }
+
+/**
+ * @english
+ * @brief range of the values of a numeric block
+ *
+ * The bounds come from R0 and NBINC only, no increment is read.
+ * @param idx  the index
+ * @param blk  position of the block in the index
+ * @param vmin  receives the smallest value the block may hold
+ * @param vmax  receives the largest value the block may hold
+ * @return 1 with the bounds set, 0 if all values are missing,
+ * -1 if the block is not numeric
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_block_bounds( BufrBlockIndex *idx, int blk, double *vmin, double *vmax )
+   {
+   BufrBlock  *block;
+   uint64_t    missing, ival;
+
+   if ((idx == NULL)||(blk < 0)||(blk >= idx->nb_blocks)) return -1;
+
+   block = &(idx->blocks[blk]);
+   if (block->kind != BLOCK_NUMERIC) return -1;
+   switch (block->bd->encoding.type)
+      {
+      case TYPE_NUMERIC :
+      case TYPE_CODETABLE :
+      case TYPE_FLAGTABLE :
+         break;
+      default :
+         return -1;
+      }
+
+   missing = bufr_missing_ivalue( block->nbits );
+   if ((block->inc_nbits > 0)&&(block->r0 >= missing)) return -1;
+   if (block->inc_nbits == 0)
+      {
+      if (block->r0 == missing) return 0;
+      ival = block->r0;
+      }
+   else
+      {
+/*
+ * the largest increment is the missing value
+ */
+      ival = block->r0 + bufr_missing_ivalue( block->inc_nbits ) - 1;
+      if (ival >= missing) ival = missing - 1;
+      }
+
+   *vmin = bufr_cvt_i64_to_dval( &(block->bd->encoding), block->r0 );
+   *vmax = bufr_cvt_i64_to_dval( &(block->bd->encoding), ival );
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief tell if any subset of a compressed message can match search keys
+ *
+ * Only the bounds of the blocks are used, a message is rejected when a
+ * key cannot be found in any block of its descriptor. Keys on qualifiers
+ * or with callbacks, and keys on descriptors that have no block, such as
+ * skipped ones, are not checked.
+ * @param idx  the index
+ * @param keys  search keys as given to bufr_subset_find_values
+ * @param nb  number of keys
+ * @return 0 if no subset can match, 1 if some may
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_candidates
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_block_index_may_match( BufrBlockIndex *idx, BufrDescValue *keys, int nb )
+   {
+   int   i, k, found;
+
+   if (idx == NULL) return 1;
+
+   for (k = 0; k < nb ; k++)
+      {
+      if (!bufr_key_is_plain( &(keys[k]) )) continue;
+      if (bufr_desc_has_no_block( idx, keys[k].descriptor )) continue;
+
+      found = 0;
+      for (i = 0; (i < idx->nb_blocks)&&!found ; i++)
+         {
+         if (idx->blocks[i].kind == BLOCK_AF) continue;
+         if (idx->blocks[i].bd->descriptor != keys[k].descriptor) continue;
+         found = bufr_block_may_hold( idx, i, &(keys[k]) );
+         }
+      if (!found) return 0;
+      }
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief find the subsets that may match search keys
+ *
+ * Only the increments of the blocks of the key descriptors are read.
+ * A candidate holds every key in some block of its descriptor, the
+ * order of the keys is not checked, so candidates must still be
+ * decoded and matched with bufr_subset_find_values.
+ * @param idx  the index
+ * @param keys  search keys as given to bufr_subset_find_values
+ * @param nb  number of keys
+ * @param candidates  receives 1 for each subset that may match, else 0
+ * @return number of candidates
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_may_match
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_block_index_candidates( BufrBlockIndex *idx, BufrDescValue *keys, int nb, char *candidates )
+   {
+   int        i, k, s, count;
+   char      *str, *found;
+   BufrBlock *blk;
+
+   if (idx == NULL) return -1;
+
+   for (s = 0; s < idx->nb_subsets ; s++)
+      candidates[s] = 1;
+
+   found = (char *)malloc( idx->nb_subsets );
+   str = NULL;
+   for (k = 0; k < nb ; k++)
+      {
+      if (!bufr_key_is_plain( &(keys[k]) )) continue;
+      if (bufr_desc_has_no_block( idx, keys[k].descriptor )) continue;
+
+      memset( found, 0, idx->nb_subsets );
+      for (i = 0; i < idx->nb_blocks ; i++)
+         {
+         blk = &(idx->blocks[i]);
+         if (blk->kind == BLOCK_AF) continue;
+         if (blk->bd->descriptor != keys[k].descriptor) continue;
+         if (!bufr_block_may_hold( idx, i, &(keys[k]) )) continue;
+         if (blk->kind == BLOCK_STRING)
+            str = (char *)realloc( str, blk->nbits / 8 + 1 );
+         for (s = 0; s < idx->nb_subsets ; s++)
+            {
+            if (!candidates[s] || found[s]) continue;
+            found[s] = bufr_block_holds( idx, blk, s, &(keys[k]), str );
+            }
+         }
+      for (s = 0; s < idx->nb_subsets ; s++)
+         if (!found[s]) candidates[s] = 0;
+      }
+   free( found );
+   if (str) free( str );
+
+   count = 0;
+   for (s = 0; s < idx->nb_subsets ; s++)
+      if (candidates[s]) ++count;
+   return count;
+   }
+
+/**
+ * @english
+ * @brief tell if a message may hold a subset that matches a query
+ *
+ * The bounds of the compressed blocks, then the values of the key
+ * descriptors only, tell if any subset can match the query, so that
+ * messages that cannot are skipped without being decoded.
+ * Uncompressed messages, and those that cannot be indexed, may always match.
+ * @param msg  the message
+ * @param tbls  tables to decode the message with
+ * @param query  the query
+ * @return 0 if no subset can match, 1 if some may
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_may_match_blocks, bufr_query_block_candidates
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_message_may_match( BUFR_Message *msg, BUFR_Tables *tbls, BufrQuery *query )
+   {
+   BufrBlockIndex *idx;
+   char           *candidates;
+   int             rtrn;
+
+   if ((query == NULL)||(arr_count( query->terms ) == 0)) return 1;
+   if ((msg == NULL)||!BUFR_IS_COMPRESSED( msg )) return 1;
+
+   idx = bufr_create_block_index( msg, tbls );
+   if (idx == NULL) return 1;
+
+   rtrn = bufr_query_may_match_blocks( query, idx );
+   if (rtrn)
+      {
+      candidates = (char *)malloc( idx->nb_subsets );
+      if (candidates == NULL)
+         rtrn = 1;
+      else
+         rtrn = (bufr_query_block_candidates( query, idx, candidates ) > 0) ? 1 : 0;
+      free( candidates );
+      }
+   bufr_free_block_index( idx );
+   return rtrn;
+   }
+
+/**
+ * @english
+ * @brief position of a descriptor in the subsets of an indexed message
+ *
+ * All subsets of a compressed message share the layout of the first one,
+ * the position found is valid for every subset.
+ * @param idx  the index
+ * @param descriptor  descriptor to find
+ * @param startpos  position where the search starts
+ * @return position of the descriptor, -1 if not found
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_get_descriptor
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_block_index_find_descriptor( BufrBlockIndex *idx, int descriptor, int startpos )
+   {
+   DataSubset  *subset;
+   int          j;
+
+   if ((idx == NULL)||(startpos < 0)) return -1;
+
+   subset = bufr_get_datasubset( idx->layout, 0 );
+   for (j = startpos; j < idx->nb_positions ; j++)
+      {
+      if (bufr_datasubset_get_descriptor( subset, j )->descriptor == descriptor)
+         return j;
+      }
+   return -1;
+   }
+
+/**
+ * @english
+ * @brief value of a numeric descriptor of one subset
+ *
+ * The value is read directly from its block: R0 plus one increment,
+ * nothing else of the message is decoded.
+ * @param idx  the index
+ * @param subset  position of the subset, from 0
+ * @param pos  position of the descriptor in the subset
+ * @return the value, or the value of bufr_get_max_double() if missing,
+ * not numeric or out of range
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_get_descriptor
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+double bufr_block_index_get_dvalue( BufrBlockIndex *idx, int subset, int pos )
+   {
+   BufrBlock  *blk;
+   uint64_t    ival;
+
+   blk = bufr_block_at( idx, subset, pos );
+   if ((blk == NULL)||(blk->kind != BLOCK_NUMERIC)) return bufr_get_max_double();
+
+   ival = bufr_block_subset_bits( idx, blk, subset );
+   if (ival == bufr_missing_ivalue( blk->nbits )) return bufr_get_max_double();
+   return bufr_cvt_i64_to_dval( &(blk->bd->encoding), ival );
+   }
+
+/**
+ * @english
+ * @brief descriptor of one subset with its value
+ *
+ * The descriptor of the first subset is copied and given the value of
+ * the requested subset, read directly from its block together with its
+ * associated field. The value is the same as given by
+ * bufr_decode_message for that subset.
+ * @param idx  the index
+ * @param subset  position of the subset, from 0
+ * @param pos  position of the descriptor in the subset
+ * @return a new descriptor to free with bufr_free_descriptor,
+ * NULL if out of range
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_block_index_get_dvalue, bufr_block_index_find_descriptor
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+BufrDescriptor *bufr_block_index_get_descriptor( BufrBlockIndex *idx, int subset, int pos )
+   {
+   BufrDescriptor  *bd;
+   BufrBlock       *blk;
+   char            *str;
+   uint64_t         ival;
+   int              errcode;
+
+   if ((idx == NULL)||(subset < 0)||(subset >= idx->nb_subsets)) return NULL;
+   if ((pos < 0)||(pos >= idx->nb_positions)) return NULL;
+
+   bd = bufr_dupl_descriptor( bufr_datasubset_get_descriptor( bufr_get_datasubset( idx->layout, 0 ), pos ) );
+   if (bd == NULL) return NULL;
+
+   if (idx->af_block[pos] >= 0)
+      {
+      blk = &(idx->blocks[idx->af_block[pos]]);
+      if (bd->value == NULL)
+         bd->value = bufr_mkval_for_descriptor( bd );
+      if (bd->value && bd->value->af)
+         bd->value->af->bits = bufr_block_subset_bits( idx, blk, subset );
+      }
+
+   if (idx->value_block[pos] < 0) return bd;
+
+   blk = &(idx->blocks[idx->value_block[pos]]);
+   switch (blk->kind)
+      {
+      case BLOCK_NUMERIC :
+         bufr_descriptor_set_bitsvalue( bd, bufr_block_subset_bits( idx, blk, subset ) );
+         break;
+      case BLOCK_STRING :
+         if (blk->inc_nbits == 0) break;
+         str = (char *)malloc( blk->inc_nbits / 8 + 1 );
+         bufr_block_string( idx, blk->incpos + (uint64_t)blk->inc_nbits * subset, blk->inc_nbits / 8, str );
+         bufr_descriptor_set_svalue( bd, str );
+         free( str );
+         break;
+      case BLOCK_IEEE_FP :
+         if (blk->inc_nbits == 0) break;
+         ival = bufr_block_getbits( idx->msg, blk->incpos + (uint64_t)blk->inc_nbits * subset,
+                                    blk->nbits, &errcode );
+         if (bd->value == NULL)
+            bd->value = bufr_mkval_for_descriptor( bd );
+         if (blk->nbits == 64)
+            bufr_value_set_double( bd->value, bufr_ieee_decode_double( ival ) );
+         else
+            bufr_value_set_float( bd->value, bufr_ieee_decode_single( ival ) );
+         break;
+      default :
+         break;
+      }
+   return bd;
+   }
+
+/**
+ * @english
+ * read R0 and NBINC of the next block and skip its increments
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_add_block( BufrBlockIndex *idx, BufrDescriptor *bd, int pos, int kind, int nbits, uint64_t *bitpos )
+   {
+   BufrBlock  *blk;
+   int         errcode;
+
+   blk = &(idx->blocks[idx->nb_blocks]);
+   blk->bd    = bd;
+   blk->pos   = pos;
+   blk->kind  = kind;
+   blk->nbits = nbits;
+   blk->r0pos = *bitpos;
+   blk->r0    = 0;
+   if ((kind == BLOCK_NUMERIC)||(kind == BLOCK_AF))
+      {
+      blk->r0 = bufr_block_getbits( idx->msg, blk->r0pos, nbits, &errcode );
+      if (errcode < 0) return errcode;
+      }
+   blk->nbinc = bufr_block_getbits( idx->msg, blk->r0pos + nbits, 6, &errcode );
+   if (errcode < 0) return errcode;
+   blk->incpos = blk->r0pos + nbits + 6;
+
+   switch (kind)
+      {
+      case BLOCK_STRING :
+         blk->inc_nbits = (blk->nbinc == bufr_missing_ivalue( 6 )) ? 0 : blk->nbinc * 8;
+         break;
+      case BLOCK_IEEE_FP :
+         blk->inc_nbits = (blk->nbinc > 0) ? nbits : 0;
+         break;
+      case BLOCK_NUMERIC :
+         blk->inc_nbits = (blk->nbinc == bufr_missing_ivalue( 6 )) ? 0 : blk->nbinc;
+         break;
+      default :
+         blk->inc_nbits = blk->nbinc;
+         break;
+      }
+
+   *bitpos = blk->incpos + (uint64_t)blk->inc_nbits * idx->nb_subsets;
+   if (*bitpos > (uint64_t)idx->msg->s4.max_data_len * 8)
+      {
+      bufr_print_debug( _("Error: compressed block goes past the end of section 4\n") );
+      return -1;
+      }
+   idx->nb_blocks += 1;
+   return 0;
+   }
+
+/**
+ * @english
+ * read bits of section 4 at a bit position
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_block_getbits( BUFR_Message *msg, uint64_t bitpos, int nbits, int *errcode )
+   {
+   unsigned char  *current;
+   unsigned short  bitno;
+   uint64_t        bits;
+
+   if (bitpos + nbits > (uint64_t)msg->s4.max_data_len * 8)
+      {
+      *errcode = -1;
+      return 0;
+      }
+   current = msg->s4.current;
+   bitno = msg->s4.bitno;
+   msg->s4.current = msg->s4.data + bitpos / 8;
+   msg->s4.bitno = bitpos % 8;
+   bits = bufr_getbits( msg, nbits, errcode );
+   msg->s4.current = current;
+   msg->s4.bitno = bitno;
+   return bits;
+   }
+
+/**
+ * @english
+ * read a string of len characters at a bit position
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_block_string( BufrBlockIndex *idx, uint64_t bitpos, int len, char *str )
+   {
+   int   i, errcode;
+
+   for (i = 0; i < len ; i++)
+      str[i] = bufr_block_getbits( idx->msg, bitpos + 8 * i, 8, &errcode );
+   str[len] = '\0';
+   }
+
+/**
+ * @english
+ * encoded value of a numeric block for one subset
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_block_subset_bits( BufrBlockIndex *idx, BufrBlock *blk, int subset )
+   {
+   uint64_t   inc;
+   int        errcode;
+
+   if (blk->inc_nbits == 0) return blk->r0;
+
+   inc = bufr_block_getbits( idx->msg, blk->incpos + (uint64_t)blk->inc_nbits * subset,
+                             blk->inc_nbits, &errcode );
+   if (inc == bufr_missing_ivalue( blk->inc_nbits ))
+      return bufr_missing_ivalue( blk->nbits );
+   return blk->r0 + inc;
+   }
+
+/**
+ * @english
+ * block holding the value of a position, NULL if out of range or none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrBlock *bufr_block_at( BufrBlockIndex *idx, int subset, int pos )
+   {
+   if ((idx == NULL)||(subset < 0)||(subset >= idx->nb_subsets)) return NULL;
+   if ((pos < 0)||(pos >= idx->nb_positions)) return NULL;
+   if (idx->value_block[pos] < 0) return NULL;
+
+   return &(idx->blocks[idx->value_block[pos]]);
+   }
+
+/**
+ * @english
+ * tell from its bounds if a block may hold the value of a key
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_block_may_hold( BufrBlockIndex *idx, int blk, BufrDescValue *key )
+   {
+   BufrBlock  *block;
+   double      vmin, vmax;
+   char       *str;
+   int         rtrn;
+
+   if ((key->nbval <= 0)||bufr_key_has_missing( key )) return 1;
+
+   block = &(idx->blocks[blk]);
+   switch (block->kind)
+      {
+      case BLOCK_NUMERIC :
+         rtrn = bufr_block_bounds( idx, blk, &vmin, &vmax );
+         if (rtrn < 0) return 1;
+         if (rtrn == 0) return 0;
+         return bufr_key_double_match( key, vmin, vmax, 1.0 / bufr_pow10( block->bd->encoding.scale ) );
+      case BLOCK_STRING :
+         if (block->inc_nbits > 0) return 1;
+         str = (char *)malloc( block->nbits / 8 + 1 );
+         bufr_block_string( idx, block->r0pos, block->nbits / 8, str );
+         rtrn = bufr_key_string_match( key, str, block->nbits / 8 );
+         free( str );
+         return rtrn;
+      default :
+         return 1;
+      }
+   }
+
+/**
+ * @english
+ * tell if the value of one subset in a block matches a key
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_block_holds( BufrBlockIndex *idx, BufrBlock *blk, int subset, BufrDescValue *key, char *str )
+   {
+   double     dval;
+   uint64_t   ival;
+
+   if ((key->nbval <= 0)||bufr_key_has_missing( key )) return 1;
+
+   switch (blk->kind)
+      {
+      case BLOCK_NUMERIC :
+         if (blk->bd->encoding.type == TYPE_CHNG_REF_VAL_OP) return 1;
+         ival = bufr_block_subset_bits( idx, blk, subset );
+         if (ival == bufr_missing_ivalue( blk->nbits )) return 0;
+         dval = bufr_cvt_i64_to_dval( &(blk->bd->encoding), ival );
+         if (blk->bd->value == NULL)
+            return bufr_key_double_match( key, dval, dval, 1.0 / bufr_pow10( blk->bd->encoding.scale ) );
+         return bufr_key_value_match( key, blk->bd->value, dval, 0.5 / bufr_pow10( blk->bd->encoding.scale ) );
+      case BLOCK_STRING :
+         if (blk->inc_nbits == 0)
+            bufr_block_string( idx, blk->r0pos, blk->nbits / 8, str );
+         else
+            bufr_block_string( idx, blk->incpos + (uint64_t)blk->inc_nbits * subset, blk->inc_nbits / 8, str );
+         return bufr_key_string_match( key, str, strlen( str ) );
+      default :
+         return 1;
+      }
+   }
+
+/**
+ * @english
+ * tell if a value between lo and hi may match a key, eps widens the range
+ * so that rounding cannot reject a match
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_key_double_match( BufrDescValue *key, double lo, double hi, double eps )
+   {
+   double   v1, v2;
+   int      k;
+
+   for (k = 0; k < key->nbval ; k++)
+      {
+      if ((key->values[k] == NULL)||(key->values[k]->type == VALTYPE_STRING)) return 1;
+      }
+
+   lo -= eps;
+   hi += eps;
+   if (key->nbval == 2)
+      {
+      v1 = bufr_value_get_double( key->values[0] );
+      v2 = bufr_value_get_double( key->values[1] );
+      return ((v2 >= lo)&&(v1 <= hi)) ? 1 : 0;
+      }
+   for (k = 0; k < key->nbval ; k++)
+      {
+      v1 = bufr_value_get_double( key->values[k] );
+      if ((v1 >= lo)&&(v1 <= hi)) return 1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * tell if a value matches a key exactly as bufr_subset_find_values does,
+ * the value being held in a copy of model so that it compares by type
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_key_value_match( BufrDescValue *key, const BufrValue *model, double dval, double eps )
+   {
+   BufrValue  *bv;
+   int         k, rtrn=0;
+
+   for (k = 0; k < key->nbval ; k++)
+      {
+      if (key->values[k] == NULL) return 1;
+      }
+
+   bv = bufr_duplicate_value( model );
+   if (bv == NULL) return 1;
+   bufr_value_set_double( bv, dval );
+   if (key->nbval == 2)
+      {
+      rtrn = (bufr_between_values( key->values[0], bv, key->values[1] ) == 1) ? 1 : 0;
+      }
+   else
+      {
+      for (k = 0; k < key->nbval ; k++)
+         {
+         if (bufr_compare_value( bv, key->values[k], eps ) == 0)
+            {
+            rtrn = 1;
+            break;
+            }
+         }
+      }
+   bufr_free_value( bv );
+   return rtrn;
+   }
+
+/**
+ * @english
+ * tell if a string may match a key, compared as bufr_compare_value does
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_key_string_match( BufrDescValue *key, const char *str, int len )
+   {
+   const char  *s;
+   int          k, slen;
+
+   if (key->nbval == 2) return 1;
+
+   for (k = 0; k < key->nbval ; k++)
+      {
+      if ((key->values[k] == NULL)||(key->values[k]->type != VALTYPE_STRING)) return 1;
+      s = bufr_value_get_string( key->values[k], &slen );
+      if (s == NULL) return 1;
+      if (strncmp( s, str, (slen < len) ? slen : len ) == 0) return 1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * keys on qualifiers, with location or callbacks carry flags in their
+ * descriptor and cannot be checked on blocks
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_key_is_plain( BufrDescValue *key )
+   {
+   return bufr_is_table_b( key->descriptor );
+   }
+
+/**
+ * @english
+ * tell if a key looks for a missing value, which the bounds of the blocks
+ * leave out, so that any block may hold it
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_key_has_missing( BufrDescValue *key )
+   {
+   int   k;
+
+   for (k = 0; k < key->nbval ; k++)
+      {
+      if ((key->values[k] != NULL)&&bufr_value_is_missing( key->values[k] )) return 1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * tell if a descriptor appears somewhere without a block of values, as
+ * when it is skipped, its keys are then left to bufr_subset_find_values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_desc_has_no_block( BufrBlockIndex *idx, int descriptor )
+   {
+   DataSubset      *subset;
+   BufrDescriptor  *bd;
+   int              j;
+
+   subset = bufr_get_datasubset( idx->layout, 0 );
+   for (j = 0; j < idx->nb_positions ; j++)
+      {
+      if (idx->value_block[j] >= 0) continue;
+      bd = bufr_datasubset_get_descriptor( subset, j );
+      if ((bd != NULL)&&(bd->descriptor == descriptor)) return 1;
+      }
+   return 0;
+   }
@@ -0,0 +1,541 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_bloom.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: filtres de Bloom des stations et des heures d'observation
+ *
+ * A sidecar file holds a Bloom filter of the station identifiers and
+ * observation hours of a BUFR file, and optionally one for each of its
+ * messages. It tells without reading the file that a station, an hour or
+ * a station at an hour is not in it; a positive answer may be false, with
+ * the probability given when it was built. The keys are taken from an
+ * archive index, a message is kept for each hour of its time range.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bufr_array.h"
+#include "bufr_archive.h"
+#include "bufr_bloom.h"
+#include "bufr_i18n.h"
+
+#ifndef M_LN2
+#define M_LN2   0.69314718055994530942
+#endif
+
+static uint64_t   bufr_bloom_hash        ( const char *key );
+static int        bufr_bloom_count_keys  ( BufrArchiveEntry *entry );
+static BufrBloom *bufr_read_bloom        ( FILE *fp, long *offset );
+static void       bufr_write_bloom       ( BufrBloom *bloom, long offset, FILE *fp );
+
+/**
+ * @english
+ * @brief create an empty Bloom filter
+ * @param nb_keys  number of keys expected
+ * @param fp_rate  probability of a false positive with that many keys
+ * @return the filter, to free with bufr_free_bloom
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bloom_add, bufr_bloom_may_contain
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrBloom *bufr_create_bloom( int nb_keys, double fp_rate )
+   {
+   BufrBloom  *bloom;
+   double      m;
+
+   if (nb_keys < 1) nb_keys = 1;
+   if ((fp_rate <= 0.0)||(fp_rate >= 1.0)) fp_rate = 0.01;
+/*
+ * optimal size and number of hashes for the rate
+ */
+   m = -nb_keys * log( fp_rate ) / (M_LN2 * M_LN2);
+   bloom = (BufrBloom *)malloc( sizeof(BufrBloom) );
+   bloom->nbits = ((int)ceil( m ) + 63) / 64 * 64;
+   bloom->nb_hashes = (int)ceil( bloom->nbits * M_LN2 / nb_keys );
+   if (bloom->nb_hashes < 1) bloom->nb_hashes = 1;
+   if (bloom->nb_hashes > 16) bloom->nb_hashes = 16;
+   bloom->bits = (unsigned char *)calloc( bloom->nbits / 8, 1 );
+   return bloom;
+   }
+
+/**
+ * @english
+ * @brief free a Bloom filter
+ * @param bloom  the filter
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_free_bloom( BufrBloom *bloom )
+   {
+   if (bloom == NULL) return;
+   free( bloom->bits );
+   free( bloom );
+   }
+
+/**
+ * @english
+ * @brief add a key to a Bloom filter
+ * @param bloom  the filter
+ * @param key  the key
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_bloom_add( BufrBloom *bloom, const char *key )
+   {
+   uint64_t  h;
+   uint32_t  h1, h2;
+   int       i, bit;
+
+   h = bufr_bloom_hash( key );
+   h1 = (uint32_t)h;
+   h2 = (uint32_t)(h >> 32) | 1;
+   for (i = 0; i < bloom->nb_hashes ; i++)
+      {
+      bit = (h1 + (uint32_t)i * h2) % bloom->nbits;
+      bloom->bits[bit >> 3] |= (1 << (bit & 7));
+      }
+   }
+
+/**
+ * @english
+ * @brief tell if a key may have been added to a Bloom filter
+ * @param bloom  the filter
+ * @param key  the key
+ * @return 0 if it was not, 1 if it may have been
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_bloom_may_contain( BufrBloom *bloom, const char *key )
+   {
+   uint64_t  h;
+   uint32_t  h1, h2;
+   int       i, bit;
+
+   if (bloom == NULL) return 1;
+
+   h = bufr_bloom_hash( key );
+   h1 = (uint32_t)h;
+   h2 = (uint32_t)(h >> 32) | 1;
+   for (i = 0; i < bloom->nb_hashes ; i++)
+      {
+      bit = (h1 + (uint32_t)i * h2) % bloom->nbits;
+      if (!(bloom->bits[bit >> 3] & (1 << (bit & 7)))) return 0;
+      }
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief add the stations and hours of a message to a Bloom filter
+ *
+ * Each station, each hour of the time range and each station at each
+ * hour are added. A message longer than BLOOM_MAX_HOURS is kept for
+ * any hour.
+ * @param bloom  the filter
+ * @param entry  the message, from an archive index
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bloom_may_hold
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_bloom_add_entry( BufrBloom *bloom, BufrArchiveEntry *entry )
+   {
+   char      key[ARCHIVE_STATION_LEN+32];
+   int64_t   h, h0, h1;
+   int       k, wide;
+
+   h0 = (int64_t)floor( entry->time_min / 3600.0 );
+   h1 = (int64_t)floor( entry->time_max / 3600.0 );
+   wide = (h1 - h0 >= BLOOM_MAX_HOURS);
+
+   for (k = 0; k < entry->nb_stations ; k++)
+      {
+      snprintf( key, sizeof(key), "S%s", entry->stations[k] );
+      bufr_bloom_add( bloom, key );
+      if (wide)
+         {
+         snprintf( key, sizeof(key), "%s@*", entry->stations[k] );
+         bufr_bloom_add( bloom, key );
+         continue;
+         }
+      for (h = h0; h <= h1 ; h++)
+         {
+         snprintf( key, sizeof(key), "%s@%lld", entry->stations[k], (long long)h );
+         bufr_bloom_add( bloom, key );
+         }
+      }
+   if (wide)
+      {
+      bufr_bloom_add( bloom, "H*" );
+      return;
+      }
+   for (h = h0; h <= h1 ; h++)
+      {
+      snprintf( key, sizeof(key), "H%lld", (long long)h );
+      bufr_bloom_add( bloom, key );
+      }
+   }
+
+/**
+ * @english
+ * @brief tell if a station may have been observed at a time
+ * @param bloom  the filter
+ * @param station  the station, or NULL for any
+ * @param time  the time as given by bufr_archive_time, rounded down
+ * to the hour, or BLOOM_ANY_TIME
+ * @return 0 if it was not, 1 if it may have been
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bloom_add_entry
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_bloom_may_hold( BufrBloom *bloom, const char *station, int64_t time )
+   {
+   char      name[ARCHIVE_STATION_LEN];
+   char      key[ARCHIVE_STATION_LEN+32];
+   int64_t   h;
+
+   if (bloom == NULL) return 1;
+
+   if (station) bufr_archive_station_id( name, station );
+   h = (int64_t)floor( time / 3600.0 );
+   if (station && (time != BLOOM_ANY_TIME))
+      {
+      snprintf( key, sizeof(key), "%s@%lld", name, (long long)h );
+      if (bufr_bloom_may_contain( bloom, key )) return 1;
+      snprintf( key, sizeof(key), "%s@*", name );
+      return bufr_bloom_may_contain( bloom, key );
+      }
+   if (station)
+      {
+      snprintf( key, sizeof(key), "S%s", name );
+      return bufr_bloom_may_contain( bloom, key );
+      }
+   if (time != BLOOM_ANY_TIME)
+      {
+      snprintf( key, sizeof(key), "H%lld", (long long)h );
+      return bufr_bloom_may_contain( bloom, key ) || bufr_bloom_may_contain( bloom, "H*" );
+      }
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief build the Bloom filters of the file of an archive index
+ * @param idx  the index of the messages of one file
+ * @param per_message  also build a filter for each message
+ * @param fp_rate  probability of a false positive
+ * @return the sidecar, to free with bufr_free_bloom_sidecar
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_write_bloom_sidecar, bufr_sidecar_may_hold
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrBloomSidecar *bufr_archive_index_sidecar( BufrArchiveIndex *idx, int per_message, double fp_rate )
+   {
+   BufrBloomSidecar  *sc;
+   BufrArchiveEntry  *entries;
+   int                i, count, nb_keys;
+
+   if (idx == NULL) return NULL;
+
+   count = arr_count( idx->entries );
+   entries = (BufrArchiveEntry *)arr_get( idx->entries, 0 );
+   nb_keys = 0;
+   for (i = 0; i < count ; i++)
+      nb_keys += bufr_bloom_count_keys( &(entries[i]) );
+
+   sc = (BufrBloomSidecar *)malloc( sizeof(BufrBloomSidecar) );
+   sc->file = bufr_create_bloom( nb_keys, fp_rate );
+   sc->nb_messages = per_message ? count : 0;
+   sc->offsets  = NULL;
+   sc->messages = NULL;
+   if (sc->nb_messages > 0)
+      {
+      sc->offsets  = (long *)malloc( count * sizeof(long) );
+      sc->messages = (BufrBloom **)malloc( count * sizeof(BufrBloom *) );
+      }
+   for (i = 0; i < count ; i++)
+      {
+      bufr_bloom_add_entry( sc->file, &(entries[i]) );
+      if (sc->nb_messages == 0) continue;
+      sc->offsets[i] = entries[i].offset;
+      sc->messages[i] = bufr_create_bloom( bufr_bloom_count_keys( &(entries[i]) ), fp_rate );
+      bufr_bloom_add_entry( sc->messages[i], &(entries[i]) );
+      }
+   return sc;
+   }
+
+/**
+ * @english
+ * @brief free the Bloom filters of a file
+ * @param sc  the sidecar
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_free_bloom_sidecar( BufrBloomSidecar *sc )
+   {
+   int  i;
+
+   if (sc == NULL) return;
+
+   bufr_free_bloom( sc->file );
+   for (i = 0; i < sc->nb_messages ; i++)
+      bufr_free_bloom( sc->messages[i] );
+   if (sc->offsets) free( sc->offsets );
+   if (sc->messages) free( sc->messages );
+   free( sc );
+   }
+
+/**
+ * @english
+ * @brief tell if a file or one of its messages may hold a station at a time
+ * @param sc  the sidecar of the file
+ * @param offset  offset of the message in the file, -1 for the whole file
+ * @param station  the station, or NULL for any
+ * @param time  the time, or BLOOM_ANY_TIME
+ * @return 0 if it does not, 1 if it may; a message without its own
+ * filter is answered by the filter of the file
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bloom_may_hold
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_sidecar_may_hold( BufrBloomSidecar *sc, long offset, const char *station, int64_t time )
+   {
+   int  lo, hi, mid;
+
+   if (sc == NULL) return 1;
+
+   if ((offset >= 0)&&(sc->nb_messages > 0))
+      {
+      lo = 0;
+      hi = sc->nb_messages - 1;
+      while (lo <= hi)
+         {
+         mid = (lo + hi) / 2;
+         if (sc->offsets[mid] == offset)
+            return bufr_bloom_may_hold( sc->messages[mid], station, time );
+         if (sc->offsets[mid] < offset)
+            lo = mid + 1;
+         else
+            hi = mid - 1;
+         }
+      }
+   return bufr_bloom_may_hold( sc->file, station, time );
+   }
+
+/**
+ * @english
+ * @brief write the Bloom filters of a file into a sidecar file
+ * @param sc  the sidecar
+ * @param fp  the sidecar file, opened in binary mode
+ * @return number of filters written
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_read_bloom_sidecar
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_write_bloom_sidecar( BufrBloomSidecar *sc, FILE *fp )
+   {
+   int  i;
+
+   if ((sc == NULL)||(fp == NULL)) return -1;
+
+   fprintf( fp, "BUFR_BLOOM_SIDECAR 1 %d\n", sc->nb_messages );
+   bufr_write_bloom( sc->file, -1, fp );
+   for (i = 0; i < sc->nb_messages ; i++)
+      bufr_write_bloom( sc->messages[i], sc->offsets[i], fp );
+   return sc->nb_messages + 1;
+   }
+
+/**
+ * @english
+ * @brief read a sidecar file written by bufr_write_bloom_sidecar
+ * @param fp  the sidecar file, opened in binary mode
+ * @return the sidecar, NULL if the file is not a sidecar
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_write_bloom_sidecar
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrBloomSidecar *bufr_read_bloom_sidecar( FILE *fp )
+   {
+   BufrBloomSidecar  *sc;
+   long               offset;
+   int                version, count, i;
+
+   if (fp == NULL) return NULL;
+   if ((fscanf( fp, "BUFR_BLOOM_SIDECAR %d %d", &version, &count ) != 2)||(version != 1)||(count < 0))
+      {
+      bufr_print_debug( _("Error: not a bloom sidecar\n") );
+      return NULL;
+      }
+
+   sc = (BufrBloomSidecar *)malloc( sizeof(BufrBloomSidecar) );
+   sc->nb_messages = 0;
+   sc->offsets  = (count > 0) ? (long *)malloc( count * sizeof(long) ) : NULL;
+   sc->messages = (count > 0) ? (BufrBloom **)malloc( count * sizeof(BufrBloom *) ) : NULL;
+   sc->file = bufr_read_bloom( fp, &offset );
+   for (i = 0; (i < count)&&(sc->file != NULL) ; i++)
+      {
+      sc->messages[i] = bufr_read_bloom( fp, &(sc->offsets[i]) );
+      if (sc->messages[i] == NULL) break;
+      sc->nb_messages = i + 1;
+      }
+   if ((sc->file == NULL)||(sc->nb_messages != count))
+      {
+      bufr_print_debug( _("Error: bloom sidecar is truncated\n") );
+      bufr_free_bloom_sidecar( sc );
+      return NULL;
+      }
+   return sc;
+   }
+
+/**
+ * @english
+ * 64 bits FNV-1a hash of a key
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_bloom_hash( const char *key )
+   {
+   uint64_t  h = 14695981039346656037ULL;
+
+   while (*key)
+      {
+      h ^= (unsigned char)*key++;
+      h *= 1099511628211ULL;
+      }
+   return h;
+   }
+
+/**
+ * @english
+ * number of keys bufr_bloom_add_entry adds for a message
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_bloom_count_keys( BufrArchiveEntry *entry )
+   {
+   int64_t  hours;
+
+   hours = (int64_t)floor( entry->time_max / 3600.0 ) - (int64_t)floor( entry->time_min / 3600.0 ) + 1;
+   if (hours > BLOOM_MAX_HOURS) return 2 * entry->nb_stations + 1;
+   return entry->nb_stations * (1 + hours) + hours;
+   }
+
+/**
+ * @english
+ * write one filter: a line with its offset, size and number of hashes,
+ * then its bits
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_write_bloom( BufrBloom *bloom, long offset, FILE *fp )
+   {
+   fprintf( fp, "%ld %d %d\n", offset, bloom->nbits, bloom->nb_hashes );
+   fwrite( bloom->bits, 1, bloom->nbits / 8, fp );
+   fprintf( fp, "\n" );
+   }
+
+/**
+ * @english
+ * read one filter written by bufr_write_bloom
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrBloom *bufr_read_bloom( FILE *fp, long *offset )
+   {
+   BufrBloom  *bloom;
+   int         nbits, nb_hashes;
+
+   if (fscanf( fp, "%ld %d %d", offset, &nbits, &nb_hashes ) != 3) return NULL;
+   if ((nbits <= 0)||(nbits % 8)||(nb_hashes < 1)) return NULL;
+   if (fgetc( fp ) != '\n') return NULL;
+
+   bloom = (BufrBloom *)malloc( sizeof(BufrBloom) );
+   bloom->nbits = nbits;
+   bloom->nb_hashes = nb_hashes;
+   bloom->bits = (unsigned char *)malloc( nbits / 8 );
+   if ((fread( bloom->bits, 1, nbits / 8, fp ) != nbits / 8)||(fgetc( fp ) != '\n'))
+      {
+      bufr_free_bloom( bloom );
+      return NULL;
+      }
+   return bloom;
+   }
@@ -0,0 +1,651 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_bundler.c
+ *
+ * author:  Vanh Souvanlasy 
+ *
+ * function: regroupement de subsets en messages au fur et a mesure
+ *
+ * Subsets are sorted into open bundles by template, section 1 and, when
+ * compressing, by structure. Uncompressed subsets are encoded as soon as
+ * they arrive; compressed ones are moved, not copied, into the bundle
+ * dataset. A bundle is written out once it reaches a size, count or age
+ * limit, so memory is bounded by the limits and the number of open bundles.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_tables.h"
+#include "bufr_template.h"
+#include "bufr_dataset.h"
+#include "bufr_bundler.h"
+#include "bufr_i18n.h"
+
+static BufrBundle  *bufr_find_bundle         ( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1,
+                                               int data_flag, uint64_t signature );
+static int          bufr_same_s1_key         ( BufrSection1 *s1, BufrSection1 *s2 );
+static BufrBundle  *bufr_open_bundle         ( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1,
+                                               int data_flag, uint64_t signature );
+static void         bufr_free_bundle         ( BufrBundle *bundle );
+static void         bufr_bundle_estimate     ( BufrBundle *bundle, DataSubset *subset );
+static int          bufr_bundle_check        ( BUFR_Bundler *bundler, BufrBundle *bundle );
+static void         bufr_flush_bundle        ( BUFR_Bundler *bundler, int pos );
+
+/**
+ * @english
+ * @brief create a bundler
+ *
+ * Subsets given to the bundler are gathered into messages that are handed
+ * to the output function once complete. There are no limits until
+ * bufr_bundler_set_limits is called, bundles are then only written by
+ * bufr_bundler_flush.
+ * @param x_compress  compress the messages when subsets allow it
+ * @param output  function receiving each message
+ * @param client_data  passed to output
+ * @return the bundler
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bundler_add_subset, bufr_bundler_flush, bufr_free_bundler
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+BUFR_Bundler *bufr_create_bundler( int x_compress, bufr_bundle_output output, void *client_data )
+   {
+   BUFR_Bundler *bundler;
+
+   if (output == NULL) return NULL;
+
+   bundler = (BUFR_Bundler *)malloc( sizeof(BUFR_Bundler) );
+   bundler->x_compress  = x_compress;
+   bundler->max_subsets = 0;
+   bundler->max_octets  = 0;
+   bundler->max_seconds = 0;
+   bundler->bundles     = arr_create( 16, sizeof(BufrBundle *), 16 );
+   bundler->output      = output;
+   bundler->client_data = client_data;
+   return bundler;
+   }
+
+/**
+ * @english
+ * @brief free a bundler, subsets not yet flushed are discarded
+ * @param bundler the bundler
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+void bufr_free_bundler( BUFR_Bundler *bundler )
+   {
+   int          i, count;
+   BufrBundle **pbundle;
+
+   if (bundler == NULL) return;
+
+   count = arr_count( bundler->bundles );
+   for (i = 0; i < count ; i++)
+      {
+      pbundle = (BufrBundle **)arr_get( bundler->bundles, i );
+      bufr_free_bundle( *pbundle );
+      }
+   arr_free( &(bundler->bundles) );
+   free( bundler );
+   }
+
+/**
+ * @english
+ * @brief set when a bundle is written out
+ *
+ * A bundle is written as soon as it holds max_subsets subsets or its
+ * section 4 reaches max_octets; the size of a compressed bundle is
+ * estimated from the running range of each of its columns. max_octets
+ * is a threshold and not a bound: the subset that reaches it stays in
+ * the message, which may then be larger by up to one subset. max_seconds
+ * is checked by bufr_bundler_expire. A limit of 0 is no limit.
+ * @param bundler the bundler
+ * @param max_subsets  maximum number of subsets per message
+ * @param max_octets  size of section 4 at which a message is written
+ * @param max_seconds  maximum age of a bundle
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+void bufr_bundler_set_limits( BUFR_Bundler *bundler, int max_subsets, int max_octets, int max_seconds )
+   {
+   if (bundler == NULL) return;
+
+   bundler->max_subsets = max_subsets;
+   bundler->max_octets  = max_octets;
+   bundler->max_seconds = max_seconds;
+   }
+
+/**
+ * @english
+ * @brief add a decoded subset to the bundler
+ *
+ * Uncompressed, the datasubset is encoded at once and dts is left as is.
+ * Compressed, it is moved into a bundle of subsets with the same structure
+ * and dts keeps an empty datasubset at pos.
+ * @param bundler the bundler
+ * @param dts  dataset holding the subset, with its section 1 set
+ * @param pos  position of the subset in dts
+ * @return number of messages written out, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_add_subset( BUFR_Bundler *bundler, BUFR_Dataset *dts, int pos )
+   {
+   BufrBundle  *bundle;
+   DataSubset  *subset;
+   uint64_t     signature;
+   int          dpos;
+
+   if ((bundler == NULL)||(dts == NULL)) return -1;
+
+   subset = bufr_get_datasubset( dts, pos );
+   if (subset == NULL) return -1;
+   if (bufr_datasubset_count_descriptor( subset ) <= 0) return 0;
+
+   signature = bundler->x_compress ? bufr_datasubset_signature( subset ) : 0;
+   bundle = bufr_find_bundle( bundler, dts->tmplte, &(dts->s1), dts->data_flag, signature );
+   if (bundle == NULL) 
+      bundle = bufr_open_bundle( bundler, dts->tmplte, &(dts->s1), dts->data_flag, signature );
+   if (bundle == NULL) return -1;
+
+   if (bundle->dts)
+      {
+      dpos = bufr_move_datasubset( bundle->dts, dts, pos );
+      if (dpos < 0) return -1;
+      bufr_bundle_estimate( bundle, bufr_get_datasubset( bundle->dts, dpos ) );
+      }
+   else
+      {
+      bufr_encode_datasubset( bundle->msg, subset );
+      bundle->nbits = (uint64_t)bundle->msg->s4.filled * 8 + bundle->msg->s4.bitno;
+      }
+   bundle->nb_subsets += 1;
+
+   return bufr_bundle_check( bundler, bundle );
+   }
+
+/**
+ * @english
+ * @brief add every subset of a decoded dataset to the bundler
+ * @param bundler the bundler
+ * @param dts  dataset, its subsets are moved out when compressing
+ * @return number of messages written out, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_bundler_add_subset
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_add_dataset( BUFR_Bundler *bundler, BUFR_Dataset *dts )
+   {
+   int  i, count, rtrn;
+   int  total = 0;
+
+   count = bufr_count_datasubset( dts );
+   for (i = 0; i < count ; i++)
+      {
+      rtrn = bufr_bundler_add_subset( bundler, dts, i );
+      if (rtrn < 0) return -1;
+      total += rtrn;
+      }
+   return total;
+   }
+
+/**
+ * @english
+ * @brief add the raw bits of an uncompressed subset to the bundler
+ *
+ * The subset is copied bit for bit from section 4 of another message,
+ * without being decoded. This is only possible when the bundler does
+ * not compress.
+ * @param bundler the bundler
+ * @param tmplt  template of the subset
+ * @param s1  section 1 of the message holding the subset
+ * @param data  section 4 data of the message holding the subset
+ * @param bitpos  position of the first bit of the subset in data
+ * @param nbits  length of the subset in bits
+ * @return number of messages written out, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_add_bits( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1,
+                           const unsigned char *data, uint64_t bitpos, uint64_t nbits )
+   {
+   BufrBundle  *bundle;
+
+   if ((bundler == NULL)||(tmplt == NULL)||(s1 == NULL)||(data == NULL)) return -1;
+   if (bundler->x_compress)
+      {
+      bufr_print_debug( _("Error: raw subsets cannot be added to a compressing bundler\n") );
+      return -1;
+      }
+
+   bundle = bufr_find_bundle( bundler, tmplt, s1, 0, 0 );
+   if (bundle == NULL) 
+      bundle = bufr_open_bundle( bundler, tmplt, s1, 0, 0 );
+   if (bundle == NULL) return -1;
+
+   bufr_put_bitrange( bundle->msg, data, bitpos, nbits );
+   bundle->nbits = (uint64_t)bundle->msg->s4.filled * 8 + bundle->msg->s4.bitno;
+   bundle->nb_subsets += 1;
+
+   return bufr_bundle_check( bundler, bundle );
+   }
+
+/**
+ * @english
+ * @brief write out the bundles older than the age limit
+ * @param bundler the bundler
+ * @param now  current time
+ * @return number of messages written out
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_expire( BUFR_Bundler *bundler, time_t now )
+   {
+   int          i, total = 0;
+   BufrBundle **pbundle;
+
+   if ((bundler == NULL)||(bundler->max_seconds <= 0)) return 0;
+
+   for (i = arr_count( bundler->bundles ) - 1; i >= 0 ; i--)
+      {
+      pbundle = (BufrBundle **)arr_get( bundler->bundles, i );
+      if (now - (*pbundle)->opened >= bundler->max_seconds)
+         {
+         bufr_flush_bundle( bundler, i );
+         ++total;
+         }
+      }
+   return total;
+   }
+
+/**
+ * @english
+ * @brief write out every open bundle
+ * @param bundler the bundler
+ * @return number of messages written out
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_flush( BUFR_Bundler *bundler )
+   {
+   int  total;
+
+   if (bundler == NULL) return 0;
+
+   total = 0;
+   while (arr_count( bundler->bundles ) > 0)
+      {
+      bufr_flush_bundle( bundler, 0 );
+      ++total;
+      }
+   return total;
+   }
+
+/**
+ * @english
+ * @return number of bundles open
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+int bufr_bundler_count( BUFR_Bundler *bundler )
+   {
+   if (bundler == NULL) return 0;
+   return arr_count( bundler->bundles );
+   }
+
+/**
+ * @english
+ * find the open bundle where a subset goes
+ * @return the bundle, NULL if there is none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrBundle *bufr_find_bundle
+   ( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1, int data_flag, uint64_t signature )
+   {
+   int          i, count;
+   BufrBundle **pbundle, *bundle;
+
+   count = arr_count( bundler->bundles );
+   for (i = 0; i < count ; i++)
+      {
+      pbundle = (BufrBundle **)arr_get( bundler->bundles, i );
+      bundle = *pbundle;
+      if (bundle->signature != signature) continue;
+      if ((bundle->data_flag & BUFR_FLAG_OBSERVED) != (data_flag & BUFR_FLAG_OBSERVED)) continue;
+      if (!bufr_same_s1_key( &(bundle->s1), s1 )) continue;
+      if (bufr_compare_template( bundle->tmplte, tmplt ) != 0) continue;
+      return bundle;
+      }
+   return NULL;
+   }
+
+/**
+ * @english
+ * compare the section 1 fields that must be the same for subsets of a message
+ * @return 1 if they are the same
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_same_s1_key( BufrSection1 *s1, BufrSection1 *s2 )
+   {
+   return (s1->bufr_master_table == s2->bufr_master_table)&&
+          (s1->orig_centre == s2->orig_centre)&&
+          (s1->orig_sub_centre == s2->orig_sub_centre)&&
+          (s1->msg_type == s2->msg_type)&&
+          (s1->msg_inter_subtype == s2->msg_inter_subtype)&&
+          (s1->msg_local_subtype == s2->msg_local_subtype)&&
+          (s1->master_table_version == s2->master_table_version)&&
+          (s1->local_table_version == s2->local_table_version);
+   }
+
+/**
+ * @english
+ * open a new bundle, its section 1 is the one of its first subset
+ * @return the bundle, NULL on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrBundle *bufr_open_bundle
+   ( BUFR_Bundler *bundler, BUFR_Template *tmplt, BufrSection1 *s1, int data_flag, uint64_t signature )
+   {
+   BufrBundle  *bundle;
+
+   bundle = (BufrBundle *)malloc( sizeof(BufrBundle) );
+   bundle->signature  = signature;
+   bundle->data_flag  = data_flag & BUFR_FLAG_OBSERVED;
+   bundle->dts        = NULL;
+   bundle->msg        = NULL;
+   bundle->stats      = NULL;
+   bundle->nb_stats   = 0;
+   bundle->nb_subsets = 0;
+   bundle->nbits      = 0;
+   bundle->opened     = time(NULL);
+   bufr_init_sect1( &(bundle->s1), tmplt->edition );
+   bufr_copy_sect1( &(bundle->s1), s1 );
+
+   if (bundler->x_compress)
+      {
+      bundle->dts = bufr_create_dataset( tmplt );
+      if (bundle->dts == NULL)
+         {
+         free( bundle );
+         return NULL;
+         }
+      bundle->tmplte = bundle->dts->tmplte;
+      bufr_copy_sect1( &(bundle->dts->s1), s1 );
+      bundle->dts->data_flag = bundle->data_flag;
+      }
+   else
+      {
+      bundle->tmplte = bufr_copy_template( tmplt );
+      if (bundle->tmplte == NULL)
+         {
+         free( bundle );
+         return NULL;
+         }
+      bundle->msg = bufr_create_message( tmplt->edition );
+      bufr_copy_sect1( &(bundle->msg->s1), s1 );
+      bundle->msg->s3.flag = bundle->data_flag;
+      BUFR_SET_UNCOMPRESSED( bundle->msg );
+      bufr_begin_message( bundle->msg );
+      bufr_alloc_sect4( bundle->msg, 4096 );
+      }
+
+   arr_add( bundler->bundles, (char *)&bundle );
+   return bundle;
+   }
+
+/**
+ * @english
+ * free a bundle and what it holds
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_free_bundle( BufrBundle *bundle )
+   {
+   if (bundle == NULL) return;
+
+   if (bundle->dts)
+      bufr_free_dataset( bundle->dts );
+   else
+      bufr_free_template( bundle->tmplte );
+   if (bundle->msg)
+      bufr_free_message( bundle->msg );
+   if (bundle->stats)
+      free( bundle->stats );
+   free( bundle );
+   }
+
+/**
+ * @english
+ * add a subset to the running range of each column of a compressed bundle
+ * and estimate the size of its section 4 the way bufr_encode_message
+ * would encode it; strings and floating point values are counted in full
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_bundle_estimate( BufrBundle *bundle, DataSubset *subset )
+   {
+   int              j, count, nbinc;
+   BufrDescriptor  *bd;
+   BufrBundleStats *st;
+   uint64_t         bits, nbits, missing;
+
+   count = bufr_datasubset_count_descriptor( subset );
+   if (bundle->stats == NULL)
+      {
+      bundle->stats = (BufrBundleStats *)malloc( count * sizeof(BufrBundleStats) );
+      bundle->nb_stats = count;
+      for (j = 0; j < count ; j++)
+         {
+         bundle->stats[j].min = 0;
+         bundle->stats[j].max = 0;
+         bundle->stats[j].nb_missing = 0;
+         }
+      }
+
+   nbits = 0;
+   for (j = 0; (j < count)&&(j < bundle->nb_stats) ; j++)
+      {
+      bd = bufr_datasubset_get_descriptor( subset, j );
+      if ((bd->flags & FLAG_SKIPPED)||(bd->encoding.nbits <= 0)) continue;
+
+      if (bd->encoding.af_nbits > 0)
+         nbits += bd->encoding.af_nbits + 6 + (uint64_t)bd->encoding.af_nbits * (bundle->nb_subsets + 1);
+
+      if (bufr_descriptor_get_bitsvalue( bd, &bits ) < 0)
+         {
+         nbits += bd->encoding.nbits + 6 + (uint64_t)bd->encoding.nbits * (bundle->nb_subsets + 1);
+         continue;
+         }
+
+      st = &(bundle->stats[j]);
+      missing = bufr_missing_ivalue( bd->encoding.nbits );
+      if (bits == missing)
+         {
+         st->nb_missing += 1;
+         }
+      else if (st->nb_missing == bundle->nb_subsets)
+         {
+         st->min = st->max = bits;   /* first value */
+         }
+      else
+         {
+         if (bits < st->min) st->min = bits;
+         if (bits > st->max) st->max = bits;
+         }
+/*
+ * same rules as bufr_put_numeric_compressed
+ */
+      if (((st->min == st->max)&&(st->nb_missing == 0))||(st->nb_missing == bundle->nb_subsets + 1))
+         nbinc = 0;
+      else
+         nbinc = bufr_value_nbits( st->max - st->min );
+      nbits += bd->encoding.nbits + 6 + (uint64_t)nbinc * (bundle->nb_subsets + 1);
+      }
+   bundle->nbits = nbits;
+   }
+
+/**
+ * @english
+ * write out a bundle if it reached its size threshold or count limit
+ * @return 1 if it was written, 0 otherwise
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_bundle_check( BUFR_Bundler *bundler, BufrBundle *bundle )
+   {
+   int          i, count;
+   BufrBundle **pbundle;
+
+   if (((bundler->max_subsets <= 0)||(bundle->nb_subsets < bundler->max_subsets))&&
+       ((bundler->max_octets <= 0)||(bundle->nbits < (uint64_t)bundler->max_octets * 8)))
+      return 0;
+
+   count = arr_count( bundler->bundles );
+   for (i = 0; i < count ; i++)
+      {
+      pbundle = (BufrBundle **)arr_get( bundler->bundles, i );
+      if (*pbundle == bundle)
+         {
+         bufr_flush_bundle( bundler, i );
+         return 1;
+         }
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * complete the message of a bundle, hand it to the output and close the
+ * bundle; the last bundle takes its place in the array
+ * @param bundler the bundler
+ * @param pos  position of the bundle in the bundler
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_flush_bundle( BUFR_Bundler *bundler, int pos )
+   {
+   BufrBundle    **pbundle, *bundle;
+   BufrDescValue  *bdv;
+   BUFR_Message   *msg;
+   int             i, count, descriptor;
+
+   pbundle = (BufrBundle **)arr_get( bundler->bundles, pos );
+   bundle = *pbundle;
+
+   if (bundle->dts)
+      {
+      msg = bufr_encode_message( bundle->dts, 1 );
+      }
+   else
+      {
+      msg = bundle->msg;
+      bundle->msg = NULL;
+      BUFR_SET_NB_DATASET( msg, bundle->nb_subsets );
+      count = arr_count( bundle->tmplte->codets );
+      for (i = 0; i < count ; i++ )
+         {
+         bdv = (BufrDescValue *)arr_get( bundle->tmplte->codets, i );
+         descriptor = bdv->descriptor;
+         arr_add( msg->s3.desc_list, (char *)&descriptor );
+         }
+      bufr_end_message( msg );
+      }
+
+   count = arr_count( bundler->bundles );
+   if (pos < count - 1)
+      arr_set( bundler->bundles, pos, arr_get( bundler->bundles, count - 1 ) );
+   arr_del( bundler->bundles, 1 );
+   bufr_free_bundle( bundle );
+
+   if (msg)
+      {
+      bundler->output( msg, bundler->client_data );
+      bufr_free_message( msg );
+      }
+   }
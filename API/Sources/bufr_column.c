@@ -0,0 +1,802 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_column.c
+ *
+ * author:  Vanh Souvanlasy 
+ *
+ * function: encodage de colonnes de valeurs sans passer par un BUFR_Dataset
+ *
+ * The template is expanded once into an encode plan; each message is then
+ * written straight into section 4 from arrays holding the values of one
+ * template position for all subsets.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_linklist.h"
+#include "bufr_io.h"
+#include "bufr_ieee754.h"
+#include "bufr_desc.h"
+#include "bufr_sequence.h"
+#include "bufr_ddo.h"
+#include "bufr_tables.h"
+#include "bufr_template.h"
+#include "bufr_column.h"
+#include "bufr_i18n.h"
+
+static int          bufr_check_column         ( BufrDescriptor *bd, BufrColumn *col, int pos );
+static uint64_t     bufr_column_bits          ( BufrDescriptor *bd, BufrColumn *col, int i );
+static double       bufr_column_dvalue        ( BufrDescriptor *bd, BufrColumn *col, int i );
+static const char  *bufr_column_svalue        ( BufrDescriptor *bd, BufrColumn *col, int i );
+static void         bufr_put_column_string    ( BUFR_Message *msg, const char *str, int enclen );
+static void         bufr_put_column_ieeefp    ( BUFR_Message *msg, double dval, int nbits );
+static void         bufr_put_column_value     ( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int i );
+static void         bufr_put_numeric_column   ( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col,
+                                                int nb_subsets, uint64_t *bits );
+static void         bufr_put_ccitt_column     ( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int nb_subsets );
+static void         bufr_put_ieeefp_column    ( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int nb_subsets );
+
+/**
+ * @english
+ * @brief Expand a template once for direct encoding of columns.
+ *
+ * The template is expanded and Table C operators are applied as they
+ * would be for every subset of a BUFR_Dataset. The position of a
+ * descriptor in the plan is its position in a data subset.
+ * Templates with delayed replication or associated fields cannot be
+ * planned, their layout depends on the data.
+ * @param tmplt a finalized template, it must outlive the plan
+ * @return the plan, NULL on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_encode_columns, bufr_free_encode_plan
+ * @author Vanh Souvanlasy
+ * @ingroup template encode
+ */
+BufrEncodePlan *bufr_create_encode_plan( BUFR_Template *tmplt )
+   {
+   BufrEncodePlan   *plan;
+   BUFR_Sequence    *bsq;
+   BufrDescriptor  **pbcd, *bd;
+   BufrDDOp         *ddo;
+   int               i, count;
+   int               errcode;
+   char              errmsg[256];
+
+   if (tmplt == NULL) return NULL;
+
+   count = arr_count( tmplt->gabarit );
+   if (count <= 0)
+      {
+      bufr_print_debug( _("Error: cannot plan encoding, template is not finalized\n") );
+      return NULL;
+      }
+   if (tmplt->flags & HAS_DELAYED_REPLICATION)
+      {
+      bufr_print_debug( _("Error: cannot plan encoding of a template with delayed replication\n") );
+      return NULL;
+      }
+
+   bsq = bufr_create_sequence(NULL);
+   pbcd = (BufrDescriptor **)arr_get( tmplt->gabarit, 0 );
+   for (i = 0; i < count ; i++)
+      {
+      bd = bufr_dupl_descriptor( pbcd[i] );
+      bufr_add_descriptor_to_sequence( bsq, bd );
+      }
+
+   ddo = bufr_create_BufrDDOp( BUFR_STRICT );
+   bufr_apply_Tables( ddo, bsq, tmplt, NULL, &errcode ); 
+   bufr_free_BufrDDOp( ddo );
+
+   plan = (BufrEncodePlan *)malloc( sizeof(BufrEncodePlan) );
+   plan->tmplte = tmplt;
+   plan->descs = bufr_sequence_to_array( bsq, 1 );
+   plan->nbits = 0;
+   lst_dellist( bsq->list );
+   bsq->list = NULL;
+   bufr_free_sequence( bsq );
+
+   if (errcode < 0)
+      {
+      bufr_print_debug( _("Error: cannot plan encoding, invalid template\n") );
+      bufr_free_encode_plan( plan );
+      return NULL;
+      }
+
+   count = arr_count( plan->descs );
+   for (i = 0; i < count ; i++)
+      {
+      bd = bufr_encode_plan_descriptor( plan, i );
+      if (bd->flags & FLAG_SKIPPED) continue;
+      if (bd->encoding.af_nbits > 0)
+         {
+         sprintf( errmsg, _("Error: cannot plan encoding, descriptor %.6d has associated fields\n"), 
+                  bd->descriptor );
+         bufr_print_debug( errmsg );
+         bufr_free_encode_plan( plan );
+         return NULL;
+         }
+      if (bd->encoding.nbits > 0)
+         plan->nbits += bd->encoding.nbits;
+      }
+   return plan;
+   }
+
+/**
+ * @english
+ * @brief free an encode plan and its expanded descriptors
+ * @param plan the plan, the template is not freed
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup template encode
+ */
+void bufr_free_encode_plan( BufrEncodePlan *plan )
+   {
+   int              i, count;
+   BufrDescriptor  *bd;
+
+   if (plan == NULL) return;
+
+   count = arr_count( plan->descs );
+   for (i = 0; i < count ; i++)
+      {
+      bd = bufr_encode_plan_descriptor( plan, i );
+      if (bd == NULL) continue;
+      if (bd->value)
+         {
+         bufr_free_value( bd->value );
+         bd->value = NULL;
+         }
+      bufr_free_descriptor( bd );
+      }
+   arr_free( &(plan->descs) );
+   free( plan );
+   }
+
+/**
+ * @english
+ * @return number of positions in the plan, ie. the size of the columns
+ * array given to bufr_encode_columns
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup template encode
+ */
+int bufr_encode_plan_count( BufrEncodePlan *plan )
+   {
+   if (plan == NULL) return 0;
+   return arr_count( plan->descs );
+   }
+
+/**
+ * @english
+ * @return the expanded descriptor at a position of the plan, its encoding
+ * has Table C applied and its value is the one defined in the template
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup template encode
+ */
+BufrDescriptor *bufr_encode_plan_descriptor( BufrEncodePlan *plan, int pos )
+   {
+   BufrDescriptor  **pbd;
+
+   if (plan == NULL) return NULL;
+
+   pbd = (BufrDescriptor **)arr_get( plan->descs, pos );
+   return (pbd ? *pbd : NULL);
+   }
+
+/**
+ * @english
+ * @brief find the position of a descriptor in the plan
+ * @param plan the plan
+ * @param descriptor descriptor to look for
+ * @param startpos first position to look at
+ * @return position found, -1 if not found
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup template encode
+ */
+int bufr_encode_plan_find( BufrEncodePlan *plan, int descriptor, int startpos )
+   {
+   int              i, count;
+   BufrDescriptor  *bd;
+
+   count = bufr_encode_plan_count( plan );
+   for (i = (startpos < 0) ? 0 : startpos; i < count ; i++)
+      {
+      bd = bufr_encode_plan_descriptor( plan, i );
+      if (bd->descriptor == descriptor) return i;
+      }
+   return -1;
+   }
+
+/**
+ * @english
+ * initialize a column to use the template values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode
+ */
+void bufr_init_column( BufrColumn *col )
+   {
+   col->type    = BUFR_COLUMN_NONE;
+   col->values  = NULL;
+   col->missing = NULL;
+   }
+
+/**
+ * @english
+ * @brief Encode columns of values into a BUFR message without a dataset.
+ *
+ * columns[pos] holds the values of position pos of the plan for all
+ * subsets; a position left as BUFR_COLUMN_NONE, or a NULL columns array,
+ * takes its value from the template or is missing. Section 4 is written
+ * directly from the columns, in a single pass per column when compressed,
+ * so no memory is needed beyond the message and one array of bits.
+ * @param plan encode plan of the template
+ * @param s1 section 1 to copy into the message, may be NULL
+ * @param columns array of bufr_encode_plan_count(plan) columns
+ * @param nb_subsets number of values in each column
+ * @param x_compress compress the subsets if non zero and nb_subsets > 1
+ * @return the message, NULL if a column does not suit its descriptor
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_create_encode_plan, bufr_encode_message
+ * @author Vanh Souvanlasy
+ * @ingroup message encode
+ */
+BUFR_Message *bufr_encode_columns
+   ( BufrEncodePlan *plan, BufrSection1 *s1, BufrColumn *columns, int nb_subsets, int x_compress )
+   {
+   BUFR_Message    *msg;
+   BUFR_Template   *tmplt;
+   BufrDescValue   *bdv;
+   BufrDescriptor  *bd;
+   BufrColumn       none, *col;
+   uint64_t         blen, *bits;
+   int              i, j, count, descriptor;
+   char             errmsg[256];
+
+   if ((plan == NULL)||(nb_subsets <= 0)) return NULL;
+
+   bufr_init_column( &none );
+   count = bufr_encode_plan_count( plan );
+   for (j = 0; j < count ; j++ )
+      {
+      col = columns ? &columns[j] : &none;
+      if (bufr_check_column( bufr_encode_plan_descriptor( plan, j ), col, j ) < 0)
+         return NULL;
+      }
+
+   tmplt = plan->tmplte;
+   msg = bufr_create_message( tmplt->edition );
+   if (s1)
+      bufr_copy_sect1( &(msg->s1), s1 );
+
+   if (x_compress && (nb_subsets > 1))
+      BUFR_SET_COMPRESSED( msg );
+   else 
+      BUFR_SET_UNCOMPRESSED( msg );
+
+   bufr_begin_message( msg );
+   BUFR_SET_NB_DATASET( msg, nb_subsets );
+
+   for (i = 0; i < arr_count( tmplt->codets ) ; i++ )
+      {
+      bdv = (BufrDescValue *)arr_get( tmplt->codets, i );
+      descriptor = bdv->descriptor;
+      arr_add( msg->s3.desc_list, (char *)&descriptor );
+      }
+
+   if (!BUFR_IS_COMPRESSED(msg))
+      {
+      blen = ((uint64_t)plan->nbits * nb_subsets + 7) / 8;
+      bufr_alloc_sect4( msg, blen );
+      for (i = 0; i < nb_subsets ; i++)
+         {
+         for (j = 0; j < count ; j++ )
+            {
+            bd = bufr_encode_plan_descriptor( plan, j );
+            if ((bd->flags & FLAG_SKIPPED)||(bd->encoding.nbits <= 0)) continue;
+            bufr_put_column_value( msg, bd, columns ? &columns[j] : &none, i );
+            }
+         }
+      }
+   else 
+      {
+      blen = ((uint64_t)plan->nbits * (nb_subsets + 1) + 6 * count + 7) / 8;
+      bufr_alloc_sect4( msg, blen );
+      bits = (uint64_t *)malloc( nb_subsets * sizeof(uint64_t) );
+      for (j = 0; j < count ; j++ )
+         {
+         bd = bufr_encode_plan_descriptor( plan, j );
+         if ((bd->flags & FLAG_SKIPPED)||(bd->encoding.nbits <= 0)) continue;
+         col = columns ? &columns[j] : &none;
+         switch (bd->encoding.type)
+            {
+            case TYPE_CCITT_IA5 :
+               bufr_put_ccitt_column( msg, bd, col, nb_subsets );
+               break;
+            case TYPE_IEEE_FP :
+               bufr_put_ieeefp_column( msg, bd, col, nb_subsets );
+               break;
+            default :
+               bufr_put_numeric_column( msg, bd, col, nb_subsets, bits );
+               break;
+            }
+         }
+      free( bits );
+      }
+
+   bufr_end_message( msg );
+
+   if (msg->len_msg > BUFR_MAX_MSG_LEN)
+      {
+      sprintf( errmsg, _n("Warning: BUFR message length is %u octet. ", "Warning: BUFR message length is %u octets. ", msg->len_msg), 
+               msg->len_msg );
+      bufr_print_debug( errmsg );
+      sprintf( errmsg, _n("It exceeds the maximum allowed of %d octet\n", "It exceeds the maximum allowed of %d octets\n", BUFR_MAX_MSG_LEN), 
+               BUFR_MAX_MSG_LEN );
+      bufr_print_debug( errmsg );
+      }
+   return msg;
+   }
+
+/**
+ * @english
+ * verify that the type of a column can be encoded by a descriptor
+ * @return 0 if it can, -1 if not
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_check_column( BufrDescriptor *bd, BufrColumn *col, int pos )
+   {
+   int    ok;
+   char   errmsg[256];
+
+   if ((bd->flags & FLAG_SKIPPED)||(bd->encoding.nbits <= 0)) return 0;
+   if (col->type == BUFR_COLUMN_NONE) return 0;
+
+   if (col->values == NULL)
+      ok = 0;
+   else switch (bd->encoding.type)
+      {
+      case TYPE_CCITT_IA5 :
+         ok = (col->type == BUFR_COLUMN_STRING);
+         break;
+      case TYPE_NUMERIC :
+      case TYPE_CODETABLE :
+      case TYPE_FLAGTABLE :
+         ok = (col->type != BUFR_COLUMN_STRING);
+         break;
+      case TYPE_IEEE_FP :
+         ok = (col->type == BUFR_COLUMN_DOUBLE)||(col->type == BUFR_COLUMN_INT32);
+         break;
+      case TYPE_CHNG_REF_VAL_OP :
+         ok = (col->type == BUFR_COLUMN_INT32);
+         break;
+      default :
+         ok = 0;
+         break;
+      }
+
+   if (!ok)
+      {
+      sprintf( errmsg, _("Error: column type %d cannot be encoded by descriptor %.6d at position %d\n"), 
+               col->type, bd->descriptor, pos );
+      bufr_print_debug( errmsg );
+      return -1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * encoded bits of the value of a numerical column for subset i
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_column_bits( BufrDescriptor *bd, BufrColumn *col, int i )
+   {
+   uint64_t   missing, bits;
+   int64_t    scaled;
+   int32_t    ival;
+   char       errmsg[256];
+
+   missing = bufr_missing_ivalue( bd->encoding.nbits );
+
+   if (col->type == BUFR_COLUMN_NONE)
+      {
+      if (bd->encoding.type == TYPE_CHNG_REF_VAL_OP)
+         {
+         ival = bufr_value_get_int32( bd->value );
+         return (ival < 0) ? bufr_negative_ivalue( ival, bd->encoding.nbits ) : ival;
+         }
+      if (bufr_descriptor_get_bitsvalue( bd, &bits ) <= 0) return missing;
+      return bits;
+      }
+   if (col->missing && col->missing[i]) return missing;
+
+   switch (col->type)
+      {
+      case BUFR_COLUMN_DOUBLE :
+         return bufr_cvt_dval_to_i64( bd->descriptor, &(bd->encoding), ((const double *)col->values)[i] );
+      case BUFR_COLUMN_INT32 :
+         ival = ((const int32_t *)col->values)[i];
+         if (bd->encoding.type == TYPE_CHNG_REF_VAL_OP)
+            return (ival < 0) ? bufr_negative_ivalue( ival, bd->encoding.nbits ) : ival;
+         if (bufr_is_missing_int( ival )) return missing;
+         if (bd->encoding.scale != 0)
+            return bufr_cvt_dval_to_i64( bd->descriptor, &(bd->encoding), (double)ival );
+         scaled = ival;
+         break;
+      case BUFR_COLUMN_SCALED :
+         scaled = ((const int64_t *)col->values)[i];
+         break;
+      default :
+         return missing;
+      }
+
+   if ((scaled < bd->encoding.reference)||((uint64_t)(scaled - bd->encoding.reference) >= missing))
+      {
+      sprintf( errmsg, _("Warning: The scaled value %lld of descriptor %d is out of range [%lld,%lld]\n"),
+               (long long)scaled, bd->descriptor, (long long)bd->encoding.reference,
+               (long long)(missing - 1 + bd->encoding.reference) );
+      bufr_print_debug( errmsg );
+      return missing;
+      }
+   return scaled - bd->encoding.reference;
+   }
+
+/**
+ * @english
+ * real value of an IEEE floating point column for subset i
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static double bufr_column_dvalue( BufrDescriptor *bd, BufrColumn *col, int i )
+   {
+   int32_t  ival;
+
+   if (col->type == BUFR_COLUMN_NONE)
+      return bd->value ? bufr_value_get_double( bd->value ) : bufr_missing_double();
+   if (col->missing && col->missing[i]) 
+      return bufr_missing_double();
+
+   if (col->type == BUFR_COLUMN_INT32)
+      {
+      ival = ((const int32_t *)col->values)[i];
+      return bufr_is_missing_int( ival ) ? bufr_missing_double() : (double)ival;
+      }
+   return ((const double *)col->values)[i];
+   }
+
+/**
+ * @english
+ * string of a CCITT_IA5 column for subset i, NULL if missing
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static const char *bufr_column_svalue( BufrDescriptor *bd, BufrColumn *col, int i )
+   {
+   const char  *str;
+   int          len;
+
+   if (col->type == BUFR_COLUMN_NONE)
+      {
+      str = bd->value ? bufr_value_get_string( bd->value, &len ) : NULL;
+      if (str && bufr_is_missing_string( str, len )) str = NULL;
+      return str;
+      }
+   if (col->missing && col->missing[i]) return NULL;
+   return ((const char * const *)col->values)[i];
+   }
+
+/**
+ * @english
+ * store a string padded with blanks, or a missing string if NULL
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_column_string( BUFR_Message *msg, const char *str, int enclen )
+   {
+   int  i;
+
+   if (str == NULL)
+      {
+      for (i = 0; i < enclen ; i++)
+         bufr_putbits( msg, 0xff, 8 );
+      }
+   else
+      {
+      bufr_put_padstring( msg, str, strlen( str ), enclen );
+      }
+   }
+
+/**
+ * @english
+ * store an IEEE floating point value
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_column_ieeefp( BUFR_Message *msg, double dval, int nbits )
+   {
+   float  fval;
+
+   if (nbits == 64)
+      {
+      bufr_putbits( msg, bufr_ieee_encode_double( dval ), 64 );
+      }
+   else
+      {
+      fval = bufr_is_missing_double( dval ) ? bufr_missing_float() : (float)dval;
+      bufr_putbits( msg, bufr_ieee_encode_single( fval ), 32 );
+      }
+   }
+
+/**
+ * @english
+ * store the value of subset i of a column, uncompressed
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_column_value( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int i )
+   {
+   switch (bd->encoding.type)
+      {
+      case TYPE_CCITT_IA5 :
+         bufr_put_column_string( msg, bufr_column_svalue( bd, col, i ), bd->encoding.nbits/8 );
+         break;
+      case TYPE_IEEE_FP :
+         bufr_put_column_ieeefp( msg, bufr_column_dvalue( bd, col, i ), bd->encoding.nbits );
+         break;
+      default :
+         bufr_putbits( msg, bufr_column_bits( bd, col, i ), bd->encoding.nbits );
+         break;
+      }
+   }
+
+/**
+ * @english
+ * store a numerical column with compression, the reference and the
+ * increments width are found in a single pass over the values
+ * @param  bits : work array of nb_subsets values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_numeric_column
+   ( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int nb_subsets, uint64_t *bits )
+   {
+   uint64_t   missing, msng, imin, imax, ival;
+   double    *dvals;
+   int        i, nb_msng, nbinc;
+
+   missing = bufr_missing_ivalue( bd->encoding.nbits );
+
+   if (col->type == BUFR_COLUMN_NONE)
+      {
+      bufr_putbits( msg, bufr_column_bits( bd, col, 0 ), bd->encoding.nbits );  /* REF */
+      bufr_putbits( msg, 0, 6 );                                                /* NBINC */
+      return;
+      }
+
+   if ((col->type == BUFR_COLUMN_DOUBLE)&&(col->missing == NULL))
+      {
+      bufr_cvt_dval_to_i64_array( bd->descriptor, &(bd->encoding), 
+                                  (const double *)col->values, bits, nb_subsets );
+      }
+   else if (col->type == BUFR_COLUMN_DOUBLE)
+      {
+/*
+ * masked values are made missing first, so that what they hold is not
+ * converted and reported out of range
+ */
+      dvals = (double *)malloc( nb_subsets * sizeof(double) );
+      for (i = 0; i < nb_subsets ; i++)
+         dvals[i] = col->missing[i] ? bufr_missing_double() : ((const double *)col->values)[i];
+      bufr_cvt_dval_to_i64_array( bd->descriptor, &(bd->encoding), dvals, bits, nb_subsets );
+      free( dvals );
+      }
+   else
+      {
+      for (i = 0; i < nb_subsets ; i++)
+         bits[i] = bufr_column_bits( bd, col, i );
+      }
+
+   nb_msng = 0;
+   imin = imax = missing;
+   for (i = 0; i < nb_subsets ; i++)
+      {
+      if (col->missing && col->missing[i]) bits[i] = missing;
+      ival = bits[i];
+      if (ival == missing) 
+         {
+         ++nb_msng;
+         continue;
+         }
+      if (imin == missing)
+         {
+         imin = imax = ival;
+         continue;
+         }
+      if (ival < imin) imin = ival;
+      if (ival > imax) imax = ival;
+      }
+
+   bufr_putbits( msg, imin, bd->encoding.nbits );  /* REF */
+/*
+ * same value for all subsets, ie all missing or a value
+ */
+   if (((imin == imax)&&(nb_msng == 0))||(nb_msng == nb_subsets))
+      {
+      bufr_putbits( msg, 0, 6 );                   /* NBINC */
+      return;
+      }
+
+   nbinc = bufr_value_nbits( imax - imin );
+   msng = bufr_missing_ivalue( nbinc );
+   bufr_putbits( msg, nbinc, 6 );                  /* NBINC */
+   for (i = 0; i < nb_subsets ; i++)
+      {
+      ival = (bits[i] == missing) ? msng : bits[i] - imin;
+      bufr_putbits( msg, ival, nbinc );            /* Inc 's */
+      }
+   }
+
+/**
+ * @english
+ * store a CCITT_IA5 column with compression
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_ccitt_column( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int nb_subsets )
+   {
+   const char  *str0, *str;
+   int          i, enclen, len0, len;
+   int          differs;
+
+   enclen = bd->encoding.nbits/8;
+/*
+ * see if all strings are the same, ignoring trailing blanks
+ */
+   str0 = bufr_column_svalue( bd, col, 0 );
+   len0 = str0 ? strlen( str0 ) : 0;
+   if (len0 > enclen) len0 = enclen;
+   while ((len0 > 0)&&(str0[len0-1] == ' ')) len0--;
+   differs = 0;
+   for (i = 1; (i < nb_subsets)&&(differs == 0) ; i++)
+      {
+      str = bufr_column_svalue( bd, col, i );
+      if ((str == NULL)||(str0 == NULL))
+         {
+         differs = (str != str0);
+         continue;
+         }
+      len = strlen( str );
+      if (len > enclen) len = enclen;
+      while ((len > 0)&&(str[len-1] == ' ')) len--;
+      differs = (len != len0)||strncmp( str, str0, len );
+      }
+
+   if (differs == 0)
+      {
+      bufr_put_column_string( msg, str0, enclen );    /* R0 */
+      bufr_putbits( msg, 0, 6 );                      /* NBINC */
+      return;
+      }
+
+   bufr_put_column_string( msg, NULL, enclen );       /* R0 */
+   bufr_putbits( msg, enclen, 6 );                    /* NBINC */
+   for (i = 0; i < nb_subsets ; i++)
+      bufr_put_column_string( msg, bufr_column_svalue( bd, col, i ), enclen );
+   }
+
+/**
+ * @english
+ * store an IEEE floating point column with compression
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_ieeefp_column( BUFR_Message *msg, BufrDescriptor *bd, BufrColumn *col, int nb_subsets )
+   {
+   double   dval0;
+   int      i, nbits, differs;
+
+   nbits = (bd->encoding.nbits == 64) ? 64 : 32;
+   dval0 = bufr_column_dvalue( bd, col, 0 );
+   differs = 0;
+   for (i = 1; (i < nb_subsets)&&(differs == 0) ; i++)
+      {
+      if (bufr_column_dvalue( bd, col, i ) != dval0) differs = 1;
+      }
+
+   if (differs == 0)
+      {
+      bufr_put_column_ieeefp( msg, dval0, nbits );    /* R0 */
+      bufr_putbits( msg, 0, 6 );                      /* NBINC */
+      return;
+      }
+
+   bufr_putbits( msg, 0, nbits );                     /* R0 */
+   bufr_putbits( msg, nbits/8, 6 );                   /* NBINC */
+   for (i = 0; i < nb_subsets ; i++)
+      bufr_put_column_ieeefp( msg, bufr_column_dvalue( bd, col, i ), nbits );
+   }
@@ -30,6 +30,7 @@ This file is part of libECBUFR.
 #include <locale.h>
 #include <gettext.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "bufr_util.h"
 #include "bufr_array.h"
@@ -42,12 +43,98 @@ This file is part of libECBUFR.
 #include "bufr_sequence.h"
 #include "bufr_dataset.h"
 #include "bufr_i18n.h"
+#include "private/bufr_priv_thread.h"
+
+/*
+ * a range of subsets, or of descriptor positions when compressed,
+ * encoded by one thread into its own section 4
+ */
+typedef struct
+   {
+   BUFR_Dataset  *dts;
+   int            from, to;
+   BUFR_Message  *part;
+   } EncodeSlice;
+
+/*
+ * slices shared by the encoding threads, each takes the next one left
+ */
+typedef struct
+   {
+   EncodeSlice      *slices;
+   int               nb_slices;
+   int               next;
+   pthread_mutex_t   lock;
+   void            (*encode)( EncodeSlice * );
+   } EncodeSlices;
+
+/*
+ * text of a dump file held in memory, read one line at a time
+ */
+typedef struct
+   {
+   const char       *ptr;          /* NEXT LINE TO READ */
+   const char       *end;
+   const char       *cur;          /* LINE LAST READ, IN THE TEXT */
+   int               len;          /* ITS LENGTH */
+   char             *line;         /* ITS COPY, TERMINATED, FOR STRTOK */
+   int               line_max;
+   int               fast_numbers; /* DECIMAL POINT OF THE LOCALE IS '.' */
+   } DumpText;
+
+/*
+ * a dataset of a dump file, parsed and encoded by one thread
+ */
+typedef struct
+   {
+   const char       *text, *end;
+   const char       *stop;         /* WHERE ITS PARSING STOPPED */
+   int               status;       /* OF bufr_read_dataset_dump */
+   int               encoded;      /* A MESSAGE WAS ENCODED */
+   int               done;
+   char             *bytes;        /* THE ENCODED MESSAGE */
+   size_t            len, max;
+   } DumpBlock;
+
+/*
+ * datasets shared by the threads of bufr_genmsgs_from_dump, each takes
+ * the next one left, without getting too far ahead of the writing
+ */
+typedef struct
+   {
+   BUFR_Template    *tmplt;
+   int               do_compress;
+   DumpBlock        *blocks;
+   int               nb_blocks;
+   int               next;
+   int               written;
+   int               window;
+   int               abort;
+   pthread_mutex_t   lock;
+   pthread_cond_t    cond;
+   } DumpBlocks;
+
+/*
+ * set in the threads of bufr_genmsgs_from_dump, which encode their own
+ * message and should not start more threads for it
+ */
+static BUFR_THREAD_LOCAL int  bufr_genmsgs_worker=0;
 
 static uint64_t    bufr_value2bits           ( BufrDescriptor *code );
+static int         bufr_scaled2bits          ( BufrDescriptor *code, uint64_t *bits );
+static uint64_t   *bufr_values2bits          ( BUFR_Dataset *dts, BufrDescriptor *bcv, int j, int nb_subsets );
+static int         bufr_column_prepare       ( BufrDescriptor *bd, BufrDescriptor **last, int *has_range, double *min, double *max );
 static void        bufr_empty_datasubsets    ( BUFR_Dataset *dts );
 static void        bufr_free_datasubsets     ( BUFR_Dataset *dts );
 static void        bufr_free_datasubset      ( DataSubset *subset );
 static void        bufr_put_desc_value       ( BUFR_Message *bufr, BufrDescriptor *bc );
+static int         bufr_put_subsets_threaded ( BUFR_Message *msg, BUFR_Dataset *dts, int nb_subsets );
+static int         bufr_put_compressed_threaded( BUFR_Message *msg, BUFR_Dataset *dts, int count );
+static void        bufr_put_compressed_descriptor( BUFR_Message *msg, BUFR_Dataset *dts, BufrDescriptor *bcv, int j );
+static void        bufr_encode_slices        ( BUFR_Message *msg, EncodeSlices *work, int nb_threads );
+static void       *bufr_encode_slices_worker ( void *work );
+static void        bufr_put_subsets_slice    ( EncodeSlice *slice );
+static void        bufr_put_positions_slice  ( EncodeSlice *slice );
 static int         bufr_get_desc_value       ( BUFR_Message *bufr, BufrDescriptor *bc );
 static int         bufr_get_desc_ieeefp     ( BUFR_Message *bufr, BufrDescriptor *code );
 static int         bufr_get_desc_ccittia5   ( BUFR_Message *bufr, BufrDescriptor *code, int );
@@ -56,6 +143,13 @@ static void        bufr_put_af_compressed    ( BUFR_Message *msg, BUFR_Dataset *
 static void        bufr_put_ccitt_compressed ( BUFR_Message *msg, BUFR_Dataset *dts, int j );
 static void        bufr_put_ieeefp_compressed( BUFR_Message *msg, BUFR_Dataset *dts, int j );
 static DataSubset *bufr_duplicate_datasubset ( DataSubset *dss );
+static uint64_t    bufr_signature_mix        ( uint64_t hash, int64_t value );
+static int         bufr_is_delayed_count     ( BufrDescriptor *bd );
+static void        bufr_signature_base       ( DataSubset *subset, int stamp );
+static void        bufr_forget_signature     ( DataSubset *subset );
+static BufrPositionIndex *bufr_create_position_index( DataSubset *subset );
+static void        bufr_release_position_index( BufrPositionIndex *index );
+static int         bufr_compare_desc_pos     ( const void *p1, const void *p2 );
 static void        bufr_put_numeric_compressed
                            ( BUFR_Message *msg, BUFR_Dataset *dts, BufrDescriptor *bcv, int j );
 static int         bufr_get_ccitt_compressed 
@@ -68,11 +162,25 @@ static int         bufr_get_af_compressed
                            ( BufrDescriptor *cb, int nbsubset, BUFR_Message *msg, ListNode **, int subset_from, int subset_to );
 static DataSubset *bufr_allocate_datasubset  ( void );
 static void        bufr_fill_datasubset      ( DataSubset *subset, BUFR_Sequence *bsq );
-static int         bufr_load_header( FILE *fp, BUFR_Dataset *dts );
-static int         bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_Enforcement enforce );
+static int         bufr_load_header( DumpText *dt, BUFR_Dataset *dts );
+static int         bufr_load_datasubsets( DumpText *dt, BUFR_Dataset *dts, int lineno, BUFR_Enforcement enforce );
+static int         bufr_parse_dataset_dump   ( BUFR_Dataset *dts, DumpText *dt );
+static void        bufr_dump_text_init       ( DumpText *dt, const char *text, size_t len );
+static char       *bufr_dump_text_gets       ( DumpText *dt );
+static void        bufr_dump_text_unget      ( DumpText *dt );
+static const char *bufr_dump_text_next       ( const char *ptr, const char *end );
+static int         bufr_split_decimal        ( const char *str, uint64_t *mantissa, int *decimals );
+static double      bufr_dump_strtod          ( DumpText *dt, const char *str );
+static float       bufr_dump_strtof          ( DumpText *dt, const char *str );
+static int64_t     bufr_dump_atol            ( const char *str );
+static void        bufr_genmsgs_serial       ( BUFR_Template *tmplt, DumpText *dt, FILE *fpo, int do_compress, int *has_msg );
+static int         bufr_genmsgs_threaded     ( BUFR_Template *tmplt, const char *text, size_t len, FILE *fpo, int do_compress, int nb_threads );
+static void       *bufr_genmsgs_thread       ( void *data );
+static ssize_t     bufr_dump_block_write     ( void *client_data, size_t len, const char *buffer );
 static void        bufr_mkval_rest_sequence(BUFR_Tables   *tbls, BUFR_Sequence *bsq2, ListNode *node, int *errflg );
 
 extern int         bufr_meta_enabled;
+extern int         bufr_nb_threads;
 
 /**
  * @english
@@ -91,6 +199,11 @@ static DataSubset *bufr_allocate_datasubset(void)
    subset = (DataSubset *)malloc( sizeof(DataSubset ));
    subset->dpbm     = NULL;
    subset->data     = NULL;
+   subset->signature = 0;
+   subset->sig_stamp = 0;
+   subset->count_pos = NULL;
+   subset->nb_count_pos = 0;
+   subset->index    = NULL;
    return  subset;
    }
 
@@ -309,6 +422,7 @@ int bufr_expand_qualifiers( DataSubset* dss )
 			{
 			BufrDescriptor* bd = pbcd[i];
 			if( bd->meta == NULL ) bd->meta = bufr_create_rtmd(0);
+			else bd->meta = bufr_unshare_rtmd(bd->meta);
 			if( bd->meta == NULL ) break;
 
 			if( bd->meta->qualifiers ) free(bd->meta->qualifiers);
@@ -437,6 +551,9 @@ int bufr_expand_datasubset( BUFR_Dataset *dts, int dss_pos )
 
    arr_free( &(dss->data) );
    dss->data = bufr_sequence_to_array( bsq, 1 );
+   bufr_forget_signature( dss );
+   bufr_release_position_index( dss->index );
+   dss->index = NULL;
    if (dss->dpbm != NULL)
       {
       bufr_free_BufrDPBM( dss->dpbm );
@@ -480,6 +597,16 @@ static DataSubset *bufr_duplicate_datasubset( DataSubset *dss )
       bc = bufr_dupl_descriptor( bc );
       arr_add( subset->data , (char *)&bc );
       }
+   subset->signature = dss->signature;
+   subset->sig_stamp = dss->sig_stamp;
+   if (dss->nb_count_pos > 0)
+      {
+      subset->count_pos = (int *)malloc( dss->nb_count_pos * sizeof(int) );
+      memcpy( subset->count_pos, dss->count_pos, dss->nb_count_pos * sizeof(int) );
+      subset->nb_count_pos = dss->nb_count_pos;
+      }
+   subset->index = dss->index;
+   if (subset->index) BUFR_ATOMIC_INCR( &(subset->index->refcount) );
 
    return subset;
    }
@@ -543,6 +670,9 @@ int bufr_add_datasubset( BUFR_Dataset *dts, BUFR_Sequence *bsq, BufrDDOp *ddo )
 static void bufr_fill_datasubset( DataSubset *subset, BUFR_Sequence *bsq )
    {
    subset->data =  bufr_sequence_to_array( bsq, 1 );
+   bufr_forget_signature( subset );
+   bufr_release_position_index( subset->index );
+   subset->index = NULL;
 /*
  * all items already transfered to datasubset array
  * so just free the list
@@ -601,6 +731,260 @@ BufrDescriptor *bufr_datasubset_get_descriptor( DataSubset *dts, int pos )
    return (pcb ? *pcb : NULL);
    }
 
+/**
+ * @english
+ * @brief Fetch the scaled integer values of a template position in all subsets.
+ *
+ * Fills values[i] with the value * 10^scale of the descriptor at position
+ * pos of subset i, without going through floating point for decoded
+ * values. Missing values are set to the given missing marker.
+ * @param dts pointer to a BUFR_Dataset
+ * @param pos position of the descriptor in each data subset
+ * @param values output array, at least bufr_count_datasubset() long
+ * @param missing value stored for missing or absent values
+ * @return number of subsets filled, -1 if a descriptor at pos is not numeric
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_get_scaled
+ * @author Vanh Souvanlasy
+ * @ingroup dataset descriptor
+ */
+int bufr_dataset_get_scaled_column( BUFR_Dataset *dts, int pos, int64_t *values, int64_t missing )
+   {
+   int             i, n, rtrn;
+   DataSubset     *subset;
+   BufrDescriptor *bd;
+
+   if ((dts == NULL)||(values == NULL)) return -1;
+
+   n = bufr_count_datasubset( dts );
+   for (i = 0; i < n ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      bd = bufr_datasubset_get_descriptor( subset, pos );
+      if (bd == NULL)
+         {
+         values[i] = missing;
+         continue;
+         }
+      rtrn = bufr_descriptor_get_scaled( bd, &values[i] );
+      if (rtrn < 0) return -1;
+      if (rtrn == 0) values[i] = missing;
+      }
+   return n;
+   }
+
+/**
+ * @english
+ * prepare a descriptor of a column for direct value assignment,
+ * the range is only recomputed when the encoding differs from the last one
+ * @return 1 if the value can be assigned directly, 0 if the checked
+ * setter must be used
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset internal
+ */
+static int bufr_column_prepare
+   ( BufrDescriptor *bd, BufrDescriptor **last, int *has_range, double *min, double *max )
+   {
+/*
+ * delayed replication counts must go through the checked setters
+ */
+   if (DESC_TO_X( bd->descriptor ) == 31) return 0;
+
+   if ((*last == NULL)||
+       ((*last)->descriptor != bd->descriptor)||
+       ((*last)->encoding.type != bd->encoding.type)||
+       ((*last)->encoding.scale != bd->encoding.scale)||
+       ((*last)->encoding.reference != bd->encoding.reference)||
+       ((*last)->encoding.nbits != bd->encoding.nbits))
+      {
+      *has_range = (bufr_descriptor_get_range( bd, min, max ) > 0);
+      *last = bd;
+      }
+   if (!*has_range) return 0;
+
+   if (bd->value == NULL)
+      bd->value = bufr_mkval_for_descriptor( bd );
+   return (bd->value != NULL);
+   }
+
+/**
+ * @english
+ * @brief Assign a template position in all subsets from an array of doubles.
+ *
+ * This is the bulk version of bufr_descriptor_set_dvalue: values[i] goes
+ * to the descriptor at position pos of subset i. The range of the
+ * descriptor is computed once for the column instead of once per value.
+ * @param dts pointer to a BUFR_Dataset
+ * @param pos position of the descriptor in each data subset
+ * @param values input array, bufr_count_datasubset() long
+ * @param missing optional mask, a non zero missing[i] stores a missing value
+ * @return number of values rejected (out of range), -1 if a subset
+ * has no descriptor at pos
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_set_dvalue, bufr_dataset_set_ivalue_column,
+ * bufr_dataset_set_svalue_column
+ * @author Vanh Souvanlasy
+ * @ingroup dataset descriptor
+ */
+int bufr_dataset_set_dvalue_column
+   ( BUFR_Dataset *dts, int pos, const double *values, const char *missing )
+   {
+   int             i, n, nbad, has_range=0;
+   double          dval, min=0.0, max=0.0;
+   BufrDescriptor *bd, *last=NULL;
+   char            errmsg[256];
+
+   if ((dts == NULL)||(values == NULL)) return -1;
+
+   nbad = 0;
+   n = bufr_count_datasubset( dts );
+   for (i = 0; i < n ; i++)
+      {
+      bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, i ), pos );
+      if (bd == NULL) return -1;
+
+      dval = (missing && missing[i]) ? bufr_missing_double() : values[i];
+      if (!bufr_column_prepare( bd, &last, &has_range, &min, &max ))
+         {
+         if (bufr_descriptor_set_dvalue( bd, dval ) < 0) ++nbad;
+         }
+      else if (bufr_is_missing_double( dval )||((dval >= min)&&(dval <= max)))
+         {
+         bufr_value_set_double( bd->value, dval );
+         }
+      else
+         {
+         bufr_value_set_double( bd->value, bufr_missing_double() );
+         sprintf( errmsg, _("Warning: The value %f of descriptor %d is out of range [%f,%f]\n"), 
+                  dval, bd->descriptor, min, max );
+         bufr_print_debug( errmsg );
+         ++nbad;
+         }
+      }
+   return nbad;
+   }
+
+/**
+ * @english
+ * @brief Assign a template position in all subsets from an array of integers.
+ *
+ * This is the bulk version of bufr_descriptor_set_ivalue, the range of
+ * the descriptor is computed once for the column.
+ * @param dts pointer to a BUFR_Dataset
+ * @param pos position of the descriptor in each data subset
+ * @param values input array, bufr_count_datasubset() long
+ * @param missing optional mask, a non zero missing[i] stores a missing value
+ * @return number of values rejected (out of range), -1 if a subset
+ * has no descriptor at pos
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_set_ivalue, bufr_dataset_set_dvalue_column
+ * @author Vanh Souvanlasy
+ * @ingroup dataset descriptor
+ */
+int bufr_dataset_set_ivalue_column
+   ( BUFR_Dataset *dts, int pos, const int32_t *values, const char *missing )
+   {
+   int             i, n, nbad, has_range=0;
+   int32_t         ival, min=0, max=0;
+   double          dmin=0.0, dmax=0.0;
+   BufrDescriptor *bd, *last=NULL;
+   char            errmsg[256];
+
+   if ((dts == NULL)||(values == NULL)) return -1;
+
+   nbad = 0;
+   n = bufr_count_datasubset( dts );
+   for (i = 0; i < n ; i++)
+      {
+      bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, i ), pos );
+      if (bd == NULL) return -1;
+
+      ival = (missing && missing[i]) ? -1 : values[i];
+      if (!bufr_column_prepare( bd, &last, &has_range, &dmin, &dmax ))
+         {
+         if (bufr_descriptor_set_ivalue( bd, ival ) < 0) ++nbad;
+         continue;
+         }
+      min = (int32_t) dmin;
+      max = (int32_t) dmax;
+/*
+ * for descriptor 20011, it is valid to use missing=max+1 as value
+ */
+      if (bd->descriptor == 20011) max += 1;
+
+      if (bufr_is_missing_int( ival )||((ival >= min)&&(ival <= max)))
+         {
+         bufr_value_set_int32( bd->value, ival );
+         }
+      else
+         {
+         bufr_value_set_int32( bd->value, -1 );
+         sprintf( errmsg, _("Warning: The value %d of descriptor %d is out of range [%d,%d]\n"), 
+                  ival, bd->descriptor, min, max );
+         bufr_print_debug( errmsg );
+         ++nbad;
+         }
+      }
+   return nbad;
+   }
+
+/**
+ * @english
+ * @brief Assign a template position in all subsets from an array of strings.
+ *
+ * This is the bulk version of bufr_descriptor_set_svalue, a NULL string
+ * stores a missing value.
+ * @param dts pointer to a BUFR_Dataset
+ * @param pos position of the descriptor in each data subset
+ * @param values input array, bufr_count_datasubset() long
+ * @param missing optional mask, a non zero missing[i] stores a missing value
+ * @return number of values rejected, -1 if a subset has no descriptor at pos
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_set_svalue, bufr_dataset_set_dvalue_column
+ * @author Vanh Souvanlasy
+ * @ingroup dataset descriptor
+ */
+int bufr_dataset_set_svalue_column
+   ( BUFR_Dataset *dts, int pos, const char * const *values, const char *missing )
+   {
+   int             i, n, nbad;
+   const char     *sval;
+   BufrDescriptor *bd;
+
+   if ((dts == NULL)||(values == NULL)) return -1;
+
+   nbad = 0;
+   n = bufr_count_datasubset( dts );
+   for (i = 0; i < n ; i++)
+      {
+      bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, i ), pos );
+      if (bd == NULL) return -1;
+
+      sval = (missing && missing[i]) ? NULL : values[i];
+      if (bd->value == NULL)
+         bd->value = bufr_mkval_for_descriptor( bd );
+      if (bufr_value_set_string( bd->value, sval, bd->encoding.nbits/8 ) < 0)
+         ++nbad;
+      }
+   return nbad;
+   }
+
 /**
  * @english
  * @return a pointer to a next unskipped BufrDescriptor
@@ -763,6 +1147,9 @@ static void bufr_free_datasubset( DataSubset *subset )
       }
    arr_free( &list );
    subset->data = NULL;
+   bufr_forget_signature( subset );
+   bufr_release_position_index( subset->index );
+   subset->index = NULL;
 
    if (subset->dpbm)
       {
@@ -903,20 +1290,26 @@ BUFR_Message *bufr_encode_message( BUFR_Dataset *dts , int x_compress )
 */
    if (!BUFR_IS_COMPRESSED(msg))  /* sans compress */
       {
-      for (i = 0; i < nb_subsets ; i++)
+/*
+ * subsets are encoded in parallel when threads are enabled
+ */
+      if (bufr_put_subsets_threaded( msg, dts, nb_subsets ) == 0)
          {
-         subset = bufr_get_datasubset( dts, i );
-         count = bufr_datasubset_count_descriptor( subset );
-         if (debug)
-            {
-            sprintf( errmsg, _("Storing Subset # %d\n"), i+1 );
-            bufr_print_debug( errmsg );
-            }
-         for ( j = 0 ; j < count ; j++ )
+         for (i = 0; i < nb_subsets ; i++)
             {
-            bcv = bufr_datasubset_get_descriptor( subset, j );
-            if (bcv->flags & FLAG_SKIPPED) continue;
-            bufr_put_desc_value( msg, bcv );
+            subset = bufr_get_datasubset( dts, i );
+            count = bufr_datasubset_count_descriptor( subset );
+            if (debug)
+               {
+               sprintf( errmsg, _("Storing Subset # %d\n"), i+1 );
+               bufr_print_debug( errmsg );
+               }
+            for ( j = 0 ; j < count ; j++ )
+               {
+               bcv = bufr_datasubset_get_descriptor( subset, j );
+               if (bcv->flags & FLAG_SKIPPED) continue;
+               bufr_put_desc_value( msg, bcv );
+               }
             }
          }
       }
@@ -933,47 +1326,30 @@ BUFR_Message *bufr_encode_message( BUFR_Dataset *dts , int x_compress )
          sprintf( errmsg, _("Storing %d compressed Subsets of %d items\n"), nb_subsets, count );
          bufr_print_debug( errmsg );
          }
-      for ( j = 0 ; j < count ; j++ )
+/*
+ * each descriptor block depends only on its column, blocks are encoded
+ * in parallel when threads are enabled
+ */
+      if (bufr_put_compressed_threaded( msg, dts, count ) == 0)
          {
-         bcv = bufr_datasubset_get_descriptor( subset, j );
-         if (debug)
-            {
-            bufr_print_descriptor( errmsg, bcv );
-            bufr_print_debug( errmsg );
-            bufr_print_debug( "\n" );
-            }
-
-         if (bcv->flags & FLAG_SKIPPED) 
+         for ( j = 0 ; j < count ; j++ )
             {
+            bcv = bufr_datasubset_get_descriptor( subset, j );
             if (debug)
+               {
+               bufr_print_descriptor( errmsg, bcv );
+               bufr_print_debug( errmsg );
                bufr_print_debug( "\n" );
-            continue;
-            }
-
-         bufr_put_af_compressed( msg, dts, bcv, j );
-
-         switch (bcv->encoding.type)
-            {
-            case TYPE_CCITT_IA5 :
-               bufr_put_ccitt_compressed( msg, dts, j );
-               break;
-            case TYPE_IEEE_FP :
-               bufr_put_ieeefp_compressed( msg, dts, j );
-
-               break;
-            case TYPE_NUMERIC :
-            case TYPE_CODETABLE :
-            case TYPE_FLAGTABLE :
-            case TYPE_CHNG_REF_VAL_OP :
-               if (bcv->encoding.nbits <= 0) continue;
-
-               bufr_put_numeric_compressed( msg, dts, bcv, j );
+               }
 
-               break;
-            default :
+            if (bcv->flags & FLAG_SKIPPED) 
+               {
                if (debug)
                   bufr_print_debug( "\n" );
-               break;
+               continue;
+               }
+
+            bufr_put_compressed_descriptor( msg, dts, bcv, j );
             }
          }
       }
@@ -1000,54 +1376,341 @@ BUFR_Message *bufr_encode_message( BUFR_Dataset *dts , int x_compress )
 
 /**
  * @english
- * store a numeric of every subset in a dataset with compression
+ * store a compressed descriptor block, its associated field then the
+ * values of every subset
  * @param  msg : pointer to BUFR_Message where data are stored
  * @param  dts : pointer to BUFR_Dataset containing data to be stored
- * @param  bcv : BurCode of the numeric to be stored
+ * @param  bcv : descriptor of the first subset at that position
  * @param  j   : position of bcv within each subset.
  * @endenglish
  * @francais
  * @todo translate to French
  * @endfrancais
  * @author Vanh Souvanlasy
- * @ingroup message encode dataset internal
+ * @ingroup message encode internal
  */
-static void bufr_put_numeric_compressed( BUFR_Message *msg, BUFR_Dataset *dts, BufrDescriptor *bcv, int j )
+static void bufr_put_compressed_descriptor( BUFR_Message *msg, BUFR_Dataset *dts, BufrDescriptor *bcv, int j )
    {
-   uint64_t    ival, ival2;
-   uint64_t    imin, imax;
-   int         i, nbinc;
-   int         nb_subsets;
-   DataSubset *subset;
-   char        errmsg[256];
-   int         debug = bufr_is_debug();
-   uint64_t    missing, msng;
-   int         nb_msng;
+   bufr_put_af_compressed( msg, dts, bcv, j );
 
-   missing = bufr_missing_ivalue( bcv->encoding.nbits );
+   switch (bcv->encoding.type)
+      {
+      case TYPE_CCITT_IA5 :
+         bufr_put_ccitt_compressed( msg, dts, j );
+         break;
+      case TYPE_IEEE_FP :
+         bufr_put_ieeefp_compressed( msg, dts, j );
+         break;
+      case TYPE_NUMERIC :
+      case TYPE_CODETABLE :
+      case TYPE_FLAGTABLE :
+      case TYPE_CHNG_REF_VAL_OP :
+         if (bcv->encoding.nbits <= 0) break;
+         bufr_put_numeric_compressed( msg, dts, bcv, j );
+         break;
+      default :
+         if (bufr_is_debug())
+            bufr_print_debug( "\n" );
+         break;
+      }
+   }
 
-   nb_subsets = bufr_count_datasubset( dts );
-/*
- * find 1st valid min and max , not missing
+/**
+ * @english
+ * thread body of bufr_encode_slices
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
  */
-   nb_msng = 0;
-   imin = imax = bufr_value2bits( bcv );
-   for (i = 0; i < nb_subsets ; i++)
+static void *bufr_encode_slices_worker( void *data )
+   {
+   EncodeSlices  *work = (EncodeSlices *)data;
+   int            i;
+
+   for (;;)
       {
-      subset = bufr_get_datasubset( dts, i );
-      bcv = bufr_datasubset_get_descriptor( subset, j );
-      ival = bufr_value2bits( bcv );
-      if (ival == missing) 
-         {
-         ++nb_msng;
-         continue;
-         }
-      if (imin == missing)
-         {
-         imin = imax = ival;
-         continue;
-         }
-      if (ival < imin) imin = ival;
+      pthread_mutex_lock( &work->lock );
+      i = work->next++;
+      pthread_mutex_unlock( &work->lock );
+      if (i >= work->nb_slices) break;
+      work->encode( &work->slices[i] );
+      }
+   return NULL;
+   }
+
+/**
+ * @english
+ * encode slices with up to nb_threads threads, the calling one included,
+ * then concatenate their sections 4 in order, bit for bit, giving the
+ * same section 4 as a serial encoding
+ * @param  msg : message being encoded, section 4 already started
+ * @param  work : slices to encode, with from and to already set
+ * @param  nb_threads : number of threads
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup message encode internal
+ */
+static void bufr_encode_slices( BUFR_Message *msg, EncodeSlices *work, int nb_threads )
+   {
+   pthread_t      *tids;
+   EncodeSlice    *slice;
+   int             i, started;
+   uint64_t        nbits;
+
+   for (i = 0; i < work->nb_slices ; i++)
+      {
+      slice = &work->slices[i];
+      slice->part = bufr_create_message( msg->edition );
+      bufr_alloc_sect4( slice->part, msg->s4.max_data_len / work->nb_slices + 1 );
+      bufr_begin_message( slice->part );
+      }
+   work->next = 0;
+   pthread_mutex_init( &work->lock, NULL );
+
+   tids = (pthread_t *)malloc( nb_threads * sizeof(pthread_t) );
+   started = 1;
+   for (i = 1; i < nb_threads ; i++)
+      {
+      if (pthread_create( &tids[i], NULL, bufr_encode_slices_worker, work ) != 0) break;
+      started = i + 1;
+      }
+   bufr_encode_slices_worker( work );
+   for (i = 1; i < started ; i++)
+      pthread_join( tids[i], NULL );
+   free( tids );
+   pthread_mutex_destroy( &work->lock );
+
+   for (i = 0; i < work->nb_slices ; i++)
+      {
+      slice = &work->slices[i];
+      nbits = (uint64_t)slice->part->s4.filled * 8 + slice->part->s4.bitno;
+      bufr_put_bitstream( msg, slice->part->s4.data, nbits );
+      bufr_free_message( slice->part );
+      slice->part = NULL;
+      }
+   }
+
+/**
+ * @english
+ * encode uncompressed subsets in parallel, each thread writes a contiguous
+ * range of subsets
+ * @param  msg : message being encoded, section 4 already started
+ * @param  dts : dataset holding the subsets
+ * @param  nb_subsets : number of subsets
+ * @return 1 if the subsets were encoded, 0 if they must be done serially
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup message encode internal
+ */
+static int bufr_put_subsets_threaded( BUFR_Message *msg, BUFR_Dataset *dts, int nb_subsets )
+   {
+   EncodeSlices    work;
+   int             i, nb_threads, per_thread;
+
+/*
+ * the debug printout must stay in subset order
+ */
+   nb_threads = bufr_genmsgs_worker ? 1 : bufr_nb_threads;
+   if ((nb_threads <= 1)||bufr_is_debug()) return 0;
+   if (nb_threads > nb_subsets / 2) nb_threads = nb_subsets / 2;
+   if (nb_threads <= 1) return 0;
+
+   work.nb_slices = nb_threads;
+   work.slices = (EncodeSlice *)malloc( nb_threads * sizeof(EncodeSlice) );
+   work.encode = bufr_put_subsets_slice;
+   per_thread = (nb_subsets + nb_threads - 1) / nb_threads;
+   for (i = 0; i < nb_threads ; i++)
+      {
+      work.slices[i].dts  = dts;
+      work.slices[i].from = i * per_thread;
+      work.slices[i].to   = (i+1) * per_thread;
+      if (work.slices[i].to > nb_subsets) work.slices[i].to = nb_subsets;
+      }
+   bufr_encode_slices( msg, &work, nb_threads );
+   free( work.slices );
+   return 1;
+   }
+
+/**
+ * @english
+ * encode the subsets of a slice, uncompressed
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_subsets_slice( EncodeSlice *slice )
+   {
+   int             i;
+
+   for (i = slice->from; i < slice->to ; i++)
+      bufr_encode_datasubset( slice->part, bufr_get_datasubset( slice->dts, i ) );
+   }
+
+/**
+ * @english
+ * @brief append a datasubset, uncompressed, to section 4 of a message
+ *
+ * The message must have been started with bufr_begin_message; section 4
+ * grows as needed. This lets subsets be encoded one at a time as they
+ * arrive instead of being kept in a dataset.
+ * @param  msg : message being encoded
+ * @param  subset : the datasubset, it must be expanded
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup message encode
+ */
+void bufr_encode_datasubset( BUFR_Message *msg, DataSubset *subset )
+   {
+   BufrDescriptor *bcv;
+   int             j, count;
+
+   count = bufr_datasubset_count_descriptor( subset );
+   for ( j = 0 ; j < count ; j++ )
+      {
+      bcv = bufr_datasubset_get_descriptor( subset, j );
+      if (bcv->flags & FLAG_SKIPPED) continue;
+      bufr_put_desc_value( msg, bcv );
+      }
+   }
+
+/**
+ * @english
+ * encode the descriptor blocks of a compressed dataset in parallel, the
+ * positions are cut in more slices than threads so that threads
+ * finishing early take the remaining ones
+ * @param  msg : message being encoded, section 4 already started
+ * @param  dts : dataset holding the subsets
+ * @param  count : number of descriptors in each subset
+ * @return 1 if the blocks were encoded, 0 if they must be done serially
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup message encode internal
+ */
+static int bufr_put_compressed_threaded( BUFR_Message *msg, BUFR_Dataset *dts, int count )
+   {
+   EncodeSlices    work;
+   int             i, nb_threads, nb_slices, per_slice;
+
+   nb_threads = bufr_genmsgs_worker ? 1 : bufr_nb_threads;
+   if ((nb_threads <= 1)||bufr_is_debug()) return 0;
+   if (nb_threads > count / 2) nb_threads = count / 2;
+   if (nb_threads <= 1) return 0;
+
+   nb_slices = nb_threads * 4;
+   if (nb_slices > count) nb_slices = count;
+   per_slice = (count + nb_slices - 1) / nb_slices;
+   nb_slices = (count + per_slice - 1) / per_slice;
+
+   work.nb_slices = nb_slices;
+   work.slices = (EncodeSlice *)malloc( nb_slices * sizeof(EncodeSlice) );
+   work.encode = bufr_put_positions_slice;
+   for (i = 0; i < nb_slices ; i++)
+      {
+      work.slices[i].dts  = dts;
+      work.slices[i].from = i * per_slice;
+      work.slices[i].to   = (i+1) * per_slice;
+      if (work.slices[i].to > count) work.slices[i].to = count;
+      }
+   bufr_encode_slices( msg, &work, nb_threads );
+   free( work.slices );
+   return 1;
+   }
+
+/**
+ * @english
+ * encode the compressed descriptor blocks of a slice of positions
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_put_positions_slice( EncodeSlice *slice )
+   {
+   DataSubset     *subset;
+   BufrDescriptor *bcv;
+   int             j;
+
+   subset = bufr_get_datasubset( slice->dts, 0 );
+   for ( j = slice->from ; j < slice->to ; j++ )
+      {
+      bcv = bufr_datasubset_get_descriptor( subset, j );
+      if (bcv->flags & FLAG_SKIPPED) continue;
+      bufr_put_compressed_descriptor( slice->part, slice->dts, bcv, j );
+      }
+   }
+
+/**
+ * @english
+ * store a numeric of every subset in a dataset with compression
+ * @param  msg : pointer to BUFR_Message where data are stored
+ * @param  dts : pointer to BUFR_Dataset containing data to be stored
+ * @param  bcv : BurCode of the numeric to be stored
+ * @param  j   : position of bcv within each subset.
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup message encode dataset internal
+ */
+static void bufr_put_numeric_compressed( BUFR_Message *msg, BUFR_Dataset *dts, BufrDescriptor *bcv, int j )
+   {
+   uint64_t    ival, ival2;
+   uint64_t    imin, imax;
+   int         i, nbinc;
+   int         nb_subsets;
+   DataSubset *subset;
+   char        errmsg[256];
+   int         debug = bufr_is_debug();
+   uint64_t    missing, msng;
+   int         nb_msng;
+   uint64_t   *bits;
+
+   missing = bufr_missing_ivalue( bcv->encoding.nbits );
+
+   nb_subsets = bufr_count_datasubset( dts );
+   bits = bufr_values2bits( dts, bcv, j, nb_subsets );
+/*
+ * find 1st valid min and max , not missing
+ */
+   nb_msng = 0;
+   imin = imax = bits[0];
+   for (i = 0; i < nb_subsets ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      bcv = bufr_datasubset_get_descriptor( subset, j );
+      ival = bits[i];
+      if (ival == missing) 
+         {
+         ++nb_msng;
+         continue;
+         }
+      if (imin == missing)
+         {
+         imin = imax = ival;
+         continue;
+         }
+      if (ival < imin) imin = ival;
       if (ival > imax) imax = ival;
       }
 /*
@@ -1089,7 +1752,7 @@ static void bufr_put_numeric_compressed( BUFR_Message *msg, BUFR_Dataset *dts, B
          {
          subset = bufr_get_datasubset( dts, i );
          bcv = bufr_datasubset_get_descriptor( subset, j );
-         ival2 = bufr_value2bits( bcv );
+         ival2 = bits[i];
          if (ival2 == missing)
             ival = msng;
          else
@@ -1105,6 +1768,7 @@ static void bufr_put_numeric_compressed( BUFR_Message *msg, BUFR_Dataset *dts, B
             }
          }
       }
+   free( bits );
    }
 
 /**
@@ -1488,6 +2152,97 @@ DataSubset *bufr_get_datasubset( BUFR_Dataset *dts, int pos )
       return (DataSubset *)NULL;
    }
 
+/**
+ * @english
+ * encode the numerical values of a descriptor position across all subsets
+ * @param  dts : dataset holding the subsets
+ * @param  bcv : descriptor of the first subset at that position
+ * @param  j   : position of the descriptor in the subsets
+ * @param  nb_subsets : number of subsets
+ * @return array of encoded values, to be freed by the caller
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t *bufr_values2bits( BUFR_Dataset *dts, BufrDescriptor *bcv, int j, int nb_subsets )
+   {
+   uint64_t       *bits;
+   double         *dvals=NULL;
+   DataSubset     *subset;
+   BufrDescriptor *bd;
+   int             i;
+
+   bits = (uint64_t *)malloc( nb_subsets * sizeof(uint64_t) );
+/*
+ * real values of all subsets are converted in one pass
+ */
+   if ((bcv->encoding.type == TYPE_NUMERIC)&&(bcv->value)&&
+       ((bcv->value->type == VALTYPE_FLT64)||(bcv->value->type == VALTYPE_FLT32)))
+      {
+      dvals = (double *)malloc( nb_subsets * sizeof(double) );
+      for (i = 0; i < nb_subsets ; i++)
+         {
+         subset = bufr_get_datasubset( dts, i );
+         bd = bufr_datasubset_get_descriptor( subset, j );
+         if ((bd->value == NULL)||bufr_scaled2bits( bd, &bits[i] )||
+             ((bd->value->type != VALTYPE_FLT64)&&(bd->value->type != VALTYPE_FLT32)))
+            {
+            free( dvals );
+            dvals = NULL;
+            break;
+            }
+         dvals[i] = bufr_value_get_double( bd->value );
+         }
+      }
+
+   if (dvals)
+      {
+      bufr_cvt_dval_to_i64_array( bcv->descriptor, &(bcv->encoding), dvals, bits, nb_subsets );
+      free( dvals );
+      }
+   else
+      {
+      for (i = 0; i < nb_subsets ; i++)
+         {
+         subset = bufr_get_datasubset( dts, i );
+         bd = bufr_datasubset_get_descriptor( subset, j );
+         bits[i] = bufr_value2bits( bd );
+         }
+      }
+   return bits;
+   }
+
+/**
+ * @english
+ * encode a value that holds its scaled integer without converting it
+ * @param  bd   : pointer to BufrDescriptor containing value to encode
+ * @param  bits : output
+ * @return 1 if encoded, 0 if the value must be converted
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_scaled2bits( BufrDescriptor *bd, uint64_t *bits )
+   {
+   int64_t   scaled, ival;
+   int       scale;
+
+   if (!bufr_value_get_scaled( bd->value, &scaled, &scale )) return 0;
+   if (scale != bd->encoding.scale) return 0;
+
+   ival = scaled - bd->encoding.reference;
+   if ((ival < 0)||((uint64_t)ival >= bufr_missing_ivalue( bd->encoding.nbits ))) return 0;
+
+   *bits = ival;
+   return 1;
+   }
+
 /**
  * @english
  * encode a numerical value into bits for storage into output bitsream
@@ -1503,11 +2258,16 @@ static uint64_t bufr_value2bits( BufrDescriptor *bd )
    {
    double          dval;
    int64_t         ival;
+   uint64_t        bits;
 
    switch (bd->encoding.type)
       {
       case TYPE_NUMERIC :
-         if (bd->encoding.nbits <= 32)
+         if (bufr_scaled2bits( bd, &bits ))
+            {
+            ival = bits;
+            }
+         else if (bd->encoding.nbits <= 32)
             {
             if (bd->value->type == VALTYPE_INT32)
                {
@@ -1705,7 +2465,16 @@ static void bufr_put_desc_value ( BUFR_Message *bufr, BufrDescriptor *bd )
       case TYPE_NUMERIC :
          if (isdebug)
             bufr_print_debug( _("NUM: ") );
-         if (bd->encoding.nbits <= 32)
+         if (bufr_scaled2bits( bd, &ui64val ))
+            {
+            if (isdebug)
+               {
+               sprintf( errmsg, _("%f --> %llu"), bufr_value_get_double( bd->value ), 
+                        (unsigned long long)ui64val );
+               bufr_print_debug( errmsg );
+               }
+            }
+         else if (bd->encoding.nbits <= 32)
             {
             if (bd->value->type == VALTYPE_INT32)
                {
@@ -2386,7 +3155,7 @@ BUFR_Dataset  *bufr_decode_message_subsets( BUFR_Message *msg, BUFR_Tables *tabl
  */
       for (j = 0; j < nbsubset1 ; j++ )
          {
-         bsq2 = bufr_copy_sequence( bsq );
+         bsq2 = bufr_share_sequence( bsq );
          node = lst_firstnode( bsq2->list );
          ddo = bufr_create_BufrDDOp( msg->enforce );
          while ( node )
@@ -2548,7 +3317,7 @@ BUFR_Dataset  *bufr_decode_message_subsets( BUFR_Message *msg, BUFR_Tables *tabl
 
       for ( i = 0; i < nbsubset1 ; i++ )
          {
-         bseq[i] = bufr_copy_sequence( bsq );
+         bseq[i] = bufr_share_sequence( bsq );
          subset = bufr_allocate_datasubset();
          arr_add( dts->datasubsets, (char *)&subset );
          ddos[i] = bufr_create_BufrDDOp( msg->enforce );
@@ -3025,24 +3794,55 @@ static int bufr_get_numeric_compressed
       }
    else
       {
+      int64_t  *ivals;
+      double   *dvals=NULL;
+      int       nbread;
+
       if (subset_from > 1)
          bufr_skip_bits( msg, nbinc*(subset_from-1), &errcode );
       msng = bufr_missing_ivalue( nbinc );
-      for (i = 0; i < count ; i++)
+/*
+ * read all increments first so that scaled values are converted in one pass
+ */
+      ivals = (int64_t *)malloc( count * sizeof(int64_t) );
+      for (nbread = 0; nbread < count ; nbread++)
          {
-         node2 = nodes[i];
-         cb2 = (BufrDescriptor *)node2->data;
          ival = bufr_getbits( msg, nbinc, &errcode ); 
-         if ( errcode < 0 ) return errcode;
+         if ( errcode < 0 ) break;
          if (ival == msng)
-            ival2 = missing;
+            ivals[nbread] = missing;
          else
-            ival2 = ival + imin;
+            ivals[nbread] = ival + imin;
+         }
+
+      if (nbread > 0)
+         {
+         cb2 = (BufrDescriptor *)nodes[0]->data;
+         if (cb2->value == NULL)
+            cb2->value = bufr_mkval_for_descriptor( cb2 );
+         if ((cb2->encoding.type == TYPE_NUMERIC)&&(cb2->value)&&
+             (cb2->value->type == VALTYPE_FLT64)&&!(cb2->flags & FLAG_SKIPPED))
+            {
+            dvals = (double *)malloc( nbread * sizeof(double) );
+            bufr_cvt_i64_to_dval_array( &(cb2->encoding), ivals, dvals, nbread );
+            }
+         }
+
+      for (i = 0; i < nbread ; i++)
+         {
+         node2 = nodes[i];
+         cb2 = (BufrDescriptor *)node2->data;
+         ival2 = ivals[i];
          if (cb2->value == NULL)
             cb2->value = bufr_mkval_for_descriptor( cb2 );
-         bufr_descriptor_set_bitsvalue( cb2, ival2 );
+         if (dvals && (cb2->value->type == VALTYPE_FLT64))
+            bufr_value_set_scaled( cb2->value, ival2 + cb2->encoding.reference, 
+                                   cb2->encoding.scale, dvals[i] );
+         else
+            bufr_descriptor_set_bitsvalue( cb2, ival2 );
          if (debug)
             {
+            ival = (ival2 == missing) ? msng : ival2 - imin;
             sprintf( errmsg, _n("   R(%d)=%llx(%llx) (%d bit)", " R(%d)=%llx(%llx) (%d bits)", nbinc), i+1, (unsigned long long)ival2, (unsigned long long)ival, nbinc );
             bufr_print_debug( errmsg );
             if (bufr_print_dscptr_value( errmsg, cb2 ))
@@ -3050,6 +3850,10 @@ static int bufr_get_numeric_compressed
             bufr_print_debug( "\n" );
             }
          }
+      free( ivals );
+      if (dvals) free( dvals );
+      if ( errcode < 0 ) return errcode;
+
       if (subset_from > 0)
          bufr_skip_bits( msg, nbinc*(nbsubset-subset_to), &errcode );
       }
@@ -3156,7 +3960,11 @@ static int bufr_get_af_compressed
  * @brief check if a dataset is compressible
  *
  * It is compressible when there are more than 1 datasubsets and if there are
- * delayed replication, all count must be identical codes list
+ * delayed replication, all count must be identical codes list.
+ * Each datasubset is checked by its descriptor count and structure signature
+ * against the first one, signatures being kept with the datasubsets; the
+ * descriptors are then compared one by one, as equal signatures do not
+ * prove an equal structure.
  
  * @param dts pointer to a BUFR_Dataset
  * @return int
@@ -3169,14 +3977,9 @@ static int bufr_get_af_compressed
  */
 int  bufr_dataset_compressible( BUFR_Dataset *dts )
    {
-   int          i, j, count;
+   int          i;
    DataSubset  *subsetref, *subset;
-   BufrDescriptor    *coderef, *code;
-   int          next_31=0;
-   int          nrep1, nrep2;
    int          nb_subsets;
-   int          d1, d2;
-   int          f, x, y;
    char         errmsg[256];
 
 /*
@@ -3188,223 +3991,1049 @@ int  bufr_dataset_compressible( BUFR_Dataset *dts )
 
 /*
  * data with delayed replication is compressible only when
- * all replication number are identical
+ * all replication number are identical, those are part of the signature
 
 */
    subsetref = bufr_get_datasubset( dts, 0 );
-   count = bufr_datasubset_count_descriptor( subsetref );
    for (i = 1; i < nb_subsets ; i++)
       {
       subset = bufr_get_datasubset( dts, i );
-/*
- * first indication that delayed replication count are not the same
- * make sure all datasubsets have the same code values count, 
-
-*/
-      if (count != bufr_datasubset_count_descriptor( subset ))
-         return 0;
-/*
- * the above test should be enough, will skip the following test is slowing down very large dataset
-
-*/
-#if 0
-      for (j = 0; j < count ; j++ )
+      if (!bufr_datasubset_same_structure( subsetref, subset ))
          {
-         coderef = bufr_datasubset_get_descriptor( subsetref, j );
-         if (next_31)
-            {
-            next_31 = 0;
-            d2 = coderef->descriptor;
-            nrep1 = bufr_descriptor_get_ivalue( coderef );
-            code = bufr_datasubset_get_descriptor( subset, j );
-            nrep2 = bufr_descriptor_get_ivalue( code );
-            if (nrep1 != nrep2) 
-               {
-               if (bufr_is_debug())
-                  {
-                  bufr_print_debug( _("### Dataset not compressible, delayed replication count differs\n"));
-                  sprintf( errmsg, "### %d  %d (0)=%d  (%d)=%d\n", d1, d2, nrep1, j, nrep2 );
-                  bufr_print_debug( errmsg );
-                  }
-               return 0;
-               }
-            }
-         else
+         if (bufr_is_debug())
             {
-            bufr_descriptor_to_fxy( coderef->descriptor, &f, &x, &y );
-            if ((f == 1)&&(y == 0))
-               {
-               d1 = coderef->descriptor;
-               next_31 = 1;
-               }
+            sprintf( errmsg, _("### Dataset not compressible, structure of subset %d differs from subset 0\n"), i );
+            bufr_print_debug( errmsg );
             }
+         return 0;
          }
-#endif
       }
-   return 1;
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief mix an integer into a structure signature (FNV-1a on 8 octets)
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset internal
+ */
+static uint64_t bufr_signature_mix( uint64_t hash, int64_t value )
+   {
+   int  i;
+
+   for (i = 0; i < 8 ; i++)
+      {
+      hash ^= (uint64_t)((value >> (i*8)) & 0xff);
+      hash *= 1099511628211ULL;
+      }
+   return hash;
+   }
+
+/**
+ * @english
+ * @brief tell if a descriptor holds a delayed replication or repetition count
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset internal
+ */
+static int bufr_is_delayed_count( BufrDescriptor *bd )
+   {
+   if (!(bd->flags & FLAG_CLASS31)) return 0;
+   switch (bd->descriptor)
+      {
+      case 31000 :
+      case 31001 :
+      case 31002 :
+      case 31011 :
+      case 31012 :
+         return 1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * @brief structure signature of a datasubset
+ *
+ * This is a hash of the expanded descriptor sequence, the encoding of each
+ * descriptor and the delayed replication counts. Two datasubsets with a
+ * different signature cannot be encoded together in a compressed message.
+ * The hash of the descriptors and encodings is kept with the datasubset
+ * until it is expanded or refilled, or until an encoding is changed with
+ * bufr_descriptor_set_encoding, which advances the structure stamp; an
+ * encoding changed in place otherwise is only seen once the datasubset
+ * is expanded again. The delayed counts, located once, are read on each
+ * call.
+ * @param subset pointer to a DataSubset
+ * @return the signature, never 0 unless subset is NULL
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+uint64_t bufr_datasubset_signature( DataSubset *subset )
+   {
+   int              i, stamp;
+   uint64_t         hash;
+   BufrDescriptor **pbcd;
+
+   if (subset == NULL) return 0;
+   stamp = bufr_structure_stamp();
+   if ((subset->signature == 0)||(subset->sig_stamp != stamp))
+      bufr_signature_base( subset, stamp );
+/*
+ * delayed counts are read each time, they may be set at any time
+ */
+   hash = subset->signature;
+   if (subset->nb_count_pos > 0)
+      {
+      pbcd = (BufrDescriptor **)arr_get( subset->data, 0 );
+      for (i = 0; i < subset->nb_count_pos ; i++)
+         hash = bufr_signature_mix( hash, bufr_descriptor_get_ivalue( pbcd[subset->count_pos[i]] ) );
+      }
+   if (hash == 0) hash = 1;
+   return hash;
+   }
+
+/**
+ * @english
+ * hash the descriptors and encodings of a datasubset, and locate its
+ * delayed counts, to be kept with it
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset internal
+ */
+static void bufr_signature_base( DataSubset *subset, int stamp )
+   {
+   int              i, count;
+   uint64_t         hash;
+   BufrDescriptor **pbcd;
+   BufrDescriptor  *bd;
+
+   bufr_forget_signature( subset );
+   hash = 14695981039346656037ULL;
+   count = bufr_datasubset_count_descriptor( subset );
+   pbcd = (count > 0) ? (BufrDescriptor **)arr_get( subset->data, 0 ) : NULL;
+   for (i = 0; i < count ; i++)
+      {
+      bd = pbcd[i];
+      hash = bufr_signature_mix( hash, bd->descriptor );
+      hash = bufr_signature_mix( hash, bd->flags & FLAG_SKIPPED );
+      hash = bufr_signature_mix( hash, bd->encoding.type );
+      hash = bufr_signature_mix( hash, bd->encoding.nbits );
+      hash = bufr_signature_mix( hash, bd->encoding.scale );
+      hash = bufr_signature_mix( hash, bd->encoding.reference );
+      hash = bufr_signature_mix( hash, bd->encoding.af_nbits );
+      if (bufr_is_delayed_count( bd ))
+         {
+         if ((subset->nb_count_pos % 16) == 0)
+            subset->count_pos = (int *)realloc( subset->count_pos, (subset->nb_count_pos + 16) * sizeof(int) );
+         subset->count_pos[subset->nb_count_pos++] = i;
+         }
+      }
+   if (hash == 0) hash = 1;
+   subset->signature = hash;
+   subset->sig_stamp = stamp;
+   }
+
+/**
+ * @english
+ * drop the signature kept with a datasubset
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset internal
+ */
+static void bufr_forget_signature( DataSubset *subset )
+   {
+   if (subset->count_pos) free( subset->count_pos );
+   subset->count_pos = NULL;
+   subset->nb_count_pos = 0;
+   subset->signature = 0;
+   }
+
+/**
+ * @english
+ * @brief check if two datasubsets share the same structure
+ *
+ * The signatures kept with the datasubsets are compared first,
+ * descriptors are compared one by one only when they are equal.
+ * @param ss1 pointer to a DataSubset
+ * @param ss2 pointer to a DataSubset
+ * @return 1 if same structure, 0 otherwise
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_datasubset_same_structure( DataSubset *ss1, DataSubset *ss2 )
+   {
+   int              i, count;
+   BufrDescriptor **pbcd1, **pbcd2;
+   BufrDescriptor  *bd1, *bd2;
+
+   if ((ss1 == NULL)||(ss2 == NULL)) return 0;
+   if (ss1 == ss2) return 1;
+
+   count = bufr_datasubset_count_descriptor( ss1 );
+   if (count != bufr_datasubset_count_descriptor( ss2 )) return 0;
+   if (bufr_datasubset_signature( ss1 ) != bufr_datasubset_signature( ss2 )) return 0;
+
+   pbcd1 = (BufrDescriptor **)arr_get( ss1->data, 0 );
+   pbcd2 = (BufrDescriptor **)arr_get( ss2->data, 0 );
+   for (i = 0; i < count ; i++)
+      {
+      bd1 = pbcd1[i];
+      bd2 = pbcd2[i];
+      if (bd1->descriptor != bd2->descriptor) return 0;
+      if ((bd1->flags & FLAG_SKIPPED) != (bd2->flags & FLAG_SKIPPED)) return 0;
+      if ((bd1->encoding.type != bd2->encoding.type)||
+          (bd1->encoding.nbits != bd2->encoding.nbits)||
+          (bd1->encoding.scale != bd2->encoding.scale)||
+          (bd1->encoding.reference != bd2->encoding.reference)||
+          (bd1->encoding.af_nbits != bd2->encoding.af_nbits))
+         return 0;
+      if (bufr_is_delayed_count( bd1 ) != bufr_is_delayed_count( bd2 )) return 0;
+      if (bufr_is_delayed_count( bd1 )&&
+          (bufr_descriptor_get_ivalue( bd1 ) != bufr_descriptor_get_ivalue( bd2 )))
+         return 0;
+      }
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief index the positions of the descriptors of a datasubset
+ *
+ * Once built, bufr_subset_find_descriptor and bufr_subset_find_values
+ * look up the positions of a descriptor instead of scanning the
+ * datasubset. The index is kept until the datasubset is expanded or
+ * refilled, it must not be built while other threads search the
+ * datasubset.
+ * @param subset pointer to a DataSubset
+ * @return number of distinct descriptors, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_dataset_build_index, bufr_datasubset_find_positions
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_datasubset_build_index( DataSubset *subset )
+   {
+   if (subset == NULL) return -1;
+
+   if (subset->index && (subset->index->count == bufr_datasubset_count_descriptor( subset )))
+      return subset->index->nb_descriptors;
+
+   bufr_release_position_index( subset->index );
+   subset->index = bufr_create_position_index( subset );
+   return subset->index ? subset->index->nb_descriptors : -1;
+   }
+
+/**
+ * @english
+ * @brief index the positions of the descriptors of every datasubset
+ *
+ * Datasubsets of the same structure share one index, so a dataset
+ * without delayed replication builds a single one.
+ * @param dts pointer to a BUFR_Dataset
+ * @return number of indexes built, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_datasubset_build_index
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_dataset_build_index( BUFR_Dataset *dts )
+   {
+   int                 i, nb_subsets, nb_groups;
+   int                *groups;
+   BufrPositionIndex **indexes;
+   DataSubset         *subset;
+
+   if (dts == NULL) return -1;
+
+   nb_subsets = bufr_count_datasubset( dts );
+   if (nb_subsets <= 0) return 0;
+
+   groups = (int *)malloc( nb_subsets * sizeof(int) );
+   nb_groups = bufr_dataset_group_subsets( dts, groups );
+   if (nb_groups < 0)
+      {
+      free( groups );
+      return -1;
+      }
+   indexes = (BufrPositionIndex **)calloc( nb_groups, sizeof(BufrPositionIndex *) );
+
+   for (i = 0; i < nb_subsets ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      if (indexes[groups[i]] == NULL)
+         {
+         bufr_datasubset_build_index( subset );
+         indexes[groups[i]] = subset->index;
+         }
+      else if (subset->index != indexes[groups[i]])
+         {
+         bufr_release_position_index( subset->index );
+         subset->index = indexes[groups[i]];
+         BUFR_ATOMIC_INCR( &(subset->index->refcount) );
+         }
+      }
+
+   free( indexes );
+   free( groups );
+   return nb_groups;
+   }
+
+/**
+ * @english
+ * @brief positions of a descriptor in an indexed datasubset
+ * @param subset pointer to a DataSubset
+ * @param descriptor the descriptor
+ * @param startpos smallest position wanted
+ * @param positions receives the sorted positions from startpos
+ * @return number of positions, -1 if the datasubset is not indexed
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_datasubset_build_index
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_datasubset_find_positions( DataSubset *subset, int descriptor, int startpos, const int **positions )
+   {
+   BufrPositionIndex  *index;
+   int                 lo, hi, mid, first, last;
+
+   if ((subset == NULL)||(subset->index == NULL)) return -1;
+   index = subset->index;
+   if (index->count != bufr_datasubset_count_descriptor( subset )) return -1;
+
+   lo = 0;
+   hi = index->nb_descriptors;
+   while (lo < hi)
+      {
+      mid = (lo + hi) / 2;
+      if (index->descriptors[mid] < descriptor)
+         lo = mid + 1;
+      else
+         hi = mid;
+      }
+   if ((lo >= index->nb_descriptors)||(index->descriptors[lo] != descriptor)) return 0;
+/*
+ * skip the positions before startpos
+ */
+   first = index->first[lo];
+   last = index->first[lo+1];
+   lo = first;
+   hi = last;
+   while (lo < hi)
+      {
+      mid = (lo + hi) / 2;
+      if (index->positions[mid] < startpos)
+         lo = mid + 1;
+      else
+         hi = mid;
+      }
+   if (positions) *positions = index->positions + lo;
+   return last - lo;
+   }
+
+/**
+ * @english
+ * sort the positions of a datasubset by descriptor
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrPositionIndex *bufr_create_position_index( DataSubset *subset )
+   {
+   BufrPositionIndex  *index;
+   BufrDescriptor    **pbcd;
+   int                *pairs;
+   int                 i, count, nb;
+
+   count = bufr_datasubset_count_descriptor( subset );
+   index = (BufrPositionIndex *)malloc( sizeof(BufrPositionIndex) );
+   index->descriptors    = (int *)malloc( (count + 1) * sizeof(int) );
+   index->first          = (int *)malloc( (count + 1) * sizeof(int) );
+   index->positions      = (int *)malloc( (count + 1) * sizeof(int) );
+   index->nb_descriptors = 0;
+   index->count          = count;
+   index->refcount       = 1;
+/*
+ * pairs of descriptor and position, sorted on both
+ */
+   pairs = (int *)malloc( (2 * count + 1) * sizeof(int) );
+   pbcd = (count > 0) ? (BufrDescriptor **)arr_get( subset->data, 0 ) : NULL;
+   for (i = 0; i < count ; i++)
+      {
+      pairs[2*i]   = pbcd[i]->descriptor;
+      pairs[2*i+1] = i;
+      }
+   qsort( pairs, count, 2 * sizeof(int), bufr_compare_desc_pos );
+
+   nb = 0;
+   for (i = 0; i < count ; i++)
+      {
+      if ((i == 0)||(pairs[2*i] != pairs[2*i-2]))
+         {
+         index->descriptors[nb] = pairs[2*i];
+         index->first[nb] = i;
+         ++nb;
+         }
+      index->positions[i] = pairs[2*i+1];
+      }
+   index->first[nb] = count;
+   index->nb_descriptors = nb;
+   free( pairs );
+   return index;
+   }
+
+/**
+ * @english
+ * drop a reference to a position index, freed with the last one
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_release_position_index( BufrPositionIndex *index )
+   {
+   if (index == NULL) return;
+
+   if (BUFR_ATOMIC_DECR( &(index->refcount) ) > 0) return;
+
+   free( index->descriptors );
+   free( index->first );
+   free( index->positions );
+   free( index );
+   }
+
+/**
+ * @english
+ * order pairs of descriptor and position
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_compare_desc_pos( const void *p1, const void *p2 )
+   {
+   const int  *i1 = (const int *)p1;
+   const int  *i2 = (const int *)p2;
+
+   if (i1[0] != i2[0]) return (i1[0] < i2[0]) ? -1 : 1;
+   if (i1[1] != i2[1]) return (i1[1] < i2[1]) ? -1 : 1;
+   return 0;
+   }
+
+/**
+ * @english
+ * @brief group the datasubsets of a dataset by structure
+ *
+ * Subsets of a same group may be encoded together in a compressed message.
+ * Groups are numbered from 0 in order of first appearance. Subsets are
+ * looked up by signature, with a full comparison only on equal signatures.
+ * @param dts pointer to a BUFR_Dataset
+ * @param groups array receiving the group of each datasubset
+ * @return the number of groups, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_dataset_group_subsets( BUFR_Dataset *dts, int *groups )
+   {
+   int          i, h, nb_subsets, nb_groups;
+   int          size;
+   int         *table;   /* SUBSET INDEX OF EACH GROUP, -1 WHEN EMPTY */
+   DataSubset  *subset;
+   uint64_t     sig;
+
+   if ((dts == NULL)||(groups == NULL)) return -1;
+
+   nb_subsets = bufr_count_datasubset( dts );
+   if (nb_subsets <= 0) return 0;
+
+   for (size = 16; size < 2 * nb_subsets ; size *= 2) ;
+   table = (int *)malloc( size * sizeof(int) );
+   if (table == NULL) return -1;
+   for (h = 0; h < size ; h++) table[h] = -1;
+
+   nb_groups = 0;
+   for (i = 0; i < nb_subsets ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      sig = bufr_datasubset_signature( subset );
+      h = (int)(sig & (size - 1));
+      while (table[h] >= 0)
+         {
+         if (bufr_datasubset_same_structure( bufr_get_datasubset( dts, table[h] ), subset ))
+            break;
+         h = (h + 1) & (size - 1);
+         }
+      if (table[h] < 0)
+         {
+         table[h] = i;
+         groups[i] = nb_groups++;
+         }
+      else
+         {
+         groups[i] = groups[table[h]];
+         }
+      }
+   free( table );
+   return nb_groups;
+   }
+
+/**
+ * @english
+ * Used to bundle data subsets into a larger dataset (e.g. one has ten
+ * empty slots and wished to choose a particular slot. It is a requirement
+ * for this call that the data subsets are following a single template.
+ * This internally compares the templates of the two BUFR datasets to
+ * verify if they are compatible; if not, an error is retuned. The
+ * parameter ‘dts’ is the destination dataset where the data subset
+ * will be copied. The second parameter is the destination position of the
+ * subset starting from 0. The third parameter is the source dataset, the
+ * fourth parameter is the starting position of the source dataset and the
+ * fifth one is the number of data subsets to be copied.
+ * @param   dest  destination Dataset
+ * @param   dest_pos starting subset location where Datasubset from source will be copied
+ *                if (dest_pos > number of subset in dest) then extra blank subset will be added
+ * @param   src  source Dataset
+ * @param   src_pos  starting subset location of Datasubset from source
+ * @param   nb  number of subset to copy
+ * @return int, It returns -1 if there is a template mismatch or return the
+ * number of data subsets that have been copied if successful.
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode dataset
+ */
+int bufr_merge_dataset ( BUFR_Dataset *dest, int dest_pos, BUFR_Dataset *src,  int src_pos, int nb )
+   {
+   int          destcount;
+   int          srccount;
+   int          pos;
+   DataSubset  *ss, *dss, *oss;
+   int          i;
+   int          total=0;
+
+   if (bufr_compare_template( dest->tmplte, src->tmplte ) != 0) return -1;
+
+   srccount = bufr_count_datasubset( src );
+   destcount = bufr_count_datasubset( dest );
+   if (nb > srccount) nb = srccount;
+   if (dest_pos >= destcount)
+      {
+      for (i = destcount; i <= dest_pos ; i++ )
+         bufr_create_datasubset( dest );
+      destcount = bufr_count_datasubset( dest );
+      }
+
+   for ( i = 0; i < nb ; i++ )
+      {
+      pos = i + dest_pos;
+      ss = bufr_get_datasubset( src, src_pos + i );
+      dss = bufr_duplicate_datasubset( ss );
+      if ( pos < destcount )
+         {
+         oss = bufr_get_datasubset( dest, pos );
+         bufr_free_datasubset( oss );
+         arr_set( dest->datasubsets, pos, (char *)&dss );
+         ++total;
+         }
+      else
+         {
+         arr_add( dest->datasubsets, (char *)&dss );
+         ++total;
+         }
+      }
+   return total;
+   }
+
+
+/**
+ * @english
+ * @brief move a datasubset from a dataset to the end of another one
+ *
+ * Unlike bufr_merge_dataset, nothing is copied: the datasubset now
+ * belongs to dest and an empty datasubset takes its place in src.
+ * @param   dest  destination Dataset
+ * @param   src  source Dataset
+ * @param   src_pos  position of the Datasubset in src
+ * @return position of the datasubset in dest, -1 if the templates differ
+ * or src_pos is out of range
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup encode dataset
+ */
+int bufr_move_datasubset ( BUFR_Dataset *dest, BUFR_Dataset *src, int src_pos )
+   {
+   DataSubset  *ss, *empty;
+   int          pos;
+
+   if ((dest == NULL)||(src == NULL)||(dest == src)) return -1;
+   if (bufr_compare_template( dest->tmplte, src->tmplte ) != 0) return -1;
+
+   ss = bufr_get_datasubset( src, src_pos );
+   if (ss == NULL) return -1;
+
+   empty = bufr_allocate_datasubset();
+   empty->data = (BufrDescriptorArray)arr_create( 1, sizeof(BufrDescriptor *), 100 );
+   arr_set( src->datasubsets, src_pos, (char *)&empty );
+
+   pos = arr_count( dest->datasubsets );
+   arr_add( dest->datasubsets, (char *)&ss );
+   return pos;
+   }
+
+/**
+ * @english
+ *    bufr_load_dataset( dts, str_datafile )
+ *    (BUFR_Dataset *dts, char *infile)
+ * This loads a dataset initialised with bufr_create_dataset using data from
+ * a dump file (cite Code Example later)from the function
+ * bufr_dump_dataset. 
+ * @warning The dump file should exactly match the template or there will
+ * be a loading error, “dts” will not be valid (but neither set to
+ * NULL). 
+ * @warning The dump file may contain only 1 single dataset. for multiple
+ * datasets in a dump file, use the function  bufr_read_dataset_text
+ * @param   dts      destination Dataset
+ * @param   infile   filename containing data to load, the data should match
+ *                the template defined in the Dataset
+ * @return int, Upon failure an integer return code will be set less than
+ * or equal to zero (zero is where there’s no error but nothing’s
+ * loaded).
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @deprecated by bufr_read_dataset_dump
+ * @author Vanh Souvanlasy
+ * @ingroup io encode dataset
+ */
+int bufr_load_dataset( BUFR_Dataset *dts,  const char *infile )
+   {
+   char          *text;
+   size_t         size;
+   int            mapped;
+   DumpText       dt;
+   char           errmsg[256];
+   int            status=0;
+   int            lineno;
+
+   if (infile == NULL) return -1;
+
+   text = bufr_map_file( infile, &size, &mapped );
+   if (text == NULL) 
+      {
+      snprintf( errmsg, sizeof(errmsg), _("Error: can't open Datafile %s\n"), infile );
+      bufr_print_debug( errmsg );
+      return -1;
+      }
+
+   bufr_dump_text_init( &dt, text, size );
+   if ((lineno = bufr_load_header( &dt, dts )) > 0)
+      status = bufr_load_datasubsets( &dt, dts, lineno, BUFR_STRICT );
+   free( dt.line );
+   bufr_unmap_file( text, size, mapped );
+   if (status >= 0)
+      return bufr_count_datasubset( dts );
+   else
+      return status;
+   }
+
+/**
+ * @english
+ *    bufr_read_dataset_dump( dts, fp )
+ *    (BUFR_Dataset *dts, FILE *fp)
+ * This reads 1 dataset from a dump file (output of bufr_dump_dataset())
+ * @warning The dump file should exactly match the template or there will
+ * be a loading error, will not be valid (but neither set to
+ * NULL). 
+ * @param   dts      destination Dataset
+ * @param   fp       pointer to file containing data to read, the data should match
+ *                   the template defined in the Dataset
+ * @return int, Upon failure an integer return code will be set less than
+ * or equal to zero (zero is where there’s no error but nothing’s
+ * loaded).
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io encode dataset
+ */
+int bufr_read_dataset_dump( BUFR_Dataset *dts, FILE *fp )
+   {
+   char      *text;
+   size_t     len=0, max=4096;
+   int        status;
+   int        bol=1, has_subset=0;
+   DumpText   dt;
+
+/*
+ * read the text of the dataset, up to the next one, then parse it
+ * from memory; what was read but not used is given back to the file
+ */
+   text = (char *)malloc( max );
+   for (;;)
+      {
+      if (max - len < 2048)
+         {
+         max *= 2;
+         text = (char *)realloc( text, max );
+         }
+      if (fgets( text + len, max - len, fp ) == NULL) break;
+      if (bol)
+         {
+         if (has_subset && (strncmp( text + len, "BUFR_EDITION=", 13 ) == 0))
+            {
+            len += strlen( text + len );
+            break;
+            }
+         if (strncmp( text + len, "DATASUBSE", 9 ) == 0)
+            has_subset = 1;
+         }
+      len += strlen( text + len );
+      bol = (text[len-1] == '\n');
+      }
+
+   bufr_dump_text_init( &dt, text, len );
+   status = bufr_parse_dataset_dump( dts, &dt );
+   if (dt.ptr < dt.end)
+      fseek( fp, - (long)(dt.end - dt.ptr), SEEK_CUR );
+   free( dt.line );
+   free( text );
+   return status;
+   }
+
+/**
+ * @english
+ * read 1 dataset from a dump text held in memory
+ * @param   dts      destination Dataset
+ * @param   dt       the text, left after the dataset
+ * @return int, same as bufr_read_dataset_dump
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_parse_dataset_dump( BUFR_Dataset *dts, DumpText *dt )
+   {
+   int status = 0;
+
+   bufr_empty_datasubsets( dts );
+
+   if ((status = bufr_load_header( dt, dts )) > 0)
+      status = bufr_load_datasubsets( dt, dts, status, BUFR_STRICT );
+   return status;
+   }
+
+/**
+ * @english
+ * start reading a dump text held in memory
+ * @param   dt   : the reader
+ * @param   text : the text, not necessarily terminated
+ * @param   len  : its length
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_dump_text_init( DumpText *dt, const char *text, size_t len )
+   {
+   struct lconv  *lc;
+
+   dt->ptr = text;
+   dt->end = text + len;
+   dt->cur = text;
+   dt->len = 0;
+   dt->line_max = 2048;
+   dt->line = (char *)malloc( dt->line_max );
+/*
+ * numbers are converted by hand only when strtod would read the same
+ */
+   lc = localeconv();
+   dt->fast_numbers = (lc == NULL)||(lc->decimal_point == NULL)||
+                      (strcmp( lc->decimal_point, "." ) == 0);
+   }
+
+/**
+ * @english
+ * read the next line of a dump text, like fgets but of any length
+ * @param   dt   : the reader
+ * @return  the copy of the line, with its end of line, NULL at the end
+ * of the text
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static char *bufr_dump_text_gets( DumpText *dt )
+   {
+   const char  *nl;
+
+   if (dt->ptr >= dt->end) return NULL;
+
+   nl = (const char *)memchr( dt->ptr, '\n', dt->end - dt->ptr );
+   dt->cur = dt->ptr;
+   dt->len = nl ? (int)(nl - dt->ptr + 1) : (int)(dt->end - dt->ptr);
+   dt->ptr += dt->len;
+   if (dt->len >= dt->line_max)
+      {
+      dt->line_max = dt->len + 1024;
+      dt->line = (char *)realloc( dt->line, dt->line_max );
+      }
+   memcpy( dt->line, dt->cur, dt->len );
+   dt->line[dt->len] = '\0';
+   return dt->line;
+   }
+
+/**
+ * @english
+ * put back the line last read, it will be read again
+ * @param   dt   : the reader
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_dump_text_unget( DumpText *dt )
+   {
+   dt->ptr = dt->cur;
+   dt->len = 0;
+   }
+
+/**
+ * @english
+ * find where the dataset starting in a dump text ends: at the next
+ * BUFR_EDITION line following a DATASUBSET, as bufr_load_datasubsets
+ * would stop
+ * @param   ptr  : start of the dataset
+ * @param   end  : end of the text
+ * @return  the start of the next dataset, or end
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static const char *bufr_dump_text_next( const char *ptr, const char *end )
+   {
+   const char  *nl;
+   int          has_subset=0;
+
+   while (ptr < end)
+      {
+      if (has_subset && (end - ptr >= 13) && (strncmp( ptr, "BUFR_EDITION=", 13 ) == 0))
+         return ptr;
+      if ((end - ptr >= 9) && (strncmp( ptr, "DATASUBSE", 9 ) == 0))
+         has_subset = 1;
+      nl = (const char *)memchr( ptr, '\n', end - ptr );
+      if (nl == NULL) break;
+      ptr = nl + 1;
+      }
+   return end;
    }
 
+/*
+ * powers of ten exactly represented as double
+ */
+static const double  bufr_exact_pow10[23] =
+   {
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+   };
+
 /**
  * @english
- * Used to bundle data subsets into a larger dataset (e.g. one has ten
- * empty slots and wished to choose a particular slot. It is a requirement
- * for this call that the data subsets are following a single template.
- * This internally compares the templates of the two BUFR datasets to
- * verify if they are compatible; if not, an error is retuned. The
- * parameter ‘dts’ is the destination dataset where the data subset
- * will be copied. The second parameter is the destination position of the
- * subset starting from 0. The third parameter is the source dataset, the
- * fourth parameter is the starting position of the source dataset and the
- * fifth one is the number of data subsets to be copied.
- * @param   dest  destination Dataset
- * @param   dest_pos starting subset location where Datasubset from source will be copied
- *                if (dest_pos > number of subset in dest) then extra blank subset will be added
- * @param   src  source Dataset
- * @param   src_pos  starting subset location of Datasubset from source
- * @param   nb  number of subset to copy
- * @return int, It returns -1 if there is a template mismatch or return the
- * number of data subsets that have been copied if successful.
+ * split a plain decimal number, without exponent, into an integer
+ * mantissa and a number of decimals
+ * @param   str       : the number
+ * @param   mantissa  : receives the digits as an integer
+ * @param   decimals  : receives the number of digits after the point
+ * @return  -1 or 1 for the sign, 0 if the number is not that simple
  * @endenglish
  * @francais
  * @todo translate to French
  * @endfrancais
  * @author Vanh Souvanlasy
- * @ingroup encode dataset
+ * @ingroup internal
  */
-int bufr_merge_dataset ( BUFR_Dataset *dest, int dest_pos, BUFR_Dataset *src,  int src_pos, int nb )
+static int bufr_split_decimal( const char *str, uint64_t *mantissa, int *decimals )
    {
-   int          destcount;
-   int          srccount;
-   int          pos;
-   DataSubset  *ss, *dss, *oss;
-   int          i;
-   int          total=0;
-
-   if (bufr_compare_template( dest->tmplte, src->tmplte ) != 0) return -1;
+   uint64_t  m=0;
+   int       sign=1, ndigits=0, k=-1;
 
-   srccount = bufr_count_datasubset( src );
-   destcount = bufr_count_datasubset( dest );
-   if (nb > srccount) nb = srccount;
-   if (dest_pos >= destcount)
+   if (*str == '-')
       {
-      for (i = destcount; i <= dest_pos ; i++ )
-         bufr_create_datasubset( dest );
-      destcount = bufr_count_datasubset( dest );
+      sign = -1;
+      ++str;
       }
+   else if (*str == '+')
+      ++str;
 
-   for ( i = 0; i < nb ; i++ )
+   for ( ; *str ; str++)
       {
-      pos = i + dest_pos;
-      ss = bufr_get_datasubset( src, src_pos + i );
-      dss = bufr_duplicate_datasubset( ss );
-      if ( pos < destcount )
+      if ((*str >= '0')&&(*str <= '9'))
          {
-         oss = bufr_get_datasubset( dest, pos );
-         bufr_free_datasubset( oss );
-         arr_set( dest->datasubsets, pos, (char *)&dss );
-         ++total;
+         if (m > (UINT64_MAX - 9) / 10) return 0;
+         m = m * 10 + (*str - '0');
+         ++ndigits;
+         if (k >= 0) ++k;
          }
+      else if ((*str == '.')&&(k < 0))
+         k = 0;
       else
-         {
-         arr_add( dest->datasubsets, (char *)&dss );
-         ++total;
-         }
+         return 0;
       }
-   return total;
-   }
+   if (ndigits == 0) return 0;
 
+   *mantissa = m;
+   *decimals = (k < 0) ? 0 : k;
+   return sign;
+   }
 
 /**
  * @english
- *    bufr_load_dataset( dts, str_datafile )
- *    (BUFR_Dataset *dts, char *infile)
- * This loads a dataset initialised with bufr_create_dataset using data from
- * a dump file (cite Code Example later)from the function
- * bufr_dump_dataset. 
- * @warning The dump file should exactly match the template or there will
- * be a loading error, “dts” will not be valid (but neither set to
- * NULL). 
- * @warning The dump file may contain only 1 single dataset. for multiple
- * datasets in a dump file, use the function  bufr_read_dataset_text
- * @param   dts      destination Dataset
- * @param   infile   filename containing data to load, the data should match
- *                the template defined in the Dataset
- * @return int, Upon failure an integer return code will be set less than
- * or equal to zero (zero is where there’s no error but nothing’s
- * loaded).
+ * convert a value of a dump to double, giving the same result as strtod
+ * @param   dt   : the reader, its locale setting
+ * @param   str  : the value
+ * @return  the value
  * @endenglish
  * @francais
  * @todo translate to French
  * @endfrancais
- * @deprecated by bufr_read_dataset_dump
  * @author Vanh Souvanlasy
- * @ingroup io encode dataset
+ * @ingroup internal
  */
-int bufr_load_dataset( BUFR_Dataset *dts,  const char *infile )
+static double bufr_dump_strtod( DumpText *dt, const char *str )
    {
-   FILE          *fp;
-   char           errmsg[256];
-   int            status=0;
-   int            lineno;
-
-   if (infile == NULL) return -1;
+   uint64_t  m;
+   int       k, sign;
 
-   fp = fopen ( infile, "rb" ) ;
-   if (fp == NULL) 
+/*
+ * an integer of at most 53 bits and an exact power of ten are both
+ * doubles, their quotient is then rounded once, as strtod does
+ */
+   if (dt->fast_numbers)
       {
-      sprintf( errmsg, _("Error: can't open Datafile %s\n"), infile );
-      bufr_print_debug( errmsg );
-      return -1;
+      sign = bufr_split_decimal( str, &m, &k );
+      if (sign && (m <= ((uint64_t)1 << 53)) && (k <= 22))
+         return sign * ((double)m / bufr_exact_pow10[k]);
       }
+   return strtod( str, NULL );
+   }
 
-   if ((lineno = bufr_load_header( fp, dts )) > 0)
-      status = bufr_load_datasubsets( fp, dts, lineno, BUFR_STRICT );
+/**
+ * @english
+ * convert a value of a dump to float, giving the same result as strtof
+ * @param   dt   : the reader, its locale setting
+ * @param   str  : the value
+ * @return  the value
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static float bufr_dump_strtof( DumpText *dt, const char *str )
+   {
+   uint64_t  m;
+   int       k, sign;
 
-   fclose ( fp ) ;
-   if (status >= 0)
-      return bufr_count_datasubset( dts );
-   else
-      return status;
+/*
+ * with both parts exact as floats, the quotient rounded to double
+ * then to float is still the correctly rounded float
+ */
+   if (dt->fast_numbers)
+      {
+      sign = bufr_split_decimal( str, &m, &k );
+      if (sign && (m <= ((uint64_t)1 << 24)) && (k <= 10))
+         return (float)(sign * ((double)m / bufr_exact_pow10[k]));
+      }
+   return strtof( str, NULL );
    }
 
 /**
  * @english
- *    bufr_read_dataset_dump( dts, fp )
- *    (BUFR_Dataset *dts, FILE *fp)
- * This reads 1 dataset from a dump file (output of bufr_dump_dataset())
- * @warning The dump file should exactly match the template or there will
- * be a loading error, will not be valid (but neither set to
- * NULL). 
- * @param   dts      destination Dataset
- * @param   fp       pointer to file containing data to read, the data should match
- *                   the template defined in the Dataset
- * @return int, Upon failure an integer return code will be set less than
- * or equal to zero (zero is where there’s no error but nothing’s
- * loaded).
+ * convert an integer value of a dump, like atol
+ * @param   str  : the value
+ * @return  the value
  * @endenglish
  * @francais
  * @todo translate to French
  * @endfrancais
  * @author Vanh Souvanlasy
- * @ingroup io encode dataset
+ * @ingroup internal
  */
-int bufr_read_dataset_dump( BUFR_Dataset *dts, FILE *fp )
+static int64_t bufr_dump_atol( const char *str )
    {
-   int status = 0;
-
-   bufr_empty_datasubsets( dts );
+   uint64_t  m;
+   int       k, sign;
 
-   if ((status = bufr_load_header( fp, dts )) > 0)
-      status = bufr_load_datasubsets( fp, dts, status, BUFR_STRICT );
-   return status;
+   sign = bufr_split_decimal( str, &m, &k );
+   if (sign && (k == 0) && (strchr( str, '.' ) == NULL) && (m <= INT64_MAX))
+      return sign * (int64_t)m;
+   return atol( str );
    }
 
 /**
  * @english
- * load data stored in a file into a Dataset
- * @param   fp       :  file pointer containing data to load
+ * load data of a dump text into a Dataset
+ * @param   dt       :  the text, read up to the next dataset
  * @param   dts      :  destination Dataset
- * @param   ligne    :  string buffer for reading a line of string from the file
  * @endenglish
  * @francais
  * @todo translate to French
@@ -3412,7 +5041,7 @@ int bufr_read_dataset_dump( BUFR_Dataset *dts, FILE *fp )
  * @author Vanh Souvanlasy
  * @ingroup io dataset internal
  */
-static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_Enforcement enforce )
+static int bufr_load_datasubsets( DumpText *dt, BUFR_Dataset *dts, int lineno, BUFR_Enforcement enforce )
    {
    char            *errmsg;
    char            *dstrptr;
@@ -3423,7 +5052,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
    ListNode      *node;
    BufrDDOp      *ddo=NULL;
    BUFR_Tables   *tbls;
-   char          ligne[2048];
+   char         *ligne;
    char          msg[2048];
 
    char          *tok;
@@ -3433,7 +5062,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
    unsigned int   uival;
    float          fval;
    double         dval;
-   char          *kptr = NULL, *ptr;
+   char          *ptr;
    int            i, len;
    int            errcode;
    LinkedList    *tmplist;
@@ -3467,7 +5096,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
    arr_inc( dstrptr, 2000 );
    errmsg = (char *) arr_get( dstrptr, 0 );
 
-   while ( fgets(ligne,2048,fp) != NULL )
+   while ((ligne = bufr_dump_text_gets( dt )) != NULL)
       {
       ++lineno;
       if ( ligne[0] == '#' ) continue;
@@ -3475,21 +5104,15 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
 
       if (strncmp( ligne, "BUFR_EDITION=", 13 ) == 0)
          {
-         if (bsq2)
-            {
-            bufr_mkval_rest_sequence( tbls, bsq2, node, &errflg );
-            bufr_add_datasubset( dts, bsq2, ddo );
-            }
-         fseek( fp, - strlen(ligne), SEEK_CUR );
-         arr_free( &dstrptr );
-         return 1;
+         bufr_dump_text_unget( dt );
+         break;
          }
 
       if (strncmp( ligne, "DATASUBSET", 10 ) == 0)
          {
          if (bufr_is_verbose())
 	    {
-            sprintf( msg, _("Loading: %s\n"), ligne );
+            snprintf( msg, sizeof(msg), _("Loading: %s\n"), ligne );
 	    bufr_print_debug( msg );
 	    }
 
@@ -3512,13 +5135,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
          ddo = bufr_create_BufrDDOp( enforce );
          }
 
-      if (kptr != NULL) 
-         {
-         free( kptr );
-         kptr = NULL;
-         }
-      kptr = strdup( ligne );
-      tok = strtok_r( kptr, " \t\n\r,=", &ptr );
+      tok = strtok_r( ligne, " \t\n\r,=", &ptr );
       if (tok == NULL) continue;
       icode = atoi(tok);
 
@@ -3576,6 +5193,9 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
          sprintf( errmsg, _("Error: data descriptor %d mismatch with template %d\n"), 
                   icode, cb->descriptor );
          bufr_print_debug( errmsg );
+         bufr_free_sequence( bsq2 );
+         bufr_free_sequence( bsq );
+         bufr_free_BufrDDOp( ddo );
          arr_free( &dstrptr );
          return -1;
          }
@@ -3642,7 +5262,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
          int j;
 
          tok = strtok_r( NULL, " \t\n\r():", &ptr );
-         sscanf( tok, "%llx", &afbits );
+         afbits = tok ? strtoull( tok, NULL, 16 ) : 0;
          if (debug)
             {
             sprintf( errmsg, _("   *** has AF: %s -> %llx\n"), tok, afbits );
@@ -3657,7 +5277,8 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
             cb->value->af->bits = afbits;
          else
             {
-            sprintf( errmsg, _("Warning: can't set AF at line %d : %s"), lineno-1,  ligne );
+            snprintf( errmsg, arr_count(dstrptr), _("Warning: can't set AF at line %d : %.*s"), 
+                      lineno-1, dt->len, dt->cur );
             bufr_print_debug( errmsg );
             }
 
@@ -3768,7 +5389,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
                            ival64 = bufr_binary_to_int( tok );
                         break;
                         default :
-                           ival64 = atol(tok);
+                           ival64 = bufr_dump_atol( tok );
                         break;
                         }
                      }
@@ -3788,7 +5409,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
             case VALTYPE_FLT64  :
                if (strcmp( tok, "MSNG" ) != 0)
                   {
-                  dval = strtod( tok, NULL );
+                  dval = bufr_dump_strtod( dt, tok );
                   if (!bufr_is_missing_double( dval ))
                      bufr_descriptor_set_dvalue( cb, dval );
                   if (debug)
@@ -3801,7 +5422,7 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
             case VALTYPE_FLT32  :
                if (strcmp( tok, "MSNG" ) != 0)
                   {
-                  fval = strtof( tok, NULL );
+                  fval = bufr_dump_strtof( dt, tok );
                   if (!bufr_is_missing_float( fval ))
                      bufr_descriptor_set_fvalue( cb, fval );
                   if (debug)
@@ -3831,6 +5452,9 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
             dts->data_flag |= BUFR_FLAG_INVALID;                    
          if (tmplist == NULL)
             {
+            bufr_free_sequence( bsq2 );
+            bufr_free_sequence( bsq );
+            bufr_free_BufrDDOp( ddo );
             arr_free( &dstrptr );
             return -1;
             }
@@ -3855,12 +5479,6 @@ static int bufr_load_datasubsets( FILE *fp, BUFR_Dataset *dts, int lineno, BUFR_
 
    bufr_free_BufrDDOp( ddo );
 
-   if (kptr != NULL) 
-      {
-      free( kptr );
-      kptr = NULL;
-      }
-
    arr_free( &dstrptr );
 
    if (bsq2) 
@@ -3908,10 +5526,9 @@ static void bufr_mkval_rest_sequence(BUFR_Tables   *tbls, BUFR_Sequence *bsq2, L
 
 /**
  * @english
- * load the header part of the data stored in a file into a Dataset
- * @param   fp       :  file pointer containing data to load
+ * load the header part of a dump text into a Dataset
+ * @param   dt       :  the text, left at the first DATASUBSET
  * @param   dts      :  destination Dataset
- * @param   ligne    :  string buffer for reading a line of string from the file
  * @endenglish
  * @francais
  * @todo translate to French
@@ -3919,14 +5536,14 @@ static void bufr_mkval_rest_sequence(BUFR_Tables   *tbls, BUFR_Sequence *bsq2, L
  * @author Vanh Souvanlasy
  * @ingroup io dataset internal
  */
-static int bufr_load_header( FILE *fp, BUFR_Dataset *dts )
+static int bufr_load_header( DumpText *dt, BUFR_Dataset *dts )
    {
-   char    ligne[2048];
+   char    *ligne;
    char    errmsg[256];
-   char    *tok;
+   char    *tok, *ptr;
    int     lineno=0;
 
-   while ( fgets(ligne,2048,fp) != NULL )
+   while ((ligne = bufr_dump_text_gets( dt )) != NULL)
       {
       ++lineno;
       if ( ligne[0] == '#' ) continue;
@@ -3934,7 +5551,7 @@ static int bufr_load_header( FILE *fp, BUFR_Dataset *dts )
 
       if (strncmp( ligne, "BUFR_EDITION", 12 ) == 0)
          {
-         tok = strtok( ligne+12, " =\t\n" );
+         tok = strtok_r( ligne+12, " =\t\n", &ptr );
          if (tok)
             {
             int ed = atoi( tok );
@@ -3948,104 +5565,104 @@ static int bufr_load_header( FILE *fp, BUFR_Dataset *dts )
          }
       else if (strncmp( ligne, "BUFR_MASTER_TABLE", 17 ) == 0)
          {
-         tok = strtok( ligne+17, " =\t\n" );
+         tok = strtok_r( ligne+17, " =\t\n", &ptr );
          if (tok)
             dts->s1.bufr_master_table = atoi( tok );
          }
       else if (strncmp( ligne, "ORIG_CENTER", 11 ) == 0)
          {
-         tok = strtok( ligne+11, " =\t\n" );
+         tok = strtok_r( ligne+11, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_ORIG_CENTRE( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "ORIG_SUB_CENTER", 15 ) == 0)
          {
-         tok = strtok( ligne+15, " =\t\n" );
+         tok = strtok_r( ligne+15, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_SUB_CENTRE( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "UPDATE_SEQUENCE", 15 ) == 0)
          {
-         tok = strtok( ligne+15, " =\t\n" );
+         tok = strtok_r( ligne+15, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_UPD_SEQUENCE( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "DATA_CATEGORY", 13 ) == 0)
          {
-         tok = strtok( ligne+13, " =\t\n" );
+         tok = strtok_r( ligne+13, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_DATA_CATEGORY( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "INTERN_SUB_CATEGORY", 19 ) == 0)
          {
-         tok = strtok( ligne+19, " =\t\n" );
+         tok = strtok_r( ligne+19, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_INTERN_SUB_CAT( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "LOCAL_SUB_CATEGORY", 18 ) == 0)
          {
-         tok = strtok( ligne+18, " =\t\n" );
+         tok = strtok_r( ligne+18, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_LOCAL_SUB_CAT( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "MASTER_TABLE_VERSION", 20 ) == 0)
          {
-         tok = strtok( ligne+20, " =\t\n" );
+         tok = strtok_r( ligne+20, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_MSTR_TBL_VRSN( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "LOCAL_TABLE_VERSION", 19 ) == 0)
          {
-         tok = strtok( ligne+19, " =\t\n" );
+         tok = strtok_r( ligne+19, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_LOCAL_TBL_VRSN( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "YEAR", 4 ) == 0)
          {
-         tok = strtok( ligne+4, " =\t\n" );
+         tok = strtok_r( ligne+4, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_YEAR( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "MONTH", 5 ) == 0)
          {
-         tok = strtok( ligne+5, " =\t\n" );
+         tok = strtok_r( ligne+5, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_MONTH( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "DAY", 3 ) == 0)
          {
-         tok = strtok( ligne+3, " =\t\n" );
+         tok = strtok_r( ligne+3, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_DAY( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "HOUR", 4 ) == 0)
          {
-         tok = strtok( ligne+4, " =\t\n" );
+         tok = strtok_r( ligne+4, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_HOUR( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "MINUTE", 6 ) == 0)
          {
-         tok = strtok( ligne+6, " =\t\n" );
+         tok = strtok_r( ligne+6, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_MINUTE( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "SECOND", 6 ) == 0)
          {
-         tok = strtok( ligne+6, " =\t\n" );
+         tok = strtok_r( ligne+6, " =\t\n", &ptr );
          if (tok)
             BUFR_SET_SECOND( dts, atoi( tok ) );
          }
       else if (strncmp( ligne, "DATA_FLAG", 9 ) == 0)
          {
-         tok = strtok( ligne+9, " =\t\n" );
+         tok = strtok_r( ligne+9, " =\t\n", &ptr );
          if (tok)
             dts->data_flag = atoi( tok );
          }
       else if (strncmp( ligne, "COMPRESSED", 10 ) == 0)
          {
          int compressed;
-         tok = strtok( ligne+10, " =\t\n" );
+         tok = strtok_r( ligne+10, " =\t\n", &ptr );
          if (tok)
             {
             compressed = atoi( tok );
@@ -4065,18 +5682,22 @@ static int bufr_load_header( FILE *fp, BUFR_Dataset *dts )
                if (ligne[e] == '"')  break;
             if (e <= b) e = len;
             ligne[e] = '\0';
+            if (dts->header_string) free( dts->header_string );
             dts->header_string = strdup( ligne+b+1 );
             }
          else
             {
-            tok = strtok( ligne+13, "=\t\n" );
+            tok = strtok_r( ligne+13, "=\t\n", &ptr );
             if (tok)
+               {
+               if (dts->header_string) free( dts->header_string );
                dts->header_string = strdup( tok );
+               }
             }
          }
       else
          {
-         fseek( fp, - strlen(ligne), SEEK_CUR );
+         bufr_dump_text_unget( dt );
          if (strncmp( ligne, "DATASUBSET", 9 ) == 0 )
             return lineno;
          break;
@@ -4298,6 +5919,9 @@ BUFR_Dataset *bufr_create_dataset_from_sequence
  *    ( BUFR_Template *tmplt, const char *infile, const char *outfile )
  * This loads all datasets of a dump text file, as they will be read 1 by 1
  * and the stored in the output BUFR file.
+ * The file is mapped in memory; with more than 1 thread set by
+ * bufr_set_threads, the datasets are parsed and encoded in parallel and
+ * the messages still written in their order.
  * @warning The dump file should exactly match the template or there will
  * be a loading error, “dts” will not be valid (but neither set to
  * NULL). 
@@ -4318,21 +5942,22 @@ BUFR_Dataset *bufr_create_dataset_from_sequence
 int bufr_genmsgs_from_dump
    ( BUFR_Template *tmplt, const char *infile, const char *outfile, int do_compress )
    {
-   FILE          *fpi, *fpo;
-   int            debug;
+   FILE          *fpo;
    char           errmsg[1024];
-   BUFR_Dataset  *dts;
-   BUFR_Message  *msg = NULL;
+   char          *text;
+   size_t         size;
+   int            mapped;
+   int            nb_threads;
+   int            has_msg=0;
+   DumpText       dt;
 
    if (infile == NULL) return -1;
    if (outfile == NULL) return -1;
 
-   debug = bufr_is_debug();
-
-   fpi = fopen ( infile, "rb" ) ;
-   if (fpi == NULL) 
+   text = bufr_map_file( infile, &size, &mapped );
+   if (text == NULL) 
       {
-      sprintf( errmsg, _("Error: can't open input file %s\n"), infile );
+      snprintf( errmsg, sizeof(errmsg), _("Error: can't open input file %s\n"), infile );
       bufr_print_debug( errmsg );
       return -1;
       }
@@ -4340,24 +5965,63 @@ int bufr_genmsgs_from_dump
    fpo = fopen ( outfile, "wb" ) ;
    if (fpo == NULL) 
       {
-      sprintf( errmsg, _("Error: can't open output file %s\n"), outfile );
+      snprintf( errmsg, sizeof(errmsg), _("Error: can't open output file %s\n"), outfile );
       bufr_print_debug( errmsg );
-      fclose( fpi );
+      bufr_unmap_file( text, size, mapped );
       return -1;
       }
 
+/*
+ * the debug printout must stay in dataset order
+ */
+   nb_threads = bufr_genmsgs_worker ? 1 : bufr_nb_threads;
+   if (bufr_is_debug()) nb_threads = 1;
+   if ((nb_threads <= 1)||!bufr_genmsgs_threaded( tmplt, text, size, fpo, do_compress, nb_threads ))
+      {
+      bufr_dump_text_init( &dt, text, size );
+      bufr_genmsgs_serial( tmplt, &dt, fpo, do_compress, &has_msg );
+      free( dt.line );
+      }
+
+   fclose ( fpo ) ;
+   bufr_unmap_file( text, size, mapped );
+   return 1;
+   }
+
+/**
+ * @english
+ * encode the datasets of a dump text one after the other, each
+ * message but the first preceded by a ^D if the previous one was encoded
+ * @param   tmplt       : template of the datasets
+ * @param   dt          : the text
+ * @param   fpo         : output file
+ * @param   do_compress : if output message need to be compressed
+ * @param   has_msg     : if the previous message was encoded, updated
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_genmsgs_serial
+   ( BUFR_Template *tmplt, DumpText *dt, FILE *fpo, int do_compress, int *has_msg )
+   {
+   int            debug;
+   char           errmsg[1024];
+   BUFR_Dataset  *dts;
+   BUFR_Message  *msg;
+
+   debug = bufr_is_debug();
    dts = bufr_create_dataset( tmplt );
 
-   while (bufr_read_dataset_dump( dts, fpi ) > 0)
+   while (bufr_parse_dataset_dump( dts, dt ) > 0)
       {
-      if (msg != NULL)
-         {
-         bufr_free_message ( msg );
+      if (*has_msg)
          fprintf( fpo, "\004" );
-         msg = NULL;
-         }
 
       msg = bufr_encode_message ( dts, do_compress );
+      *has_msg = (msg != NULL);
       if (msg != NULL)
          {
          if (debug)
@@ -4366,16 +6030,227 @@ int bufr_genmsgs_from_dump
             bufr_print_debug( errmsg );
             }
          bufr_write_message( fpo, msg );
+         bufr_free_message ( msg );
          }
       }
 
-   fclose ( fpi ) ;
-   fclose ( fpo ) ;
+   bufr_free_dataset( dts );
+   }
+
+/**
+ * @english
+ * encode the datasets of a dump text with several threads, each one
+ * parsing and encoding whole datasets into memory, the calling thread
+ * writing the messages in their order, as bufr_genmsgs_serial would
+ * @param   tmplt       : template of the datasets
+ * @param   text        : the text
+ * @param   len         : its length
+ * @param   fpo         : output file
+ * @param   do_compress : if output message need to be compressed
+ * @param   nb_threads  : number of threads
+ * @return  1 if done, 0 if there are too few datasets and it should be
+ * done serially
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_genmsgs_threaded
+   ( BUFR_Template *tmplt, const char *text, size_t len, FILE *fpo, int do_compress, int nb_threads )
+   {
+   DumpBlocks     work;
+   DumpBlock     *blk;
+   DumpText       dt;
+   pthread_t     *tids;
+   const char    *ptr, *end;
+   int            i, max, started;
+   int            has_msg=0;
+
+/*
+ * the datasets are found beforehand, just by their BUFR_EDITION line
+ */
+   end = text + len;
+   max = 64;
+   work.blocks = (DumpBlock *)malloc( max * sizeof(DumpBlock) );
+   work.nb_blocks = 0;
+   for (ptr = text; ptr < end ; ptr = blk->end)
+      {
+      if (work.nb_blocks >= max)
+         {
+         max *= 2;
+         work.blocks = (DumpBlock *)realloc( work.blocks, max * sizeof(DumpBlock) );
+         }
+      blk = &work.blocks[work.nb_blocks++];
+      memset( blk, 0, sizeof(DumpBlock) );
+      blk->text = ptr;
+      blk->end = bufr_dump_text_next( ptr, end );
+      }
+   if (work.nb_blocks < 2)
+      {
+      free( work.blocks );
+      return 0;
+      }
+   if (nb_threads > work.nb_blocks) nb_threads = work.nb_blocks;
+
+   work.tmplt = tmplt;
+   work.do_compress = do_compress;
+   work.next = 0;
+   work.written = 0;
+   work.window = nb_threads * 4;
+   work.abort = 0;
+   pthread_mutex_init( &work.lock, NULL );
+   pthread_cond_init( &work.cond, NULL );
+
+   tids = (pthread_t *)malloc( nb_threads * sizeof(pthread_t) );
+   for (started = 0; started < nb_threads ; started++)
+      if (pthread_create( &tids[started], NULL, bufr_genmsgs_thread, &work ) != 0) break;
+
+   ptr = NULL;
+   for (i = 0; (i < work.nb_blocks)&&(started > 0) ; i++)
+      {
+      blk = &work.blocks[i];
+      pthread_mutex_lock( &work.lock );
+      while (!blk->done)
+         pthread_cond_wait( &work.cond, &work.lock );
+      pthread_mutex_unlock( &work.lock );
+
+      if (blk->status <= 0) break;
+      if (has_msg)
+         fprintf( fpo, "\004" );
+      if (blk->encoded)
+         fwrite( blk->bytes, 1, blk->len, fpo );
+      has_msg = blk->encoded;
+/*
+ * a dataset not read to its end leaves the rest to be read as the next
+ * one, which only the serial reading can do
+ */
+      if (blk->stop != blk->end)
+         {
+         ptr = blk->stop;
+         break;
+         }
 
-   if ( msg != NULL )
-      bufr_free_message ( msg );
+      pthread_mutex_lock( &work.lock );
+      work.written = i + 1;
+      free( blk->bytes );
+      blk->bytes = NULL;
+      pthread_cond_broadcast( &work.cond );
+      pthread_mutex_unlock( &work.lock );
+      }
 
-   bufr_free_dataset( dts );
+   pthread_mutex_lock( &work.lock );
+   work.abort = 1;
+   pthread_cond_broadcast( &work.cond );
+   pthread_mutex_unlock( &work.lock );
+   for (i = 0; i < started ; i++)
+      pthread_join( tids[i], NULL );
+   free( tids );
+   pthread_cond_destroy( &work.cond );
+   pthread_mutex_destroy( &work.lock );
+
+   if (started == 0) ptr = text;
+   if (ptr != NULL)
+      {
+      bufr_dump_text_init( &dt, ptr, end - ptr );
+      bufr_genmsgs_serial( tmplt, &dt, fpo, do_compress, &has_msg );
+      free( dt.line );
+      }
+
+   for (i = 0; i < work.nb_blocks ; i++)
+      free( work.blocks[i].bytes );
+   free( work.blocks );
    return 1;
    }
 
+/**
+ * @english
+ * thread body of bufr_genmsgs_threaded
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void *bufr_genmsgs_thread( void *data )
+   {
+   DumpBlocks    *work = (DumpBlocks *)data;
+   DumpBlock     *blk;
+   DumpText       dt;
+   BUFR_Dataset  *dts;
+   BUFR_Message  *msg;
+   int            i;
+
+   bufr_genmsgs_worker = 1;
+   dts = bufr_create_dataset( work->tmplt );
+   dt.line = NULL;
+   for (;;)
+      {
+      pthread_mutex_lock( &work->lock );
+      while (!work->abort && (work->next < work->nb_blocks) &&
+             (work->next >= work->written + work->window))
+         pthread_cond_wait( &work->cond, &work->lock );
+      i = work->next++;
+      if (work->abort || (i >= work->nb_blocks))
+         {
+         pthread_mutex_unlock( &work->lock );
+         break;
+         }
+      pthread_mutex_unlock( &work->lock );
+
+      blk = &work->blocks[i];
+      free( dt.line );
+      bufr_dump_text_init( &dt, blk->text, blk->end - blk->text );
+      blk->status = bufr_parse_dataset_dump( dts, &dt );
+      blk->stop = dt.ptr;
+      if (blk->status > 0)
+         {
+         msg = bufr_encode_message( dts, work->do_compress );
+         if (msg != NULL)
+            {
+            blk->encoded = 1;
+            bufr_callback_write_message( bufr_dump_block_write, blk, msg );
+            bufr_free_message( msg );
+            }
+         }
+
+      pthread_mutex_lock( &work->lock );
+      blk->done = 1;
+      pthread_cond_broadcast( &work->cond );
+      pthread_mutex_unlock( &work->lock );
+      }
+   free( dt.line );
+   bufr_free_dataset( dts );
+   return NULL;
+   }
+
+/**
+ * @english
+ * callback of bufr_callback_write_message keeping a message in memory
+ * @param   client_data : the DumpBlock of the message
+ * @param   len         : number of bytes to write
+ * @param   buffer      : data buffer to write from
+ * @return  number of bytes written
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static ssize_t bufr_dump_block_write( void *client_data, size_t len, const char *buffer )
+   {
+   DumpBlock  *blk = (DumpBlock *)client_data;
+
+   if (blk->len + len > blk->max)
+      {
+      blk->max = (blk->len + len) * 2;
+      blk->bytes = (char *)realloc( blk->bytes, blk->max );
+      }
+   memcpy( blk->bytes + blk->len, buffer, len );
+   blk->len += len;
+   return len;
+   }
+
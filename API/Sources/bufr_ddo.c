@@ -798,6 +798,7 @@ void bufr_assoc_location  ( BufrDescriptor *bc, BufrDDOp *ddo )
       }
    else
       {
+      bc->meta = bufr_unshare_rtmd( bc->meta );
       if (bc->meta->tlc != NULL)
          free( bc->meta->tlc );
       bc->meta->nb_tlc = 0;
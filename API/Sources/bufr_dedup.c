@@ -0,0 +1,517 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_dedup.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: detection des bulletins en double et des corrections
+ *
+ * A feed delivers the same bulletin many times, and corrected bulletins
+ * with a higher update sequence number. The raw octets of sections 3
+ * and 4 of a message are hashed and kept for a time window, so that a
+ * duplicate is dropped before anything is decoded. The section 1 keys
+ * and the bulletin heading, without the update sequence number, tell
+ * which earlier message a correction replaces.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_message.h"
+#include "bufr_dedup.h"
+#include "bufr_api.h"
+#include "bufr_i18n.h"
+
+#define  FNV_OFFSET   14695981039346656037ULL
+#define  FNV_PRIME    1099511628211ULL
+
+static uint64_t  bufr_dedup_hash       ( uint64_t hash, const unsigned char *data, int len );
+static uint64_t  bufr_dedup_mix        ( uint64_t hash, int64_t value );
+static int       bufr_dedup_heading    ( const char *str, char *dst, int size );
+static void      bufr_dedup_expire     ( BufrDedup *dd, int64_t now );
+static void      bufr_dedup_drop_first ( BufrDedup *dd );
+static void      bufr_dedup_insert     ( BufrDedup *dd, uint64_t fingerprint, uint64_t identity,
+                                         int upd_seq_no, int64_t now, long id );
+
+/**
+ * @english
+ * @brief create an empty set of recent messages
+ * @param capacity  most messages kept, 0 for DEDUP_DEFAULT_CAPACITY
+ * @param window  seconds a message is kept, 0 for DEDUP_DEFAULT_WINDOW
+ * @return the set, to free with bufr_free_dedup
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_dedup_message, bufr_dedup_read_message
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrDedup *bufr_create_dedup( int capacity, int64_t window )
+   {
+   BufrDedup  *dd;
+   int         i;
+
+   if (capacity <= 0) capacity = DEDUP_DEFAULT_CAPACITY;
+   if (window <= 0) window = DEDUP_DEFAULT_WINDOW;
+
+   dd = (BufrDedup *)malloc( sizeof(BufrDedup) );
+   dd->capacity = capacity;
+   dd->window = window;
+   dd->first = 0;
+   dd->count = 0;
+   dd->entries = (BufrDedupEntry *)malloc( capacity * sizeof(BufrDedupEntry) );
+/*
+ * twice as many buckets as entries, a power of 2
+ */
+   for (dd->nb_buckets = 16; dd->nb_buckets < 2 * capacity ; dd->nb_buckets *= 2) ;
+   dd->fp_heads = (int *)malloc( dd->nb_buckets * sizeof(int) );
+   dd->id_heads = (int *)malloc( dd->nb_buckets * sizeof(int) );
+   for (i = 0; i < dd->nb_buckets ; i++)
+      {
+      dd->fp_heads[i] = -1;
+      dd->id_heads[i] = -1;
+      }
+   dd->nb_checked = 0;
+   dd->nb_duplicates = 0;
+   dd->nb_stale = 0;
+   dd->nb_corrections = 0;
+   return dd;
+   }
+
+/**
+ * @english
+ * @brief free a set of recent messages
+ * @param dd  the set
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_free_dedup( BufrDedup *dd )
+   {
+   if (dd == NULL) return;
+   free( dd->entries );
+   free( dd->fp_heads );
+   free( dd->id_heads );
+   free( dd );
+   }
+
+/**
+ * @english
+ * @brief hash of the raw octets of sections 3 and 4 of a message
+ *
+ * Two messages with the same fingerprint hold the same descriptors and
+ * the same data, whatever their section 1 says.
+ * @param msg  the message, as read
+ * @return 64 bits FNV-1a hash
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+uint64_t bufr_message_fingerprint( BUFR_Message *msg )
+   {
+   uint64_t  hash;
+   int       len;
+
+   hash = FNV_OFFSET;
+   hash = bufr_dedup_mix( hash, msg->s3.no_data_subsets );
+   hash = bufr_dedup_mix( hash, msg->s3.flag );
+   len = msg->s3.len - msg->s3.header_len;
+   if (msg->s3.data && (len > 0))
+      hash = bufr_dedup_hash( hash, (const unsigned char *)msg->s3.data, len );
+   len = msg->s4.len - msg->s4.header_len;
+   if (len > (int)msg->s4.max_data_len) len = msg->s4.max_data_len;
+   if (msg->s4.data && (len > 0))
+      hash = bufr_dedup_hash( hash, msg->s4.data, len );
+   return hash;
+   }
+
+/**
+ * @english
+ * @brief hash of what identifies a bulletin apart from its update
+ *
+ * The section 1 keys except the update sequence number and the table
+ * versions, and the TTAAii CCCC YYGGgg heading when there is one.
+ * Without a heading, the number of subsets and the descriptors of
+ * section 3 are taken instead, which still does not tell apart bulletins
+ * of the same kind, time and size.
+ * @param msg  the message, as read
+ * @return 64 bits FNV-1a hash
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+uint64_t bufr_message_identity( BUFR_Message *msg )
+   {
+   BufrSection1  *s1 = &(msg->s1);
+   uint64_t       hash;
+   char           heading[32];
+   int           *descs;
+   int            i, len;
+
+   hash = FNV_OFFSET;
+   hash = bufr_dedup_mix( hash, s1->bufr_master_table );
+   hash = bufr_dedup_mix( hash, s1->orig_centre );
+   hash = bufr_dedup_mix( hash, s1->orig_sub_centre );
+   hash = bufr_dedup_mix( hash, s1->msg_type );
+   hash = bufr_dedup_mix( hash, s1->msg_inter_subtype );
+   hash = bufr_dedup_mix( hash, s1->msg_local_subtype );
+   hash = bufr_dedup_mix( hash, s1->year );
+   hash = bufr_dedup_mix( hash, s1->month );
+   hash = bufr_dedup_mix( hash, s1->day );
+   hash = bufr_dedup_mix( hash, s1->hour );
+   hash = bufr_dedup_mix( hash, s1->minute );
+   hash = bufr_dedup_mix( hash, s1->second );
+   len = bufr_dedup_heading( msg->header_string, heading, sizeof(heading) );
+   if (len > 0)
+      return bufr_dedup_hash( hash, (const unsigned char *)heading, len );
+
+   hash = bufr_dedup_mix( hash, msg->s3.no_data_subsets );
+   len = arr_count( msg->s3.desc_list );
+   descs = (len > 0) ? (int *)arr_get( msg->s3.desc_list, 0 ) : NULL;
+   for (i = 0; i < len ; i++)
+      hash = bufr_dedup_mix( hash, descs[i] );
+   return hash;
+   }
+
+/**
+ * @english
+ * @brief check a message against the recent ones, and remember it
+ *
+ * A duplicate or a stale message is not remembered; a new message or a
+ * correction is. As its identity may be shared by other bulletins, a
+ * message without a heading is never stale, a lower update of it is
+ * new. Messages older than the window before now, or beyond the
+ * capacity, are forgotten first.
+ * @param dd  the set of recent messages
+ * @param msg  the message, as read
+ * @param now  time of arrival in seconds, never decreasing
+ * @param id  what identifies the message to the caller
+ * @param superseded  if not NULL, receives the id of the recent message
+ *        it duplicates, corrects or is superseded by, else -1
+ * @return DEDUP_NEW, DEDUP_DUPLICATE, DEDUP_CORRECTION or DEDUP_STALE
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_dedup_message( BufrDedup *dd, BUFR_Message *msg, int64_t now, long id, long *superseded )
+   {
+   BufrDedupEntry  *e, *latest;
+   uint64_t         fingerprint, identity;
+   char             heading[32];
+   int              i, upd;
+
+   if (superseded) *superseded = -1;
+   ++dd->nb_checked;
+   bufr_dedup_expire( dd, now );
+
+   fingerprint = bufr_message_fingerprint( msg );
+   for (i = dd->fp_heads[fingerprint & (dd->nb_buckets - 1)]; i >= 0 ; i = e->next_fp)
+      {
+      e = &(dd->entries[i]);
+      if (e->fingerprint == fingerprint)
+         {
+         if (superseded) *superseded = e->id;
+         ++dd->nb_duplicates;
+         return DEDUP_DUPLICATE;
+         }
+      }
+/*
+ * the highest update of the same bulletin
+ */
+   identity = bufr_message_identity( msg );
+   upd = msg->s1.upd_seq_no;
+   latest = NULL;
+   for (i = dd->id_heads[identity & (dd->nb_buckets - 1)]; i >= 0 ; i = e->next_id)
+      {
+      e = &(dd->entries[i]);
+      if ((e->identity == identity)&&((latest == NULL)||(e->upd_seq_no > latest->upd_seq_no)))
+         latest = e;
+      }
+   if (latest && (latest->upd_seq_no > upd)&&
+       (bufr_dedup_heading( msg->header_string, heading, sizeof(heading) ) == 0))
+      latest = NULL;
+   if (latest && (latest->upd_seq_no > upd))
+      {
+      if (superseded) *superseded = latest->id;
+      ++dd->nb_stale;
+      return DEDUP_STALE;
+      }
+
+   bufr_dedup_insert( dd, fingerprint, identity, upd, now, id );
+   if (latest && (latest->upd_seq_no < upd))
+      {
+      if (superseded) *superseded = latest->id;
+      ++dd->nb_corrections;
+      return DEDUP_CORRECTION;
+      }
+   return DEDUP_NEW;
+   }
+
+/**
+ * @english
+ * @brief read the next message that is neither a duplicate nor stale
+ *
+ * Same as bufr_read_message, the time of arrival is the current time
+ * and the id of a message is its rank in the stream, from 1.
+ * @param dd  the set of recent messages
+ * @param fp  the stream
+ * @param rtrn  receives the message
+ * @return same as bufr_read_message
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_read_message
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_dedup_read_message( BufrDedup *dd, FILE *fp, BUFR_Message **rtrn )
+   {
+   BUFR_Message  *msg;
+   long           superseded;
+   int            rc, status;
+   char           errmsg[256];
+
+   while ((rc = bufr_read_message( fp, &msg )) > 0)
+      {
+      status = bufr_dedup_message( dd, msg, (int64_t)time( NULL ), dd->nb_checked + 1, &superseded );
+      if ((status == DEDUP_NEW)||(status == DEDUP_CORRECTION))
+         {
+         if ((status == DEDUP_CORRECTION)&& bufr_is_verbose())
+            {
+            sprintf( errmsg, _("Message %ld corrects message %ld\n"), dd->nb_checked, superseded );
+            bufr_print_debug( errmsg );
+            }
+         *rtrn = msg;
+         return rc;
+         }
+      if (bufr_is_verbose())
+         {
+         sprintf( errmsg, (status == DEDUP_DUPLICATE) ? _("Message %ld duplicates message %ld\n") :
+                  _("Message %ld is superseded by message %ld\n"), dd->nb_checked, superseded );
+         bufr_print_debug( errmsg );
+         }
+      bufr_free_message( msg );
+      }
+   *rtrn = NULL;
+   return rc;
+   }
+
+/**
+ * @english
+ * FNV-1a hash of octets
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_dedup_hash( uint64_t hash, const unsigned char *data, int len )
+   {
+   int  i;
+
+   for (i = 0; i < len ; i++)
+      {
+      hash ^= data[i];
+      hash *= FNV_PRIME;
+      }
+   return hash;
+   }
+
+/**
+ * @english
+ * mix an integer into a hash, on 8 octets
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_dedup_mix( uint64_t hash, int64_t value )
+   {
+   int  i;
+
+   for (i = 0; i < 8 ; i++)
+      {
+      hash ^= (uint64_t)((value >> (i*8)) & 0xff);
+      hash *= FNV_PRIME;
+      }
+   return hash;
+   }
+
+/**
+ * @english
+ * the TTAAii CCCC YYGGgg heading of a bulletin, without its BBB group
+ * nor the control characters around it
+ * @return the length of the heading, 0 if none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_dedup_heading( const char *str, char *dst, int size )
+   {
+   const char  *words[3]={NULL,NULL,NULL};
+   int          lens[3]={0,0,0};
+   int          nb, len, n;
+
+   dst[0] = '\0';
+   if (str == NULL) return 0;
+/*
+ * words of letters and digits, control characters were kept as \ooo
+ */
+   nb = 0;
+   while (*str)
+      {
+      if (*str == '\\')
+         {
+         for (++str, n = 0; (n < 3)&& isdigit( (unsigned char)*str ) ; n++) ++str;
+         continue;
+         }
+      if (!isalnum( (unsigned char)*str ))
+         {
+         ++str;
+         continue;
+         }
+      for (len = 0; isalnum( (unsigned char)str[len] ) ; len++) ;
+      if (nb == 0)
+         {
+         if ((len == 6)&& isupper( (unsigned char)str[0] )&& isupper( (unsigned char)str[1] )&&
+             isdigit( (unsigned char)str[4] )&& isdigit( (unsigned char)str[5] ))
+            {
+            words[nb] = str;
+            lens[nb++] = len;
+            }
+         }
+      else if (((nb == 1)&&(len == 4))||((nb == 2)&&(len == 6)))
+         {
+         words[nb] = str;
+         lens[nb++] = len;
+         if (nb == 3) break;
+         }
+      else
+         {
+         nb = 0;
+         continue;
+         }
+      str += len;
+      }
+   if ((nb < 3)||(lens[0] + lens[1] + lens[2] + 3 > size)) return 0;
+
+   return sprintf( dst, "%.*s %.*s %.*s", lens[0], words[0], lens[1], words[1], lens[2], words[2] );
+   }
+
+/**
+ * @english
+ * forget the messages that arrived before the window
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_dedup_expire( BufrDedup *dd, int64_t now )
+   {
+   while ((dd->count > 0)&&(dd->entries[dd->first].seen < now - dd->window))
+      bufr_dedup_drop_first( dd );
+   }
+
+/**
+ * @english
+ * forget the oldest message, unlinking it from both hash tables
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_dedup_drop_first( BufrDedup *dd )
+   {
+   BufrDedupEntry  *e;
+   int             *link;
+
+   e = &(dd->entries[dd->first]);
+   for (link = &(dd->fp_heads[e->fingerprint & (dd->nb_buckets - 1)]); *link != dd->first ;
+        link = &(dd->entries[*link].next_fp)) ;
+   *link = e->next_fp;
+   for (link = &(dd->id_heads[e->identity & (dd->nb_buckets - 1)]); *link != dd->first ;
+        link = &(dd->entries[*link].next_id)) ;
+   *link = e->next_id;
+
+   dd->first = (dd->first + 1) % dd->capacity;
+   --dd->count;
+   }
+
+/**
+ * @english
+ * remember a message, forgetting the oldest one when full
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_dedup_insert( BufrDedup *dd, uint64_t fingerprint, uint64_t identity,
+                               int upd_seq_no, int64_t now, long id )
+   {
+   BufrDedupEntry  *e;
+   int              i, bucket;
+
+   if (dd->count == dd->capacity)
+      bufr_dedup_drop_first( dd );
+
+   i = (dd->first + dd->count) % dd->capacity;
+   e = &(dd->entries[i]);
+   e->fingerprint = fingerprint;
+   e->identity = identity;
+   e->upd_seq_no = upd_seq_no;
+   e->seen = now;
+   e->id = id;
+   bucket = fingerprint & (dd->nb_buckets - 1);
+   e->next_fp = dd->fp_heads[bucket];
+   dd->fp_heads[bucket] = i;
+   bucket = identity & (dd->nb_buckets - 1);
+   e->next_id = dd->id_heads[bucket];
+   dd->id_heads[bucket] = i;
+   ++dd->count;
+   }
@@ -39,12 +39,18 @@ This file is part of libECBUFR.
 #include "bufr_value.h"
 #include "bufr_i18n.h"
 #include "private/gcmemory.h"
+#include "private/bufr_priv_thread.h"
 #include "config.h"
 
 static void * BufrDescriptor_gcmemory=NULL;
+/*
+ * advanced whenever an encoding is changed in place, see bufr_structure_stamp
+ */
+static int    structure_stamp=0;
 
 
 static int bufr_check_class31_set( BufrDescriptor *cb );
+static void bufr_copy_descriptor_fields( BufrDescriptor *dest, BufrDescriptor *src );
 static void print_set_value_error( BufrDescriptor *cb, char *valstr );
 
 /**
@@ -203,7 +209,49 @@ BufrDescriptor  *bufr_dupl_descriptor( BufrDescriptor *dup )
    code->afd                = NULL;
    code->value              = NULL;
    code->meta               = NULL;
-   bufr_copy_descriptor( code, dup );
+   bufr_copy_descriptor_fields( code, dup );
+   return code;
+   }
+
+/**
+ * @english
+ * @brief Creates a copy of a BUFR code structure for a datasubset.
+ *
+ * Like bufr_dupl_descriptor, but the runtime meta-data of the original
+ * is shared instead of copied; it is copied on write only if the datasubset
+ * diverges from the template (replication, location or qualifiers).
+ * Used by the decoder to instantiate the template of each datasubset.
+ *
+ * @param dup code to duplicate
+ * @return BufrDescriptor pointer, to be cleared with bufr_free_descriptor
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_dupl_descriptor, bufr_unshare_rtmd
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+BufrDescriptor  *bufr_share_descriptor( BufrDescriptor *dup )
+   {
+   BufrDescriptor     *code;
+
+   if (dup == NULL) return NULL;
+
+#if USE_GCMEMORY
+   code = gcmem_alloc(BufrDescriptor_gcmemory);
+#else
+   code = (BufrDescriptor *)malloc(sizeof(BufrDescriptor));
+#endif
+   code->descriptor         = dup->descriptor;
+   code->flags              = dup->flags;
+   code->encoding           = dup->encoding;
+   code->repl_rank          = dup->repl_rank;
+   code->s_descriptor       = dup->s_descriptor;
+   code->etb                = dup->etb;
+   code->value              = dup->value ? bufr_duplicate_value( dup->value ) : NULL;
+   code->afd                = bufr_share_afd( dup->afd );
+   code->meta               = bufr_share_rtmd( dup->meta );
    return code;
    }
 
@@ -256,6 +304,23 @@ void bufr_free_descriptor( BufrDescriptor *code )
  * @ingroup descriptor
  */
 void bufr_copy_descriptor( BufrDescriptor *dest, BufrDescriptor *src )
+   {
+   bufr_copy_descriptor_fields( dest, src );
+   bufr_structure_changed();
+   }
+
+/**
+ * @english
+ * copy a descriptor into another, a new one being left out of the
+ * structure stamp
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor internal
+ */
+static void bufr_copy_descriptor_fields( BufrDescriptor *dest, BufrDescriptor *src )
    {
    dest->descriptor         = src->descriptor;
    dest->flags              = src->flags;
@@ -271,10 +336,7 @@ void bufr_copy_descriptor( BufrDescriptor *dest, BufrDescriptor *src )
 
    if (dest->afd)
       bufr_free_afd( dest->afd );
-   if (src->afd)
-      dest->afd = bufr_duplicate_afd( src->afd );
-   else
-      dest->afd = NULL;
+   dest->afd = bufr_share_afd( src->afd );
 
    if (dest->meta)
       bufr_free_rtmd( dest->meta );
@@ -286,6 +348,66 @@ void bufr_copy_descriptor( BufrDescriptor *dest, BufrDescriptor *src )
    dest->etb = src->etb;
    }
 
+/**
+ * @english
+ * @brief change the encoding of a descriptor
+ *
+ * Signatures of the datasubsets are computed again after this call.
+ * @param bdsc the descriptor
+ * @param be its new encoding
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_datasubset_signature
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+void bufr_descriptor_set_encoding( BufrDescriptor *bdsc, const BufrValueEncoding *be )
+   {
+   if ((bdsc == NULL)||(be == NULL)) return;
+
+   memcpy( &(bdsc->encoding), be, sizeof(BufrValueEncoding) );
+   bufr_structure_changed();
+   }
+
+/**
+ * @english
+ * @brief current structure stamp
+ *
+ * The stamp is advanced each time the encoding of a descriptor is
+ * changed through bufr_descriptor_set_encoding or bufr_copy_descriptor,
+ * a signature computed at an older stamp may be stale.
+ * @return the stamp
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_structure_changed, bufr_datasubset_signature
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor internal
+ */
+int bufr_structure_stamp( void )
+   {
+   return BUFR_ATOMIC_LOAD( &structure_stamp );
+   }
+
+/**
+ * @english
+ * @brief advance the structure stamp
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_structure_stamp
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor internal
+ */
+void bufr_structure_changed( void )
+   {
+   BUFR_ATOMIC_INCR( &structure_stamp );
+   }
+
 /**
  * @english
  * @endenglish
@@ -544,7 +666,7 @@ int bufr_descriptor_get_range ( BufrDescriptor *cb, double *min, double *max )
          return 0;
       }
 
-   scale_factor = pow(10.0,(double)cb->encoding.scale);
+   scale_factor = bufr_pow10( cb->encoding.scale );
    imax = (1ULL << cb->encoding.nbits) - 1;
 
    x = DESC_TO_X( cb->descriptor );
@@ -873,7 +995,7 @@ static int bufr_check_class31_set( BufrDescriptor *cb )
  * @endfrancais
  * @author Vanh Souvanlasy
  * @ingroup descriptor
- * @bug where's bufr_code_get_bitsvalue?
+ * @see bufr_descriptor_get_bitsvalue
  */
 int bufr_descriptor_set_bitsvalue ( BufrDescriptor *cb , uint64_t ival )
    {
@@ -927,7 +1049,10 @@ int bufr_descriptor_set_bitsvalue ( BufrDescriptor *cb , uint64_t ival )
       else if (cb->value->type == VALTYPE_FLT64)
          {
          double dval = bufr_cvt_i64_to_dval( &(cb->encoding), ival );
-         bufr_value_set_double( cb->value, dval );
+         if (iv == -1)
+            bufr_value_set_double( cb->value, dval );
+         else
+            bufr_value_set_scaled( cb->value, iv + cb->encoding.reference, cb->encoding.scale, dval );
          }
       }
    else if (cb->encoding.type == TYPE_CHNG_REF_VAL_OP)
@@ -942,6 +1067,160 @@ int bufr_descriptor_set_bitsvalue ( BufrDescriptor *cb , uint64_t ival )
    return 1;
    }
 
+/**
+ * @english
+ * @brief Get the value of a numeric descriptor as a scaled integer.
+ *
+ * The scaled integer is the value multiplied by 10^scale of the descriptor
+ * encoding (cb->encoding.scale), ie. the decoded bits plus the reference.
+ * A temperature of Table B scale 2 is returned in 0.01 K. Decoded values
+ * keep this integer so no floating point conversion is done; values that
+ * were assigned as reals are converted.
+ * @param cb the descriptor
+ * @param scaled output, value * 10^scale
+ * @return 1 if a value is returned, 0 if it is missing, -1 if the
+ * descriptor is not numeric
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_set_scaled, bufr_descriptor_get_bitsvalue
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+int bufr_descriptor_get_scaled ( BufrDescriptor *cb, int64_t *scaled )
+   {
+   int64_t   iv;
+   uint64_t  ival;
+   int       scale;
+   double    dval;
+
+   if ((cb == NULL)||(cb->value == NULL)) return -1;
+
+   switch ( cb->encoding.type )
+      {
+      case TYPE_NUMERIC :
+      case TYPE_CODETABLE :
+      case TYPE_FLAGTABLE :
+      break;
+      default :
+         return -1;
+      }
+
+   switch ( cb->value->type )
+      {
+      case VALTYPE_INT8 :
+      case VALTYPE_INT32 :
+      case VALTYPE_INT64 :
+         iv = bufr_value_get_int64( cb->value );
+         if (iv == -1) return 0;
+         *scaled = iv;
+         return 1;
+      case VALTYPE_FLT64 :
+         if (bufr_value_get_scaled( cb->value, scaled, &scale )&&(scale == cb->encoding.scale))
+            return 1;
+         break;
+      default :
+         break;
+      }
+
+   dval = bufr_value_get_double( cb->value );
+   if (bufr_is_missing_double( dval )) return 0;
+   ival = bufr_cvt_dval_to_i64( cb->descriptor, &(cb->encoding), dval );
+   if (ival == bufr_missing_ivalue( cb->encoding.nbits )) return 0;
+   *scaled = (int64_t)ival + cb->encoding.reference;
+   return 1;
+   }
+
+/**
+ * @english
+ * @brief Get the value of a numeric descriptor as its encoded bits.
+ *
+ * This is the scaled integer minus the reference, as stored in the message.
+ * @param cb the descriptor
+ * @param bits output, all bits set if the value is missing
+ * @return 1 if a value is returned, 0 if it is missing, -1 if the
+ * descriptor is not numeric
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_get_scaled, bufr_descriptor_set_bitsvalue
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+int bufr_descriptor_get_bitsvalue ( BufrDescriptor *cb, uint64_t *bits )
+   {
+   int64_t  scaled;
+   int      rtrn;
+
+   rtrn = bufr_descriptor_get_scaled( cb, &scaled );
+   if (rtrn > 0)
+      *bits = scaled - cb->encoding.reference;
+   else if (rtrn == 0)
+      *bits = bufr_missing_ivalue( cb->encoding.nbits );
+   return rtrn;
+   }
+
+/**
+ * @english
+ * @brief Assign a pre-scaled integer to a numeric descriptor.
+ *
+ * The integer is the value multiplied by 10^scale of the descriptor
+ * encoding, it is range checked against the encoding with integer
+ * arithmetic and encoded as is, without the floating point round trip
+ * of bufr_descriptor_set_dvalue. Use bufr_descriptor_set_dvalue with
+ * bufr_missing_double() to assign a missing value.
+ * @param cb the descriptor
+ * @param scaled value * 10^scale
+ * @return 1 on success, -1 if out of range or the descriptor is not numeric
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_descriptor_get_scaled
+ * @author Vanh Souvanlasy
+ * @ingroup descriptor
+ */
+int bufr_descriptor_set_scaled ( BufrDescriptor *cb, int64_t scaled )
+   {
+   int64_t   bits;
+   uint64_t  msng;
+   char      errmsg[256];
+
+   if (bufr_check_class31_set( cb )) return -1;
+
+   switch ( cb->encoding.type )
+      {
+      case TYPE_NUMERIC :
+      case TYPE_CODETABLE :
+      case TYPE_FLAGTABLE :
+      break;
+      default :
+         return -1;
+      }
+
+   msng = bufr_missing_ivalue( cb->encoding.nbits );
+   bits = scaled - cb->encoding.reference;
+   if ((bits < 0)||((uint64_t)bits >= msng))
+      {
+      sprintf( errmsg, _("Warning: The scaled value %lld of descriptor %d is out of range [%lld,%lld]\n"),
+               (long long)scaled, cb->descriptor, (long long)cb->encoding.reference,
+               (long long)(msng - 1 + cb->encoding.reference) );
+      bufr_print_debug( errmsg );
+      return -1;
+      }
+
+   if (cb->value == NULL)
+      cb->value = bufr_mkval_for_descriptor( cb );
+   if (cb->value == NULL) return -1;
+
+   if (cb->value->type == VALTYPE_FLT64)
+      return bufr_value_set_scaled( cb->value, scaled, cb->encoding.scale,
+                                    bufr_cvt_i64_to_dval( &(cb->encoding), bits ) );
+   return bufr_descriptor_set_bitsvalue( cb, bits );
+   }
+
 /**
  * @english
  * @brief This function stores a string value with a BUFR code structure.
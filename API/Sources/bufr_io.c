@@ -33,6 +33,7 @@ This file is part of libECBUFR.
 #include <errno.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "bufr_util.h"
 #include "bufr_array.h"
@@ -44,8 +45,21 @@ This file is part of libECBUFR.
 
 #define DEBUG  0
 
+/*
+ * a file being read, with where the message found in it starts
+ */
+typedef struct
+   {
+   FILE      *fp;
+   long       nread;       /* OCTETS READ SO FAR */
+   long       start;       /* OCTETS BEFORE "BUFR", -1 UNTIL FOUND */
+   uint32_t   last4;       /* LAST 4 OCTETS READ */
+   } BufrFileReader;
+
 static FILE *debug_fp=NULL;
 static char *debug_filename=NULL;
+/* messages of threads working together go to the same debug file */
+static pthread_mutex_t  debug_lock=PTHREAD_MUTEX_INITIALIZER;
 static void (*udf_debug)(const char *msg) = NULL;
 static FILE *output_fp=NULL;
 static char *output_filename=NULL;
@@ -91,6 +105,8 @@ static uint64_t  bufr_rd_section4 ( bufr_read_callback readcb,
 static int   bufr_rd_section5 ( bufr_read_callback readcb, void *cd );
 
 static int   bufr_seek_msg_start( bufr_read_callback readcb, void *cd, char **tagstr, int *len );
+static ssize_t bufr_read_fn     ( void *client_data, size_t ilen, char *buffer );
+static ssize_t bufr_file_read_fn ( void *client_data, size_t len, char *buffer );
 static int   bufr_wr_header_string ( bufr_write_callback writecb, void *cd, BUFR_Message *bufr );
 
 /**
@@ -900,13 +916,17 @@ void bufr_putbits ( BUFR_Message *bufr, uint64_t v1, int nbbits)
 
 /**
  * @english
- * @todo translate
+ * append a bit stream to section 4, used to concatenate sections
+ * encoded separately; the destination need not be byte aligned
+ * @param    bufr : the BUFR message being encoded
+ * @param    str  : the bits, most significant bit of str[0] first
+ * @param    nbbits : number of bits to append
  * @endenglish
  * @francais
  * ajouter des bits comme donnees
  * @param    bufr : la structure de donnees BUFR
  * @param    str  : la valeur contenue dans une chaine de caract.
- * @param    nbbits : nombre de bits (max: 32)
+ * @param    nbbits : nombre de bits
  * @endfrancais
  * @author Vanh Souvanlasy
  * @ingroup internal
@@ -914,76 +934,82 @@ void bufr_putbits ( BUFR_Message *bufr, uint64_t v1, int nbbits)
 void bufr_put_bitstream ( BUFR_Message *bufr, const unsigned char *str, int nbbits)
    {
 	unsigned char *ptrData ;
-	int            valeur ;
-	int            p1 ;
-	int            nbit_take, nbit_left, nbit_shift, nbit_move ;
-   int            nbit_remain;
-   int           bitno ;
-   int           pos;
+   unsigned char  c;
+   int            bitno ;
+   int            i, nbytes, nbit_left;
+
+   if (nbbits <= 0) return;
 
+   nbytes = nbbits / 8;
+   nbit_left = nbbits % 8;
 /*
  * agrandir l'allocation de la section 4 si necessaire
 
 */
-   if ((bufr->s4.filled+(nbbits/8+4096)) >= bufr->s4.max_data_len) 
+   if ((bufr->s4.filled + nbytes + 2) >= bufr->s4.max_data_len) 
       {
-      bufr_alloc_sect4( bufr, bufr->s4.max_data_len + 4096 );
+      bufr_alloc_sect4( bufr, bufr->s4.filled + nbytes + 4096 );
       }
 
 	ptrData = bufr->s4.current;
 	bitno = bufr->s4.bitno;
-   pos = 0;
-	valeur = str[pos++] ;
-	if ( bitno == 0 ) *ptrData = 0 ;
-
 /*
- * inserer par tranche de 8 bits / insert by group of 8 bits 
-
-*/
-   nbit_remain = (nbbits >= 8) ? 8 : nbbits ;
-	p1  = bitno % 8 ;
-	nbit_take = nbbits < (8-p1) ? nbbits : (8-p1) ;
-	nbit_left = nbbits - nbit_take ;
-   nbit_remain = nbit_remain - nbit_take;
-   nbit_shift= nbit_remain;
-	nbit_move = 8 -  bitno - nbit_take ;
-	*ptrData |= ( ( valeur >> nbit_shift ) & ( (1ULL<<nbit_take) -1 ) ) << nbit_move ;
-   bitno = (bitno + nbit_take) % 8;
-/*
- * repeter l'insertion si le nombre de bits est plus grand que 8
- * repeat insertion if number of bits to insert is greater than 8 
-
-*/
-	while ( nbit_left > 0 )
+ * copie directe si aligne, sinon decaler chaque octet sur 2 octets
+ * plain copy when aligned, else each byte is shifted over 2 bytes
+ */
+   if (bitno == 0)
       {
-      if (bitno == 0)
-         {
-		   ++ptrData;
-		   *ptrData = 0 ;
-         bufr->s4.filled += 1;
-         }
-      if (nbit_remain == 0)
+      memcpy( ptrData, str, nbytes );
+      ptrData += nbytes;
+      }
+   else
+      {
+      for (i = 0; i < nbytes ; i++)
          {
-         valeur = str[pos++];
-         nbit_remain = (nbit_left < 8) ? nbit_left : 8;
+         c = str[i];
+         *ptrData++ |= c >> bitno;
+         *ptrData = (unsigned char)(c << (8 - bitno));
          }
-		nbit_take = nbit_remain;
-      nbit_remain -= nbit_take;
-		nbit_left -= nbit_take ;
-      nbit_shift= 0;
-		nbit_move = 8 - nbit_take ;
-		*ptrData = ( ( valeur >> nbit_shift ) & ( (1ULL<<nbit_take) -1 ) ) << nbit_move ;
-      bitno = nbit_take % 8;
       }
+   bufr->s4.filled += nbytes;
+	bufr->s4.current = ptrData;
 
-   if (bitno == 0)
+   if (nbit_left > 0)
+      bufr_putbits( bufr, str[nbytes] >> (8 - nbit_left), nbit_left );
+   }
+
+/**
+ * @english
+ * append bits taken from a section 4 buffer starting at any bit position,
+ * neither the source nor the destination need be byte aligned
+ * @param    bufr : the BUFR message being encoded
+ * @param    data : section 4 data holding the bits
+ * @param    bitpos : position of the first bit in data
+ * @param    nbbits : number of bits to append
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+void bufr_put_bitrange( BUFR_Message *bufr, const unsigned char *data, uint64_t bitpos, uint64_t nbbits )
+   {
+   int   lead;
+
+   if ((bufr->s4.filled + nbbits / 8 + 2) >= bufr->s4.max_data_len) 
+      bufr_alloc_sect4( bufr, bufr->s4.filled + nbbits / 8 + 4096 );
+
+   data += bitpos / 8;
+   lead = (8 - (int)(bitpos % 8)) % 8;
+   if (lead > 0)
       {
-		++ptrData;
-		*ptrData = 0 ;
-      bufr->s4.filled += 1;
+      if ((uint64_t)lead > nbbits) lead = nbbits;
+      bufr_putbits( bufr, (data[0] >> (8 - (bitpos % 8) - lead)) & ((1 << lead) - 1), lead );
+      nbbits -= lead;
+      data += 1;
       }
-   bufr->s4.bitno = bitno;
-	bufr->s4.current = ptrData;
+   bufr_put_bitstream( bufr, data, nbbits );
    }
 
 /**
@@ -1161,11 +1187,13 @@ void bufr_print_debug(const char *msg)
 	*/
    if (msg == NULL)
       {
+      pthread_mutex_lock( &debug_lock );
       if (debug_fp)
          {
          fclose( debug_fp );
          debug_fp = NULL;
          }
+      pthread_mutex_unlock( &debug_lock );
       }
 	else if( udf_debug )
 		{
@@ -1173,6 +1201,7 @@ void bufr_print_debug(const char *msg)
 		}
 	else if (debug_filename || debug_fp )
 		{
+		pthread_mutex_lock( &debug_lock );
 		if (debug_fp == NULL)
 			{
 			debug_fp = fopen( debug_filename, "a+" );
@@ -1184,6 +1213,7 @@ void bufr_print_debug(const char *msg)
 			/* debug/error output shouldn't be buffered */
 			fflush( debug_fp );
 			}
+		pthread_mutex_unlock( &debug_lock );
 		}
 	else
 		{
@@ -1711,12 +1741,44 @@ static ssize_t bufr_read_fn( void *client_data, size_t ilen, char *buffer)
 	return got;
 	}
 
+/**
+ * @english
+ * internal callback to read from a file, that also finds where the
+ * first "BUFR" read starts, as bufr_seek_msg_start reads up to it
+ * @param     client_data : a BufrFileReader
+ * @param     len : number of bytes to read
+ * @param     buffer : data buffer to read into
+ * @return     number of bytes read
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static ssize_t bufr_file_read_fn( void *client_data, size_t len, char *buffer )
+   {
+   BufrFileReader  *rd=(BufrFileReader *)client_data;
+   ssize_t          i, rc;
+
+   rc = bufr_read_fn( rd->fp, len, buffer );
+   for (i = 0; (rd->start < 0)&&(i < rc) ; i++)
+      {
+      rd->last4 = (rd->last4 << 8) | (unsigned char)buffer[i];
+      if ((rd->last4 == 0x42554652)&&(rd->nread + i >= 3))  /* "BUFR" */
+         rd->start = rd->nread + i - 3;
+      }
+   if (rc > 0) rd->nread += rc;
+   return rc;
+   }
+
 /**
  * @english
  *    rtrn = bufr_read_message( fpBufr, &msg )
  *    (FILE *fpBufr, BUFR_Message **rtrn)
  * This is a low-level I/O call to read all sections of the BUFR message
- * from 0 to 5. 
+ * from 0 to 5. Where the message starts in the file, past any header
+ * preceding it, is kept in offset, or -1 if the file is not seekable.
  * @warning When the message is no longer needed, the storage should be
  * freed by calling bufr_free_message.
  * @return int, It returns a flag code for errors that would be greater
@@ -1737,8 +1799,18 @@ int bufr_read_message( FILE *fp, BUFR_Message **rtrn )
 	int rc;
 	fpos_t pos;
 	int seekable = !fgetpos( fp, &pos );
+   BufrFileReader  rd;
+   long            where;
+
    if (feof( fp )) return 0;
-	rc = bufr_callback_read_message( bufr_read_fn, (void*) fp, rtrn );
+   where    = ftell( fp );
+   rd.fp    = fp;
+   rd.nread = 0;
+   rd.start = -1;
+   rd.last4 = 0;
+	rc = bufr_callback_read_message( bufr_file_read_fn, (void*) &rd, rtrn );
+   if (rc > 0)
+      (*rtrn)->offset = ((where >= 0)&&(rd.start >= 0)) ? where + rd.start : -1;
 	if( rc <= 0 && seekable )
 		{
 		/* if fgetpos worked and the message read failed, try to
@@ -23,10 +23,23 @@ This file is part of libECBUFR.
 #include <stdlib.h>
 #include "bufr_linklist.h"
 #include "private/gcmemory.h"
+#include "private/bufr_priv_pool.h"
 #include "config.h"
 
 static void *  ListNode_gcmemory=NULL;
 
+static void    lst_forget_index( LinkedList *clst, int nb );
+
+#if (!USE_GCMEMORY)
+/*
+ * Without the garbage collector, nodes are carved out of contiguous chunks
+ * so that the nodes of a sequence built in one pass sit next to each other
+ * in memory, and allocation is a pointer pop instead of a malloc.
+ */
+static BufrPool                  ListNode_pool=BUFR_POOL_INITIALIZER(sizeof(ListNode),1024);
+static BUFR_THREAD_LOCAL BufrPoolCache  ListNode_cache;
+#endif
+
 
 /**************************************************************************
  ***NOM: *lst_newlist()
@@ -54,6 +67,9 @@ LinkedList *lst_newlist(void)
    tmp->last = tmp->first = NULL;
    tmp->nb_node = 0; /* indique le nombre de noeud dans la liste */
    tmp->name = NULL;
+   tmp->index = NULL;
+   tmp->nb_index = 0;
+   tmp->max_index = 0;
    return( tmp );
    }
 
@@ -89,7 +105,8 @@ ListNode * lst_newnode(void *data)
 
    tmp = gcmem_alloc(ListNode_gcmemory);
 #else
-   if ((tmp = (ListNode *) malloc(sizeof(ListNode))) == NULL) 
+   tmp = (ListNode *)bufr_pool_alloc( &ListNode_pool, &ListNode_cache );
+   if (tmp == NULL)
       {
       perror( "malloc" );
       exit(1);
@@ -128,6 +145,7 @@ void lst_addfirst( LinkedList *clst, ListNode *node)
    if (( node == NULL )||( clst == NULL ))
       return;
 
+   lst_forget_index( clst, 0 );
    if ( clst->first == NULL )
       {
       clst->last = clst->first = node;
@@ -342,8 +360,10 @@ void lst_addafter( LinkedList *clst, ListNode *after, ListNode *node)
       } 
    else 
       {
+      lst_forget_index( clst, 0 );
       node->next = after->next;
       node->prev = after;
+      after->next->prev = node;
       after->next = node;
       clst->nb_node += 1;
       }
@@ -385,6 +405,7 @@ void lst_addbefore( LinkedList *clst, ListNode *b4, ListNode *node)
       } 
    else 
       {
+      lst_forget_index( clst, 0 );
       node->next = b4;
       node->prev = b4->prev;
       b4->prev->next = node;
@@ -419,6 +440,7 @@ ListNode *lst_rmfirst(LinkedList *clst)
    if ( clst == NULL ) return( NULL );
    if ( clst->first == NULL ) return( NULL );
 
+   lst_forget_index( clst, 0 );
    tmp = clst->first;
    clst->first = tmp->next;
 
@@ -466,6 +488,7 @@ ListNode * lst_rmafter(LinkedList *clst, ListNode * node)
    if (( node == NULL )||( clst == NULL ) || ( node->next == NULL ))
       return( NULL );
 
+   lst_forget_index( clst, 0 );
    if ( node->next == clst->last ) clst->last = node;
 
    tmp = node->next;
@@ -510,6 +533,7 @@ ListNode * lst_rmnode(LinkedList *clst, ListNode * node)
       return lst_rmlast( clst );
    else
       {
+      lst_forget_index( clst, 0 );
       node->prev->next = node->next;
       node->next->prev = node->prev;
       node->next = NULL;
@@ -552,15 +576,13 @@ ListNode * lst_rmlast( LinkedList *clst)
       return( tmp );
       }
    /*
-    * deplacer jusqu'a l'avant dernier de la liste 
+    * l'avant dernier est connu par le lien arriere
     */
-   for ( tmp = clst->first ; tmp->next->next != NULL ; tmp = tmp->next )
-      ;
-
-   clst->last = tmp;
-   tmp = tmp->next;
+   tmp = clst->last;
+   clst->last = tmp->prev;
    clst->last->next = NULL;
    clst->nb_node -= 1;
+   lst_forget_index( clst, clst->nb_node );
    tmp->next = NULL;
    tmp->prev = NULL;
    return ( tmp );
@@ -576,6 +598,9 @@ ListNode * lst_rmlast( LinkedList *clst)
  *LANGAGE: C
  *
  *OBJET: retourner un pointeur sur le noeud a la position
+ *       les noeuds parcourus sont gardes dans l'index de la liste, un
+ *       acces suivant a une position deja vue ne parcourt plus la liste;
+ *       l'index etant modifie, la liste ne peut etre partagee entre fils
  *      
  *LIBRAIRIES: 
  *
@@ -592,6 +617,7 @@ ListNode * lst_rmlast( LinkedList *clst)
 ListNode * lst_nodepos(LinkedList *clst, int pos)
    {
    ListNode *    current;
+   ListNode **   index;
    int          i;
 
    if ( clst == NULL ) return NULL;
@@ -600,17 +626,74 @@ ListNode * lst_nodepos(LinkedList *clst, int pos)
       {
       return ( NULL );
       }
+   /*
+    * la position est deja connue de l'index
+    */
+   if ( pos <= clst->nb_index )
+      return ( clst->index[pos-1] );
+   /*
+    * sinon prolonger l'index jusqu'a la position, en poursuivant le
+    * parcours la ou il s'etait arrete
+    */
+   if ( clst->max_index < clst->nb_node )
+      {
+      index = (ListNode **)realloc( clst->index, clst->nb_node * sizeof(ListNode *) );
+      if ( index != NULL )
+         {
+         clst->index = index;
+         clst->max_index = clst->nb_node;
+         }
+      }
+   if ( pos <= clst->max_index )
+      {
+      current = ( clst->nb_index > 0 ) ? clst->index[clst->nb_index-1]->next : clst->first;
+      for ( ; (clst->nb_index < pos)&&(current != NULL) ; current = current->next )
+         clst->index[clst->nb_index++] = current;
+      return ( clst->index[clst->nb_index-1] );
+      }
    else 
       {
       /*
-       * Parcourir jusqu'a la position desiree
+       * sans index, parcourir jusqu'a la position desiree, depuis l'extremite la plus proche
        */
+      if ( pos > clst->nb_node / 2 )
+         {
+         for ( current = clst->last, i = clst->nb_node; (i>pos)&&(current->prev != NULL ) ;
+               i-- , current = current->prev );
+         return ( current );
+         }
       for ( current = clst->first, i = 1; (i<pos)&&(current->next != NULL ) ;
             i++ , current = current->next );
       return ( current );
       }
    }
 
+/**************************************************************************
+ ***NOM: lst_forget_index
+ *
+ *AUTEUR: Souvanlasy Viengsavanh
+ *
+ *REVISION: AUCUN
+ *
+ *LANGAGE: C
+ *
+ *OBJET: ne garder de l'index des positions que les nb premiers noeuds,
+ *       ceux qui n'ont pas bouge apres une modification de la liste
+ *      
+ *LIBRAIRIES: 
+ *
+ *ARGUMENTS: 
+ *
+ *    LinkedList    *clst : pointeur sur la liste chainee 
+ *    int            nb   : nombre de positions encore valides
+ **
+--------------------------------------------------------------------------*/
+static void lst_forget_index( LinkedList *clst, int nb )
+   {
+   if ( clst->nb_index > nb )
+      clst->nb_index = nb;
+   }
+
 /**************************************************************************
  ***NOM: lst_dellist
  *
@@ -645,6 +728,9 @@ void lst_dellist( LinkedList *clst )
    if (clst->name)
       free( clst->name );
 
+   if (clst->index)
+      free( clst->index );
+
    free( clst );
    }
 
@@ -676,7 +762,7 @@ void lst_delnode(ListNode *tmp)
 #if USE_GCMEMORY
    gcmem_dealloc( ListNode_gcmemory,  (caddr_t)tmp );
 #else
-   free( tmp );
+   bufr_pool_free( &ListNode_pool, &ListNode_cache, tmp );
 #endif
    }
 
@@ -705,6 +791,13 @@ int lst_movelist(LinkedList *dest, ListNode *after, LinkedList *src )
    {
    if ((src->last == NULL)&&(src->first == NULL)) return 0;
 
+   /*
+    * seul un ajout a la fin de dest laisse son index valide
+    */
+   if ((after == NULL)||(after != dest->last))
+      lst_forget_index( dest, 0 );
+   lst_forget_index( src, 0 );
+
    if ((dest->last == NULL)&&(dest->first == NULL)) 
       {                              /* dest is empty */
       dest->last = src->last;
@@ -975,6 +1068,10 @@ void bufr_linklist_end(void)
       sprintf( errmsg, "GCMEM used %d ListNode, blocs size=%d\n", size, isize );
       bufr_print_output( errmsg );
       }
+#else
+/*
+ * chunks are not released here: lists may still be freed after this call
+ */
 #endif
    }
 
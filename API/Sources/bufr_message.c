@@ -80,6 +80,7 @@ BUFR_Message *bufr_create_message(int edition)
    r->header_string   = NULL;
    r->header_len      = 0;
    r->enforce         = BUFR_WARN_ALLOW;
+   r->offset          = -1;
    bufr_init_header( r, edition );
    return r;
    }
@@ -650,8 +651,13 @@ void bufr_set_gmtime(BufrSection1 *s1)
 void bufr_set_time_sect1( BufrSection1 *s1, time_t temps )
    {
    struct  tm *gmt;
+   struct  tm  tms;
 
+#if defined(__MINGW32__)
    gmt = gmtime( &temps );
+#else
+   gmt = gmtime_r( &temps, &tms );
+#endif
 
    s1->year = gmt->tm_year + 1900;
    s1->month = gmt->tm_mon+1;
@@ -33,6 +33,7 @@ This file is part of libECBUFR.
 #include "bufr_meta.h"
 #include "bufr_desc.h"
 #include "bufr_value.h"
+#include "private/bufr_priv_thread.h"
 
 
 /**
@@ -69,6 +70,7 @@ BufrRTMD  *bufr_create_rtmd( int count )
 		}
 
    bm->pos_template = -1;
+   bm->refcount = 1;
 
    return bm;
    }
@@ -174,6 +176,8 @@ void bufr_copy_rtmd( BufrRTMD *dest, BufrRTMD *src )
  */
 void bufr_free_rtmd( BufrRTMD *rtmd )
    {
+   if (BUFR_ATOMIC_DECR( &(rtmd->refcount) ) > 0) return;
+
    if (rtmd->nesting)
       {
       free( rtmd->nesting );
@@ -196,6 +200,59 @@ void bufr_free_rtmd( BufrRTMD *rtmd )
    free( rtmd );
    }
 
+/**
+ * @english
+ *
+ * Add a reference to a BufrRTMD object so that it can be held by the
+ * descriptors of several datasubsets, each released with bufr_free_rtmd.
+ *
+ * @warning A shared object must not be modified, call bufr_unshare_rtmd
+ * before writing to it.
+ * @param rtmd  pointer to object to share
+ * @return the same pointer
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+BufrRTMD *bufr_share_rtmd( BufrRTMD *rtmd )
+   {
+   if (rtmd) BUFR_ATOMIC_INCR( &(rtmd->refcount) );
+   return rtmd;
+   }
+
+/**
+ * @english
+ *
+ * Obtain a BufrRTMD object that may be modified: the object itself if it
+ * is not shared, otherwise a private copy and the reference to the shared
+ * one is released.
+ *
+ * @param rtmd  pointer to the object about to be modified
+ * @return (BufrRTMD *)
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+BufrRTMD *bufr_unshare_rtmd( BufrRTMD *rtmd )
+   {
+   BufrRTMD *bm;
+
+   if ((rtmd == NULL)||(BUFR_ATOMIC_LOAD( &(rtmd->refcount) ) <= 1)) return rtmd;
+
+   bm = bufr_duplicate_rtmd( rtmd );
+/*
+ * the other holders may have let it go meanwhile
+ */
+   bufr_free_rtmd( rtmd );
+   return bm;
+   }
+
 /**
  * @english
  *  
@@ -0,0 +1,223 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_pool.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: reserves de cellules de taille fixe
+ *
+ * Cells are carved out of contiguous chunks and recycled through a free
+ * list private to each thread, so that allocating and freeing take no
+ * lock. A thread keeps at most two chunks worth of free cells: beyond
+ * that, cells are given back to the pool in batches that other threads
+ * reuse before any new chunk is allocated. The pool thus never grows
+ * beyond what was in use at once, even when cells are freed by another
+ * thread than the one that allocated them. Chunks are kept until the
+ * process ends.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "config.h"
+#include "private/bufr_priv_pool.h"
+
+static void  bufr_pool_register    ( BufrPool *pool, BufrPoolCache *cache );
+static int   bufr_pool_refill      ( BufrPool *pool, BufrPoolCache *cache );
+static void  bufr_pool_spill       ( BufrPool *pool, BufrPoolCache *cache );
+static void  bufr_pool_thread_exit ( void *arg );
+
+/**
+ * @english
+ * obtain a cell from the free list of the current thread
+ * @param  pool   pool of cells
+ * @param  cache  thread local free list of that pool
+ * @return pointer to a cell of pool->cell_size bytes, NULL if out of memory
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+void *bufr_pool_alloc( BufrPool *pool, BufrPoolCache *cache )
+   {
+   BufrPoolCell *cell;
+
+   if (cache->pool == NULL) bufr_pool_register( pool, cache );
+   if (cache->free == NULL)
+      {
+      if (bufr_pool_refill( pool, cache ) < 0) return NULL;
+      }
+   cell = cache->free;
+   cache->free = cell->next;
+   cache->nfree--;
+   return cell;
+   }
+
+/**
+ * @english
+ * put back a cell in the free list of the current thread, giving a
+ * batch back to the pool when that list gets too long
+ * @param  pool   pool of cells
+ * @param  cache  thread local free list of that pool
+ * @param  cell   cell obtained from bufr_pool_alloc, by any thread
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+void bufr_pool_free( BufrPool *pool, BufrPoolCache *cache, void *cell )
+   {
+   BufrPoolCell *c = (BufrPoolCell *)cell;
+
+   if (cache->pool == NULL) bufr_pool_register( pool, cache );
+   c->next = cache->free;
+   cache->free = c;
+   if (++cache->nfree > 2 * pool->chunk_cells)
+      bufr_pool_spill( pool, cache );
+   }
+
+/**
+ * @english
+ * attach the free list of the current thread to the pool, so that its
+ * cells are given back when the thread exits
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_pool_register( BufrPool *pool, BufrPoolCache *cache )
+   {
+   pthread_mutex_lock( &(pool->lock) );
+   if (!pool->has_key)
+      {
+      pthread_key_create( &(pool->key), bufr_pool_thread_exit );
+      pool->has_key = 1;
+      }
+   pthread_mutex_unlock( &(pool->lock) );
+
+   cache->pool = pool;
+   pthread_setspecific( pool->key, cache );
+   }
+
+/**
+ * @english
+ * refill the free list of the current thread with a batch given back
+ * by another thread, or with a newly allocated chunk
+ * @return 0 on success, -1 if out of memory
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_pool_refill( BufrPool *pool, BufrPoolCache *cache )
+   {
+   BufrPoolCell *batch;
+   char         *chunk;
+   long          i;
+
+   pthread_mutex_lock( &(pool->lock) );
+   if (pool->batches)
+      {
+      batch = pool->batches;
+      pool->batches = batch->batch;
+      pthread_mutex_unlock( &(pool->lock) );
+      cache->free = batch;
+      cache->nfree = batch->count;
+      return 0;
+      }
+   pool->nchunks++;
+   pthread_mutex_unlock( &(pool->lock) );
+
+   chunk = (char *)malloc( pool->chunk_cells * pool->cell_size );
+   if (chunk == NULL) return -1;
+   for ( i = 0 ; i < pool->chunk_cells-1 ; i++ )
+      ((BufrPoolCell *)(chunk + i * pool->cell_size))->next =
+            (BufrPoolCell *)(chunk + (i+1) * pool->cell_size);
+   ((BufrPoolCell *)(chunk + i * pool->cell_size))->next = NULL;
+   cache->free = (BufrPoolCell *)chunk;
+   cache->nfree = pool->chunk_cells;
+   return 0;
+   }
+
+/**
+ * @english
+ * keep one chunk worth of free cells in the list of the current thread
+ * and give the others back to the pool as one batch
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_pool_spill( BufrPool *pool, BufrPoolCache *cache )
+   {
+   BufrPoolCell *last, *batch;
+   long          i;
+
+   last = cache->free;
+   for ( i = 1 ; i < pool->chunk_cells ; i++ )
+      last = last->next;
+   batch = last->next;
+   last->next = NULL;
+   batch->count = cache->nfree - pool->chunk_cells;
+   cache->nfree = pool->chunk_cells;
+
+   pthread_mutex_lock( &(pool->lock) );
+   batch->batch = pool->batches;
+   pool->batches = batch;
+   pthread_mutex_unlock( &(pool->lock) );
+   }
+
+/**
+ * @english
+ * give back the free cells of a terminating thread to its pool
+ * @param  arg  thread local free list of the pool
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_pool_thread_exit( void *arg )
+   {
+   BufrPoolCache *cache = (BufrPoolCache *)arg;
+   BufrPool      *pool = cache->pool;
+   BufrPoolCell  *batch = cache->free;
+
+   cache->pool = NULL;
+   if (batch == NULL) return;
+
+   batch->count = cache->nfree;
+   cache->free = NULL;
+   cache->nfree = 0;
+
+   pthread_mutex_lock( &(pool->lock) );
+   batch->batch = pool->batches;
+   pool->batches = batch;
+   pthread_mutex_unlock( &(pool->lock) );
+   }
@@ -0,0 +1,605 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_query.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: requetes de recherche compilees sur les datasubsets
+ *
+ * A query is a disjunction of groups of terms, each term a sequence of
+ * keys as given to bufr_subset_find_values. The values of plain keys are
+ * converted once, and the positions where the descriptors of each term
+ * match are found once per structure of datasubset: a subset is then
+ * matched by checking values at those positions only. Terms with keys
+ * on qualifiers, location or callbacks use bufr_subset_find_values.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bufr_array.h"
+#include "bufr_desc.h"
+#include "bufr_value.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+#include "bufr_query.h"
+#include "bufr_api.h"
+#include "bufr_i18n.h"
+
+#define  QUERY_PLANS_MAX   64
+
+static void           bufr_query_compile_key  ( BufrQueryKey *ck, BufrDescValue *key );
+static void           bufr_query_free_plans   ( BufrQuery *query );
+static BufrQueryPlan *bufr_query_plan         ( BufrQuery *query, DataSubset *subset );
+static int            bufr_query_match_term   ( BufrQueryTerm *term, BufrQueryPlan *plan, int t,
+                                                DataSubset *subset );
+static int            bufr_query_key_match    ( BufrQueryKey *ck, BufrDescriptor *cb );
+
+/**
+ * @english
+ * @brief create an empty query, which matches any datasubset
+ * @return the query, to free with bufr_free_query
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_add_term, bufr_query_or
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+BufrQuery *bufr_create_query( void )
+   {
+   BufrQuery  *query;
+
+   query = (BufrQuery *)malloc( sizeof(BufrQuery) );
+   query->terms     = arr_create( 16, sizeof(BufrQueryTerm), 16 );
+   query->nb_groups = 0;
+   query->plans     = arr_create( 16, sizeof(BufrQueryPlan *), 16 );
+   query->last_plan = 0;
+   return query;
+   }
+
+/**
+ * @english
+ * @brief free a query, the keys of its terms are not freed
+ * @param query  the query
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+void bufr_free_query( BufrQuery *query )
+   {
+   BufrQueryTerm  *terms;
+   int             i, k, count;
+
+   if (query == NULL) return;
+
+   bufr_query_free_plans( query );
+   arr_free( &(query->plans) );
+
+   count = arr_count( query->terms );
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   for (i = 0; i < count ; i++)
+      {
+      if (terms[i].ckeys == NULL) continue;
+      for (k = 0; k < terms[i].nb_keys ; k++)
+         {
+         if (terms[i].ckeys[k].ivals) free( terms[i].ckeys[k].ivals );
+         if (terms[i].ckeys[k].fvals) free( terms[i].ckeys[k].fvals );
+         if (terms[i].ckeys[k].dvals) free( terms[i].ckeys[k].dvals );
+         }
+      free( terms[i].ckeys );
+      }
+   arr_free( &(query->terms) );
+   free( query );
+   }
+
+/**
+ * @english
+ * @brief add a term to the current group of a query
+ *
+ * A term matches a datasubset as bufr_subset_find_values would, all the
+ * terms of a group must match. The keys are kept by reference, they must
+ * not change nor be freed while the query is used.
+ * @param query  the query
+ * @param keys  search keys as given to bufr_subset_find_values
+ * @param nb  number of keys
+ * @return number of terms of the query
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_or
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_query_add_term( BufrQuery *query, BufrDescValue *keys, int nb )
+   {
+   BufrQueryTerm  term;
+   int            k;
+
+   if ((query == NULL)||(nb < 0)) return -1;
+
+   if (query->nb_groups == 0) query->nb_groups = 1;
+   term.keys    = keys;
+   term.nb_keys = nb;
+   term.group   = query->nb_groups - 1;
+   term.ckeys   = NULL;
+   for (k = 0; k < nb ; k++)
+      if (!bufr_is_table_b( keys[k].descriptor )) break;
+   if ((k == nb)&&(nb > 0))
+      {
+      term.ckeys = (BufrQueryKey *)malloc( nb * sizeof(BufrQueryKey) );
+      for (k = 0; k < nb ; k++)
+         bufr_query_compile_key( &(term.ckeys[k]), &(keys[k]) );
+      }
+/*
+ * plans hold the positions of each term
+ */
+   bufr_query_free_plans( query );
+   arr_add( query->terms, (char *)&term );
+   return arr_count( query->terms );
+   }
+
+/**
+ * @english
+ * @brief start a new group of terms, matched when the previous ones are not
+ * @param query  the query
+ * @return number of groups of the query
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_add_term
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_query_or( BufrQuery *query )
+   {
+   BufrQueryTerm  *terms;
+   int             count;
+
+   if (query == NULL) return -1;
+
+   count = arr_count( query->terms );
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   if ((count > 0)&&(terms[count-1].group == query->nb_groups - 1))
+      ++query->nb_groups;
+   return query->nb_groups;
+   }
+
+/**
+ * @english
+ * @brief tell if a datasubset matches a query
+ *
+ * The positions of the terms are found at the first datasubset of each
+ * structure and kept in the query, which must not be shared between
+ * threads.
+ * @param query  the query
+ * @param subset  the datasubset
+ * @return 1 if it matches, else 0
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_select
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_query_match( BufrQuery *query, DataSubset *subset )
+   {
+   BufrQueryTerm  *terms;
+   BufrQueryPlan  *plan;
+   int             i, count, group, ok;
+
+   if (query == NULL) return 1;
+   count = arr_count( query->terms );
+   if (count == 0) return 1;
+   if (subset == NULL) return 0;
+
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   plan  = NULL;
+   group = terms[0].group;
+   ok    = 1;
+   for (i = 0; i < count ; i++)
+      {
+      if (terms[i].group != group)
+         {
+         if (ok) return 1;
+         group = terms[i].group;
+         ok = 1;
+         }
+      if (!ok) continue;
+
+      if (terms[i].ckeys == NULL)
+         {
+         ok = (bufr_subset_find_values( subset, terms[i].keys, terms[i].nb_keys, 0 ) >= 0);
+         }
+      else
+         {
+         if (plan == NULL) plan = bufr_query_plan( query, subset );
+         ok = bufr_query_match_term( &(terms[i]), plan, i, subset );
+         }
+      }
+   return ok;
+   }
+
+/**
+ * @english
+ * @brief match every datasubset of a dataset with a query
+ * @param query  the query
+ * @param dts  the dataset
+ * @param selected  receives 1 for each datasubset that matches, else 0
+ * @return number of datasubsets that match
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_match
+ * @author Vanh Souvanlasy
+ * @ingroup dataset
+ */
+int bufr_query_select( BufrQuery *query, BUFR_Dataset *dts, char *selected )
+   {
+   int  i, count, nb;
+
+   if (dts == NULL) return -1;
+
+   nb = 0;
+   count = bufr_count_datasubset( dts );
+   for (i = 0; i < count ; i++)
+      {
+      selected[i] = bufr_query_match( query, bufr_get_datasubset( dts, i ) ) ? 1 : 0;
+      if (selected[i]) ++nb;
+      }
+   return nb;
+   }
+
+/**
+ * @english
+ * @brief tell if any subset of a compressed message can match a query
+ *
+ * Each term is checked with bufr_block_index_may_match.
+ * @param query  the query
+ * @param idx  block index of the message
+ * @return 0 if no subset can match, 1 if some may
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_block_candidates
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_query_may_match_blocks( BufrQuery *query, BufrBlockIndex *idx )
+   {
+   BufrQueryTerm  *terms;
+   int             i, count, group, ok;
+
+   if ((query == NULL)||(idx == NULL)) return 1;
+   count = arr_count( query->terms );
+   if (count == 0) return 1;
+
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   group = terms[0].group;
+   ok    = 1;
+   for (i = 0; i < count ; i++)
+      {
+      if (terms[i].group != group)
+         {
+         if (ok) return 1;
+         group = terms[i].group;
+         ok = 1;
+         }
+      if (ok) ok = bufr_block_index_may_match( idx, terms[i].keys, terms[i].nb_keys );
+      }
+   return ok;
+   }
+
+/**
+ * @english
+ * @brief find the subsets of a compressed message that may match a query
+ *
+ * The candidates of the terms, from bufr_block_index_candidates, are
+ * and-ed within a group and or-ed between groups.
+ * @param query  the query
+ * @param idx  block index of the message
+ * @param candidates  receives 1 for each subset that may match, else 0
+ * @return number of candidates
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_query_may_match_blocks
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_query_block_candidates( BufrQuery *query, BufrBlockIndex *idx, char *candidates )
+   {
+   BufrQueryTerm  *terms;
+   char           *gcand, *tcand;
+   int             i, s, count, nb;
+
+   if (idx == NULL) return -1;
+
+   count = (query != NULL) ? arr_count( query->terms ) : 0;
+   if (count == 0)
+      {
+      memset( candidates, 1, idx->nb_subsets );
+      return idx->nb_subsets;
+      }
+
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   gcand = (char *)malloc( 2 * idx->nb_subsets );
+   tcand = gcand + idx->nb_subsets;
+   memset( candidates, 0, idx->nb_subsets );
+   for (i = 0; i < count ; i++)
+      {
+      if ((i == 0)||(terms[i].group != terms[i-1].group))
+         memset( gcand, 1, idx->nb_subsets );
+      bufr_block_index_candidates( idx, terms[i].keys, terms[i].nb_keys, tcand );
+      for (s = 0; s < idx->nb_subsets ; s++)
+         gcand[s] &= tcand[s];
+      if ((i == count-1)||(terms[i+1].group != terms[i].group))
+         {
+         for (s = 0; s < idx->nb_subsets ; s++)
+            candidates[s] |= gcand[s];
+         }
+      }
+   free( gcand );
+
+   nb = 0;
+   for (s = 0; s < idx->nb_subsets ; s++)
+      if (candidates[s]) ++nb;
+   return nb;
+   }
+
+/**
+ * @english
+ * convert the values of a plain key for each numeric type of BufrValue,
+ * two values are a range as in bufr_subset_find_values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_query_compile_key( BufrQueryKey *ck, BufrDescValue *key )
+   {
+   int  k;
+
+   ck->key   = key;
+   ck->ivals = NULL;
+   ck->fvals = NULL;
+   ck->dvals = NULL;
+   if (key->nbval <= 0)
+      {
+      ck->kind = QUERY_KEY_ANY;
+      return;
+      }
+   if (key->nbval == 2)
+      {
+      ck->kind = QUERY_KEY_RANGE;
+      return;
+      }
+   ck->kind  = QUERY_KEY_IN;
+   ck->ivals = (int32_t *)malloc( key->nbval * sizeof(int32_t) );
+   ck->fvals = (float *)malloc( key->nbval * sizeof(float) );
+   ck->dvals = (double *)malloc( key->nbval * sizeof(double) );
+   for (k = 0; k < key->nbval ; k++)
+      {
+      ck->ivals[k] = bufr_value_get_int32( key->values[k] );
+      ck->fvals[k] = bufr_value_get_float( key->values[k] );
+      ck->dvals[k] = bufr_value_get_double( key->values[k] );
+      }
+   }
+
+/**
+ * @english
+ * free the positions kept for each structure
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_query_free_plans( BufrQuery *query )
+   {
+   BufrQueryPlan **plans;
+   int             i, count;
+
+   count = arr_count( query->plans );
+   plans = (BufrQueryPlan **)arr_get( query->plans, 0 );
+   for (i = 0; i < count ; i++)
+      {
+      free( plans[i]->first );
+      free( plans[i]->starts );
+      free( plans[i] );
+      }
+   arr_del( query->plans, count );
+   query->last_plan = 0;
+   }
+
+/**
+ * @english
+ * the positions of the plain terms for the structure of a datasubset,
+ * found once and kept by signature
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrQueryPlan *bufr_query_plan( BufrQuery *query, DataSubset *subset )
+   {
+   BufrQueryPlan   **plans, *plan;
+   BufrQueryTerm    *terms;
+   BufrDescriptor  **pcb;
+   const int        *positions;
+   IntArray          starts;
+   uint64_t          signature;
+   int               count, nb_plans, nb_terms;
+   int               i, j, n, p, t;
+
+   signature = bufr_datasubset_signature( subset );
+   count = bufr_datasubset_count_descriptor( subset );
+   nb_plans = arr_count( query->plans );
+   plans = (BufrQueryPlan **)arr_get( query->plans, 0 );
+   for (i = 0; i < nb_plans ; i++)
+      {
+      plan = plans[(query->last_plan + i) % nb_plans];
+      if ((plan->signature == signature)&&(plan->count == count))
+         {
+         query->last_plan = (query->last_plan + i) % nb_plans;
+         return plan;
+         }
+      }
+/*
+ * too many structures, start over
+ */
+   if (nb_plans >= QUERY_PLANS_MAX)
+      bufr_query_free_plans( query );
+
+   nb_terms = arr_count( query->terms );
+   terms = (BufrQueryTerm *)arr_get( query->terms, 0 );
+   pcb = (BufrDescriptor **)arr_get( subset->data, 0 );
+   starts = arr_create( 64, sizeof(int), 64 );
+
+   plan = (BufrQueryPlan *)malloc( sizeof(BufrQueryPlan) );
+   plan->signature = signature;
+   plan->count     = count;
+   plan->first     = (int *)malloc( (nb_terms + 1) * sizeof(int) );
+   for (t = 0; t < nb_terms ; t++)
+      {
+      plan->first[t] = arr_count( starts );
+      if (terms[t].ckeys == NULL) continue;
+
+      n = bufr_datasubset_find_positions( subset, terms[t].keys[0].descriptor, 0, &positions );
+      for (i = 0; (n < 0) ? (i < count) : (i < n) ; i++)
+         {
+         p = (n < 0) ? i : positions[i];
+         if (p + terms[t].nb_keys > count) break;
+         for (j = 0; j < terms[t].nb_keys ; j++)
+            if (pcb[p+j]->descriptor != terms[t].keys[j].descriptor) break;
+         if (j == terms[t].nb_keys)
+            arr_add( starts, (char *)&p );
+         }
+      }
+   plan->first[nb_terms] = n = arr_count( starts );
+   plan->starts = (int *)malloc( (n > 0 ? n : 1) * sizeof(int) );
+   if (n > 0)
+      memcpy( plan->starts, arr_get( starts, 0 ), n * sizeof(int) );
+   arr_free( &starts );
+
+   arr_add( query->plans, (char *)&plan );
+   query->last_plan = arr_count( query->plans ) - 1;
+   return plan;
+   }
+
+/**
+ * @english
+ * check the values of a plain term at the positions where its
+ * descriptors match
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_query_match_term( BufrQueryTerm *term, BufrQueryPlan *plan, int t, DataSubset *subset )
+   {
+   BufrDescriptor  **pcb;
+   int               i, j, p;
+
+   pcb = (BufrDescriptor **)arr_get( subset->data, 0 );
+   for (i = plan->first[t]; i < plan->first[t+1] ; i++)
+      {
+      p = plan->starts[i];
+      for (j = 0; j < term->nb_keys ; j++)
+         {
+         if (pcb[p+j]->descriptor != term->keys[j].descriptor) break;
+         if (!bufr_query_key_match( &(term->ckeys[j]), pcb[p+j] )) break;
+         }
+      if (j == term->nb_keys) return 1;
+      }
+   return 0;
+   }
+
+/**
+ * @english
+ * compare the value of a descriptor with a plain key exactly as
+ * bufr_compare_value and bufr_between_values would
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_query_key_match( BufrQueryKey *ck, BufrDescriptor *cb )
+   {
+   BufrDescValue  *key;
+   double          eps;
+   int32_t         ival;
+   float           fval;
+   double          dval;
+   int             k;
+
+   if (ck->kind == QUERY_KEY_ANY) return 1;
+   if (cb->value == NULL) return 0;
+
+   key = ck->key;
+   if (ck->kind == QUERY_KEY_RANGE)
+      return (bufr_between_values( key->values[0], cb->value, key->values[1] ) == 1);
+
+   eps = 0.5 / bufr_pow10( cb->encoding.scale );
+   switch( cb->value->type )
+      {
+      case VALTYPE_INT8 :
+      case VALTYPE_INT32 :
+         ival = bufr_value_get_int32( cb->value );
+         for (k = 0; k < key->nbval ; k++)
+            if (ival == ck->ivals[k]) return 1;
+         break;
+      case VALTYPE_FLT32 :
+         fval = bufr_value_get_float( cb->value );
+         for (k = 0; k < key->nbval ; k++)
+            if (fabsf( fval - ck->fvals[k] ) <= eps) return 1;
+         break;
+      case VALTYPE_FLT64 :
+         dval = bufr_value_get_double( cb->value );
+         for (k = 0; k < key->nbval ; k++)
+            if (fabs( dval - ck->dvals[k] ) <= eps) return 1;
+         break;
+      default :
+         for (k = 0; k < key->nbval ; k++)
+            if (bufr_compare_value( cb->value, key->values[k], eps ) == 0) return 1;
+         break;
+      }
+   return 0;
+   }
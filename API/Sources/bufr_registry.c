@@ -0,0 +1,539 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_registry.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: registre de tables BUFR rechargeables a chaud
+ *
+ * Readers acquire the current snapshot and keep it for the duration of
+ * their work; a reload builds a complete new snapshot without holding any
+ * lock, then only swaps the published pointer. A retired snapshot is freed
+ * by whoever drops its last reference.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "config.h"
+#if HAVE_SYS_INOTIFY_H
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+#include "bufr_api.h"
+#include "bufr_io.h"
+#include "bufr_i18n.h"
+#include "bufr_registry.h"
+#include "private/bufr_priv_thread.h"
+
+struct bufr_registry_priv
+   {
+   pthread_mutex_t  lock;
+   pthread_mutex_t  reload_lock;
+   int              watching;
+   pthread_t        watcher;
+   int              ifd;
+   int              stop_pipe[2];
+   };
+
+static BufrTablesSnapshot *bufr_registry_build   ( BUFR_TablesRegistry *reg );
+static void                bufr_free_snapshot    ( BufrTablesSnapshot *snap );
+static char               *bufr_registry_strdup  ( const char *str );
+
+/**
+ * @english
+ *    reg = bufr_create_tables_registry( path, tbnos, nb )
+ *    (const char *path, int tbnos[], int nb)
+ * Create a registry of BUFR tables that can be reloaded while other
+ * threads keep decoding. The tables are loaded exactly as
+ * bufr_load_tables_list would do with the same arguments, and the
+ * result is published as the first snapshot.
+ * @param path directory of the tables, NULL to use env. var. BUFR_TABLES
+ * @param tbnos  list of tables versions to load
+ * @param nb     number of versions in tbnos
+ * @return BUFR_TablesRegistry, or NULL if nothing could be loaded
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+BUFR_TablesRegistry *bufr_create_tables_registry( const char *path, int tbnos[], int nb )
+   {
+   BUFR_TablesRegistry *reg;
+
+   reg = (BUFR_TablesRegistry *)malloc( sizeof(BUFR_TablesRegistry) );
+   reg->path = bufr_registry_strdup( path );
+   reg->nb_tbnos = nb;
+   reg->tbnos = NULL;
+   if (nb > 0)
+      {
+      reg->tbnos = (int *)malloc( nb * sizeof(int) );
+      memcpy( reg->tbnos, tbnos, nb * sizeof(int) );
+      }
+   reg->ltableb_fn = NULL;
+   reg->ltabled_fn = NULL;
+   reg->generation = 0;
+   reg->current = NULL;
+
+   reg->priv = (struct bufr_registry_priv *)malloc( sizeof(struct bufr_registry_priv) );
+   pthread_mutex_init( &(reg->priv->lock), NULL );
+   pthread_mutex_init( &(reg->priv->reload_lock), NULL );
+   reg->priv->watching = 0;
+   reg->priv->ifd = -1;
+
+   if (bufr_registry_reload( reg ) < 0)
+      {
+      bufr_free_tables_registry( reg );
+      return NULL;
+      }
+   return reg;
+   }
+
+/**
+ * @english
+ *    bufr_free_tables_registry( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * Stop watching and drop the registry's reference to the current
+ * snapshot. Snapshots still acquired by readers stay valid and are
+ * freed by the last bufr_registry_release.
+ * @return void
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+void bufr_free_tables_registry( BUFR_TablesRegistry *reg )
+   {
+   if (reg == NULL) return;
+
+   bufr_registry_unwatch( reg );
+
+   if (reg->current)
+      {
+      if (BUFR_ATOMIC_DECR( &(reg->current->refcount) ) == 0)
+         bufr_free_snapshot( reg->current );
+      reg->current = NULL;
+      }
+
+   pthread_mutex_destroy( &(reg->priv->lock) );
+   pthread_mutex_destroy( &(reg->priv->reload_lock) );
+   free( reg->priv );
+
+   if (reg->path) free( reg->path );
+   if (reg->tbnos) free( reg->tbnos );
+   if (reg->ltableb_fn) free( reg->ltableb_fn );
+   if (reg->ltabled_fn) free( reg->ltabled_fn );
+   free( reg );
+   }
+
+/**
+ * @english
+ *    bufr_registry_set_local( reg, tableb_fn, tabled_fn )
+ *    (BUFR_TablesRegistry *reg, const char *tableb_fn, const char *tabled_fn)
+ * Define local Table B and D files to be added to every tables of the
+ * registry, as bufr_tables_list_addlocal does. This takes effect on the
+ * next call to bufr_registry_reload.
+ * @return void
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+void bufr_registry_set_local
+   ( BUFR_TablesRegistry *reg, const char *tableb_fn, const char *tabled_fn )
+   {
+   if (reg == NULL) return;
+
+   pthread_mutex_lock( &(reg->priv->reload_lock) );
+   if (reg->ltableb_fn) free( reg->ltableb_fn );
+   if (reg->ltabled_fn) free( reg->ltabled_fn );
+   reg->ltableb_fn = bufr_registry_strdup( tableb_fn );
+   reg->ltabled_fn = bufr_registry_strdup( tabled_fn );
+   pthread_mutex_unlock( &(reg->priv->reload_lock) );
+   }
+
+/**
+ * @english
+ *    bufr_registry_reload( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * Load a fresh set of tables and publish it as the current snapshot.
+ * Loading is done without blocking readers; only the swap of the
+ * published snapshot is serialized. The previous snapshot is freed as
+ * soon as no reader holds it anymore. If loading fails, the current
+ * snapshot stays in use.
+ * @return int, the new generation number, or -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+int bufr_registry_reload( BUFR_TablesRegistry *reg )
+   {
+   BufrTablesSnapshot *snap, *old;
+   int                 generation;
+   char                errmsg[256];
+
+   if (reg == NULL) return -1;
+/*
+ * only one reload at a time, readers are never blocked by this lock
+ */
+   pthread_mutex_lock( &(reg->priv->reload_lock) );
+   snap = bufr_registry_build( reg );
+   if (snap == NULL)
+      {
+      pthread_mutex_unlock( &(reg->priv->reload_lock) );
+      sprintf( errmsg, _("Error: failed to reload BUFR tables, keeping generation %d\n"),
+            reg->generation );
+      bufr_print_debug( errmsg );
+      return -1;
+      }
+
+   pthread_mutex_lock( &(reg->priv->lock) );
+   snap->generation = ++reg->generation;
+   generation = snap->generation;
+   old = reg->current;
+   reg->current = snap;
+/*
+ * drop the registry's own reference to the retired snapshot
+ */
+   if (old && (BUFR_ATOMIC_DECR( &(old->refcount) ) > 0)) old = NULL;
+   pthread_mutex_unlock( &(reg->priv->lock) );
+   pthread_mutex_unlock( &(reg->priv->reload_lock) );
+
+   if (old) bufr_free_snapshot( old );
+
+   if (bufr_is_verbose())
+      {
+      sprintf( errmsg, _("Info: BUFR tables generation %d published\n"), generation );
+      bufr_print_debug( errmsg );
+      }
+   return generation;
+   }
+
+/**
+ * @english
+ *    snap = bufr_registry_acquire( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * Obtain a reference to the current snapshot of tables. The tables
+ * found in snap->tables_list (see bufr_use_tables_list) remain valid
+ * until the snapshot is given back with bufr_registry_release, even
+ * if the registry is reloaded in the meantime.
+ * @return BufrTablesSnapshot
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+BufrTablesSnapshot *bufr_registry_acquire( BUFR_TablesRegistry *reg )
+   {
+   BufrTablesSnapshot *snap;
+
+   if (reg == NULL) return NULL;
+
+   pthread_mutex_lock( &(reg->priv->lock) );
+   snap = reg->current;
+   if (snap) BUFR_ATOMIC_INCR( &(snap->refcount) );
+   pthread_mutex_unlock( &(reg->priv->lock) );
+   return snap;
+   }
+
+/**
+ * @english
+ *    bufr_registry_release( reg, snap )
+ *    (BUFR_TablesRegistry *reg, BufrTablesSnapshot *snap)
+ * Give back a snapshot obtained by bufr_registry_acquire; a retired
+ * snapshot is freed here when this was its last reader. The registry
+ * itself is not used, so that this may follow bufr_free_tables_registry.
+ * @return void
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+void bufr_registry_release( BUFR_TablesRegistry *reg, BufrTablesSnapshot *snap )
+   {
+   if (snap == NULL) return;
+
+   if (BUFR_ATOMIC_DECR( &(snap->refcount) ) == 0)
+      bufr_free_snapshot( snap );
+   }
+
+/**
+ * @english
+ *    bufr_registry_generation( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * @return int, generation number of the current snapshot
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+int bufr_registry_generation( BUFR_TablesRegistry *reg )
+   {
+   int  generation;
+
+   if (reg == NULL) return -1;
+
+   pthread_mutex_lock( &(reg->priv->lock) );
+   generation = reg->generation;
+   pthread_mutex_unlock( &(reg->priv->lock) );
+   return generation;
+   }
+
+#if HAVE_SYS_INOTIFY_H
+/**
+ * @english
+ * watcher thread: reload the registry whenever a file is written or
+ * moved into one of the watched directories
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void *bufr_registry_watcher( void *arg )
+   {
+   BUFR_TablesRegistry *reg = (BUFR_TablesRegistry *)arg;
+   struct pollfd        fds[2];
+   char                 buf[4096];
+   ssize_t              len;
+
+   fds[0].fd = reg->priv->ifd;
+   fds[0].events = POLLIN;
+   fds[1].fd = reg->priv->stop_pipe[0];
+   fds[1].events = POLLIN;
+
+   while (poll( fds, 2, -1 ) >= 0)
+      {
+      if (fds[1].revents) break;
+      if (fds[0].revents & POLLIN)
+         {
+/*
+ * drain all pending events, an editor may generate several of them,
+ * then give it a moment to settle before reloading once
+ */
+         len = read( reg->priv->ifd, buf, sizeof(buf) );
+         if (len <= 0) break;
+         usleep( 100000 );
+         while (poll( fds, 1, 0 ) > 0)
+            {
+            if (read( reg->priv->ifd, buf, sizeof(buf) ) <= 0) break;
+            }
+         bufr_registry_reload( reg );
+         }
+      }
+   return NULL;
+   }
+
+/**
+ * @english
+ * add an inotify watch on the directory containing a file
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_registry_watch_dir( int ifd, const char *filename )
+   {
+   char  dirname[1024];
+   char *str;
+
+   strncpy( dirname, filename, sizeof(dirname)-1 );
+   dirname[sizeof(dirname)-1] = '\0';
+   str = strrchr( dirname, '/' );
+   if (str == NULL)
+      strcpy( dirname, "." );
+   else if (str == dirname)
+      str[1] = '\0';
+   else
+      str[0] = '\0';
+
+   return inotify_add_watch( ifd, dirname, IN_CLOSE_WRITE|IN_MOVED_TO );
+   }
+#endif
+
+/**
+ * @english
+ *    bufr_registry_watch( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * Start a thread watching the tables directory and the local tables
+ * files with inotify; any change triggers bufr_registry_reload.
+ * @return int, 0 if watching, -1 if unsupported or on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+int bufr_registry_watch( BUFR_TablesRegistry *reg )
+   {
+#if HAVE_SYS_INOTIFY_H
+   const char *path;
+   char        dirname[1024];
+   int         nbw = 0;
+
+   if (reg == NULL) return -1;
+   if (reg->priv->watching) return 0;
+
+   reg->priv->ifd = inotify_init();
+   if (reg->priv->ifd < 0) return -1;
+
+   path = reg->path ? reg->path : getenv( "BUFR_TABLES" );
+   if (path)
+      {
+      snprintf( dirname, sizeof(dirname), "%s/", path );
+      if (bufr_registry_watch_dir( reg->priv->ifd, dirname ) >= 0) ++nbw;
+      }
+   if (reg->ltableb_fn && (bufr_registry_watch_dir( reg->priv->ifd, reg->ltableb_fn ) >= 0)) ++nbw;
+   if (reg->ltabled_fn && (bufr_registry_watch_dir( reg->priv->ifd, reg->ltabled_fn ) >= 0)) ++nbw;
+
+   if ((nbw == 0)||(pipe( reg->priv->stop_pipe ) < 0))
+      {
+      close( reg->priv->ifd );
+      reg->priv->ifd = -1;
+      return -1;
+      }
+
+   if (pthread_create( &(reg->priv->watcher), NULL, bufr_registry_watcher, reg ) != 0)
+      {
+      close( reg->priv->stop_pipe[0] );
+      close( reg->priv->stop_pipe[1] );
+      close( reg->priv->ifd );
+      reg->priv->ifd = -1;
+      return -1;
+      }
+   reg->priv->watching = 1;
+   return 0;
+#else
+   bufr_print_debug( _("Warning: watching BUFR tables files is not supported\n") );
+   return -1;
+#endif
+   }
+
+/**
+ * @english
+ *    bufr_registry_unwatch( reg )
+ *    (BUFR_TablesRegistry *reg)
+ * Stop the thread started by bufr_registry_watch.
+ * @return void
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables
+ */
+void bufr_registry_unwatch( BUFR_TablesRegistry *reg )
+   {
+#if HAVE_SYS_INOTIFY_H
+   if ((reg == NULL)||(!reg->priv->watching)) return;
+
+   if (write( reg->priv->stop_pipe[1], "", 1 ) == 1)
+      pthread_join( reg->priv->watcher, NULL );
+   close( reg->priv->stop_pipe[0] );
+   close( reg->priv->stop_pipe[1] );
+   close( reg->priv->ifd );
+   reg->priv->ifd = -1;
+   reg->priv->watching = 0;
+#endif
+   }
+
+/**
+ * @english
+ * load a complete new snapshot of the tables described by the registry
+ * @return BufrTablesSnapshot, or NULL if no tables could be loaded
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrTablesSnapshot *bufr_registry_build( BUFR_TablesRegistry *reg )
+   {
+   BufrTablesSnapshot *snap;
+   LinkedList         *list;
+
+   list = bufr_load_tables_list( reg->path, reg->tbnos, reg->nb_tbnos );
+   if (list == NULL) return NULL;
+   if (lst_count( list ) == 0)
+      {
+      bufr_free_tables_list( list );
+      return NULL;
+      }
+
+   if (reg->ltableb_fn || reg->ltabled_fn)
+      bufr_tables_list_addlocal( list, reg->ltableb_fn, reg->ltabled_fn );
+
+   snap = (BufrTablesSnapshot *)malloc( sizeof(BufrTablesSnapshot) );
+   snap->tables_list = list;
+   snap->generation = 0;
+/*
+ * the registry itself holds one reference while the snapshot is current
+ */
+   snap->refcount = 1;
+   return snap;
+   }
+
+/**
+ * @english
+ * destroy a snapshot and all of its tables
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_free_snapshot( BufrTablesSnapshot *snap )
+   {
+   if (snap == NULL) return;
+   if (snap->tables_list)
+      bufr_free_tables_list( snap->tables_list );
+   free( snap );
+   }
+
+static char *bufr_registry_strdup( const char *str )
+   {
+   char *dup;
+
+   if (str == NULL) return NULL;
+   dup = (char *)malloc( strlen(str)+1 );
+   strcpy( dup, str );
+   return dup;
+   }
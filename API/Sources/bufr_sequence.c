@@ -28,6 +28,7 @@ This file is part of libECBUFR.
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "bufr_linklist.h"
 #include "bufr_array.h"
@@ -38,10 +39,14 @@ This file is part of libECBUFR.
 #include "bufr_io.h"
 #include "bufr_template.h"
 #include "bufr_i18n.h"
+#include "private/bufr_priv_thread.h"
 
 #define DEBUG         0
 #define TESTINDEX     0
 
+/* expansions done with RTMD enabled differ, keep them apart */
+#define XPND_META_ENABLED  0x100
+
 static int         bufr_is_dd_for_dpbm( BufrDescriptor *bcv );
 static void        bufr_change_af_sig( BufrDDOp *ddo , char *sig );
 static void        bufr_reassign_table2code( BufrDescriptor *bc, int f, EntryTableB *tb );
@@ -65,6 +70,26 @@ static void        free_rep_cnt_stack ( LinkedList *stack );
 static int         bufr_simple_check_seq( BUFR_Sequence *bsq, ListNode *node, int depth );
 static void        bufr_transfer_rtmd ( LinkedList *sublist, BufrRTMD *rtmd );
 
+/*
+ * a fully expanded Table D sequence, kept by the tables that produced it
+ * it is never modified once kept, and only freed by
+ * bufr_clear_tabled_expansions when the tables change
+ */
+typedef struct
+   {
+   int               descriptor;
+   int               flags;
+   int               count;
+   BufrDescriptor  **descs;
+   } BufrTableDExpansion;
+
+static int         compare_expansion      ( const void *p1, const void *p2 );
+static LinkedList *bufr_fetch_expansion   ( BUFR_Tables *tbls, int desc, int flags );
+static void        bufr_keep_expansion    ( BUFR_Tables *tbls, int desc, int flags, LinkedList *lst );
+
+/* expansions are kept and fetched by every thread using the tables */
+static pthread_mutex_t  TableD_expansions_lock=PTHREAD_MUTEX_INITIALIZER;
+
 extern int         bufr_debugmode;
 extern int         bufr_meta_enabled;
 
@@ -264,9 +289,19 @@ static LinkedList *bufr_expand_desc( int desc, int flags, BUFR_Tables *tbls, int
    int           code;
    BufrDescriptor  *bcd;
    int  f;
+   int  err=0;
 
    f = DESC_TO_F( desc );
    if (f != 3) return NULL;
+/*
+ * without decoding context, the expansion only depends on the tables
+ * and can be reused from a previous one
+ */
+   if (s4 == NULL)
+      {
+      lst = bufr_fetch_expansion( tbls, desc, flags );
+      if (lst) return lst;
+      }
 
    etblD = bufr_fetch_tableD( tbls, desc );
    if (etblD == NULL) 
@@ -309,12 +344,180 @@ static LinkedList *bufr_expand_desc( int desc, int flags, BUFR_Tables *tbls, int
       lst_addlast( lst, lst_newnode( bcd ) );
       }
 
-   lst1 = bufr_expand_list( lst, flags, tbls, errflg, s4 );
+   lst1 = bufr_expand_list( lst, flags, tbls, &err, s4 );
    if (lst1 == NULL)
       bufr_free_descriptorList( lst );
+   else if ((s4 == NULL)&&(err == 0))
+      bufr_keep_expansion( tbls, desc, flags, lst1 );
+   if (err && errflg) *errflg = err;
    return lst1;
    }
 
+/**
+ * @english
+ * order Table D expansions by descriptor then by expansion flags
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int compare_expansion( const void *p1, const void *p2 )
+   {
+   BufrTableDExpansion *r1 = *(BufrTableDExpansion **)p1;
+   BufrTableDExpansion *r2 = *(BufrTableDExpansion **)p2;
+
+   if (r1->descriptor < r2->descriptor) return -1;
+   if (r1->descriptor > r2->descriptor) return 1;
+   if (r1->flags < r2->flags) return -1;
+   if (r1->flags > r2->flags) return 1;
+   return 0;
+   }
+
+/**
+ * @english
+ * return an already expanded Table D sequence, or NULL
+ * if that sequence was never expanded with these flags.
+ * The list returned is spliced into a template or a datasubset whose
+ * descriptors receive their own values, flags and replication rank,
+ * so each descriptor gets its own head; its meta-data and associated
+ * fields stay shared with the kept expansion and are only copied
+ * when written (see bufr_unshare_rtmd).
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static LinkedList *bufr_fetch_expansion( BUFR_Tables *tbls, int desc, int flags )
+   {
+   BufrTableDExpansion   key, *pkey, **pxpn, *xpn;
+   LinkedList           *lst;
+   int                   i;
+
+   if (tbls == NULL) return NULL;
+
+   key.descriptor = desc;
+   key.flags = bufr_meta_enabled ? (flags | XPND_META_ENABLED) : flags;
+   pkey = &key;
+   pthread_mutex_lock( &TableD_expansions_lock );
+   pxpn = NULL;
+   if (tbls->tableD_expansions)
+      pxpn = (BufrTableDExpansion **)arr_search( tbls->tableD_expansions, (char *)&pkey, compare_expansion );
+   xpn = pxpn ? *pxpn : NULL;
+   pthread_mutex_unlock( &TableD_expansions_lock );
+/*
+ * a kept expansion is read only, it can be shared without the lock
+ */
+   if (xpn == NULL) return NULL;
+
+   lst = lst_newlist();
+   for (i = 0; i < xpn->count ; i++ )
+      lst_addlast( lst, lst_newnode( bufr_share_descriptor( xpn->descs[i] ) ) );
+   return lst;
+   }
+
+/**
+ * @english
+ * keep a fully expanded Table D sequence with the tables,
+ * sharing the meta-data of its descriptors
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_keep_expansion( BUFR_Tables *tbls, int desc, int flags, LinkedList *lst )
+   {
+   BufrTableDExpansion  *xpn, key, *pkey, **base;
+   ListNode             *node;
+   int                   i, count;
+
+   if (tbls == NULL) return;
+
+   pthread_mutex_lock( &TableD_expansions_lock );
+   if (tbls->tableD_expansions == NULL)
+      tbls->tableD_expansions = arr_create( 50, sizeof(BufrTableDExpansion *), 50 );
+/*
+ * another thread may have kept the same one meanwhile
+ */
+   key.descriptor = desc;
+   key.flags = bufr_meta_enabled ? (flags | XPND_META_ENABLED) : flags;
+   pkey = &key;
+   if (arr_search( tbls->tableD_expansions, (char *)&pkey, compare_expansion ) != NULL)
+      {
+      pthread_mutex_unlock( &TableD_expansions_lock );
+      return;
+      }
+
+   xpn = (BufrTableDExpansion *)malloc( sizeof(BufrTableDExpansion) );
+   xpn->descriptor = desc;
+   xpn->flags = key.flags;
+   xpn->count = lst_count( lst );
+   xpn->descs = (BufrDescriptor **)malloc( (xpn->count+1) * sizeof(BufrDescriptor *) );
+   node = lst_firstnode( lst );
+   for (i = 0; node ; i++ )
+      {
+      xpn->descs[i] = bufr_share_descriptor( (BufrDescriptor *)node->data );
+      node = lst_nextnode( node );
+      }
+
+/*
+ * insert in place so that the array stays sorted for arr_search
+ */
+   count = arr_count( tbls->tableD_expansions );
+   arr_add( tbls->tableD_expansions, (char *)&xpn );
+   base = (BufrTableDExpansion **)arr_get( tbls->tableD_expansions, 0 );
+   for (i = count; (i > 0)&&(compare_expansion( &base[i-1], &xpn ) > 0) ; i-- )
+      base[i] = base[i-1];
+   base[i] = xpn;
+   pthread_mutex_unlock( &TableD_expansions_lock );
+   }
+
+/**
+ * @english
+ *    bufr_clear_tabled_expansions( tbls )
+ *    (BUFR_Tables *tbls)
+ * Forget all Table D sequences expanded with these tables; this is
+ * needed whenever the content of the tables is changed.
+ * @return void
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup tables internal
+ */
+void bufr_clear_tabled_expansions( BUFR_Tables *tbls )
+   {
+   BufrTableDExpansion  **pxpn;
+   int                    i, j, count;
+
+   if (tbls == NULL) return;
+
+   pthread_mutex_lock( &TableD_expansions_lock );
+   if (tbls->tableD_expansions == NULL)
+      {
+      pthread_mutex_unlock( &TableD_expansions_lock );
+      return;
+      }
+   count = arr_count( tbls->tableD_expansions );
+   for (i = 0; i < count ; i++ )
+      {
+      pxpn = (BufrTableDExpansion **)arr_get( tbls->tableD_expansions, i );
+      for (j = 0; j < (*pxpn)->count ; j++ )
+         bufr_free_descriptor( (*pxpn)->descs[j] );
+      free( (*pxpn)->descs );
+      free( *pxpn );
+      }
+   arr_free( &(tbls->tableD_expansions) );
+   tbls->tableD_expansions = NULL;
+   pthread_mutex_unlock( &TableD_expansions_lock );
+   }
+
 /**
  * @english
  * @endenglish
@@ -528,8 +731,9 @@ LinkedList *bufr_expand_node_descriptor( LinkedList *list, ListNode *node, int f
       lst_dellist( sublist );
       }
 
-   if (cb->meta)
+   if (cb->meta && (cb->meta->len_expansion != *skip))
       {
+      cb->meta = bufr_unshare_rtmd( cb->meta );
       cb->meta->len_expansion = *skip;
       }
 
@@ -1130,6 +1334,38 @@ BUFR_Sequence *bufr_copy_sequence( BUFR_Sequence *bsq )
    return list;
    }
 
+/**
+ * @english
+ *    bsq2 = bufr_share_sequence( bsq )
+ *    (BUFR_Sequence *)
+ * Same as bufr_copy_sequence but each descriptor shares the runtime
+ * meta-data and associated field definition of the original, copied on
+ * write. This is what the decoder uses to instantiate each data subset.
+ * @return BUFR_Sequence
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_share_descriptor
+ * @author Vanh Souvanlasy
+ * @ingroup template internal
+ */
+BUFR_Sequence *bufr_share_sequence( BUFR_Sequence *bsq )
+   {
+   BUFR_Sequence *list;
+   ListNode *node;
+
+   list = bufr_create_sequence( NULL );
+
+   node = lst_firstnode( bsq->list );
+   while ( node )
+      {
+      bufr_add_descriptor_to_sequence( list, bufr_share_descriptor( (BufrDescriptor *)node->data ) );
+      node = lst_nextnode( node );
+      }
+   return list;
+   }
+
 /**
  * @english
  *  
@@ -1386,8 +1622,25 @@ int bufr_apply_tables2node
 
    if (cb->meta)
       {
-      if (cb->meta->tlc) free( cb->meta->tlc );
-      cb->meta->tlc = bufr_current_location( ddo, cb->meta, &(cb->meta->nb_tlc) );
+      LocationValue *tlc;
+      int            nb_tlc;
+
+      tlc = bufr_current_location( ddo, cb->meta, &nb_tlc );
+/*
+ * a meta shared with the template only needs its own copy if the location differs
+ */
+      if ((BUFR_ATOMIC_LOAD( &(cb->meta->refcount) ) > 1) && (nb_tlc == cb->meta->nb_tlc) &&
+          ((nb_tlc == 0) || (memcmp( tlc, cb->meta->tlc, nb_tlc * sizeof(LocationValue) ) == 0)))
+         {
+         if (tlc) free( tlc );
+         }
+      else
+         {
+         cb->meta = bufr_unshare_rtmd( cb->meta );
+         if (cb->meta->tlc) free( cb->meta->tlc );
+         cb->meta->tlc = tlc;
+         cb->meta->nb_tlc = nb_tlc;
+         }
       }
 
    switch ( cb->encoding.type )
@@ -1507,7 +1760,7 @@ int bufr_apply_tables2node
 
             if (ddo->change_ref_value != 0)
                {
-               cb->encoding.reference *= pow(10,ddo->change_ref_value);
+               cb->encoding.reference *= bufr_pow10( ddo->change_ref_value );
                cb->encoding.ref_nbits = bufr_value_nbits( cb->encoding.reference );
                if (debug)
                   {
@@ -0,0 +1,997 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_snapshot.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: images binaires d'un BUFR_Dataset decode
+ *
+ * A snapshot keeps a decoded dataset, its template, section 1, every
+ * descriptor of its datasubsets with its value, flags, associated field
+ * and run time meta data, as fixed size records written in bulk. It is
+ * read back by mapping the file in memory: the offsets of its parts are
+ * turned into pointers and the records are used in place, or made into
+ * a BUFR_Dataset again without decoding nor parsing any text.
+ * Associated field definitions and meta data shared by descriptors are
+ * written once and shared again when loaded.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_tables.h"
+#include "bufr_sequence.h"
+#include "bufr_dataset.h"
+#include "bufr_snapshot.h"
+#include "bufr_util.h"
+#include "bufr_i18n.h"
+
+#define  SNAP_ALIGN(n)   (((n) + 7) & ~((int64_t)7))
+
+/*
+ * growing buffer of a part of a snapshot
+ */
+typedef struct
+   {
+   char            *data;
+   size_t           len;
+   size_t           max;
+   } SnapBuffer;
+
+/*
+ * offsets in aux of what is already written, by address
+ */
+typedef struct
+   {
+   const void     **keys;
+   int32_t         *offsets;
+   int              size;
+   int              count;
+   } SnapShared;
+
+static int64_t         snap_append          ( SnapBuffer *buf, const void *data, size_t len );
+static int32_t         snap_append_aux      ( SnapBuffer *aux, const int32_t *ints, int nb );
+static int32_t         snap_find_shared     ( SnapShared *sh, const void *key );
+static void            snap_add_shared      ( SnapShared *sh, const void *key, int32_t offset );
+static int             snap_write_part      ( FILE *fp, int64_t *pos, int64_t offset, SnapBuffer *buf );
+static void            snap_put_value       ( BufrSnapRecord *rec, BufrValue *bv, SnapBuffer *aux,
+                                              SnapBuffer *strings );
+static int32_t         snap_put_afd         ( BufrAFD *afd, SnapBuffer *aux, SnapShared *sh );
+static int32_t         snap_put_rtmd        ( BufrRTMD *rtmd, SnapBuffer *aux, SnapShared *sh );
+static int             snap_fixup           ( BufrSnapshot *snap, size_t pos );
+static int             snap_part_fits       ( int64_t offset, int64_t nb, int64_t elsize, int64_t size );
+static int32_t        *snap_get_aux         ( BufrSnapDataset *sd, int32_t offset, int nb );
+static BufrValue      *snap_get_value       ( BufrSnapDataset *sd, BufrSnapRecord *rec );
+static BufrAFD        *snap_get_afd         ( BufrSnapDataset *sd, int32_t offset, void **cache );
+static BufrRTMD       *snap_get_rtmd        ( BufrSnapDataset *sd, int32_t offset, void **cache );
+
+/**
+ * @english
+ * @brief append a dataset to a snapshot file
+ *
+ * The snapshot is in the byte order and layout of this machine. Section 1
+ * is kept in header->s1 as bufr_master_table, orig_centre,
+ * orig_sub_centre, upd_seq_no, flag, msg_type, msg_inter_subtype,
+ * msg_local_subtype, master_table_version, local_table_version, year,
+ * month, day, hour, minute, second, len and header_len.
+ * @param dts  the dataset
+ * @param fp  the file, opened for writing in binary
+ * @return the number of datasubsets written, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_open_snapshot
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+int bufr_write_snapshot( BUFR_Dataset *dts, FILE *fp )
+   {
+   BufrSnapshotHeader  hdr;
+   SnapBuffer          codes, subsets, records, aux, strings;
+   SnapShared          shared;
+   BufrSnapCode        code;
+   BufrSnapSubset      ss;
+   BufrSnapRecord      rec;
+   BufrDescValue      *dv;
+   DataSubset         *subset;
+   BufrDescriptor     *bd;
+   int                 i, j, count, nb;
+   int64_t             pos;
+   int                 rtrn;
+
+   if ((dts == NULL)||(fp == NULL)) return -1;
+
+   memset( &hdr, 0, sizeof(hdr) );
+   memset( &codes, 0, sizeof(SnapBuffer) );
+   memset( &subsets, 0, sizeof(SnapBuffer) );
+   memset( &records, 0, sizeof(SnapBuffer) );
+   memset( &aux, 0, sizeof(SnapBuffer) );
+   memset( &strings, 0, sizeof(SnapBuffer) );
+   memset( &shared, 0, sizeof(SnapShared) );
+
+   strcpy( hdr.magic, SNAPSHOT_MAGIC );
+   hdr.version = SNAPSHOT_VERSION;
+   hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+   hdr.record_size = sizeof(BufrSnapRecord);
+   hdr.edition = dts->tmplte->edition;
+   hdr.data_flag = dts->data_flag;
+   hdr.s1[0]  = dts->s1.bufr_master_table;
+   hdr.s1[1]  = dts->s1.orig_centre;
+   hdr.s1[2]  = dts->s1.orig_sub_centre;
+   hdr.s1[3]  = dts->s1.upd_seq_no;
+   hdr.s1[4]  = dts->s1.flag;
+   hdr.s1[5]  = dts->s1.msg_type;
+   hdr.s1[6]  = dts->s1.msg_inter_subtype;
+   hdr.s1[7]  = dts->s1.msg_local_subtype;
+   hdr.s1[8]  = dts->s1.master_table_version;
+   hdr.s1[9]  = dts->s1.local_table_version;
+   hdr.s1[10] = dts->s1.year;
+   hdr.s1[11] = dts->s1.month;
+   hdr.s1[12] = dts->s1.day;
+   hdr.s1[13] = dts->s1.hour;
+   hdr.s1[14] = dts->s1.minute;
+   hdr.s1[15] = dts->s1.second;
+   hdr.s1[16] = dts->s1.len;
+   hdr.s1[17] = dts->s1.header_len;
+   hdr.header_string = -1;
+   if (dts->header_string)
+      hdr.header_string = snap_append( &strings, dts->header_string, strlen( dts->header_string ) + 1 );
+/*
+ * the template, its values first in the records
+ */
+   nb = arr_count( dts->tmplte->codets );
+   for (i = 0; i < nb ; i++)
+      {
+      dv = (BufrDescValue *)arr_get( dts->tmplte->codets, i );
+      code.descriptor = dv->descriptor;
+      code.nbval = dv->values ? dv->nbval : 0;
+      code.first_value = records.len / sizeof(BufrSnapRecord);
+      snap_append( &codes, &code, sizeof(code) );
+      for (j = 0; j < code.nbval ; j++)
+         {
+         memset( &rec, 0, sizeof(rec) );
+         rec.descriptor = dv->descriptor;
+         snap_put_value( &rec, dv->values[j], &aux, &strings );
+         rec.meta = rec.afd = -1;
+         snap_append( &records, &rec, sizeof(rec) );
+         }
+      }
+   hdr.nb_codes = nb;
+/*
+ * every descriptor of every datasubset
+ */
+   count = bufr_count_datasubset( dts );
+   for (i = 0; i < count ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      nb = bufr_datasubset_count_descriptor( subset );
+      ss.first = records.len / sizeof(BufrSnapRecord);
+      ss.count = nb;
+      ss.flags = 0;
+      for (j = 0; j < nb ; j++)
+         {
+         bd = bufr_datasubset_get_descriptor( subset, j );
+         memset( &rec, 0, sizeof(rec) );
+         rec.descriptor = bd->descriptor;
+         rec.s_descriptor = bd->s_descriptor;
+         rec.repl_rank = bd->repl_rank;
+         rec.enc_type = bd->encoding.type;
+         rec.enc_scale = bd->encoding.scale;
+         rec.enc_reference = bd->encoding.reference;
+         rec.enc_nbits = bd->encoding.nbits;
+         rec.enc_af_nbits = bd->encoding.af_nbits;
+         rec.enc_ref_nbits = bd->encoding.ref_nbits;
+         rec.flags = bd->flags;
+         snap_put_value( &rec, bd->value, &aux, &strings );
+         rec.afd = snap_put_afd( bd->afd, &aux, &shared );
+         rec.meta = snap_put_rtmd( bd->meta, &aux, &shared );
+         if (bd->meta && (bd->meta->nb_qualifiers > 0))
+            ss.flags |= SNAPSHOT_HAS_QUALIFIERS;
+         snap_append( &records, &rec, sizeof(rec) );
+         }
+      snap_append( &subsets, &ss, sizeof(ss) );
+      }
+   hdr.nb_subsets = count;
+   hdr.nb_records = records.len / sizeof(BufrSnapRecord);
+   hdr.aux_len = aux.len / sizeof(int32_t);
+   hdr.strings_len = strings.len;
+/*
+ * each part aligned on 8 octets
+ */
+   hdr.codes_offset = SNAP_ALIGN( sizeof(hdr) );
+   hdr.subsets_offset = SNAP_ALIGN( hdr.codes_offset + codes.len );
+   hdr.records_offset = SNAP_ALIGN( hdr.subsets_offset + subsets.len );
+   hdr.aux_offset = SNAP_ALIGN( hdr.records_offset + records.len );
+   hdr.strings_offset = SNAP_ALIGN( hdr.aux_offset + aux.len );
+   hdr.size = SNAP_ALIGN( hdr.strings_offset + strings.len );
+
+   rtrn = count;
+   if (fwrite( &hdr, sizeof(hdr), 1, fp ) != 1) rtrn = -1;
+   pos = sizeof(hdr);
+   if ((rtrn >= 0)&&
+       ((snap_write_part( fp, &pos, hdr.codes_offset, &codes ) < 0)||
+        (snap_write_part( fp, &pos, hdr.subsets_offset, &subsets ) < 0)||
+        (snap_write_part( fp, &pos, hdr.records_offset, &records ) < 0)||
+        (snap_write_part( fp, &pos, hdr.aux_offset, &aux ) < 0)||
+        (snap_write_part( fp, &pos, hdr.strings_offset, &strings ) < 0)||
+        (snap_write_part( fp, &pos, hdr.size, NULL ) < 0)))
+      rtrn = -1;
+   if (rtrn < 0)
+      bufr_print_debug( _("Error: can't write snapshot\n") );
+
+   free( codes.data );
+   free( subsets.data );
+   free( records.data );
+   free( aux.data );
+   free( strings.data );
+   free( shared.keys );
+   free( shared.offsets );
+   return rtrn;
+   }
+
+/**
+ * @english
+ * @brief map a snapshot file in memory
+ *
+ * The file is mapped read only when mmap is available, else read at
+ * once. Each dataset of the file is checked and its parts made into
+ * pointers; the records are used in place until bufr_close_snapshot.
+ * @param filename  file written by bufr_write_snapshot
+ * @return the snapshot, NULL if it can't be read or is not valid
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_snapshot_to_dataset, bufr_snapshot_records
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrSnapshot *bufr_open_snapshot( const char *filename )
+   {
+   BufrSnapshot  *snap;
+   size_t         pos;
+   char           errmsg[256];
+
+   snap = (BufrSnapshot *)calloc( 1, sizeof(BufrSnapshot) );
+   snap->base = bufr_map_file( filename, &snap->size, &snap->mapped );
+   if (snap->base == NULL)
+      {
+      snprintf( errmsg, sizeof(errmsg), _("Error: can't open snapshot \"%s\"\n"), filename );
+      bufr_print_debug( errmsg );
+      free( snap );
+      return NULL;
+      }
+/*
+ * the datasets, one after the other
+ */
+   for (pos = 0; pos < snap->size ; pos += snap->datasets[snap->nb_datasets-1].header->size)
+      {
+      if (!snap_fixup( snap, pos ))
+         {
+         snprintf( errmsg, sizeof(errmsg), _("Error: \"%s\" is not a valid snapshot\n"), filename );
+         bufr_print_debug( errmsg );
+         bufr_close_snapshot( snap );
+         return NULL;
+         }
+      }
+   return snap;
+   }
+
+/**
+ * @english
+ * @brief unmap a snapshot
+ * @param snap  the snapshot, its records can't be used anymore
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+void bufr_close_snapshot( BufrSnapshot *snap )
+   {
+   if (snap == NULL) return;
+
+   bufr_unmap_file( snap->base, snap->size, snap->mapped );
+   free( snap->datasets );
+   free( snap );
+   }
+
+/**
+ * @english
+ * @brief the records of a datasubset of a mapped snapshot
+ * @param sd  a dataset of the snapshot
+ * @param pos  position of the datasubset
+ * @param count  receives the number of records
+ * @return the records, read only, NULL if there is no such datasubset
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_snapshot_string
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BufrSnapRecord *bufr_snapshot_records( BufrSnapDataset *sd, int pos, int *count )
+   {
+   if ((pos < 0)||(pos >= sd->header->nb_subsets))
+      {
+      *count = 0;
+      return NULL;
+      }
+   *count = sd->subsets[pos].count;
+   return sd->records + sd->subsets[pos].first;
+   }
+
+/**
+ * @english
+ * @brief the string value of a record, in place
+ * @param sd  a dataset of the snapshot
+ * @param rec  the record
+ * @param len  receives the length of the string
+ * @return the string, NULL if the value is not a string
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+const char *bufr_snapshot_string( BufrSnapDataset *sd, BufrSnapRecord *rec, int *len )
+   {
+   if (rec->value_type != VALTYPE_STRING) return NULL;
+   if (len) *len = rec->len;
+   return sd->strings + rec->ivalue;
+   }
+
+/**
+ * @english
+ * @brief make a dataset of a snapshot again
+ * @param sd  a dataset of the snapshot
+ * @param tables  tables of the descriptors of the template
+ * @return the dataset, to free with bufr_free_dataset, NULL on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup io
+ */
+BUFR_Dataset *bufr_snapshot_to_dataset( BufrSnapDataset *sd, BUFR_Tables *tables )
+   {
+   BufrSnapshotHeader  *hdr = sd->header;
+   BUFR_Dataset        *dts;
+   BUFR_Template       *tmplt;
+   BufrDescValue       *codes;
+   BUFR_Sequence       *bsq;
+   BufrDescriptor      *bd;
+   BufrSnapRecord      *rec;
+   void               **afds, **metas;
+   int                  i, j, errflg;
+
+   codes = (BufrDescValue *)calloc( hdr->nb_codes + 1, sizeof(BufrDescValue) );
+   for (i = 0; i < hdr->nb_codes ; i++)
+      {
+      bufr_init_DescValue( &(codes[i]) );
+      codes[i].descriptor = sd->codes[i].descriptor;
+      if (sd->codes[i].nbval > 0)
+         {
+         bufr_valloc_DescValue( &(codes[i]), sd->codes[i].nbval );
+         for (j = 0; j < sd->codes[i].nbval ; j++)
+            codes[i].values[j] = snap_get_value( sd, sd->records + sd->codes[i].first_value + j );
+         }
+      }
+   tmplt = bufr_create_template( codes, hdr->nb_codes, tables, hdr->edition );
+   for (i = 0; i < hdr->nb_codes ; i++)
+      bufr_vfree_DescValue( &(codes[i]) );
+   free( codes );
+   if (bufr_finalize_template( tmplt ) < 0)
+      {
+      bufr_free_template( tmplt );
+      return NULL;
+      }
+   dts = bufr_create_dataset( tmplt );
+   bufr_free_template( tmplt );
+   if (dts == NULL) return NULL;
+
+   dts->s1.bufr_master_table    = hdr->s1[0];
+   dts->s1.orig_centre          = hdr->s1[1];
+   dts->s1.orig_sub_centre      = hdr->s1[2];
+   dts->s1.upd_seq_no           = hdr->s1[3];
+   dts->s1.flag                 = hdr->s1[4];
+   dts->s1.msg_type             = hdr->s1[5];
+   dts->s1.msg_inter_subtype    = hdr->s1[6];
+   dts->s1.msg_local_subtype    = hdr->s1[7];
+   dts->s1.master_table_version = hdr->s1[8];
+   dts->s1.local_table_version  = hdr->s1[9];
+   dts->s1.year                 = hdr->s1[10];
+   dts->s1.month                = hdr->s1[11];
+   dts->s1.day                  = hdr->s1[12];
+   dts->s1.hour                 = hdr->s1[13];
+   dts->s1.minute               = hdr->s1[14];
+   dts->s1.second               = hdr->s1[15];
+   dts->s1.len                  = hdr->s1[16];
+   dts->s1.header_len           = hdr->s1[17];
+   dts->data_flag = hdr->data_flag;
+   if (hdr->header_string >= 0)
+      dts->header_string = strdup( sd->strings + hdr->header_string );
+/*
+ * shared parts are made once, by their offset
+ */
+   afds = (void **)calloc( hdr->aux_len + 1, sizeof(void *) );
+   metas = (void **)calloc( hdr->aux_len + 1, sizeof(void *) );
+   errflg = 0;
+   for (i = 0; (i < hdr->nb_subsets)&& !errflg ; i++)
+      {
+      bsq = bufr_create_sequence( NULL );
+      for (j = 0; j < sd->subsets[i].count ; j++)
+         {
+         rec = sd->records + sd->subsets[i].first + j;
+         bd = bufr_create_descriptor( tables, rec->descriptor );
+         bd->s_descriptor = rec->s_descriptor;
+         bd->repl_rank = rec->repl_rank;
+         bd->flags = rec->flags;
+         bd->encoding.type = (BufrDataType)rec->enc_type;
+         bd->encoding.scale = rec->enc_scale;
+         bd->encoding.reference = rec->enc_reference;
+         bd->encoding.nbits = rec->enc_nbits;
+         bd->encoding.af_nbits = rec->enc_af_nbits;
+         bd->encoding.ref_nbits = rec->enc_ref_nbits;
+         bd->value = snap_get_value( sd, rec );
+         bd->afd = bufr_share_afd( snap_get_afd( sd, rec->afd, afds ) );
+         bd->meta = bufr_share_rtmd( snap_get_rtmd( sd, rec->meta, metas ) );
+         if (((rec->value_type != VALTYPE_UNDEFINE)&&(bd->value == NULL))||
+             ((rec->afd >= 0)&&(bd->afd == NULL))||((rec->meta >= 0)&&(bd->meta == NULL)))
+            errflg = 1;
+         bufr_add_descriptor_to_sequence( bsq, bd );
+         }
+      bufr_add_datasubset( dts, bsq, NULL );
+      if (sd->subsets[i].flags & SNAPSHOT_HAS_QUALIFIERS)
+         bufr_expand_qualifiers( bufr_get_datasubset( dts, i ) );
+      }
+   for (i = 0; i < hdr->aux_len ; i++)
+      {
+      if (afds[i]) bufr_free_afd( (BufrAFD *)afds[i] );
+      if (metas[i]) bufr_free_rtmd( (BufrRTMD *)metas[i] );
+      }
+   free( afds );
+   free( metas );
+
+   if (errflg)
+      {
+      bufr_print_debug( _("Error: snapshot has invalid records\n") );
+      bufr_free_dataset( dts );
+      return NULL;
+      }
+   return dts;
+   }
+
+/**
+ * @english
+ * append octets to a buffer
+ * @return the offset of the octets in the buffer
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int64_t snap_append( SnapBuffer *buf, const void *data, size_t len )
+   {
+   int64_t  offset;
+
+   if (buf->len + len > buf->max)
+      {
+      buf->max = (buf->max < 4096) ? 4096 : buf->max;
+      while (buf->len + len > buf->max) buf->max *= 2;
+      buf->data = (char *)realloc( buf->data, buf->max );
+      }
+   offset = buf->len;
+   memcpy( buf->data + buf->len, data, len );
+   buf->len += len;
+   return offset;
+   }
+
+/**
+ * @english
+ * append integers to the aux part
+ * @return their offset, in integers
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int32_t snap_append_aux( SnapBuffer *aux, const int32_t *ints, int nb )
+   {
+   return (int32_t)(snap_append( aux, ints, nb * sizeof(int32_t) ) / sizeof(int32_t));
+   }
+
+/**
+ * @english
+ * offset of a shared part already written, -1 if not
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int32_t snap_find_shared( SnapShared *sh, const void *key )
+   {
+   int  i;
+
+   if (sh->size == 0) return -1;
+   for (i = ((uintptr_t)key >> 4) & (sh->size - 1); sh->keys[i] ; i = (i + 1) & (sh->size - 1))
+      if (sh->keys[i] == key) return sh->offsets[i];
+   return -1;
+   }
+
+/**
+ * @english
+ * remember the offset of a shared part, in an open addressing table
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void snap_add_shared( SnapShared *sh, const void *key, int32_t offset )
+   {
+   SnapShared  old;
+   int         i;
+
+   if (2 * (sh->count + 1) > sh->size)
+      {
+      old = *sh;
+      sh->size = (old.size == 0) ? 256 : 2 * old.size;
+      sh->keys = (const void **)calloc( sh->size, sizeof(void *) );
+      sh->offsets = (int32_t *)malloc( sh->size * sizeof(int32_t) );
+      sh->count = 0;
+      for (i = 0; i < old.size ; i++)
+         if (old.keys[i]) snap_add_shared( sh, old.keys[i], old.offsets[i] );
+      free( old.keys );
+      free( old.offsets );
+      }
+   for (i = ((uintptr_t)key >> 4) & (sh->size - 1); sh->keys[i] ; i = (i + 1) & (sh->size - 1)) ;
+   sh->keys[i] = key;
+   sh->offsets[i] = offset;
+   ++sh->count;
+   }
+
+/**
+ * @english
+ * write a part of a snapshot at its offset, padding with zeros
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int snap_write_part( FILE *fp, int64_t *pos, int64_t offset, SnapBuffer *buf )
+   {
+   static const char  zeros[8] = { 0 };
+
+   if (offset - *pos > 8) return -1;
+   if ((offset > *pos)&&(fwrite( zeros, offset - *pos, 1, fp ) != 1)) return -1;
+   *pos = offset;
+   if ((buf == NULL)||(buf->len == 0)) return 0;
+   if (fwrite( buf->data, buf->len, 1, fp ) != 1) return -1;
+   *pos += buf->len;
+   return 0;
+   }
+
+/**
+ * @english
+ * keep a value in a record, its string in strings and its associated
+ * field in aux as: count, bits (2 integers), then length and significance
+ * of each field
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void snap_put_value( BufrSnapRecord *rec, BufrValue *bv, SnapBuffer *aux, SnapBuffer *strings )
+   {
+   const char  *str;
+   int64_t      scaled;
+   int          scale, len, i;
+   int32_t      ints[3];
+
+   rec->af = -1;
+   if (bv == NULL)
+      {
+      rec->value_type = VALTYPE_UNDEFINE;
+      return;
+      }
+   rec->value_type = bv->type;
+   switch( bv->type )
+      {
+      case VALTYPE_INT8 :
+      case VALTYPE_INT32 :
+      case VALTYPE_INT64 :
+         rec->ivalue = bufr_value_get_int64( bv );
+         break;
+      case VALTYPE_FLT32 :
+         rec->dvalue = bufr_value_get_float( bv );
+         break;
+      case VALTYPE_FLT64 :
+         rec->dvalue = bufr_value_get_double( bv );
+         if (bufr_value_get_scaled( bv, &scaled, &scale ))
+            {
+            rec->has_scaled = 1;
+            rec->ivalue = scaled;
+            rec->scale = scale;
+            }
+         break;
+      case VALTYPE_STRING :
+         str = bufr_value_get_string( bv, &len );
+         rec->len = str ? len : 0;
+         rec->ivalue = snap_append( strings, str ? str : "", rec->len );
+         snap_append( strings, "", 1 );
+         break;
+      default :
+         break;
+      }
+
+   if (bv->af)
+      {
+      ints[0] = bv->af->count;
+      ints[1] = (int32_t)(bv->af->bits & 0xffffffff);
+      ints[2] = (int32_t)(bv->af->bits >> 32);
+      rec->af = snap_append_aux( aux, ints, 3 );
+      for (i = 0; i < bv->af->count ; i++)
+         {
+         ints[0] = bv->af->fields[i].len;
+         ints[1] = bv->af->fields[i].signify;
+         snap_append_aux( aux, ints, 2 );
+         }
+      }
+   }
+
+/**
+ * @english
+ * keep an associated field definition in aux, once: count then the
+ * number of bits of each field
+ * @return its offset, -1 if none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int32_t snap_put_afd( BufrAFD *afd, SnapBuffer *aux, SnapShared *sh )
+   {
+   int32_t  offset, n;
+   int      i;
+
+   if (afd == NULL) return -1;
+   if ((offset = snap_find_shared( sh, afd )) >= 0) return offset;
+
+   n = afd->count;
+   offset = snap_append_aux( aux, &n, 1 );
+   for (i = 0; i < afd->count ; i++)
+      {
+      n = afd->defs[i].nbits;
+      snap_append_aux( aux, &n, 1 );
+      }
+   snap_add_shared( sh, afd, offset );
+   return offset;
+   }
+
+/**
+ * @english
+ * keep run time meta data in aux, once: nesting count and levels, count
+ * and pairs of descriptor and value bits of the locations, pos_template,
+ * len_expansion and the number of qualifiers
+ * @return its offset, -1 if none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int32_t snap_put_rtmd( BufrRTMD *rtmd, SnapBuffer *aux, SnapShared *sh )
+   {
+   int32_t  offset, ints[3];
+   int      i;
+
+   if (rtmd == NULL) return -1;
+   if ((offset = snap_find_shared( sh, rtmd )) >= 0) return offset;
+
+   ints[0] = rtmd->nb_nesting;
+   offset = snap_append_aux( aux, ints, 1 );
+   if (rtmd->nb_nesting > 0)
+      snap_append_aux( aux, rtmd->nesting, rtmd->nb_nesting );
+   ints[0] = rtmd->nb_tlc;
+   snap_append_aux( aux, ints, 1 );
+   for (i = 0; i < rtmd->nb_tlc ; i++)
+      {
+      ints[0] = rtmd->tlc[i].descriptor;
+      memcpy( &ints[1], &(rtmd->tlc[i].value), sizeof(float) );
+      snap_append_aux( aux, ints, 2 );
+      }
+   ints[0] = rtmd->pos_template;
+   ints[1] = rtmd->len_expansion;
+   ints[2] = rtmd->nb_qualifiers;
+   snap_append_aux( aux, ints, 3 );
+   snap_add_shared( sh, rtmd, offset );
+   return offset;
+   }
+
+/**
+ * @english
+ * check the dataset at an offset of a snapshot and turn the offsets of
+ * its parts into pointers
+ * @return 1 if valid, 0 otherwise
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int snap_fixup( BufrSnapshot *snap, size_t pos )
+   {
+   BufrSnapshotHeader  *hdr;
+   BufrSnapDataset     *sd;
+   char                *base;
+   int64_t              i;
+
+   if ((pos % 8)||(pos + sizeof(BufrSnapshotHeader) > snap->size)) return 0;
+   base = snap->base + pos;
+   hdr = (BufrSnapshotHeader *)base;
+   if ((memcmp( hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) ) != 0)||
+       (hdr->version != SNAPSHOT_VERSION)||(hdr->byte_order != SNAPSHOT_BYTE_ORDER)||
+       (hdr->record_size != sizeof(BufrSnapRecord)))
+      return 0;
+   if ((hdr->size < (int64_t)sizeof(BufrSnapshotHeader))||(hdr->size % 8)||
+       (hdr->size > (int64_t)(snap->size - pos)))
+      return 0;
+   if ((hdr->nb_codes < 0)||(hdr->nb_subsets < 0)||(hdr->nb_records < 0)||
+       (hdr->aux_len < 0)||(hdr->strings_len < 0)||
+       !snap_part_fits( hdr->codes_offset, hdr->nb_codes, sizeof(BufrSnapCode), hdr->size )||
+       !snap_part_fits( hdr->subsets_offset, hdr->nb_subsets, sizeof(BufrSnapSubset), hdr->size )||
+       !snap_part_fits( hdr->records_offset, hdr->nb_records, sizeof(BufrSnapRecord), hdr->size )||
+       !snap_part_fits( hdr->aux_offset, hdr->aux_len, sizeof(int32_t), hdr->size )||
+       !snap_part_fits( hdr->strings_offset, hdr->strings_len, 1, hdr->size )||
+       (hdr->header_string < -1)||(hdr->header_string >= hdr->strings_len))
+      return 0;
+
+   snap->datasets = (BufrSnapDataset *)realloc( snap->datasets,
+                                                (snap->nb_datasets + 1) * sizeof(BufrSnapDataset) );
+   sd = &(snap->datasets[snap->nb_datasets++]);
+   sd->header = hdr;
+   sd->codes = (BufrSnapCode *)(base + hdr->codes_offset);
+   sd->subsets = (BufrSnapSubset *)(base + hdr->subsets_offset);
+   sd->records = (BufrSnapRecord *)(base + hdr->records_offset);
+   sd->aux = (int32_t *)(base + hdr->aux_offset);
+   sd->strings = base + hdr->strings_offset;
+/*
+ * records of the template and datasubsets must be there
+ */
+   for (i = 0; i < hdr->nb_codes ; i++)
+      if ((sd->codes[i].nbval < 0)||(sd->codes[i].first_value < 0)||
+          (sd->codes[i].first_value > hdr->nb_records - sd->codes[i].nbval))
+         return 0;
+   for (i = 0; i < hdr->nb_subsets ; i++)
+      if ((sd->subsets[i].count < 0)||(sd->subsets[i].first < 0)||
+          (sd->subsets[i].first > hdr->nb_records - sd->subsets[i].count))
+         return 0;
+   for (i = 0; i < hdr->nb_records ; i++)
+      if ((sd->records[i].value_type == VALTYPE_STRING)&&
+          ((sd->records[i].ivalue < 0)||(sd->records[i].len < 0)||
+           (sd->records[i].ivalue >= hdr->strings_len - sd->records[i].len)))
+         return 0;
+/*
+ * and their parts in aux, or -1 for none
+ */
+   for (i = 0; i < hdr->nb_records ; i++)
+      if ((sd->records[i].afd < -1)||(sd->records[i].afd >= hdr->aux_len)||
+          (sd->records[i].meta < -1)||(sd->records[i].meta >= hdr->aux_len)||
+          (sd->records[i].af < -1)||(sd->records[i].af >= hdr->aux_len))
+         return 0;
+   return 1;
+   }
+
+/**
+ * @english
+ * tell if nb elements of elsize bytes at offset, aligned on 8 bytes,
+ * are within a snapshot of size bytes, without overflowing
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int snap_part_fits( int64_t offset, int64_t nb, int64_t elsize, int64_t size )
+   {
+   if ((offset < 0)||(offset % 8)||(offset > size)||(nb < 0)) return 0;
+   return (nb <= (size - offset) / elsize);
+   }
+
+/**
+ * @english
+ * integers of aux, NULL if they are not all there
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int32_t *snap_get_aux( BufrSnapDataset *sd, int32_t offset, int nb )
+   {
+   if ((offset < 0)||(nb < 0)||((int64_t)offset + nb > sd->header->aux_len)) return NULL;
+   return sd->aux + offset;
+   }
+
+/**
+ * @english
+ * make the value of a record, NULL if it has none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrValue *snap_get_value( BufrSnapDataset *sd, BufrSnapRecord *rec )
+   {
+   BufrValue  *bv;
+   int32_t    *ints;
+   int         lens[64];
+   int         i, count;
+
+   if (rec->value_type == VALTYPE_UNDEFINE) return NULL;
+   bv = bufr_create_value( (ValueType)rec->value_type );
+   if (bv == NULL) return NULL;
+
+   switch( rec->value_type )
+      {
+      case VALTYPE_INT8 :
+      case VALTYPE_INT32 :
+      case VALTYPE_INT64 :
+         bufr_value_set_int64( bv, rec->ivalue );
+         break;
+      case VALTYPE_FLT32 :
+         bufr_value_set_float( bv, (float)rec->dvalue );
+         break;
+      case VALTYPE_FLT64 :
+         if (rec->has_scaled)
+            bufr_value_set_scaled( bv, rec->ivalue, rec->scale, rec->dvalue );
+         else
+            bufr_value_set_double( bv, rec->dvalue );
+         break;
+      case VALTYPE_STRING :
+         bufr_value_set_string( bv, sd->strings + rec->ivalue, rec->len );
+         break;
+      default :
+         break;
+      }
+
+   if (rec->af >= 0)
+      {
+      ints = snap_get_aux( sd, rec->af, 3 );
+      count = ints ? ints[0] : -1;
+      if ((count <= 0)||(count > 64)||(snap_get_aux( sd, rec->af + 3, 2 * count ) == NULL))
+         {
+         bufr_free_value( bv );
+         return NULL;
+         }
+      for (i = 0; i < count ; i++)
+         lens[i] = ints[3 + 2*i];
+      bv->af = bufr_create_af( lens, count );
+      if (bv->af)
+         {
+         for (i = 0; i < count ; i++)
+            bufr_af_set_sig( bv->af, i, ints[4 + 2*i] );
+         bv->af->bits = (uint64_t)(uint32_t)ints[1] | ((uint64_t)(uint32_t)ints[2] << 32);
+         }
+      }
+   return bv;
+   }
+
+/**
+ * @english
+ * make an associated field definition of aux, once for each offset
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrAFD *snap_get_afd( BufrSnapDataset *sd, int32_t offset, void **cache )
+   {
+   int32_t  *ints;
+   int       nbits[64];
+   int       i;
+
+   if (offset < 0) return NULL;
+   ints = snap_get_aux( sd, offset, 1 );
+   if (ints == NULL) return NULL;
+   if (cache[offset]) return (BufrAFD *)cache[offset];
+
+   if ((ints[0] <= 0)||(ints[0] > 64)||(snap_get_aux( sd, offset + 1, ints[0] ) == NULL))
+      return NULL;
+   for (i = 0; i < ints[0] ; i++)
+      nbits[i] = ints[1 + i];
+   cache[offset] = bufr_create_afd( nbits, ints[0] );
+   return (BufrAFD *)cache[offset];
+   }
+
+/**
+ * @english
+ * make run time meta data of aux, once for each offset
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrRTMD *snap_get_rtmd( BufrSnapDataset *sd, int32_t offset, void **cache )
+   {
+   BufrRTMD  *rtmd;
+   int32_t   *ints, *tlc;
+   int        i, nb_nesting, nb_tlc;
+
+   if (offset < 0) return NULL;
+   ints = snap_get_aux( sd, offset, 1 );
+   if (ints == NULL) return NULL;
+   if (cache[offset]) return (BufrRTMD *)cache[offset];
+
+   nb_nesting = ints[0];
+   if ((nb_nesting < 0)||(snap_get_aux( sd, offset, nb_nesting + 2 ) == NULL)) return NULL;
+   nb_tlc = ints[1 + nb_nesting];
+   tlc = ints + 2 + nb_nesting;
+   if ((nb_tlc < 0)||(snap_get_aux( sd, offset, nb_nesting + 2 + 2 * nb_tlc + 3 ) == NULL)) return NULL;
+
+   rtmd = bufr_create_rtmd( nb_nesting );
+   for (i = 0; i < nb_nesting ; i++)
+      rtmd->nesting[i] = ints[1 + i];
+   if (nb_tlc > 0)
+      {
+      rtmd->tlc = (LocationValue *)malloc( nb_tlc * sizeof(LocationValue) );
+      rtmd->nb_tlc = nb_tlc;
+      for (i = 0; i < nb_tlc ; i++)
+         {
+         rtmd->tlc[i].descriptor = tlc[2*i];
+         memcpy( &(rtmd->tlc[i].value), &tlc[2*i+1], sizeof(float) );
+         }
+      }
+   rtmd->pos_template = tlc[2*nb_tlc];
+   rtmd->len_expansion = tlc[2*nb_tlc+1];
+   cache[offset] = rtmd;
+   return rtmd;
+   }
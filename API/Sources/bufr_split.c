@@ -0,0 +1,477 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_split.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: extraction de subsets d'un message sans les decoder
+ *
+ * The bits of the selected subsets are copied as they are into new
+ * messages. Subsets of an uncompressed message are located by their
+ * bit boundaries; compressed blocks keep their R0 and NBINC and only
+ * the increments of the selected subsets are copied.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_linklist.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_sequence.h"
+#include "bufr_ddo.h"
+#include "bufr_tables.h"
+#include "bufr_template.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+#include "bufr_split.h"
+#include "bufr_i18n.h"
+
+static BUFR_Template  *bufr_message_template   ( BUFR_Message *msg, BUFR_Tables *tables );
+static int             bufr_template_nbits     ( BUFR_Message *msg, BUFR_Template *tmplt, uint64_t *nbits );
+static BUFR_Message  **bufr_split_range        ( BUFR_Message *msg, BUFR_Tables *tables, int subset_from,
+                                                 int subset_to, int per_part, int *nb_parts );
+static BUFR_Message   *bufr_create_part        ( BUFR_Message *msg, int nb_subsets, unsigned int len );
+static int             bufr_slice_compressed   ( BUFR_Message *msg, BUFR_Tables *tables, BUFR_Message **parts,
+                                                 int nb_parts, int subset_from, int per_part );
+
+/**
+ * @english
+ * @brief locate the subsets of an uncompressed message
+ *
+ * Without delayed replication every subset has the length of the template
+ * and nothing is read from section 4. Otherwise the message has to be
+ * decoded once to learn the replication counts.
+ * @param msg  an uncompressed message
+ * @param tables  tables used to decode it
+ * @param bitpos  receives the bit position of each subset in section 4
+ * followed by the end of the last one, no_data_subsets+1 entries
+ * @return the number of subsets, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_extract_subsets
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_subset_boundaries( BUFR_Message *msg, BUFR_Tables *tables, uint64_t *bitpos )
+   {
+   BUFR_Template  *tmplt;
+   BUFR_Dataset   *dts;
+   DataSubset     *subset;
+   BufrDescriptor *bd;
+   unsigned char  *current;
+   unsigned short  bitno;
+   uint64_t        nbits;
+   int             i, j, count, nbsubset;
+   int             rtrn;
+   char            errmsg[256];
+
+   if ((msg == NULL)||(bitpos == NULL)) return -1;
+   if (BUFR_IS_COMPRESSED( msg ))
+      {
+      bufr_print_debug( _("Error: subsets of a compressed message have no boundaries\n") );
+      return -1;
+      }
+
+   nbsubset = msg->s3.no_data_subsets;
+   tmplt = bufr_message_template( msg, tables );
+   if (tmplt == NULL) return -1;
+
+   bitpos[0] = 0;
+   rtrn = bufr_template_nbits( msg, tmplt, &nbits );
+   if (rtrn < 0)
+      {
+      bufr_free_template( tmplt );
+      return -1;
+      }
+   else if (rtrn > 0)
+      {
+      for (i = 1; i <= nbsubset ; i++)
+         bitpos[i] = bitpos[i-1] + nbits;
+      }
+   else
+      {
+      current = msg->s4.current;
+      bitno = msg->s4.bitno;
+      msg->s4.current = msg->s4.data;
+      msg->s4.bitno = 0;
+      dts = bufr_decode_message( msg, tables );
+      msg->s4.current = current;
+      msg->s4.bitno = bitno;
+      if ((dts == NULL)||(dts->data_flag & BUFR_FLAG_INVALID)||
+          (bufr_count_datasubset( dts ) != nbsubset))
+         {
+         bufr_print_debug( _("Error: cannot locate the subsets of an invalid message\n") );
+         if (dts) bufr_free_dataset( dts );
+         bufr_free_template( tmplt );
+         return -1;
+         }
+      for (i = 0; i < nbsubset ; i++)
+         {
+         subset = bufr_get_datasubset( dts, i );
+         count = bufr_datasubset_count_descriptor( subset );
+         nbits = 0;
+         for (j = 0; j < count ; j++)
+            {
+            bd = bufr_datasubset_get_descriptor( subset, j );
+            if (bd->flags & FLAG_SKIPPED) continue;
+            nbits += bd->encoding.nbits + bd->encoding.af_nbits;
+            }
+         bitpos[i+1] = bitpos[i] + nbits;
+         }
+      bufr_free_dataset( dts );
+      }
+   bufr_free_template( tmplt );
+
+   if (bitpos[nbsubset] > (uint64_t)msg->s4.max_data_len * 8)
+      {
+      sprintf( errmsg, _("Error: %d subsets need more bits than section 4 holds\n"), nbsubset );
+      bufr_print_debug( errmsg );
+      return -1;
+      }
+   return nbsubset;
+   }
+
+/**
+ * @english
+ * @brief copy a range of subsets into a new message
+ *
+ * Sections 1, 2 and the descriptors of section 3 are copied and the bits
+ * of the subsets are taken as they are from section 4, the values are
+ * never converted. A compressed message stays compressed.
+ * @param msg  the message holding the subsets
+ * @param tables  tables used to decode it
+ * @param subset_from  first subset to copy, starting at 1
+ * @param subset_to  last subset to copy
+ * @return the new message, NULL on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_split_message, bufr_decode_message_subsets
+ * @author Vanh Souvanlasy
+ * @ingroup decode encode message
+ */
+BUFR_Message *bufr_extract_subsets( BUFR_Message *msg, BUFR_Tables *tables, int subset_from, int subset_to )
+   {
+   BUFR_Message **parts;
+   BUFR_Message  *part;
+   int            nb_parts;
+
+   if ((subset_from < 1)||(subset_to < subset_from)) return NULL;
+
+   parts = bufr_split_range( msg, tables, subset_from, subset_to, subset_to - subset_from + 1, &nb_parts );
+   if (parts == NULL) return NULL;
+   part = parts[0];
+   free( parts );
+   return part;
+   }
+
+/**
+ * @english
+ * @brief split a message into messages of a limited number of subsets
+ *
+ * Section 4 is read only once whatever the number of messages made.
+ * @param msg  the message to split
+ * @param tables  tables used to decode it
+ * @param max_subsets  number of subsets in each message, the last one
+ * may hold less
+ * @param nb_parts  receives the number of messages
+ * @return array of messages to be freed with free() after each message
+ * is freed with bufr_free_message, NULL on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_extract_subsets
+ * @author Vanh Souvanlasy
+ * @ingroup decode encode message
+ */
+BUFR_Message **bufr_split_message( BUFR_Message *msg, BUFR_Tables *tables, int max_subsets, int *nb_parts )
+   {
+   if ((msg == NULL)||(max_subsets < 1)) return NULL;
+
+   return bufr_split_range( msg, tables, 1, msg->s3.no_data_subsets, max_subsets, nb_parts );
+   }
+
+/**
+ * @english
+ * create a template with the descriptors of section 3 of a message
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BUFR_Template *bufr_message_template( BUFR_Message *msg, BUFR_Tables *tables )
+   {
+   BUFR_Template  *tmplt;
+   BufrDescValue  *codets;
+   int             i, count;
+
+   if ((tables == NULL)||bufr_table_is_empty( tables ))
+      {
+      bufr_print_debug( _("Error: BUFR Tables contains no entry, cannot decode message\n") );
+      return NULL;
+      }
+
+   count = arr_count( msg->s3.desc_list );
+   if (count <= 0) return NULL;
+   codets = (BufrDescValue *)malloc( sizeof(BufrDescValue) * count );
+   for (i = 0; i < count ; i++)
+      {
+      codets[i].nbval = 0;
+      codets[i].values = NULL;
+      codets[i].descriptor = *(int *)arr_get( msg->s3.desc_list, i );
+      }
+   tmplt = bufr_create_template( codets, count, tables, msg->edition );
+   free( codets );
+   return tmplt;
+   }
+
+/**
+ * @english
+ * length of the subsets of a message when it does not depend on the data
+ * @return 1 with the length in nbits, 0 if the template has delayed
+ * replications, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_template_nbits( BUFR_Message *msg, BUFR_Template *tmplt, uint64_t *nbits )
+   {
+   BUFR_Sequence    *bsq;
+   BufrDescriptor  **pbcd, *bd;
+   BufrDDOp         *ddo;
+   ListNode         *node;
+   int               i, count;
+   int               errcode, flags;
+
+   bsq = bufr_create_sequence(NULL);
+   count = arr_count( tmplt->gabarit );
+   pbcd = (BufrDescriptor **)arr_get( tmplt->gabarit, 0 );
+   for (i = 0; i < count ; i++)
+      bufr_add_descriptor_to_sequence( bsq, bufr_dupl_descriptor( pbcd[i] ) );
+/*
+ * same expansion as when decoding, delayed replications inside
+ * Table D sequences are only seen once expanded
+ */
+   if (bufr_expand_sequence( bsq, OP_EXPAND_DELAY_REPL | OP_ZDRC_SKIP, tmplt->tables ) < 0)
+      {
+      bufr_free_sequence( bsq );
+      return -1;
+      }
+   flags = 0;
+   bufr_check_sequence( bsq, NULL, &flags, tmplt->tables, 0 );
+   if (flags & HAS_DELAYED_REPLICATION)
+      {
+      bufr_free_sequence( bsq );
+      return 0;
+      }
+
+   ddo = bufr_create_BufrDDOp( msg->enforce );
+   bufr_apply_Tables( ddo, bsq, tmplt, NULL, &errcode );
+   bufr_free_BufrDDOp( ddo );
+
+   *nbits = 0;
+   for (node = lst_firstnode( bsq->list ); node ; node = lst_nextnode( node ))
+      {
+      bd = (BufrDescriptor *)node->data;
+      if (bd->flags & FLAG_SKIPPED) continue;
+      *nbits += bd->encoding.nbits + bd->encoding.af_nbits;
+      }
+   bufr_free_sequence( bsq );
+
+   if (errcode < 0)
+      {
+      bufr_print_debug( _("Error: cannot locate the subsets, invalid template\n") );
+      return -1;
+      }
+   return 1;
+   }
+
+/**
+ * @english
+ * make messages of per_part subsets from a range of subsets
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BUFR_Message **bufr_split_range
+   ( BUFR_Message *msg, BUFR_Tables *tables, int subset_from, int subset_to, int per_part, int *nb_parts )
+   {
+   BUFR_Message **parts;
+   uint64_t      *bitpos=NULL;
+   uint64_t       nbits;
+   int            i, k, nb, first, count, nbsubset;
+   int            rtrn;
+   char           errmsg[256];
+
+   if (msg == NULL) return NULL;
+
+   nbsubset = msg->s3.no_data_subsets;
+   if ((subset_from < 1)||(subset_to > nbsubset)||(subset_to < subset_from))
+      {
+      sprintf( errmsg, _("Error: subsets %d to %d are not in message of %d subsets\n"),
+               subset_from, subset_to, nbsubset );
+      bufr_print_debug( errmsg );
+      return NULL;
+      }
+
+   if (!BUFR_IS_COMPRESSED( msg ))
+      {
+      bitpos = (uint64_t *)malloc( (nbsubset + 1) * sizeof(uint64_t) );
+      if (bufr_subset_boundaries( msg, tables, bitpos ) < 0)
+         {
+         free( bitpos );
+         return NULL;
+         }
+      }
+
+   nb = (subset_to - subset_from + per_part) / per_part;
+   parts = (BUFR_Message **)malloc( nb * sizeof(BUFR_Message *) );
+   for (k = 0; k < nb ; k++)
+      {
+      first = subset_from + k * per_part;
+      count = (subset_to - first + 1 < per_part) ? subset_to - first + 1 : per_part;
+      if (bitpos)
+         nbits = bitpos[first - 1 + count] - bitpos[first - 1];
+      else
+         nbits = (uint64_t)msg->s4.max_data_len * 8 * count / nbsubset;
+      parts[k] = bufr_create_part( msg, count, nbits / 8 + 4096 );
+      }
+
+   rtrn = 0;
+   if (bitpos)
+      {
+      for (k = 0; k < nb ; k++)
+         {
+         first = subset_from + k * per_part;
+         count = parts[k]->s3.no_data_subsets;
+         bufr_put_bitrange( parts[k], msg->s4.data, bitpos[first - 1],
+                            bitpos[first - 1 + count] - bitpos[first - 1] );
+         }
+      free( bitpos );
+      }
+   else
+      {
+      rtrn = bufr_slice_compressed( msg, tables, parts, nb, subset_from, per_part );
+      }
+
+   if (rtrn < 0)
+      {
+      for (k = 0; k < nb ; k++)
+         bufr_free_message( parts[k] );
+      free( parts );
+      return NULL;
+      }
+
+   for (k = 0; k < nb ; k++)
+      {
+      count = arr_count( msg->s3.desc_list );
+      for (i = 0; i < count ; i++)
+         arr_add( parts[k]->s3.desc_list, arr_get( msg->s3.desc_list, i ) );
+      bufr_end_message( parts[k] );
+      }
+
+   *nb_parts = nb;
+   return parts;
+   }
+
+/**
+ * @english
+ * create an empty message with the sections of another
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BUFR_Message *bufr_create_part( BUFR_Message *msg, int nb_subsets, unsigned int len )
+   {
+   BUFR_Message  *part;
+
+   part = bufr_create_message( msg->edition );
+   bufr_copy_sect1( &(part->s1), &(msg->s1) );
+   if ((msg->s1.flag & BUFR_FLAG_HAS_SECT2)&&(msg->s2.data_len > 0))
+      bufr_sect2_set_data( part, (const char *)msg->s2.data, msg->s2.data_len );
+   if (msg->header_string)
+      {
+      part->header_string = strdup( msg->header_string );
+      part->header_len = msg->header_len;
+      }
+   part->s3.flag = msg->s3.flag;
+   bufr_begin_message( part );
+   bufr_alloc_sect4( part, len );
+   BUFR_SET_NB_DATASET( part, nb_subsets );
+   return part;
+   }
+
+/**
+ * @english
+ * copy the blocks of a compressed message keeping the increments of
+ * the subsets of each part, R0 and NBINC are copied as they are
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static int bufr_slice_compressed
+   ( BUFR_Message *msg, BUFR_Tables *tables, BUFR_Message **parts, int nb_parts, int subset_from, int per_part )
+   {
+   BufrBlockIndex *idx;
+   BufrBlock      *blk;
+   int             i, k, first, count;
+
+   idx = bufr_create_block_index( msg, tables );
+   if (idx == NULL)
+      {
+      bufr_print_debug( _("Error: cannot split an invalid compressed message\n") );
+      return -1;
+      }
+
+   for (i = 0; i < idx->nb_blocks ; i++)
+      {
+      blk = &(idx->blocks[i]);
+      for (k = 0; k < nb_parts ; k++)
+         {
+         first = subset_from + k * per_part;
+         count = parts[k]->s3.no_data_subsets;
+         bufr_put_bitrange( parts[k], msg->s4.data, blk->r0pos, blk->nbits + 6 );
+         bufr_put_bitrange( parts[k], msg->s4.data, blk->incpos + (uint64_t)blk->inc_nbits * (first - 1),
+                            (uint64_t)blk->inc_nbits * count );
+         }
+      }
+
+   bufr_free_block_index( idx );
+   return 0;
+   }
@@ -0,0 +1,463 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+
+ * fichier : bufr_stats.c
+ *
+ * author:  Vanh Souvanlasy
+ *
+ * function: statistiques des valeurs des elements
+ *
+ * Count, minimum, maximum and sum of the numeric values of each element
+ * descriptor, accumulated over any number of messages. Compressed
+ * messages are not decoded: a block with no increment holds one value
+ * for every subset, otherwise the increments are summed as integers and
+ * only R0 plus the smallest and largest increment are converted.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "bufr_array.h"
+#include "bufr_io.h"
+#include "bufr_desc.h"
+#include "bufr_tables.h"
+#include "bufr_dataset.h"
+#include "bufr_blocks.h"
+#include "bufr_stats.h"
+#include "bufr_i18n.h"
+
+static BufrElementStats *bufr_stats_element      ( BufrStats *stats, int descriptor );
+static void              bufr_stats_add_values   ( BufrElementStats *es, int count, double vmin, double vmax,
+                                                   double sum );
+static void              bufr_stats_sum_block    ( BufrStats *stats, BufrBlockIndex *idx, BufrBlock *blk );
+
+/**
+ * @english
+ * @brief create an empty set of statistics
+ * @return the statistics, to free with bufr_free_stats
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_stats_add_message, bufr_print_stats
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+BufrStats *bufr_create_stats( void )
+   {
+   BufrStats  *stats;
+
+   stats = (BufrStats *)malloc( sizeof(BufrStats) );
+   stats->elems       = arr_create( 64, sizeof(BufrElementStats), 64 );
+   stats->nb_messages = 0;
+   stats->nb_subsets  = 0;
+   return stats;
+   }
+
+/**
+ * @english
+ * @brief free statistics
+ * @param stats  the statistics
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+void bufr_free_stats( BufrStats *stats )
+   {
+   if (stats == NULL) return;
+
+   arr_free( &(stats->elems) );
+   free( stats );
+   }
+
+/**
+ * @english
+ * @brief add the values of a message to statistics
+ *
+ * A compressed message is read from its blocks without being decoded,
+ * any other message is decoded.
+ * @param stats  the statistics
+ * @param msg  the message
+ * @param tables  tables used to decode it
+ * @return number of subsets added, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_stats_add_block_index, bufr_stats_add_dataset
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_stats_add_message( BufrStats *stats, BUFR_Message *msg, BUFR_Tables *tables )
+   {
+   BufrBlockIndex  *idx;
+   BUFR_Dataset    *dts;
+   unsigned char   *current;
+   unsigned short   bitno;
+   int              rtrn;
+
+   if ((stats == NULL)||(msg == NULL)) return -1;
+
+   if (BUFR_IS_COMPRESSED( msg ))
+      {
+      idx = bufr_create_block_index( msg, tables );
+      if (idx == NULL) return -1;
+      rtrn = bufr_stats_add_block_index( stats, idx );
+      bufr_free_block_index( idx );
+      return rtrn;
+      }
+
+   current = msg->s4.current;
+   bitno = msg->s4.bitno;
+   msg->s4.current = msg->s4.data;
+   msg->s4.bitno = 0;
+   dts = bufr_decode_message( msg, tables );
+   msg->s4.current = current;
+   msg->s4.bitno = bitno;
+   if (dts == NULL) return -1;
+   if (dts->data_flag & BUFR_FLAG_INVALID)
+      {
+      bufr_free_dataset( dts );
+      return -1;
+      }
+   rtrn = bufr_stats_add_dataset( stats, dts );
+   bufr_free_dataset( dts );
+   return rtrn;
+   }
+
+/**
+ * @english
+ * @brief add the values of an indexed compressed message to statistics
+ *
+ * Only the increments of the numeric blocks are read.
+ * @param stats  the statistics
+ * @param idx  block index of the message
+ * @return number of subsets added, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_create_block_index
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_stats_add_block_index( BufrStats *stats, BufrBlockIndex *idx )
+   {
+   BufrBlock  *blk;
+   int         i;
+
+   if ((stats == NULL)||(idx == NULL)) return -1;
+
+   for (i = 0; i < idx->nb_blocks ; i++)
+      {
+      blk = &(idx->blocks[i]);
+      if (blk->kind != BLOCK_NUMERIC) continue;
+      if (blk->bd->encoding.type != TYPE_NUMERIC) continue;
+      if (!bufr_is_table_b( blk->bd->descriptor )) continue;
+      bufr_stats_sum_block( stats, idx, blk );
+      }
+   stats->nb_messages += 1;
+   stats->nb_subsets += idx->nb_subsets;
+   return idx->nb_subsets;
+   }
+
+/**
+ * @english
+ * @brief add the values of a decoded dataset to statistics
+ * @param stats  the statistics
+ * @param dts  the dataset
+ * @return number of subsets added, -1 on error
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_stats_add_dataset( BufrStats *stats, BUFR_Dataset *dts )
+   {
+   BufrElementStats  *es;
+   DataSubset        *subset;
+   BufrDescriptor    *bd;
+   double             dval;
+   int                i, j, count, nbsubset;
+
+   if ((stats == NULL)||(dts == NULL)) return -1;
+
+   nbsubset = bufr_count_datasubset( dts );
+   for (i = 0; i < nbsubset ; i++)
+      {
+      subset = bufr_get_datasubset( dts, i );
+      count = bufr_datasubset_count_descriptor( subset );
+      for (j = 0; j < count ; j++)
+         {
+         bd = bufr_datasubset_get_descriptor( subset, j );
+         if (bd->flags & FLAG_SKIPPED) continue;
+         if (bd->encoding.type != TYPE_NUMERIC) continue;
+         if ((bd->value == NULL)||!bufr_is_table_b( bd->descriptor )) continue;
+
+         es = bufr_stats_element( stats, bd->descriptor );
+         if (bufr_value_is_missing( bd->value ))
+            {
+            es->nb_missing += 1;
+            continue;
+            }
+         dval = bufr_descriptor_get_dvalue( bd );
+         bufr_stats_add_values( es, 1, dval, dval, dval );
+         }
+      }
+   stats->nb_messages += 1;
+   stats->nb_subsets += nbsubset;
+   return nbsubset;
+   }
+
+/**
+ * @english
+ * @brief number of element descriptors in statistics
+ * @param stats  the statistics
+ * @return the count
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+int bufr_stats_count( BufrStats *stats )
+   {
+   if (stats == NULL) return 0;
+
+   return arr_count( stats->elems );
+   }
+
+/**
+ * @english
+ * @brief statistics of an element descriptor by position
+ * @param stats  the statistics
+ * @param pos  position from 0, in order of appearance
+ * @return the statistics, NULL if out of range
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+BufrElementStats *bufr_stats_get( BufrStats *stats, int pos )
+   {
+   if (stats == NULL) return NULL;
+
+   return (BufrElementStats *)arr_get( stats->elems, pos );
+   }
+
+/**
+ * @english
+ * @brief statistics of an element descriptor
+ * @param stats  the statistics
+ * @param descriptor  the element descriptor
+ * @return the statistics, NULL if the descriptor was not seen
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+BufrElementStats *bufr_stats_find( BufrStats *stats, int descriptor )
+   {
+   BufrElementStats  *es;
+   int                i, count;
+
+   count = bufr_stats_count( stats );
+   for (i = 0; i < count ; i++)
+      {
+      es = (BufrElementStats *)arr_get( stats->elems, i );
+      if (es->descriptor == descriptor) return es;
+      }
+   return NULL;
+   }
+
+/**
+ * @english
+ * @brief print statistics, one line per element descriptor
+ * @param stats  the statistics
+ * @param print_proc  output function, such as bufr_print_output
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup decode message
+ */
+void bufr_print_stats( BufrStats *stats, void (*print_proc)(const char *) )
+   {
+   BufrElementStats  *es;
+   char               buf[256];
+   int                i, count;
+
+   if (stats == NULL) return;
+
+   sprintf( buf, _("# messages=%d subsets=%d\n"), stats->nb_messages, stats->nb_subsets );
+   print_proc( buf );
+   print_proc( _("# descriptor count missing min max mean\n") );
+   count = bufr_stats_count( stats );
+   for (i = 0; i < count ; i++)
+      {
+      es = (BufrElementStats *)arr_get( stats->elems, i );
+      if (es->count > 0)
+         sprintf( buf, "%.6d %d %d %.10g %.10g %.10g\n", es->descriptor, es->count, es->nb_missing,
+                  es->min, es->max, es->sum / es->count );
+      else
+         sprintf( buf, "%.6d %d %d MSNG MSNG MSNG\n", es->descriptor, es->count, es->nb_missing );
+      print_proc( buf );
+      }
+   }
+
+/**
+ * @english
+ * statistics of a descriptor, added if not yet seen
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static BufrElementStats *bufr_stats_element( BufrStats *stats, int descriptor )
+   {
+   BufrElementStats  *es, elem;
+   int                count;
+
+/*
+ * a descriptor repeated in a row, as in a replication of a single
+ * element, is the last one added, any other one is searched for
+ */
+   count = arr_count( stats->elems );
+   if (count > 0)
+      {
+      es = (BufrElementStats *)arr_get( stats->elems, count - 1 );
+      if (es->descriptor == descriptor) return es;
+      }
+   es = bufr_stats_find( stats, descriptor );
+   if (es) return es;
+
+   elem.descriptor = descriptor;
+   elem.count      = 0;
+   elem.nb_missing = 0;
+   elem.min        = 0.0;
+   elem.max        = 0.0;
+   elem.sum        = 0.0;
+   arr_add( stats->elems, (char *)&elem );
+   return (BufrElementStats *)arr_get( stats->elems, count );
+   }
+
+/**
+ * @english
+ * add count values within vmin and vmax that sum to sum
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_stats_add_values( BufrElementStats *es, int count, double vmin, double vmax, double sum )
+   {
+   if (count <= 0) return;
+
+   if ((es->count == 0)||(vmin < es->min)) es->min = vmin;
+   if ((es->count == 0)||(vmax > es->max)) es->max = vmax;
+   es->count += count;
+   es->sum += sum;
+   }
+
+/**
+ * @english
+ * add the values of a numeric block, summed as integers above R0
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_stats_sum_block( BufrStats *stats, BufrBlockIndex *idx, BufrBlock *blk )
+   {
+   BufrElementStats  *es;
+   BUFR_Message      *msg;
+   unsigned char     *current;
+   unsigned short     bitno;
+   uint64_t           missing, inc_missing, inc, imin, imax, isum;
+   double             r0val;
+   int                i, count, errcode;
+
+   es = bufr_stats_element( stats, blk->bd->descriptor );
+   missing = bufr_missing_ivalue( blk->nbits );
+   if ((blk->inc_nbits == 0)||(blk->r0 >= missing))
+      {
+      if (blk->r0 >= missing)
+         es->nb_missing += idx->nb_subsets;
+      else
+         {
+         r0val = bufr_cvt_i64_to_dval( &(blk->bd->encoding), blk->r0 );
+         bufr_stats_add_values( es, idx->nb_subsets, r0val, r0val, r0val * idx->nb_subsets );
+         }
+      return;
+      }
+/*
+ * the increments follow each other, read them in one pass
+ */
+   msg = idx->msg;
+   current = msg->s4.current;
+   bitno = msg->s4.bitno;
+   msg->s4.current = msg->s4.data + blk->incpos / 8;
+   msg->s4.bitno = blk->incpos % 8;
+
+   inc_missing = bufr_missing_ivalue( blk->inc_nbits );
+   imin = inc_missing;
+   imax = 0;
+   isum = 0;
+   count = 0;
+   errcode = 0;
+   for (i = 0; (i < idx->nb_subsets)&&(errcode >= 0) ; i++)
+      {
+      inc = bufr_getbits( msg, blk->inc_nbits, &errcode );
+      if ((inc == inc_missing)||(blk->r0 + inc == missing)) continue;
+      if (inc < imin) imin = inc;
+      if (inc > imax) imax = inc;
+      isum += inc;
+      ++count;
+      }
+
+   msg->s4.current = current;
+   msg->s4.bitno = bitno;
+
+   es->nb_missing += idx->nb_subsets - count;
+   if (count == 0) return;
+/*
+ * the conversion is linear, the sum of the increments is scaled once
+ */
+   r0val = bufr_cvt_i64_to_dval( &(blk->bd->encoding), blk->r0 );
+   bufr_stats_add_values( es, count,
+                          bufr_cvt_i64_to_dval( &(blk->bd->encoding), blk->r0 + imin ),
+                          bufr_cvt_i64_to_dval( &(blk->bd->encoding), blk->r0 + imax ),
+                          r0val * count + (double)isum / bufr_pow10( blk->bd->encoding.scale ) );
+   }
@@ -31,6 +31,7 @@ This file is part of libECBUFR.
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include "bufr_array.h"
 #include "bufr_util.h"
 #include "bufr_io.h"
@@ -39,18 +40,44 @@ This file is part of libECBUFR.
 #include "bufr_tables.h"
 #include "bufr_sequence.h"
 #include "bufr_i18n.h"
+#include "private/bufr_priv_thread.h"
 
 static int          bad_descriptor=0;
 static BufrValueEncoding bufr_errtbe;
 static int          bufr_errcode= BUFR_NOERROR;
 static int          bufr_minimum_reference=0;
 static int          bufr_minimum_nbits=0;
+/*
+ * the cache of Table B entries grows while decoding, possibly from several
+ * threads sharing the same tables: an entry is published in its slot once
+ * found, so that looking it up again takes no lock
+ */
+static pthread_mutex_t  TableB_cache_lock=PTHREAD_MUTEX_INITIALIZER;
+#define TABLEB_CACHE_X     64
+#define TABLEB_CACHE_Y     256
+
+/*
+ * powers of ten used for scaling values, as exact as a double can hold
+ * them: 10^0 to 10^22 are exact, so that a negative scale is applied by
+ * multiplying with an exact value instead of dividing by an inexact one
+ */
+#define BUFR_POW10_MAX  32
+static const double bufr_pow10_tab[BUFR_POW10_MAX+1] =
+   {
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23,
+   1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31,
+   1e32
+   };
 
 
 static int             bufr_load_tableB       ( BUFR_Tables *, BufrTablesSet *tbls, const char *filename, int local );
 static int             bufr_load_tableD       ( BUFR_Tables *, BufrTablesSet *tbls, const char *filename );
 
 static EntryTableD    *bufr_tabled_fetch_entry( EntryTableDArray addr_tabled, int desc);
+static EntryTableB    *bufr_fetch_tableB_cached( BUFR_Tables *tbls, int desc, int slot );
+static void            bufr_clear_tableB_cache ( BUFR_Tables *tbls );
 
 static EntryTableBArray        bufr_tableb_read       ( EntryTableBArray addr_tableb, const char *filename, int local,
                                                 char *desc, int *cat, int *version );
@@ -77,6 +104,11 @@ static int                     bufr_csv_find_cell   ( char *value, char **cells,
 static EntryTableBArray        bufr_csv_read_tableb ( EntryTableBArray addr_tableb, const char *filename );
 static EntryTableDArray        bufr_csv_read_tabled ( EntryTableDArray addr_tabled, const char *filename);
 
+static double          bufr_descale_dval      ( double dval, int scale );
+static double          bufr_upscale_dval      ( double dval, int scale );
+static uint64_t        bufr_scale_dval        ( BufrValueEncoding *be, uint64_t maxval, double val_pow,
+                                                double fval, int *overflow );
+
 #define  DEBUG   0
 #if DEBUG
 static void test_print_tableD( char *tabled );
@@ -121,7 +153,7 @@ BUFR_Tables *bufr_create_tables(void)
    bufr_set_tables_category( t, 0, NULL );
 
    t->tableB_cache = NULL;
-   t->last_searched = NULL;
+   t->tableD_expansions = NULL;
    return t;
    }
 
@@ -175,7 +207,9 @@ void  bufr_free_tables( BUFR_Tables *tbls )
       }
 
    if (tbls->tableB_cache)
-      arr_free( &(tbls->tableB_cache) );
+      free( tbls->tableB_cache );
+
+   bufr_clear_tabled_expansions( tbls );
 
    free( tbls );
    }
@@ -243,6 +277,9 @@ void bufr_merge_tables( BUFR_Tables *tbls1, BUFR_Tables *tbls2 )
    {
    if ( tbls1 == NULL ) return;
    if ( tbls2 == NULL ) return;
+
+   bufr_clear_tabled_expansions( tbls1 );
+   bufr_clear_tableB_cache( tbls1 );
 /*
  * master tables are never copied on merged, only referenced
 
@@ -373,6 +410,7 @@ static int bufr_load_tableB( BUFR_Tables *tables, BufrTablesSet *tbls, const cha
    int   data_cat;
    int   version;
 
+   bufr_clear_tabled_expansions( tables );
    tbls->tableBtype = TYPE_ALLOCATED;
 
    data_cat_desc[0] = '\0';
@@ -478,6 +516,7 @@ static int bufr_load_tableD( BUFR_Tables *tbls, BufrTablesSet *tbl, const char *
    {
    int  rtrn;
 
+   bufr_clear_tabled_expansions( tbls );
    tbl->tableDtype = TYPE_ALLOCATED;
 
    if (tbl->tableD == NULL)
@@ -713,41 +752,68 @@ static int bufr_check_desc_tableD( BUFR_Tables *tbls, int desc , char *array )
  */
 EntryTableB *bufr_fetch_tableB(BUFR_Tables *tbls, int desc)
    {
-   int          f;
-   EntryTableB *e;
+   EntryTableB  *e, **cache;
+   int           x, y, slot;
 
 	if( tbls == NULL ) return errno=EINVAL, NULL;
 
-   if (tbls->last_searched)
+   switch( DESC_TO_F( desc ) )
       {
-      if (desc == tbls->last_searched->descriptor) 
-         return tbls->last_searched;
+      case 1 :
+      case 2 :
+      case 3 :
+         return NULL;
+      default :
+         break;
       }
 
-   if (tbls->tableB_cache)
+   x = DESC_TO_X( desc );
+   y = DESC_TO_Y( desc );
+   slot = -1;
+   if ((desc >= 0)&&(desc < 100000)&&(x < TABLEB_CACHE_X)&&(y < TABLEB_CACHE_Y))
       {
-      e = bufr_tableb_fetch_entry( tbls->tableB_cache, desc );
-      if (e != NULL) 
+      slot = x * TABLEB_CACHE_Y + y;
+      cache = BUFR_ATOMIC_LOAD( &(tbls->tableB_cache) );
+      if (cache)
          {
-         tbls->last_searched = e;
-         return e;
+         e = BUFR_ATOMIC_LOAD( &(cache[slot]) );
+         if (e) return e;
          }
       }
-   else
-      {
-      tbls->tableB_cache = (EntryTableBArray)arr_create( 100, sizeof(EntryTableB *), 100 );
-      }
 
-   f = DESC_TO_F( desc );
-   switch( f )
+   pthread_mutex_lock( &TableB_cache_lock );
+   e = bufr_fetch_tableB_cached( tbls, desc, slot );
+   pthread_mutex_unlock( &TableB_cache_lock );
+   return e;
+   }
+
+/**
+ * @english
+ * find a table B entry missing from the cache of the tables, and
+ * publish it in its slot of the cache, the cache lock being held
+ * @param  slot  slot of the descriptor in the cache, -1 if it has none
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static EntryTableB *bufr_fetch_tableB_cached( BUFR_Tables *tbls, int desc, int slot )
+   {
+   EntryTableB  *e, **cache;
+
+   cache = tbls->tableB_cache;
+   if ((cache == NULL)&&(slot >= 0))
       {
-      case 1 :
-      case 2 :
-      case 3 :
-         return NULL;
-      default :
-         break;
+      cache = (EntryTableB **)calloc( TABLEB_CACHE_X * TABLEB_CACHE_Y, sizeof(EntryTableB *) );
+      if (cache) BUFR_ATOMIC_STORE( &(tbls->tableB_cache), cache );
       }
+/*
+ * another thread may have found it meanwhile
+ */
+   if (cache && (slot >= 0) && cache[slot])
+      return cache[slot];
 
    e=NULL;
 
@@ -768,20 +834,39 @@ EntryTableB *bufr_fetch_tableB(BUFR_Tables *tbls, int desc)
       return NULL;
       }
 
-   arr_add( tbls->tableB_cache, (char *)&e );
-   arr_sort( tbls->tableB_cache, compare_tableb );
-
-   tbls->last_searched = e;
-
    if (e->encoding.reference != 0.0)
       {
       if (e->encoding.ref_nbits == 0)
          e->encoding.ref_nbits = bufr_value_nbits( e->encoding.reference );
       }
+/*
+ * the entry is complete before it becomes visible to other threads
+ */
+   if (cache && (slot >= 0))
+      BUFR_ATOMIC_STORE( &(cache[slot]), e );
 
    return e;
    }
 
+/**
+ * @english
+ * forget the Table B entries found so far, as the tables they come
+ * from are about to change
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static void bufr_clear_tableB_cache( BUFR_Tables *tbls )
+   {
+   pthread_mutex_lock( &TableB_cache_lock );
+   if (tbls->tableB_cache)
+      memset( tbls->tableB_cache, 0, TABLEB_CACHE_X * TABLEB_CACHE_Y * sizeof(EntryTableB *) );
+   pthread_mutex_unlock( &TableB_cache_lock );
+   }
+
 /**
  * @english
  * find and return a Table D entry
@@ -1688,31 +1773,24 @@ int bufr_parse_columns(const char *ligne, int *column, int limit)
  */
 int bufr_value_nbits(int64_t val)
    {
-   static uint64_t bmaxval[65] = {0};
-   static uint64_t bnegval[65] = {0};
    int i;
    uint64_t        ival;
 
-   if (bmaxval[0] == 0)
-      {
-      for ( i = 1 ; i <= 64 ; i++ )
-         {
-         bmaxval[i] = (1ULL<<i)-1L;
-         bnegval[i] = 1ULL<<i;
-         }
-      }
-
+/*
+ * no lazily filled tables here, this is called concurrently by
+ * the threaded encoder
+ */
    if (val >= 0)
       {
       ival = (uint64_t)val;
-      for ( i = 1 ; i <= 64 ; i++ )
-         if (bmaxval[i] > ival) break;
+      for ( i = 1 ; i < 64 ; i++ )
+         if (((1ULL<<i)-1) > ival) break;
       }
    else
       {
       ival = abs(val);
-      for ( i = 1 ; i <= 64 ; i++ )
-         if (bnegval[i-1] > ival) break;
+      for ( i = 2 ; i <= 64 ; i++ )
+         if ((1ULL<<(i-1)) > ival) break;
       }
 
    return i;
@@ -1783,9 +1861,9 @@ uint32_t bufr_cvt_fval_to_i32(int code, BufrValueEncoding *be, float fval)
  * compute value range
  */
    maxval = (1ULL << be->nbits) - 1;
-   ival_pow = val_pow = pow(10.0,(double)be->scale);
-   fmin = be->reference / val_pow;
-   fmax = ((maxval-1) + be->reference) / val_pow;
+   ival_pow = val_pow = bufr_pow10( be->scale );
+   fmin = bufr_descale_dval( be->reference, be->scale );
+   fmax = bufr_descale_dval( (maxval-1) + be->reference, be->scale );
 
    if (fval > fmax)
       {
@@ -1836,7 +1914,7 @@ uint32_t bufr_cvt_fval_to_i32(int code, BufrValueEncoding *be, float fval)
       }
    else
       {
-      int sval = round(fval * val_pow);
+      int sval = round( bufr_upscale_dval( fval, be->scale ) );
       ival = sval - be->reference;
       }
 
@@ -1844,7 +1922,7 @@ uint32_t bufr_cvt_fval_to_i32(int code, BufrValueEncoding *be, float fval)
       {
       char buffer[128];
       int32_t  minval;
-      minval = rint(fval * val_pow);
+      minval = rint( bufr_upscale_dval( fval, be->scale ) );
       bufr_minimum_reference = minval - 1;
       bufr_errtbe = *be;
       bad_descriptor = code;
@@ -1860,7 +1938,7 @@ uint32_t bufr_cvt_fval_to_i32(int code, BufrValueEncoding *be, float fval)
       char buffer[128];
 
       val1 = fval - fmax;
-      bufr_minimum_nbits = be->nbits + bufr_value_nbits( val1 * val_pow );
+      bufr_minimum_nbits = be->nbits + bufr_value_nbits( bufr_upscale_dval( val1, be->scale ) );
       bufr_errtbe = *be;
       bad_descriptor = code;
       bufr_errcode = BUFR_TB_OVERFLOW;
@@ -1891,23 +1969,12 @@ uint32_t bufr_cvt_fval_to_i32(int code, BufrValueEncoding *be, float fval)
 double bufr_cvt_i64_to_dval(BufrValueEncoding *be, int64_t ival)
    {
    double fval;
-   double val_pow;
    uint64_t  missing;
 
    missing = bufr_missing_ivalue( be->nbits );
    if ((ival < 0)||(ival == missing)) return bufr_get_max_double();
 
-   val_pow = pow(10.0,(double)be->scale);
-
-   if ((be->reference < 0) && (ival < (-be->reference)))
-      {
-      int64_t val = (int64_t)(ival + be->reference);
-      fval = (double)val / val_pow;
-      }
-   else
-      {
-      fval = (double)(ival + be->reference) / val_pow ;
-      }
+   fval = bufr_descale_dval( (double)(ival + be->reference), be->scale );
 
    return fval;
    }
@@ -1928,23 +1995,27 @@ double bufr_cvt_i64_to_dval(BufrValueEncoding *be, int64_t ival)
 float bufr_cvt_i32_to_fval(BufrValueEncoding *be, uint32_t ival)
    {
    float     fval;
-   float     val_pow;
    uint32_t  missing;
 
    missing = bufr_missing_ivalue( be->nbits );
    if (ival == missing) return bufr_get_max_float();
 
-   val_pow = pow(10.0,(double)be->scale);
-
    if ((be->reference < 0) && (ival < (-be->reference)))
       {
       int32_t val = (int32_t)(ival + be->reference);
-      fval = (float)val / val_pow;
+      fval = (float)val;
       }
    else
       {
-      fval = (float)(ival + be->reference) / val_pow ;
+      fval = (float)(ival + be->reference);
       }
+/*
+ * 10^n is exact in a float up to n=10, multiply rather than divide by 10^-n
+ */
+   if (be->scale < 0)
+      fval = fval * (float)bufr_pow10( -be->scale );
+   else if (be->scale > 0)
+      fval = fval / (float)bufr_pow10( be->scale );
 
    return fval;
    }
@@ -1966,15 +2037,13 @@ float bufr_cvt_i32_to_fval(BufrValueEncoding *be, uint32_t ival)
  */
 uint64_t bufr_cvt_dval_to_i64(int code, BufrValueEncoding *be, double fval)
    {
-   uint64_t  ival, rem;
+   uint64_t  ival;
    uint64_t  maxval;
    uint64_t  missing;
    double    val_pow;
-   int       ival_pow;
    double    val1;
    double    fmin, fmax;
    int       underflow=0, overflow=0;
-   int       delta;
 
    if (be->nbits > 32)
       {
@@ -1992,9 +2061,9 @@ uint64_t bufr_cvt_dval_to_i64(int code, BufrValueEncoding *be, double fval)
  * compute value range
  */
    maxval = (1ULL << be->nbits) - 1;
-   ival_pow = val_pow = pow(10.0,(double)be->scale);
-   fmin = be->reference / val_pow;
-   fmax = ((maxval-1) + be->reference) / val_pow;
+   val_pow = bufr_pow10( be->scale );
+   fmin = bufr_descale_dval( be->reference, be->scale );
+   fmax = bufr_descale_dval( (maxval-1) + be->reference, be->scale );
 
    if (fval > fmax)
       {
@@ -2013,8 +2082,128 @@ uint64_t bufr_cvt_dval_to_i64(int code, BufrValueEncoding *be, double fval)
       {
       underflow = 1;
       }
-   else if (be->scale >= 0)
+   else
+      {
+      ival = bufr_scale_dval( be, maxval, val_pow, fval, &overflow );
+      }
+
+   if (underflow)
+      {
+      char buffer[128];
+      int64_t  minval;
+      minval = rint( bufr_upscale_dval( fval, be->scale ) );
+      bufr_minimum_reference = minval - 1;
+      bufr_errtbe = *be;
+      bad_descriptor = code;
+      bufr_errcode = BUFR_TB_UNDERFLOW;
+      minval = (int64_t)ival - be->reference;
+      sprintf( buffer, _("Warning: UNDERFLOW with element %d : value = %e, giving %lld"),
+               code, fval, (long long)minval );
+      bufr_print_debug( buffer );
+      ival = maxval;
+      }
+   else if (overflow)
       {
+      char buffer[128];
+
+      val1 = fval - fmax;
+      bufr_minimum_nbits = be->nbits + bufr_value_nbits( bufr_upscale_dval( val1, be->scale ) );
+      bufr_errtbe = *be;
+      bad_descriptor = code;
+      bufr_errcode = BUFR_TB_OVERFLOW;
+      sprintf( buffer, _("Warning: OVERFLOW with element %d (max=%llu) : value = %e, giving %llu"),
+               code, (unsigned long long)maxval, fval,
+					(unsigned long long)missing );
+      bufr_print_debug( buffer );
+      ival = missing;
+      }
+
+   return ival;
+   }
+
+
+/**
+ * @english
+ * power of ten of a scale, taken from a table for the usual range
+ * @param  scale  : exponent
+ * @return 10^scale
+ * @endenglish
+ * @francais
+ * puissance de dix d'un facteur d'echelle
+ * @param  scale  : exposant
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+double bufr_pow10( int scale )
+   {
+   if ((scale >= 0)&&(scale <= BUFR_POW10_MAX))
+      return bufr_pow10_tab[scale];
+   if ((scale < 0)&&(scale >= -BUFR_POW10_MAX))
+      return 1.0 / bufr_pow10_tab[-scale];
+   return pow( 10.0, (double)scale );
+   }
+
+/**
+ * @english
+ * dval / 10^scale, a negative scale multiplies by an exact power of ten
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static double bufr_descale_dval( double dval, int scale )
+   {
+   if ((scale < 0)&&(scale >= -BUFR_POW10_MAX))
+      return dval * bufr_pow10_tab[-scale];
+   return dval / bufr_pow10( scale );
+   }
+
+/**
+ * @english
+ * dval * 10^scale, a negative scale divides by an exact power of ten
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static double bufr_upscale_dval( double dval, int scale )
+   {
+   if ((scale < 0)&&(scale >= -BUFR_POW10_MAX))
+      return dval / bufr_pow10_tab[-scale];
+   return dval * bufr_pow10( scale );
+   }
+
+/**
+ * @english
+ * @todo translate
+ * @endenglish
+ * @francais
+ * convertir une valeur reel deja verifiee dans l'intervalle de l'encodage
+ * @param       be       : encodage de la table B
+ * @param       maxval   : plus grande valeur de nbits
+ * @param       val_pow  : 10^scale
+ * @param       fval     : la valeur a convertir
+ * @param       overflow : mis a 1 si la valeur deborde
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+static uint64_t bufr_scale_dval
+   ( BufrValueEncoding *be, uint64_t maxval, double val_pow, double fval, int *overflow )
+   {
+   uint64_t  ival, rem;
+   int       ival_pow;
+   double    val1;
+   int       delta;
+
+   if (be->scale >= 0)
+      {
+      ival_pow = val_pow;
       val1 = fval - (be->reference / val_pow);
       ival = round(val1 * val_pow);
       delta = maxval-ival;
@@ -2041,48 +2230,131 @@ uint64_t bufr_cvt_dval_to_i64(int code, BufrValueEncoding *be, double fval)
             ival = sval - be->reference;
             }
          }
-      if (ival >= maxval) overflow = 1;
+      if (ival >= maxval) *overflow = 1;
       }
    else
       {
-      int64_t sval = round(fval * val_pow);
+      int64_t sval = round( bufr_upscale_dval( fval, be->scale ) );
       ival = sval - be->reference;
       }
+   return ival;
+   }
 
-   if (underflow)
+/**
+ * @english
+ * convert an array of encoded integers to real values with the encoding
+ * of a Table B entry, same as calling bufr_cvt_i64_to_dval for each
+ * @param       be     : Table B encoding
+ * @param       ivals  : values to convert
+ * @param       dvals  : output, missing values are set to bufr_get_max_double()
+ * @param       count  : number of values
+ * @return number of missing values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+int bufr_cvt_i64_to_dval_array
+   ( BufrValueEncoding *be, const int64_t *ivals, double *dvals, int count )
+   {
+   uint64_t  missing;
+   double    msng_val;
+   double    factor;
+   int64_t   reference;
+   int       i, nb_msng;
+
+   missing   = bufr_missing_ivalue( be->nbits );
+   msng_val  = bufr_get_max_double();
+   reference = be->reference;
+   nb_msng   = 0;
+
+   if ((be->scale < 0)&&(be->scale >= -BUFR_POW10_MAX))
       {
-      char buffer[128];
-      int64_t  minval;
-      minval = rint(fval * val_pow);
-      bufr_minimum_reference = minval - 1;
-      bufr_errtbe = *be;
-      bad_descriptor = code;
-      bufr_errcode = BUFR_TB_UNDERFLOW;
-      minval = (int64_t)ival - be->reference;
-      sprintf( buffer, _("Warning: UNDERFLOW with element %d : value = %e, giving %lld"),
-               code, fval, (long long)minval );
-      bufr_print_debug( buffer );
-      ival = maxval;
+      factor = bufr_pow10_tab[-be->scale];
+      for (i = 0; i < count ; i++)
+         dvals[i] = (double)(ivals[i] + reference) * factor;
       }
-   else if (overflow)
+   else
       {
-      char buffer[128];
-
-      val1 = fval - fmax;
-      bufr_minimum_nbits = be->nbits + bufr_value_nbits( val1 * val_pow );
-      bufr_errtbe = *be;
-      bad_descriptor = code;
-      bufr_errcode = BUFR_TB_OVERFLOW;
-      sprintf( buffer, _("Warning: OVERFLOW with element %d (max=%llu) : value = %e, giving %llu"),
-               code, (unsigned long long)maxval, fval,
-					(unsigned long long)missing );
-      bufr_print_debug( buffer );
-      ival = missing;
+      factor = bufr_pow10( be->scale );
+      for (i = 0; i < count ; i++)
+         dvals[i] = (double)(ivals[i] + reference) / factor;
       }
 
-   return ival;
+   for (i = 0; i < count ; i++)
+      {
+      if ((ivals[i] < 0)||(ivals[i] == missing))
+         {
+         dvals[i] = msng_val;
+         ++nb_msng;
+         }
+      }
+   return nb_msng;
    }
 
+/**
+ * @english
+ * convert an array of real values to encoded integers with the encoding
+ * of a Table B entry, same as calling bufr_cvt_dval_to_i64 for each
+ * @param       desc   : Table B descriptor
+ * @param       be     : Table B encoding
+ * @param       dvals  : values to convert
+ * @param       ivals  : output, missing values are set to all bits on
+ * @param       count  : number of values
+ * @return number of missing values
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author Vanh Souvanlasy
+ * @ingroup internal
+ */
+int bufr_cvt_dval_to_i64_array
+   ( int desc, BufrValueEncoding *be, const double *dvals, uint64_t *ivals, int count )
+   {
+   uint64_t  maxval;
+   uint64_t  missing;
+   double    val_pow;
+   double    fmin, fmax;
+   double    fval;
+   int       i, nb_msng, overflow;
+
+   missing = bufr_missing_ivalue( be->nbits );
+   nb_msng = 0;
+   if (be->nbits > 32)
+      {
+      for (i = 0; i < count ; i++)
+         ivals[i] = bufr_cvt_dval_to_i64( desc, be, dvals[i] );
+      return 0;
+      }
+
+   maxval = (1ULL << be->nbits) - 1;
+   val_pow = bufr_pow10( be->scale );
+   fmin = bufr_descale_dval( be->reference, be->scale );
+   fmax = bufr_descale_dval( (maxval-1) + be->reference, be->scale );
+
+   for (i = 0; i < count ; i++)
+      {
+      fval = dvals[i];
+      if (bufr_is_missing_double( fval ))
+         {
+         ivals[i] = missing;
+         ++nb_msng;
+         continue;
+         }
+      overflow = 0;
+      if ((fval >= fmin)&&(fval <= fmax))
+         ivals[i] = bufr_scale_dval( be, maxval, val_pow, fval, &overflow );
+/*
+ * out of range values are reported by the single value conversion
+ */
+      if ((fval < fmin)||(fval > fmax)||overflow)
+         ivals[i] = bufr_cvt_dval_to_i64( desc, be, fval );
+      }
+   return nb_msng;
+   }
 
 /**
  * @english
@@ -2498,6 +2770,7 @@ int bufr_load_csv_tableB( BUFR_Tables *tables, const char *filename )
    {
    BufrTablesSet  *tbls;
 
+   bufr_clear_tabled_expansions( tables );
    tbls = &(tables->master);
    tbls->tableBtype = TYPE_ALLOCATED;
 
@@ -2556,6 +2829,7 @@ int bufr_load_csv_tableD( BUFR_Tables *tables, const char *filename )
    int  rtrn;
    BufrTablesSet  *tbls;
 
+   bufr_clear_tabled_expansions( tables );
    tbls = &(tables->master);
    tbls->tableDtype = TYPE_ALLOCATED;
 
@@ -21,6 +21,14 @@ This file is part of libECBUFR.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "config.h"
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include "bufr_util.h"
 
@@ -313,6 +321,106 @@ char *str_nstrtok( char **pptr, char *deli )
    return tok;
    }
 
+/**
+ * @english
+ * @brief map a whole file in memory for reading
+ *
+ * The file is mapped read only when mmap is available, else read at
+ * once into an allocated buffer
+ *
+ * @param filename  file to read
+ * @param size      receives the size of the file
+ * @param mapped    receives 1 if the file was mapped, 0 if it was read
+ * @return the content of the file, NULL if it can't be read
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @see bufr_unmap_file
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+char *bufr_map_file( const char *filename, size_t *size, int *mapped )
+   {
+   struct stat    st;
+   int            fd;
+   char          *base;
+   size_t         pos;
+   ssize_t        got;
+
+   *size = 0;
+   *mapped = 0;
+   fd = open( filename, O_RDONLY );
+   if (fd < 0) return NULL;
+   if (fstat( fd, &st ) < 0)
+      {
+      close( fd );
+      return NULL;
+      }
+
+   base = NULL;
+#if HAVE_SYS_MMAN_H
+   if (st.st_size > 0)
+      {
+      base = (char *)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if (base == MAP_FAILED)
+         base = NULL;
+      else
+         *mapped = 1;
+      }
+#endif
+   if (base == NULL)
+      {
+      base = (char *)malloc( st.st_size + 1 );
+      if (base == NULL)
+         {
+         close( fd );
+         return NULL;
+         }
+      for (pos = 0; pos < (size_t)st.st_size ; pos += got)
+         {
+         got = read( fd, base + pos, st.st_size - pos );
+         if (got <= 0) break;
+         }
+      if (pos < (size_t)st.st_size)
+         {
+         free( base );
+         close( fd );
+         return NULL;
+         }
+      base[pos] = '\0';
+      }
+   close( fd );
+   *size = st.st_size;
+   return base;
+   }
+
+/**
+ * @english
+ * @brief release a file obtained from bufr_map_file
+ * @param base    content of the file
+ * @param size    size of the file
+ * @param mapped  mapped flag given by bufr_map_file
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @ingroup internal
+ */
+void bufr_unmap_file( char *base, size_t size, int mapped )
+   {
+   if (base == NULL) return;
+#if HAVE_SYS_MMAN_H
+   if (mapped)
+      {
+      munmap( base, size );
+      return;
+      }
+#endif
+   free( base );
+   }
+
 #if defined(__MINGW32__)
 char *mock_strtok_r( char *str, char *deli, char **pptr )
    {
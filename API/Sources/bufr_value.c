@@ -30,7 +30,6 @@ This file is part of libECBUFR.
 #include <math.h>
 #include <ctype.h>
 
-
 #include "bufr_io.h"
 #include "bufr_ieee754.h"
 #include "bufr_value.h"
@@ -38,6 +37,7 @@ This file is part of libECBUFR.
 #include "bufr_i18n.h"
 #include "bufr_util.h"
 #include "private/gcmemory.h"
+#include "private/bufr_priv_pool.h"
 #include "config.h"
 
 static void * ValueINT8_gcmemory=NULL;
@@ -48,6 +48,39 @@ static void * ValueFLT32_gcmemory=NULL;
 static void * ValueFLT64_gcmemory=NULL;
 static void * ValueSTRING_gcmemory=NULL;
 
+#if (!USE_GCMEMORY)
+/*
+ * Without the garbage collector, values are cells carved out of contiguous
+ * chunks instead of one malloc per decoded element. Values of FLT64 and
+ * STRING types need a wider cell than the other types, each size has its
+ * own pool so that integer values keep their natural size.
+ */
+typedef union
+   {
+   BufrValue          bv;
+   ValueINT8          i8;
+   ValueINT32         i32;
+   ValueINT64         i64;
+   ValueFLT32         f32;
+   } ValueCell;
+
+typedef union
+   {
+   ValueFLT64         f64;
+   ValueSTRING        str;
+   } ValueWideCell;
+
+static BufrPool                     ValueCell_pool=BUFR_POOL_INITIALIZER(sizeof(ValueCell),4096);
+static BufrPool                     ValueWideCell_pool=BUFR_POOL_INITIALIZER(sizeof(ValueWideCell),4096);
+static BUFR_THREAD_LOCAL BufrPoolCache  ValueCell_cache;
+static BUFR_THREAD_LOCAL BufrPoolCache  ValueWideCell_cache;
+
+#define bufr_alloc_value_cell()      bufr_pool_alloc( &ValueCell_pool, &ValueCell_cache )
+#define bufr_free_value_cell(c)      bufr_pool_free( &ValueCell_pool, &ValueCell_cache, (c) )
+#define bufr_alloc_value_widecell()  bufr_pool_alloc( &ValueWideCell_pool, &ValueWideCell_cache )
+#define bufr_free_value_widecell(c)  bufr_pool_free( &ValueWideCell_pool, &ValueWideCell_cache, (c) )
+#endif
+
 /**
  * @english
  * @brief create a new BufrValue structure
@@ -64,7 +97,6 @@ static void * ValueSTRING_gcmemory=NULL;
  * @endfrancais
  * @author  Vanh Souvanlasy
  * @see ValueType, bufr_duplicate_value
- * @bug should be checking the results of malloc() calls
  * @ingroup descriptor
  */
 BufrValue  *bufr_create_value( ValueType type )
@@ -92,8 +124,9 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v         = gcmem_alloc(ValueINT8_gcmemory);
 #else
-         v         = (ValueINT8 *)malloc( sizeof(ValueINT8) );
+         v         = bufr_alloc_value_cell();
 #endif
+         if (v == NULL) return NULL;
          v->type   = type;
          v->value  = -1;
          v->af     = NULL;
@@ -107,8 +140,9 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v1         = gcmem_alloc(ValueINT32_gcmemory);
 #else
-         v1         = (ValueINT32 *)malloc( sizeof(ValueINT32) );
+         v1         = bufr_alloc_value_cell();
 #endif
+         if (v1 == NULL) return NULL;
          v1->type   = type;
          v1->value  = -1;
          v1->af     = NULL;
@@ -122,8 +156,9 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v2         = gcmem_alloc(ValueINT64_gcmemory);
 #else
-         v2         = (ValueINT64 *)malloc( sizeof(ValueINT64) );
+         v2         = bufr_alloc_value_cell();
 #endif
+         if (v2 == NULL) return NULL;
          v2->type   = type;
          v2->value  = -1;
          v2->af     = NULL;
@@ -137,8 +172,9 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v3         = gcmem_alloc(ValueFLT32_gcmemory);
 #else
-         v3         = (ValueFLT32 *)malloc( sizeof(ValueFLT32) );
+         v3         = bufr_alloc_value_cell();
 #endif
+         if (v3 == NULL) return NULL;
          v3->type   = type;
          v3->value  = bufr_get_max_float();
          v3->af     = NULL;
@@ -152,10 +188,12 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v4         = gcmem_alloc(ValueFLT64_gcmemory);
 #else
-         v4         = (ValueFLT64 *)malloc( sizeof(ValueFLT64) );
+         v4         = bufr_alloc_value_widecell();
 #endif
+         if (v4 == NULL) return NULL;
          v4->type   = type;
          v4->value  = bufr_get_max_double();
+         v4->has_scaled = 0;
          v4->af     = NULL;
          bv         = (BufrValue *)v4;
          }
@@ -166,8 +204,9 @@ BufrValue  *bufr_create_value( ValueType type )
 #if USE_GCMEMORY
          v5         = gcmem_alloc(ValueSTRING_gcmemory);
 #else
-         v5         = (ValueSTRING *)malloc( sizeof(ValueSTRING) );
+         v5         = bufr_alloc_value_widecell();
 #endif
+         if (v5 == NULL) return NULL;
          v5->type   = type;
          v5->value  = NULL;
          v5->len    = 0;
@@ -176,7 +215,12 @@ BufrValue  *bufr_create_value( ValueType type )
          }
          break;
       default :
+#if USE_GCMEMORY
          bv         = (BufrValue *)malloc( sizeof(BufrValue) );
+#else
+         bv         = bufr_alloc_value_cell();
+#endif
+         if (bv == NULL) return NULL;
          bv->type   = VALTYPE_UNDEFINE;
          bv->af     = NULL;
          break;
@@ -249,35 +293,35 @@ void bufr_free_value( BufrValue *bv )
 #if USE_GCMEMORY
          gcmem_dealloc(ValueINT8_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_cell( bv );
 #endif
          break;
       case VALTYPE_INT32 :
 #if USE_GCMEMORY
          gcmem_dealloc(ValueINT32_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_cell( bv );
 #endif
          break;
       case VALTYPE_INT64 :
 #if USE_GCMEMORY
          gcmem_dealloc(ValueINT64_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_cell( bv );
 #endif
          break;
       case VALTYPE_FLT32 :
 #if USE_GCMEMORY
          gcmem_dealloc(ValueFLT32_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_cell( bv );
 #endif
          break;
       case VALTYPE_FLT64 :
 #if USE_GCMEMORY
          gcmem_dealloc(ValueFLT64_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_widecell( bv );
 #endif
          break;
       case VALTYPE_STRING :
@@ -286,7 +330,7 @@ void bufr_free_value( BufrValue *bv )
 
          if (s->value != NULL) 
             {
-            free( s->value );
+            if (s->value != s->small) free( s->value );
             s->value = NULL;
             s->len = 0;
             }
@@ -294,13 +338,13 @@ void bufr_free_value( BufrValue *bv )
 #if USE_GCMEMORY
          gcmem_dealloc(ValueSTRING_gcmemory, bv);
 #else
-         free( bv );
+         bufr_free_value_widecell( bv );
 #endif
          break;
       case VALTYPE_UNDEFINE :
       default :
 #if (!USE_GCMEMORY)
-        free( bv );
+        bufr_free_value_cell( bv );
 #endif
          break;
       }
@@ -362,7 +406,10 @@ void bufr_copy_value( BufrValue *dest, const BufrValue *src )
       case VALTYPE_FLT64 :
          {
          ValueFLT64 *vs=(ValueFLT64 *)src;
-         bufr_value_set_double( dest, vs->value );
+         if (vs->has_scaled)
+            bufr_value_set_scaled( dest, vs->scaled, vs->scale, vs->value );
+         else
+            bufr_value_set_double( dest, vs->value );
          }
          break;
       case VALTYPE_STRING :
@@ -437,6 +484,11 @@ int bufr_value_set_string
       value = old_str;
       old_str = NULL;
       }
+   else if (len <= VALSTRING_SMALL_LEN)
+      {
+      value = vstr->small;
+      if (old_str == value) old_str = NULL;
+      }
    else
       {
       value = (char *)malloc( (len+1) * sizeof(char) );
@@ -476,7 +528,7 @@ int bufr_value_set_string
          value[i] = '\377';
       }
    value[len] = '\0';
-   if ( old_str ) free( old_str );
+   if ( old_str && (old_str != vstr->small) ) free( old_str );
 
    vstr->value = value;
    vstr->len   = len;
@@ -520,6 +572,7 @@ int bufr_value_set_int32( BufrValue *bv, int value )
          ValueFLT64 *v = (ValueFLT64 *)bv;
 
          v->value = (double)value;
+         v->has_scaled = 0;
          }
       break;
       case VALTYPE_INT32 :
@@ -587,6 +640,7 @@ int bufr_value_set_int64( BufrValue *bv, int64_t value )
       ValueFLT64 *v = (ValueFLT64 *)bv;
 
       v->value = (double)value;
+      v->has_scaled = 0;
       rtrn = 1;
       }
    else if (bv->type == VALTYPE_INT8)
@@ -651,6 +705,7 @@ int bufr_value_set_float( BufrValue *bv, float value )
       ValueFLT64 *v = (ValueFLT64 *)bv;
 
       v->value = (double)value;
+      v->has_scaled = 0;
       rtrn = 1;
       }
    else if (bv->type == VALTYPE_INT8)
@@ -723,6 +778,7 @@ int bufr_value_set_double( BufrValue *bv, double value )
       ValueFLT64 *v = (ValueFLT64 *)bv;
 
       v->value = value;
+      v->has_scaled = 0;
       rtrn = 1;
       }
    else if (bv->type == VALTYPE_INT8)
@@ -758,6 +814,76 @@ int bufr_value_set_double( BufrValue *bv, double value )
    return rtrn;
    }
 
+/**
+ * @english
+ * @brief assign a value together with its scaled integer form
+ *
+ * The scaled integer is the value multiplied by 10^scale of its Table B
+ * encoding, ie. the decoded bits plus the reference. It is kept along
+ * the value so that it can be read back or encoded without any floating
+ * point conversion. It is only retained by 64-bit floating point values,
+ * other types receive dval as with bufr_value_set_double.
+ *
+ * @param bv pointer to BufrValue structure to change
+ * @param scaled value * 10^scale
+ * @param scale the scale of the encoding
+ * @param dval the same value as a double, or missing
+ * @return 1 on success, -1 on failure
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @see bufr_value_get_scaled, bufr_descriptor_set_scaled
+ * @ingroup descriptor
+ */
+int bufr_value_set_scaled( BufrValue *bv, int64_t scaled, int scale, double dval )
+   {
+   if (bv == NULL) return -1;
+
+   if (bv->type == VALTYPE_FLT64)
+      {
+      ValueFLT64 *v = (ValueFLT64 *)bv;
+
+      v->value = dval;
+      v->scaled = scaled;
+      v->scale = scale;
+      v->has_scaled = !bufr_is_missing_double( dval );
+      return 1;
+      }
+   return bufr_value_set_double( bv, dval );
+   }
+
+/**
+ * @english
+ * @brief get the scaled integer form of a value if it is known exactly
+ *
+ * @param bv pointer to BufrValue
+ * @param scaled output, value * 10^scale
+ * @param scale output, the scale it was set with
+ * @return 1 if known, 0 otherwise
+ * @endenglish
+ * @francais
+ * @todo translate to French
+ * @endfrancais
+ * @author  Vanh Souvanlasy
+ * @see bufr_value_set_scaled, bufr_descriptor_get_scaled
+ * @ingroup descriptor
+ */
+int bufr_value_get_scaled( const BufrValue *bv, int64_t *scaled, int *scale )
+   {
+   const ValueFLT64 *v;
+
+   if ((bv == NULL)||(bv->type != VALTYPE_FLT64)) return 0;
+
+   v = (const ValueFLT64 *)bv;
+   if (v->has_scaled == 0) return 0;
+
+   *scaled = v->scaled;
+   *scale  = v->scale;
+   return 1;
+   }
+
 /**
  * @english
  * @brief get a 32-bit integer from a BufrValue
@@ -1057,27 +1183,13 @@ const char *bufr_value_get_string( const BufrValue *bv, int *len )
  */
 uint64_t bufr_missing_ivalue( int nbits )
    {
-   static uint64_t msng_values[65];
-   static int      initialized=0;
-
-   if (initialized == 0)
-      {
-      int i;
-      msng_values[0] = 0;
-      for (i = 1; i <= 64 ; i++)
-         {
-         msng_values[i] = (1ULL << i) - 1L;
-         }
-      initialized=1;
-      }
-
+/*
+ * computed each time rather than from a table filled on first use,
+ * which threads encoding together could see half filled
+ */
    if (nbits <= 0) return 0;
-   if (nbits >= 64) return msng_values[64];
-   return msng_values[nbits];
-//   uint64_t v;
-//   if ((nbits >= 64)||(nbits <= 0)) return -1;
-//   v = (1ULL << nbits) - 1L;
-//   return v;
+   if (nbits >= 64) return ~(uint64_t)0;
+   return ((uint64_t)1 << nbits) - 1;
    }
 
 /**
@@ -0,0 +1,227 @@
+/*
+Unit test for the archive index. Every message of a few sample files is
+appended to one archive; station, time window and bounding box queries on
+the index, and on the index written to disk and read back, must return the
+very same messages as a scan of every message.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static const char *files[] = {
+	"BUFR/dpbm_fostats.bufr",
+	"BUFR/tableC_202YYY.bufr",
+	"BUFR/iobx12_kars_131338.bufr",
+	"BUFR/iuaa01_cwoa_1.bufr",
+	"BUFR/isaa41_cyul.bufr",
+	"BUFR/ismd01_okpr.bufr",
+	"BUFR/AMDAR+2xUS-v15.bufr",
+	"BUFR/lamwest_buf12.bufr",
+	NULL
+};
+
+/* every message of the files, one after the other */
+static int make_archive( const char *filename )
+	{
+	FILE          *fp, *fpO;
+	BUFR_Message  *msg;
+	int            i, count;
+
+	fpO = fopen( filename, "wb" );
+	assert( fpO != NULL );
+	count = 0;
+	for (i = 0; files[i] ; i++)
+		{
+		fp = fopen( files[i], "rb" );
+		assert( fp != NULL );
+		while (bufr_read_message( fp, &msg ) > 0)
+			{
+			bufr_write_message( fpO, msg );
+			bufr_free_message( msg );
+			++count;
+			}
+		fclose( fp );
+		}
+	fclose( fpO );
+	return count;
+	}
+
+/* what the index must answer, by looking at every message */
+static int brute_query( BufrArchiveIndex *idx, double lat0, double lat1, double lon0, double lon1,
+                        int64_t t0, int64_t t1, long *offsets )
+	{
+	BufrArchiveEntry *e;
+	int               i, nb;
+
+	nb = 0;
+	for (i = 0; i < arr_count( idx->entries ) ; i++)
+		{
+		e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+		if ((e->time_max < t0)||(e->time_min > t1)) continue;
+		if ((e->flags & ARCHIVE_HAS_LOCATION)&&
+		    ((e->lat_max < lat0)||(e->lat_min > lat1)||(e->lon_max < lon0)||(e->lon_min > lon1)))
+			continue;
+		offsets[nb++] = e->offset;
+		}
+	return nb;
+	}
+
+static void check_queries( BufrArchiveIndex *idx, BufrArchiveIndex *idx2 )
+	{
+	BufrArchiveEntry *e;
+	long             *offsets, *offsets2, *expected;
+	int               i, j, nb, count;
+	double            lat0, lon0;
+	int64_t           t0, tmin, tmax;
+
+	count = arr_count( idx->entries );
+	expected = (long *)malloc( count * sizeof(long) );
+
+	/* the whole world at any time */
+	assert( bufr_archive_index_query( idx, -90, 90, -180, 180, INT64_MIN, INT64_MAX, NULL, &offsets ) == count );
+	free( offsets );
+
+	tmin = INT64_MAX;
+	tmax = INT64_MIN;
+	for (i = 0; i < count ; i++)
+		{
+		e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+		if (e->time_min < tmin) tmin = e->time_min;
+		if (e->time_max > tmax) tmax = e->time_max;
+		}
+
+	/* boxes and windows of the grid against looking at every message */
+	for (i = 0; i < 400 ; i++)
+		{
+		lat0 = -90.0 + (i * 37) % 170;
+		lon0 = -180.0 + (i * 53) % 350;
+		t0 = tmin + (tmax - tmin) / 400 * i - 86400;
+		nb = brute_query( idx, lat0, lat0 + 5 + i % 20, lon0, lon0 + 5 + i % 30, t0, t0 + 3600 * (i % 48),
+		                  expected );
+		assert( bufr_archive_index_query( idx, lat0, lat0 + 5 + i % 20, lon0, lon0 + 5 + i % 30,
+		                                  t0, t0 + 3600 * (i % 48), NULL, &offsets ) == nb );
+		assert( bufr_archive_index_query( idx2, lat0, lat0 + 5 + i % 20, lon0, lon0 + 5 + i % 30,
+		                                  t0, t0 + 3600 * (i % 48), NULL, &offsets2 ) == nb );
+		for (j = 0; j < nb ; j++)
+			assert( (offsets[j] == expected[j])&&(offsets2[j] == expected[j]) );
+		free( offsets );
+		free( offsets2 );
+		}
+
+	/* each message is found by its own extent and stations */
+	for (i = 0; i < count ; i++)
+		{
+		e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+		nb = bufr_archive_index_query( idx, e->lat_min, e->lat_max, e->lon_min, e->lon_max,
+		                               e->time_min, e->time_max,
+		                               (e->nb_stations > 0) ? e->stations[0] : NULL, &offsets );
+		for (j = 0; (j < nb)&&(offsets[j] != e->offset) ; j++) ;
+		assert( j < nb );
+		free( offsets );
+		}
+	free( expected );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables      *tables=NULL;
+   BufrArchiveIndex *idx, *idx2;
+   BufrArchiveEntry *e;
+   BUFR_Message     *msg;
+   FILE             *fp;
+   char              tag[4];
+   int               i, count, nb_located;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_archive.DEBUG" );
+	bufr_set_output_file( "test_archive.OUTPUT" );
+
+	count = make_archive( "test_archive.bufr" );
+
+	idx = bufr_create_archive_index();
+	fp = fopen( "test_archive.bufr", "rb" );
+	assert( bufr_archive_index_add_file( idx, fp, tables ) == count );
+	assert( arr_count( idx->entries ) == count );
+
+	/* offsets lead back to the messages */
+	nb_located = 0;
+	for (i = 0; i < count ; i++)
+		{
+		e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+		assert( fseek( fp, e->offset, SEEK_SET ) == 0 );
+		assert( fread( tag, 1, 4, fp ) == 4 );
+		assert( memcmp( tag, "BUFR", 4 ) == 0 );
+		assert( fseek( fp, e->offset, SEEK_SET ) == 0 );
+		assert( bufr_read_message( fp, &msg ) > 0 );
+		assert( msg->offset == e->offset );
+		assert( msg->len_msg == e->length );
+		bufr_free_message( msg );
+		assert( e->time_min <= e->time_max );
+		if (e->flags & ARCHIVE_HAS_LOCATION)
+			{
+			assert( (e->lat_min <= e->lat_max)&&(e->lon_min <= e->lon_max) );
+			++nb_located;
+			}
+		}
+	fclose( fp );
+	assert( nb_located > 0 );
+
+	/* the same index once written and read back */
+	fp = fopen( "test_archive.idx", "w" );
+	assert( bufr_archive_index_write( idx, fp ) == count );
+	fclose( fp );
+	fp = fopen( "test_archive.idx", "r" );
+	idx2 = bufr_archive_index_read( fp );
+	fclose( fp );
+	assert( idx2 != NULL );
+	assert( arr_count( idx2->entries ) == count );
+
+	check_queries( idx, idx2 );
+
+	assert( bufr_archive_time( 1970, 1, 1, 0, 0, 0 ) == 0 );
+	assert( bufr_archive_time( 2000, 3, 1, 12, 30, 15 ) == 951913815 );
+	assert( bufr_archive_hour( "2000030112" ) == 951912000 );
+	assert( bufr_archive_hour( "200003" ) == INT64_MIN );
+
+	bufr_free_archive_index( idx );
+	bufr_free_archive_index( idx2 );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
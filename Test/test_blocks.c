@@ -0,0 +1,283 @@
+/*
+Unit test for the block index of compressed messages. Without decoding,
+each block must give the bounds of its values, never rule out a key that
+the decoded data holds, and read back the very values that
+bufr_decode_message gives.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+/* every value decoded from a block lies within its bounds */
+static void check_bounds( BufrBlockIndex *idx, BUFR_Dataset *dts )
+	{
+	BufrBlock      *blk;
+	BufrDescriptor *bd;
+	double          vmin, vmax, val;
+	int             i, j, nbounded=0;
+
+	for (i = 0; i < idx->nb_blocks ; i++)
+		{
+		blk = &(idx->blocks[i]);
+		if (blk->kind != BLOCK_NUMERIC) continue;
+		if (bufr_block_bounds( idx, i, &vmin, &vmax ) != 1) continue;
+		assert( vmin <= vmax );
+		nbounded++;
+		for (j = 0; j < idx->nb_subsets ; j++)
+			{
+			bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, j ), blk->pos );
+			assert( bd->descriptor == blk->bd->descriptor );
+			if ((bd->value == NULL)||bufr_value_is_missing( bd->value )) continue;
+			val = bufr_descriptor_get_dvalue( bd );
+			assert( val >= vmin - 1e-6 * (fabs( vmin ) + 1.0) );
+			assert( val <= vmax + 1e-6 * (fabs( vmax ) + 1.0) );
+			}
+		}
+	assert( nbounded > 0 );
+	}
+
+/* a key taken from the data may match, one above every block may not */
+static void check_keys( BufrBlockIndex *idx, BUFR_Dataset *dts )
+	{
+	BufrBlock      *blk;
+	BufrDescriptor *bd;
+	BufrDescValue   key;
+	DataSubset     *dss;
+	char           *candidates;
+	double          vmin, vmax, top;
+	float           fval;
+	int             i, j, k, nb, nbchecked=0;
+
+	candidates = (char *)malloc( idx->nb_subsets );
+	for (i = 0; i < idx->nb_blocks ; i++)
+		{
+		blk = &(idx->blocks[i]);
+		if (blk->kind != BLOCK_NUMERIC) continue;
+		if (bufr_block_bounds( idx, i, &vmin, &vmax ) != 1) continue;
+		if (blk->bd->value->type != VALTYPE_INT32) continue;
+/*
+ * the key descriptor must be bounded wherever it appears
+ */
+		top = vmax;
+		for (k = 0; k < idx->nb_blocks ; k++)
+			{
+			if (idx->blocks[k].kind == BLOCK_AF) continue;
+			if (idx->blocks[k].bd->descriptor != blk->bd->descriptor) continue;
+			if (bufr_block_bounds( idx, k, &vmin, &vmax ) != 1) break;
+			if (vmax > top) top = vmax;
+			}
+		if (k < idx->nb_blocks) continue;
+
+		bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, idx->nb_subsets - 1 ), blk->pos );
+		if (bufr_value_is_missing( bd->value )) continue;
+
+		fval = bufr_descriptor_get_dvalue( bd );
+		/* a float key cannot hold every large count */
+		if ((double)fval != bufr_descriptor_get_dvalue( bd )) continue;
+		bufr_init_DescValue( &key );
+		bufr_set_key_flt32( &key, bd->descriptor, &fval, 1 );
+		assert( bufr_block_index_may_match( idx, &key, 1 ) == 1 );
+		nb = bufr_block_index_candidates( idx, &key, 1, candidates );
+		assert( nb >= 1 );
+		assert( candidates[idx->nb_subsets - 1] );
+		for (j = 0; j < idx->nb_subsets ; j++)
+			{
+			dss = bufr_get_datasubset( dts, j );
+			assert( (bufr_subset_find_values( dss, &key, 1, 0 ) >= 0) == (candidates[j] != 0) );
+			}
+		bufr_vfree_DescValue( &key );
+
+		fval = top + 1000.0;
+		bufr_init_DescValue( &key );
+		bufr_set_key_flt32( &key, bd->descriptor, &fval, 1 );
+		assert( bufr_block_index_may_match( idx, &key, 1 ) == 0 );
+		assert( bufr_block_index_candidates( idx, &key, 1, candidates ) == 0 );
+		bufr_vfree_DescValue( &key );
+
+		/* the bounds leave missing values out, a key on one is never ruled out */
+		fval = bufr_missing_float();
+		bufr_init_DescValue( &key );
+		bufr_set_key_flt32( &key, bd->descriptor, &fval, 1 );
+		assert( bufr_block_index_may_match( idx, &key, 1 ) == 1 );
+		assert( bufr_block_index_candidates( idx, &key, 1, candidates ) == idx->nb_subsets );
+		bufr_vfree_DescValue( &key );
+		nbchecked++;
+		}
+	free( candidates );
+	assert( nbchecked > 0 );
+	}
+
+/* every value read from the blocks is the decoded one */
+static void check_values( BufrBlockIndex *idx, BUFR_Dataset *dts )
+	{
+	BufrDescriptor *bd, *bd2;
+	DataSubset     *dss;
+	double          dval;
+	int             i, j, pos, count;
+
+	count = bufr_datasubset_count_descriptor( bufr_get_datasubset( dts, 0 ) );
+	assert( count == idx->nb_positions );
+	for (i = 0; i < idx->nb_subsets ; i++)
+		{
+		dss = bufr_get_datasubset( dts, i );
+		for (j = 0; j < count ; j++)
+			{
+			bd = bufr_datasubset_get_descriptor( dss, j );
+			bd2 = bufr_block_index_get_descriptor( idx, i, j );
+			assert( bd2 != NULL );
+			assert( bd->descriptor == bd2->descriptor );
+			if (bd->value && !(bd->flags & FLAG_SKIPPED))
+				{
+				assert( bd2->value != NULL );
+				assert( bufr_compare_value( bd->value, bd2->value, 1e-9 ) == 0 );
+				if (bd->value->af)
+					assert( bd->value->af->bits == bd2->value->af->bits );
+				}
+			bufr_free_descriptor( bd2 );
+
+			if ((idx->value_block[j] >= 0)&&(idx->blocks[idx->value_block[j]].kind == BLOCK_NUMERIC)&&
+			    (bd->encoding.type == TYPE_NUMERIC))
+				{
+				dval = bufr_block_index_get_dvalue( idx, i, j );
+				if (bufr_value_is_missing( bd->value ))
+					assert( dval == bufr_get_max_double() );
+				else
+					assert( fabs( dval - bufr_descriptor_get_dvalue( bd ) ) <= 1e-6 * (fabs( dval ) + 1.0) );
+				}
+			}
+		}
+
+	bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts, 0 ), count - 1 );
+	pos = bufr_block_index_find_descriptor( idx, bd->descriptor, 0 );
+	assert( (pos >= 0)&&(pos <= count - 1) );
+	assert( bufr_block_index_find_descriptor( idx, bd->descriptor, count ) == -1 );
+	assert( bufr_block_index_get_descriptor( idx, idx->nb_subsets, 0 ) == NULL );
+	assert( bufr_block_index_get_descriptor( idx, 0, count ) == NULL );
+	}
+
+/* a descriptor without a block somewhere, as when skipped, is left to the decoded subsets */
+static void check_unblocked( BufrBlockIndex *idx )
+	{
+	BufrBlock      *blk;
+	BufrDescValue   key;
+	char           *candidates;
+	float           fval;
+	double          vmin, vmax;
+	int             i, pos;
+
+	for (i = 0; i < idx->nb_blocks ; i++)
+		{
+		blk = &(idx->blocks[i]);
+		if (blk->kind != BLOCK_NUMERIC) continue;
+		if (bufr_block_bounds( idx, i, &vmin, &vmax ) == 1) break;
+		}
+	assert( i < idx->nb_blocks );
+	pos = blk->pos;
+
+	candidates = (char *)malloc( idx->nb_subsets );
+	bufr_init_DescValue( &key );
+	key.descriptor = blk->bd->descriptor;
+	assert( bufr_block_index_may_match( idx, &key, 1 ) == 1 );
+	bufr_vfree_DescValue( &key );
+
+	/* out of the bounds of every block, then with the position left without one */
+	fval = 1.0e30;
+	bufr_init_DescValue( &key );
+	bufr_set_key_flt32( &key, blk->bd->descriptor, &fval, 1 );
+	assert( bufr_block_index_may_match( idx, &key, 1 ) == 0 );
+	idx->value_block[pos] = -1;
+	assert( bufr_block_index_may_match( idx, &key, 1 ) == 1 );
+	assert( bufr_block_index_candidates( idx, &key, 1, candidates ) == idx->nb_subsets );
+	idx->value_block[pos] = i;
+	bufr_vfree_DescValue( &key );
+	free( candidates );
+	}
+
+static void check_file( const char *filename, BUFR_Tables *tables )
+	{
+	BUFR_Message   *msg;
+	BUFR_Dataset   *dts;
+	BufrBlockIndex *idx;
+
+	msg = read_first( filename );
+	assert( BUFR_IS_COMPRESSED( msg ) );
+
+	idx = bufr_create_block_index( msg, tables );
+	assert( idx != NULL );
+	assert( idx->nb_subsets == msg->s3.no_data_subsets );
+	assert( idx->nb_blocks > 0 );
+
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+	assert( bufr_count_datasubset( dts ) == idx->nb_subsets );
+
+	check_bounds( idx, dts );
+	check_keys( idx, dts );
+	check_values( idx, dts );
+	check_unblocked( idx );
+
+	bufr_free_dataset( dts );
+	bufr_free_block_index( idx );
+	bufr_free_message( msg );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+   BUFR_Message  *msg;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_blocks.DEBUG" );
+	bufr_set_output_file( "test_blocks.OUTPUT" );
+
+	check_file( "BUFR/dpbm_fostats.bufr", tables );
+	check_file( "BUFR/tableC_202YYY.bufr", tables );
+
+	/* no block index for an uncompressed message */
+	msg = read_first( "BUFR/iuaa01_cwoa_1.bufr" );
+	assert( bufr_create_block_index( msg, tables ) == NULL );
+	bufr_free_message( msg );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
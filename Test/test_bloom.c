@@ -0,0 +1,172 @@
+/*
+Unit test for the Bloom filter sidecar of an archive. The sidecar must never
+rule a message out for a station it holds, at any time of its extent; false
+positives are allowed, false negatives are not.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static const char *files[] = {
+	"BUFR/isaa41_cyul.bufr",
+	"BUFR/iuaa01_cwoa_1.bufr",
+	"BUFR/iobx12_kars_131338.bufr",
+	"BUFR/ismd01_okpr.bufr",
+	"BUFR/AMDAR+2xUS-v15.bufr",
+	"BUFR/lamwest_buf12.bufr",
+	NULL
+};
+
+/* no message may be ruled out for what it holds */
+static void check_entries( BufrArchiveIndex *idx, BufrBloomSidecar *sc )
+	{
+	BufrArchiveEntry *e;
+	int               i, j;
+	int64_t           t;
+
+	for (i = 0; i < arr_count( idx->entries ) ; i++)
+		{
+		e = (BufrArchiveEntry *)arr_get( idx->entries, i );
+		assert( bufr_sidecar_may_hold( sc, e->offset, NULL, BLOOM_ANY_TIME ) );
+		for (t = e->time_min; t <= e->time_max ; t += 3600)
+			{
+			assert( bufr_sidecar_may_hold( sc, e->offset, NULL, t ) );
+			assert( bufr_sidecar_may_hold( sc, -1, NULL, t ) );
+			}
+		assert( bufr_sidecar_may_hold( sc, e->offset, NULL, e->time_max ) );
+		for (j = 0; j < e->nb_stations ; j++)
+			{
+			assert( bufr_sidecar_may_hold( sc, e->offset, e->stations[j], BLOOM_ANY_TIME ) );
+			assert( bufr_sidecar_may_hold( sc, e->offset, e->stations[j], e->time_min ) );
+			assert( bufr_sidecar_may_hold( sc, e->offset, e->stations[j], e->time_max ) );
+			assert( bufr_sidecar_may_hold( sc, -1, e->stations[j], e->time_min ) );
+			}
+		}
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables      *tables=NULL;
+   BufrArchiveIndex *idx;
+   BufrBloomSidecar *sc, *sc2;
+   BufrBloom        *bloom;
+   FILE             *fp, *fpO;
+   BUFR_Message     *msg;
+   char              key[32];
+   int               i, count, nb_false;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_bloom.DEBUG" );
+	bufr_set_output_file( "test_bloom.OUTPUT" );
+
+	/* every message of the files, one after the other */
+	fpO = fopen( "test_bloom.bufr", "wb" );
+	assert( fpO != NULL );
+	count = 0;
+	for (i = 0; files[i] ; i++)
+		{
+		fp = fopen( files[i], "rb" );
+		assert( fp != NULL );
+		while (bufr_read_message( fp, &msg ) > 0)
+			{
+			bufr_write_message( fpO, msg );
+			bufr_free_message( msg );
+			++count;
+			}
+		fclose( fp );
+		}
+	fclose( fpO );
+
+	idx = bufr_create_archive_index();
+	fp = fopen( "test_bloom.bufr", "rb" );
+	assert( bufr_archive_index_add_file( idx, fp, tables ) == count );
+	fclose( fp );
+
+	sc = bufr_archive_index_sidecar( idx, 1, 0.01 );
+	assert( sc != NULL );
+	assert( sc->nb_messages == count );
+	check_entries( idx, sc );
+
+	/* the same filters once written and read back */
+	fp = fopen( "test_bloom.sidecar", "wb" );
+	assert( bufr_write_bloom_sidecar( sc, fp ) >= 0 );
+	fclose( fp );
+	fp = fopen( "test_bloom.sidecar", "rb" );
+	sc2 = bufr_read_bloom_sidecar( fp );
+	fclose( fp );
+	assert( sc2 != NULL );
+	assert( sc2->nb_messages == count );
+	assert( sc2->file->nbits == sc->file->nbits );
+	assert( memcmp( sc2->file->bits, sc->file->bits, (sc->file->nbits + 7) / 8 ) == 0 );
+	check_entries( idx, sc2 );
+
+	/* stations that are nowhere are mostly ruled out */
+	nb_false = 0;
+	for (i = 0; i < 1000 ; i++)
+		{
+		snprintf( key, sizeof(key), "ZZ%05d", i );
+		if (bufr_sidecar_may_hold( sc2, -1, key, BLOOM_ANY_TIME )) ++nb_false;
+		}
+	assert( nb_false < 50 );
+
+	/* a filter of its own */
+	bloom = bufr_create_bloom( 1000, 0.01 );
+	for (i = 0; i < 1000 ; i++)
+		{
+		snprintf( key, sizeof(key), "K%d", i );
+		bufr_bloom_add( bloom, key );
+		}
+	nb_false = 0;
+	for (i = 0; i < 1000 ; i++)
+		{
+		snprintf( key, sizeof(key), "K%d", i );
+		assert( bufr_bloom_may_contain( bloom, key ) );
+		snprintf( key, sizeof(key), "N%d", i );
+		if (bufr_bloom_may_contain( bloom, key )) ++nb_false;
+		}
+	assert( nb_false < 50 );
+	bufr_free_bloom( bloom );
+
+	bufr_free_bloom_sidecar( sc );
+	bufr_free_bloom_sidecar( sc2 );
+	bufr_free_archive_index( idx );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,208 @@
+/*
+Unit test for the bundler. Subsets added one at a time are grouped by
+section 1 into messages written when the subset, octet or age limit is
+reached; each one must be identical to the message bufr_encode_message gives
+for the same subsets.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+#define NB_SUBSETS  10
+#define NB_DESCS    9
+#define MAX_MSGS    8
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static char     outputs[MAX_MSGS][4096];
+static ssize_t  output_lens[MAX_MSGS];
+static int      nb_outputs = 0;
+
+static void collect( BUFR_Message *msg, void *client_data )
+	{
+	assert( client_data == (void *)outputs );
+	assert( nb_outputs < MAX_MSGS );
+	output_lens[nb_outputs] = bufr_memwrite_message( outputs[nb_outputs], sizeof(outputs[0]), msg );
+	assert( output_lens[nb_outputs] > 0 );
+	++nb_outputs;
+	}
+
+/* encode subsets [from,to) of dts the usual way and compare with an output */
+static void check_output( BUFR_Dataset *dts, int from, int to, int x_compress, int n )
+	{
+	BUFR_Dataset  *ref;
+	BUFR_Message  *msg;
+	char           mem[4096];
+	ssize_t        len;
+
+	ref = bufr_create_dataset( dts->tmplte );
+	bufr_copy_sect1( &(ref->s1), &(dts->s1) );
+	assert( bufr_merge_dataset( ref, 0, dts, from, to - from ) == to - from );
+	msg = bufr_encode_message( ref, x_compress );
+	len = bufr_memwrite_message( mem, sizeof(mem), msg );
+	assert( len == output_lens[n] );
+	assert( memcmp( mem, outputs[n], len ) == 0 );
+	bufr_free_message( msg );
+	bufr_free_dataset( ref );
+	}
+
+static BUFR_Dataset *create_dataset( BUFR_Template *tmpl )
+	{
+	int            i, j;
+	double         dvals[NB_SUBSETS];
+	BUFR_Dataset  *dts;
+
+	dts = bufr_create_dataset(tmpl);
+	assert(dts != NULL);
+	/* a fixed time, datasets created a second apart must still match */
+	bufr_set_time_sect1( &(dts->s1), (time_t)1700000000 );
+	for (i = 0; i < NB_SUBSETS ; i++)
+		assert( bufr_create_datasubset(dts) == i );
+	for (j = 0; j < NB_DESCS ; j++)
+		{
+		for (i = 0; i < NB_SUBSETS ; i++)
+			dvals[i] = (j == 2) ? 2024 : (j < 6) ? 1 + (i * j) % 4 : 250.0 + ((i * j) % 30) * 0.5;
+		assert( bufr_dataset_set_dvalue_column( dts, j, dvals, NULL ) == 0 );
+		}
+	return dts;
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	int            i, j, nbits;
+	int            descs[NB_DESCS] = { 12101, 20011, 4001, 4002, 4003, 4004, 10004, 11001, 11002 };
+	BUFR_Dataset  *dts, *dts2;
+	BufrDescValue  bdv;
+	BUFR_Template *tmpl;
+	BUFR_Bundler  *bundler;
+	BufrBundle    *bundle;
+	BUFR_Message  *msg;
+	DataSubset    *subset;
+	uint64_t       estimate;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_bundler.DEBUG" );
+	bufr_set_output_file( "test_bundler.OUTPUT" );
+
+	tmpl = bufr_create_template( NULL, 0, tables, 4 );
+	assert( tmpl != NULL );
+	for (i = 0; i < NB_DESCS ; i++)
+		{
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = descs[i];
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		}
+	bufr_finalize_template( tmpl );
+
+	/* uncompressed, messages are cut every 4 subsets */
+	dts = create_dataset( tmpl );
+	bundler = bufr_create_bundler( 0, collect, outputs );
+	bufr_bundler_set_limits( bundler, 4, 0, 0 );
+	assert( bufr_bundler_add_dataset( bundler, dts ) == 2 );
+	assert( nb_outputs == 2 );
+	assert( bufr_bundler_count( bundler ) == 1 );
+	assert( bufr_bundler_flush( bundler ) == 1 );
+	assert( bufr_bundler_count( bundler ) == 0 );
+	assert( nb_outputs == 3 );
+	check_output( dts, 0, 4, 0, 0 );
+	check_output( dts, 4, 8, 0, 1 );
+	check_output( dts, 8, 10, 0, 2 );
+
+	/* raw subsets copied from a message, not octet aligned */
+	msg = bufr_encode_message( dts, 0 );
+	subset = bufr_get_datasubset( dts, 0 );
+	nbits = 0;
+	for (j = 0; j < bufr_datasubset_count_descriptor( subset ) ; j++)
+		nbits += bufr_datasubset_get_descriptor( subset, j )->encoding.nbits;
+	assert( nbits % 8 != 0 );
+	bufr_bundler_set_limits( bundler, 0, 0, 0 );
+	for (i = 3; i < 8 ; i++)
+		assert( bufr_bundler_add_bits( bundler, dts->tmplte, &(dts->s1), msg->s4.data, (uint64_t)i * nbits, nbits ) == 0 );
+	bufr_free_message( msg );
+	assert( bufr_bundler_flush( bundler ) == 1 );
+	check_output( dts, 3, 8, 0, 3 );
+
+	/* a change of section 1 opens another bundle */
+	dts2 = create_dataset( tmpl );
+	dts2->s1.orig_sub_centre = dts->s1.orig_sub_centre + 1;
+	assert( bufr_bundler_add_subset( bundler, dts, 0 ) == 0 );
+	assert( bufr_bundler_add_subset( bundler, dts2, 1 ) == 0 );
+	assert( bufr_bundler_add_subset( bundler, dts, 1 ) == 0 );
+	assert( bufr_bundler_count( bundler ) == 2 );
+	assert( bufr_bundler_expire( bundler, time(NULL) ) == 0 );
+	bufr_bundler_set_limits( bundler, 0, 0, 60 );
+	assert( bufr_bundler_expire( bundler, time(NULL) + 60 ) == 2 );
+	assert( nb_outputs == 6 );
+	bufr_free_dataset( dts2 );
+	bufr_free_bundler( bundler );
+
+	/* compressed, subsets are moved and the size estimate is exact */
+	nb_outputs = 0;
+	dts2 = create_dataset( tmpl );
+	bundler = bufr_create_bundler( 1, collect, outputs );
+	assert( bufr_bundler_add_bits( bundler, dts->tmplte, &(dts->s1), (unsigned char *)outputs, 0, 8 ) == -1 );
+	assert( bufr_bundler_add_dataset( bundler, dts2 ) == 0 );
+	assert( bufr_datasubset_count_descriptor( bufr_get_datasubset( dts2, 0 ) ) == 0 );
+	bundle = *(BufrBundle **)arr_get( bundler->bundles, 0 );
+	estimate = bundle->nbits;
+	msg = bufr_encode_message( bundle->dts, 1 );
+	assert( BUFR_IS_COMPRESSED( msg ) );
+	assert( estimate == (uint64_t)msg->s4.filled * 8 + msg->s4.bitno );
+	bufr_free_message( msg );
+
+	assert( bufr_bundler_flush( bundler ) == 1 );
+	check_output( dts, 0, NB_SUBSETS, 1, 0 );
+
+	/* the size limit writes the bundle as soon as it is reached */
+	bufr_bundler_set_limits( bundler, 0, estimate / 8, 0 );
+	bufr_free_dataset( dts2 );
+	dts2 = create_dataset( tmpl );
+	assert( bufr_bundler_add_dataset( bundler, dts2 ) == 1 );
+	assert( nb_outputs == 2 );
+	assert( bufr_bundler_count( bundler ) == 0 );
+	check_output( dts, 0, NB_SUBSETS, 1, 1 );
+
+	bufr_free_bundler( bundler );
+	bufr_free_dataset( dts2 );
+	bufr_free_dataset( dts );
+	bufr_free_template( tmpl );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
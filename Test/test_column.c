@@ -0,0 +1,225 @@
+/*
+Unit test for setting and encoding values a column at a time. Values set
+for all subsets at once must decode back as they were set, out of range
+values are reported, and the columnar encoder must give the very same
+messages as bufr_encode_message.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+#define NB_SUBSETS  5
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static int nb_range_warnings = 0;
+
+static void count_range_warnings( const char *msg ) {
+	if (strstr( msg, "FLOW" )) nb_range_warnings++;
+}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	char msgstr[8192], msgstr2[8192];
+	ssize_t msglen = 0;
+	double      temps[NB_SUBSETS] = { 273.15, 280.5, 1000.0, 250.25, 300.0 };
+	char        temps_miss[NB_SUBSETS] = { 0, 0, 0, 1, 0 };
+	int32_t     clouds[NB_SUBSETS] = { 0, 8, 14, 20, -1 };
+	const char *names[NB_SUBSETS] = { "ALERT", "EUREKA", NULL, "RESOLUTE", "IQALUIT" };
+	int         descs[3] = { 12101, 20011, 1015 };
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_column.DEBUG" );
+	bufr_set_output_file( "test_column.OUTPUT" );
+
+	/* fill each template position for all subsets at once */
+	{
+		int i;
+		BUFR_Message* msg;
+		BUFR_Dataset* dts;
+		BufrDescValue bdv;
+		BUFR_Template* tmpl = bufr_create_template( NULL, 0, tables, 4 );
+		assert( tmpl != NULL );
+		
+		for (i = 0; i < 3 ; i++)
+			{
+			bufr_init_DescValue( &bdv );
+			bdv.descriptor = descs[i];
+			bufr_template_add_DescValue( tmpl, &bdv, 1 );
+			}
+		bufr_finalize_template( tmpl );
+
+		dts = bufr_create_dataset(tmpl);
+		assert(dts != NULL);
+
+		for (i = 0; i < NB_SUBSETS ; i++)
+			assert( bufr_create_datasubset(dts) == i );
+
+		/* 1000 K is out of range for 12101 */
+		assert( bufr_dataset_set_dvalue_column( dts, 0, temps, temps_miss ) == 1 );
+		/* 20 does not fit in 4 bits */
+		assert( bufr_dataset_set_ivalue_column( dts, 1, clouds, NULL ) == 1 );
+		assert( bufr_dataset_set_svalue_column( dts, 2, names, NULL ) == 0 );
+		assert( bufr_dataset_set_dvalue_column( dts, 3, temps, NULL ) == -1 );
+
+		msg = bufr_encode_message(dts,0);
+		assert( msg != NULL );
+
+		msglen = bufr_memwrite_message( msgstr, sizeof(msgstr), msg);
+		assert( msglen >= 0 );
+		bufr_free_message( msg );
+
+		/* the columnar encoder must give the very same messages */
+		{
+		BufrEncodePlan *plan;
+		BufrColumn      cols[3];
+		char            colstr[8192];
+		ssize_t         collen;
+		int             x_compress;
+
+		plan = bufr_create_encode_plan( tmpl );
+		assert( plan != NULL );
+		assert( bufr_encode_plan_count( plan ) == 3 );
+		assert( bufr_encode_plan_find( plan, 1015, 0 ) == 2 );
+
+		for (i = 0; i < 3 ; i++)
+			bufr_init_column( &cols[i] );
+		cols[0].type = BUFR_COLUMN_DOUBLE;
+		cols[0].values = temps;
+		cols[0].missing = temps_miss;
+		cols[1].type = BUFR_COLUMN_INT32;
+		cols[1].values = clouds;
+		cols[2].type = BUFR_COLUMN_STRING;
+		cols[2].values = names;
+
+		for (x_compress = 0; x_compress <= 1 ; x_compress++)
+			{
+			msg = bufr_encode_message( dts, x_compress );
+			collen = bufr_memwrite_message( colstr, sizeof(colstr), msg );
+			if (x_compress == 0)
+				assert( (collen == msglen)&&(memcmp( colstr, msgstr, msglen ) == 0) );
+			bufr_free_message( msg );
+
+			msg = bufr_encode_columns( plan, &(dts->s1), cols, NB_SUBSETS, x_compress );
+			assert( msg != NULL );
+			assert( BUFR_IS_COMPRESSED(msg) == (x_compress ? BUFR_FLAG_COMPRESSED : 0) );
+			assert( bufr_memwrite_message( msgstr2, sizeof(msgstr2), msg ) == collen );
+			assert( memcmp( colstr, msgstr2, collen ) == 0 );
+			bufr_free_message( msg );
+			}
+
+		/* what a masked value holds is never converted */
+		{
+		double  masked[NB_SUBSETS] = { 273.15, 280.5, 290.0, -1.0e6, 300.0 };
+
+		cols[0].values = masked;
+		bufr_set_debug_handler( count_range_warnings );
+		for (x_compress = 0; x_compress <= 1 ; x_compress++)
+			{
+			msg = bufr_encode_columns( plan, &(dts->s1), cols, NB_SUBSETS, x_compress );
+			assert( msg != NULL );
+			bufr_free_message( msg );
+			}
+		bufr_set_debug_handler( NULL );
+		assert( nb_range_warnings == 0 );
+		cols[0].values = temps;
+		}
+
+		/* a string column cannot go into a numeric descriptor */
+		cols[0].type = BUFR_COLUMN_STRING;
+		assert( bufr_encode_columns( plan, NULL, cols, NB_SUBSETS, 0 ) == NULL );
+
+		bufr_free_encode_plan( plan );
+		}
+
+		bufr_free_dataset( dts );
+		bufr_free_template( tmpl );
+	}
+
+	/* ...and check the decoded values */
+	{
+		int i;
+		BUFR_Message* msg = NULL;
+		BUFR_Dataset* dts;
+		DataSubset    *dss;
+		BufrDescriptor *bcv;
+		int64_t        column[NB_SUBSETS];
+		assert( bufr_memread_message(msgstr,msglen,&msg) > 0 );
+
+		dts = bufr_decode_message( msg, tables ); 
+		assert( dts != NULL );
+		assert( bufr_count_datasubset( dts ) == NB_SUBSETS );
+
+		assert( bufr_dataset_get_scaled_column( dts, 0, column, -1 ) == NB_SUBSETS );
+		assert( column[0] == 27315 );
+		assert( column[1] == 28050 );
+		assert( column[2] == -1 );
+		assert( column[3] == -1 );
+		assert( column[4] == 30000 );
+
+		assert( bufr_dataset_get_scaled_column( dts, 1, column, -1 ) == NB_SUBSETS );
+		assert( column[0] == 0 );
+		assert( column[1] == 8 );
+		assert( column[2] == 14 );
+		assert( column[3] == -1 );
+		assert( column[4] == -1 );
+
+		assert( bufr_dataset_get_scaled_column( dts, 2, column, -1 ) == -1 );
+		for (i = 0; i < NB_SUBSETS ; i++)
+			{
+			int  len;
+			const char *s;
+
+			dss = bufr_get_datasubset( dts, i );
+			bcv = bufr_datasubset_get_descriptor( dss, 2 );
+			s = bufr_descriptor_get_svalue( bcv, &len );
+			if (names[i] == NULL)
+				assert( bufr_is_missing_string( s, len ) );
+			else
+				assert( strncmp( s, names[i], strlen(names[i]) ) == 0 );
+			}
+
+		bufr_free_dataset( dts );
+		bufr_free_message( msg );
+	}
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,188 @@
+/*
+Unit test for bulletin deduplication. A message seen again within the
+window is a duplicate, a later update of it is a correction, an older one is
+stale, and another heading is another bulletin.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static const char *files[] = {
+	"BUFR/isaa41_cyul.bufr",
+	"BUFR/iuaa01_cwoa_1.bufr",
+	"BUFR/iobx12_kars_131338.bufr",
+	"BUFR/ismd01_okpr.bufr",
+	"BUFR/AMDAR+2xUS-v15.bufr",
+	"BUFR/lamwest_buf12.bufr",
+	NULL
+};
+
+int main(int argc, char *argv[])
+   {
+   BufrDedup        *dd;
+   BUFR_Message     *msg, *msgs[16];
+   FILE             *fp, *fpO;
+   long              superseded;
+   uint64_t          identity;
+   int               i, count, nb_unique;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_dedup.DEBUG" );
+	bufr_set_output_file( "test_dedup.OUTPUT" );
+
+	dd = bufr_create_dedup( 0, 3600 );
+
+	/* first seen is new, seen again is a duplicate of it */
+	for (i = 0; files[i] ; i++)
+		{
+		msgs[i] = read_first( files[i] );
+		assert( bufr_dedup_message( dd, msgs[i], 1000, i, &superseded ) == DEDUP_NEW );
+		assert( superseded == -1 );
+		}
+	count = i;
+	for (i = 0; i < count ; i++)
+		{
+		assert( bufr_dedup_message( dd, msgs[i], 2000, 100 + i, &superseded ) == DEDUP_DUPLICATE );
+		assert( superseded == i );
+		}
+
+	/* a correction replaces the bulletin with the same section 1 */
+	msg = read_first( files[0] );
+	msg->s1.upd_seq_no = msgs[0]->s1.upd_seq_no + 1;
+	assert( bufr_message_identity( msg ) == bufr_message_identity( msgs[0] ) );
+	assert( bufr_message_fingerprint( msg ) == bufr_message_fingerprint( msgs[0] ) );
+	msg->s4.data[0] ^= 1;
+	assert( bufr_message_fingerprint( msg ) != bufr_message_fingerprint( msgs[0] ) );
+	assert( bufr_dedup_message( dd, msg, 2000, 200, &superseded ) == DEDUP_CORRECTION );
+	assert( superseded == 0 );
+	assert( bufr_dedup_message( dd, msg, 2000, 201, &superseded ) == DEDUP_DUPLICATE );
+	assert( superseded == 200 );
+
+	/* an older update of it, not seen yet, is superseded */
+	msg->s1.upd_seq_no = msgs[0]->s1.upd_seq_no;
+	msg->s4.data[0] ^= 2;
+	assert( bufr_dedup_message( dd, msg, 2000, 202, &superseded ) == DEDUP_STALE );
+	assert( superseded == 200 );
+
+	/* another heading is another bulletin */
+	free( msg->header_string );
+	msg->header_string = strdup( "ISAA42\\040CYUL\\040071732" );
+	assert( bufr_message_identity( msg ) != bufr_message_identity( msgs[0] ) );
+	assert( bufr_dedup_message( dd, msg, 2000, 203, &superseded ) == DEDUP_NEW );
+	/* while the group BBB does not count */
+	free( msg->header_string );
+	msg->header_string = strdup( "\\001\\015\\015\\012123\\015\\015\\012ISAA41\\040CYUL\\040071732\\040CCA" );
+	assert( bufr_message_identity( msg ) == bufr_message_identity( msgs[0] ) );
+	bufr_free_message( msg );
+
+	/* without a heading, the structure tells bulletins apart, none is dropped */
+	msg = read_first( files[0] );
+	free( msg->header_string );
+	msg->header_string = NULL;
+	msg->header_len = 0;
+	identity = bufr_message_identity( msg );
+	assert( identity != bufr_message_identity( msgs[0] ) );
+	msg->s3.no_data_subsets += 1;
+	assert( bufr_message_identity( msg ) != identity );
+	msg->s3.no_data_subsets -= 1;
+	msg->s1.upd_seq_no = msgs[0]->s1.upd_seq_no + 1;
+	msg->s4.data[0] ^= 4;
+	assert( bufr_dedup_message( dd, msg, 2000, 300, &superseded ) == DEDUP_NEW );
+	msg->s1.upd_seq_no = msgs[0]->s1.upd_seq_no;
+	msg->s4.data[0] ^= 8;
+	assert( bufr_dedup_message( dd, msg, 2000, 301, &superseded ) == DEDUP_NEW );
+	assert( superseded == -1 );
+	bufr_free_message( msg );
+
+	assert( dd->nb_checked == 2 * count + 6 );
+	assert( dd->nb_duplicates == count + 1 );
+	assert( dd->nb_corrections == 1 );
+	assert( dd->nb_stale == 1 );
+
+	/* past the window, everything is new again */
+	for (i = 0; i < count ; i++)
+		assert( bufr_dedup_message( dd, msgs[i], 10000, i, NULL ) == DEDUP_NEW );
+	bufr_free_dedup( dd );
+
+	/* beyond the capacity, the oldest are forgotten */
+	dd = bufr_create_dedup( 2, 3600 );
+	for (i = 0; i < 3 ; i++)
+		assert( bufr_dedup_message( dd, msgs[i], 1000, i, NULL ) == DEDUP_NEW );
+	assert( bufr_dedup_message( dd, msgs[2], 1000, 3, NULL ) == DEDUP_DUPLICATE );
+	assert( bufr_dedup_message( dd, msgs[0], 1000, 4, NULL ) == DEDUP_NEW );
+	assert( dd->count == 2 );
+	bufr_free_dedup( dd );
+
+	/* a stream where every message comes twice */
+	fpO = fopen( "test_dedup.bufr", "wb" );
+	assert( fpO != NULL );
+	nb_unique = 0;
+	for (i = 0; files[i] ; i++)
+		{
+		fp = fopen( files[i], "rb" );
+		assert( fp != NULL );
+		while (bufr_read_message( fp, &msg ) > 0)
+			{
+			bufr_write_message( fpO, msg );
+			bufr_write_message( fpO, msg );
+			bufr_free_message( msg );
+			++nb_unique;
+			}
+		fclose( fp );
+		}
+	fclose( fpO );
+
+	dd = bufr_create_dedup( 0, 0 );
+	fp = fopen( "test_dedup.bufr", "rb" );
+	count = 0;
+	while (bufr_dedup_read_message( dd, fp, &msg ) > 0)
+		{
+		bufr_free_message( msg );
+		++count;
+		}
+	fclose( fp );
+	assert( count == nb_unique );
+	assert( dd->nb_checked == 2 * nb_unique );
+	assert( dd->nb_duplicates == nb_unique );
+	bufr_free_dedup( dd );
+
+	for (i = 0; files[i] ; i++)
+		bufr_free_message( msgs[i] );
+   bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,186 @@
+/*
+Unit test for the text dump. Datasets of different sizes, with decimals,
+strings and missing values, are dumped, read back and dumped again; the
+text must not change, whether the dump is read with one thread or several.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+#define NB_DATASETS  23
+#define NB_DESCS     14
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static char *read_file( const char *filename, long *len )
+	{
+	FILE  *fp;
+	char  *buf;
+
+	fp = fopen( filename, "rb" );
+	assert( fp != NULL );
+	fseek( fp, 0, SEEK_END );
+	*len = ftell( fp );
+	rewind( fp );
+	buf = (char *)malloc( *len + 1 );
+	assert( fread( buf, 1, *len, fp ) == *len );
+	fclose( fp );
+	return buf;
+	}
+
+static void same_files( const char *file1, const char *file2 )
+	{
+	char  *buf1, *buf2;
+	long   len1, len2;
+
+	buf1 = read_file( file1, &len1 );
+	buf2 = read_file( file2, &len2 );
+	assert( len1 > 0 );
+	assert( len1 == len2 );
+	assert( memcmp( buf1, buf2, len1 ) == 0 );
+	free( buf1 );
+	free( buf2 );
+	}
+
+static int nb_subsets( int k )
+	{
+	return 1 + (k * 7) % 13;
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	int            i, j, k, nb_threads;
+	int            descs[NB_DESCS] = { 12101, 20011, 1015, 4001, 4002, 4003, 4004,
+	                                   5001, 6001, 7030, 10004, 11001, 11002, 12103 };
+	BUFR_Dataset  *dts;
+	DataSubset    *subset;
+	BufrDescriptor *bcv;
+	BufrDescValue  bdv;
+	BUFR_Template *tmpl;
+	char           name[32];
+	char           outfile[64];
+	FILE          *fp;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_dump.DEBUG" );
+	bufr_set_output_file( "test_dump.OUTPUT" );
+
+	tmpl = bufr_create_template( NULL, 0, tables, 4 );
+	assert( tmpl != NULL );
+	for (i = 0; i < NB_DESCS ; i++)
+		{
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = descs[i];
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		}
+	bufr_finalize_template( tmpl );
+
+	/* datasets of different sizes, with decimals, strings and missing values */
+	fp = fopen( "test_dump.txt", "w" );
+	assert( fp != NULL );
+	for (k = 0; k < NB_DATASETS ; k++)
+		{
+		dts = bufr_create_dataset(tmpl);
+		assert(dts != NULL);
+		for (i = 0; i < nb_subsets( k ) ; i++)
+			{
+			assert( bufr_create_datasubset(dts) == i );
+			subset = bufr_get_datasubset( dts, i );
+			for (j = 0; j < NB_DESCS ; j++)
+				{
+				bcv = bufr_datasubset_get_descriptor( subset, j );
+				if ((i + j + k) % 17 == 0) continue;
+				if (j == 2)
+					{
+					sprintf( name, "STATION %d-%d", k, i );
+					bufr_descriptor_set_svalue( bcv, name );
+					}
+				else if (j == 1)
+					bufr_descriptor_set_ivalue( bcv, (i + k) % 9 );
+				else if (j < 7)
+					bufr_descriptor_set_dvalue( bcv, (j == 3) ? 2024 : 1 + (i * j + k) % 4 );
+				else
+					bufr_descriptor_set_dvalue( bcv, 10.0 + ((i * j + k) % 300) * 0.5 + (j % 3) * 0.01 );
+				}
+			}
+		assert( bufr_fdump_dataset( dts, fp ) > 0 );
+		bufr_free_dataset( dts );
+		}
+	fclose( fp );
+
+	/* reading back gives every dataset, and dumps the same text again */
+	dts = bufr_create_dataset(tmpl);
+	fp = fopen( "test_dump.txt", "r" );
+	assert( fp != NULL );
+	{
+	FILE *fpo = fopen( "test_dump2.txt", "w" );
+	assert( fpo != NULL );
+	for (k = 0; bufr_read_dataset_dump( dts, fp ) > 0 ; k++)
+		{
+		assert( bufr_count_datasubset( dts ) == nb_subsets( k ) );
+		assert( bufr_fdump_dataset( dts, fpo ) > 0 );
+		}
+	fclose( fpo );
+	}
+	fclose( fp );
+	assert( k == NB_DATASETS );
+	same_files( "test_dump.txt", "test_dump2.txt" );
+
+	/* only the first dataset of the file is loaded */
+	bufr_free_dataset( dts );
+	dts = bufr_create_dataset(tmpl);
+	assert( bufr_load_dataset( dts, "test_dump.txt" ) == nb_subsets( 0 ) );
+	bufr_free_dataset( dts );
+
+	/* the messages encoded in parallel are those encoded serially */
+	bufr_set_threads( 1 );
+	assert( bufr_genmsgs_from_dump( tmpl, "test_dump.txt", "test_dump.bufr", 0 ) > 0 );
+	for (nb_threads = 2; nb_threads <= 5 ; nb_threads++)
+		{
+		bufr_set_threads( nb_threads );
+		sprintf( outfile, "test_dump_%d.bufr", nb_threads );
+		assert( bufr_genmsgs_from_dump( tmpl, "test_dump.txt", outfile, 0 ) > 0 );
+		same_files( "test_dump.bufr", outfile );
+		}
+	bufr_set_threads( 1 );
+
+	bufr_free_template( tmpl );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,49 @@
+/*
+Helpers shared by the unit tests that work on the sample messages in BUFR/.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test_helpers.h"
+
+/* the first message of a file, the test fails if there is none */
+BUFR_Message *read_first( const char *filename )
+	{
+	FILE          *fp;
+	BUFR_Message  *msg=NULL;
+
+	fp = fopen( filename, "rb" );
+	if (fp == NULL)
+		{
+		fprintf( stderr, "can't open %s\n", filename );
+		exit(1);
+		}
+	if (bufr_read_message( fp, &msg ) <= 0)
+		{
+		fprintf( stderr, "no message in %s\n", filename );
+		exit(1);
+		}
+	fclose( fp );
+	return msg;
+	}
@@ -0,0 +1,123 @@
+/*
+Unit test for indexed access to a linked list. Positions are served from an
+index kept with the list; every change of the list must leave that index
+agreeing with a plain walk of the nodes.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+/* every position must give the node found by walking the list */
+static void check_positions( LinkedList *lst )
+	{
+	ListNode *node;
+	int       pos;
+
+	node = lst_firstnode( lst );
+	for (pos = 1; node ; pos++)
+		{
+		assert( lst_nodepos( lst, pos ) == node );
+		node = lst_nextnode( node );
+		}
+	assert( pos - 1 == lst_count( lst ) );
+	assert( lst_nodepos( lst, pos ) == NULL );
+	assert( lst_nodepos( lst, 0 ) == NULL );
+	}
+
+static LinkedList *make_list( int first, int count )
+	{
+	LinkedList *lst;
+	int         i;
+
+	lst = lst_newlist();
+	for (i = 0; i < count ; i++)
+		lst_addlast( lst, lst_newnode( (void *)(long)(first + i) ) );
+	return lst;
+	}
+
+int main(int argc, char *argv[])
+	{
+	LinkedList *lst, *sub;
+	ListNode   *node;
+
+	lst = make_list( 0, 100 );
+	check_positions( lst );
+
+	/* appending keeps the positions already known */
+	lst_addlast( lst, lst_newnode( (void *)100L ) );
+	check_positions( lst );
+
+	lst_addfirst( lst, lst_newnode( (void *)-1L ) );
+	check_positions( lst );
+
+	lst_addafter( lst, lst_nodepos( lst, 50 ), lst_newnode( (void *)-2L ) );
+	check_positions( lst );
+
+	lst_addbefore( lst, lst_nodepos( lst, 20 ), lst_newnode( (void *)-3L ) );
+	check_positions( lst );
+
+	lst_addpos( lst, lst_newnode( (void *)-4L ), 10 );
+	check_positions( lst );
+
+	lst_delnode( lst_rmfirst( lst ) );
+	check_positions( lst );
+
+	lst_delnode( lst_rmlast( lst ) );
+	check_positions( lst );
+
+	lst_delnode( lst_rmnode( lst, lst_nodepos( lst, 30 ) ) );
+	check_positions( lst );
+
+	lst_deletepos( lst, 60 );
+	check_positions( lst );
+
+	/* splicing in the middle and at the end, as a replication does */
+	sub = make_list( 1000, 25 );
+	check_positions( sub );
+	lst_movelist( lst, lst_nodepos( lst, 40 ), sub );
+	check_positions( lst );
+	check_positions( sub );
+
+	lst_movelist( sub, NULL, make_list( 2000, 5 ) );
+	check_positions( sub );
+	lst_dellist( sub );
+
+	sub = make_list( 3000, 25 );
+	lst_movelist( lst, lst_lastnode( lst ), sub );
+	check_positions( lst );
+	assert( (long)lst_nodepos( lst, lst_count( lst ) )->data == 3024 );
+	lst_dellist( sub );
+
+	/* emptied then filled again */
+	while ((node = lst_rmlast( lst )) != NULL)
+		lst_delnode( node );
+	check_positions( lst );
+	lst_addlast( lst, lst_newnode( (void *)7L ) );
+	check_positions( lst );
+	assert( (long)lst_nodepos( lst, 1 )->data == 7 );
+
+	lst_dellist( lst );
+	return 0;
+	}
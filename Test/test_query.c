@@ -0,0 +1,236 @@
+/*
+Unit test for compiled subset queries. For keys on values, ranges and
+lists, a query must answer as bufr_subset_find_values does, and the blocks
+of a compressed message must never reject a subset that matches.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+/* a key on the value of bd: 0 equal, 1 range, 2 list, anything else no value,
+ * returns 1 if bd must match it */
+static int make_key( BufrDescriptor *bd, BufrDescValue *key, int mode )
+	{
+	int32_t  ivals[3];
+	float    fvals[3];
+	double   d;
+
+	bufr_init_DescValue( key );
+	if ((mode < 0)||(mode > 2)||(bd->value == NULL)||(bd->encoding.type != TYPE_NUMERIC)||
+	    bufr_value_is_missing( bd->value ))
+		{
+		bufr_set_key_int32( key, bd->descriptor, NULL, 0 );
+		return 1;
+		}
+	if (bd->encoding.scale == 0)
+		{
+		ivals[0] = bufr_descriptor_get_ivalue( bd );
+		if (mode == 1)
+			{
+			ivals[1] = ivals[0] + 1;
+			ivals[0] -= 1;
+			}
+		else if (mode == 2)
+			{
+			ivals[1] = ivals[0] + 5;
+			ivals[2] = ivals[0];
+			ivals[0] -= 7;
+			}
+		bufr_set_key_int32( key, bd->descriptor, ivals, (mode == 0) ? 1 : mode + 1 );
+		/* ranges only match values of the same type */
+		return (mode != 1);
+		}
+	else
+		{
+		d = bufr_descriptor_get_dvalue( bd );
+		fvals[0] = d;
+		if (mode == 1)
+			{
+			fvals[0] = d - 1.0;
+			fvals[1] = d + 1.0;
+			}
+		else if (mode == 2)
+			{
+			fvals[1] = d + 5.0;
+			fvals[2] = d;
+			fvals[0] = d - 7.0;
+			}
+		bufr_set_key_flt32( key, bd->descriptor, fvals, (mode == 0) ? 1 : mode + 1 );
+		/* a float may not hold the value closely enough */
+		return (mode != 1)&&(fabs( (float)d - d ) <= 0.5 / bufr_pow10( bd->encoding.scale ));
+		}
+	}
+
+/* a sequence of 2 keys at pos in the subset, the first one on its value */
+static int make_term( DataSubset *dss, int pos, int mode, BufrDescValue *keys, int *exact )
+	{
+	if (pos + 2 > bufr_datasubset_count_descriptor( dss )) return 0;
+	/* keys on Table D descriptors would carry flag bits */
+	if (!bufr_is_table_b( bufr_datasubset_get_descriptor( dss, pos )->descriptor )||
+	    !bufr_is_table_b( bufr_datasubset_get_descriptor( dss, pos+1 )->descriptor ))
+		return 0;
+	*exact = make_key( bufr_datasubset_get_descriptor( dss, pos ), &(keys[0]), mode );
+	make_key( bufr_datasubset_get_descriptor( dss, pos+1 ), &(keys[1]), -1 );
+	return 2;
+	}
+
+static void free_keys( BufrDescValue *keys, int nbkey )
+	{
+	int   k;
+
+	for (k = 0; k < nbkey ; k++)
+		bufr_vfree_DescValue( &(keys[k]) );
+	}
+
+/* a query answers as bufr_subset_find_values, blocks never reject a match */
+static void check_file( const char *filename, BUFR_Tables *tables )
+	{
+	BUFR_Message   *msg;
+	BUFR_Dataset   *dts;
+	BufrBlockIndex *idx;
+	DataSubset     *dss;
+	BufrQuery      *qa, *qand, *qor;
+	BufrDescValue   ka[2], kb[2];
+	char           *selected, *candidates;
+	int             i, j, s, mode, count, step, nbsubset;
+	int             ma, mb, ea, eb, nb;
+
+	msg = read_first( filename );
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+	idx = BUFR_IS_COMPRESSED( msg ) ? bufr_create_block_index( msg, tables ) : NULL;
+
+	nbsubset = bufr_count_datasubset( dts );
+	selected = (char *)malloc( nbsubset );
+	candidates = (char *)malloc( nbsubset );
+
+	/* the empty query matches everything */
+	qa = bufr_create_query();
+	assert( bufr_query_select( qa, dts, selected ) == nbsubset );
+	if (idx) assert( bufr_query_block_candidates( qa, idx, candidates ) == nbsubset );
+	bufr_free_query( qa );
+
+	for (s = 0; s < nbsubset ; s += (nbsubset > 2) ? nbsubset / 2 : 1)
+		{
+		dss = bufr_get_datasubset( dts, s );
+		count = bufr_datasubset_count_descriptor( dss );
+		step = (count > 60) ? count / 30 : 1;
+		for (j = 0; j < count ; j += step)
+			{
+			mode = j % 4;
+			if (make_term( dss, j, mode, ka, &ea ) == 0) continue;
+			if (make_term( dss, count - 1 - j, 0, kb, &eb ) == 0)
+				{
+				free_keys( ka, 2 );
+				continue;
+				}
+
+			qa = bufr_create_query();
+			assert( bufr_query_add_term( qa, ka, 2 ) == 1 );
+			qand = bufr_create_query();
+			bufr_query_add_term( qand, ka, 2 );
+			bufr_query_add_term( qand, kb, 2 );
+			qor = bufr_create_query();
+			bufr_query_add_term( qor, ka, 2 );
+			assert( bufr_query_or( qor ) == 2 );
+			bufr_query_add_term( qor, kb, 2 );
+			assert( qor->nb_groups == 2 );
+
+			nb = 0;
+			for (i = 0; i < nbsubset ; i++)
+				{
+				DataSubset *ss = bufr_get_datasubset( dts, i );
+
+				ma = (bufr_subset_find_values( ss, ka, 2, 0 ) >= 0);
+				mb = (bufr_subset_find_values( ss, kb, 2, 0 ) >= 0);
+				assert( bufr_query_match( qa, ss ) == ma );
+				assert( bufr_query_match( qand, ss ) == (ma && mb) );
+				assert( bufr_query_match( qor, ss ) == (ma || mb) );
+				if (i == s) assert( (ma || !ea)&&(mb || !eb) );
+				if (ma) ++nb;
+				}
+			assert( bufr_query_select( qa, dts, selected ) == nb );
+
+			if (idx)
+				{
+				assert( bufr_query_may_match_blocks( qor, idx ) == 1 );
+				bufr_query_block_candidates( qor, idx, candidates );
+				bufr_query_select( qor, dts, selected );
+				for (i = 0; i < nbsubset ; i++)
+					assert( candidates[i] >= selected[i] );
+				bufr_query_block_candidates( qand, idx, candidates );
+				bufr_query_select( qand, dts, selected );
+				for (i = 0; i < nbsubset ; i++)
+					assert( candidates[i] >= selected[i] );
+				}
+
+			bufr_free_query( qa );
+			bufr_free_query( qand );
+			bufr_free_query( qor );
+			free_keys( ka, 2 );
+			free_keys( kb, 2 );
+			}
+		}
+
+	free( selected );
+	free( candidates );
+	bufr_free_block_index( idx );
+	bufr_free_dataset( dts );
+	bufr_free_message( msg );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_query.DEBUG" );
+	bufr_set_output_file( "test_query.OUTPUT" );
+
+	check_file( "BUFR/dpbm_fostats.bufr", tables );
+	check_file( "BUFR/tableC_202YYY.bufr", tables );
+	check_file( "BUFR/iobx12_kars_131338.bufr", tables );
+	check_file( "BUFR/iuaa01_cwoa_1.bufr", tables );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
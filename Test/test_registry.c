@@ -0,0 +1,113 @@
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static void write_local_tableb( const char *filename, int nbits )
+	{
+	FILE *fp = fopen( filename, "w" );
+	assert( fp != NULL );
+	fprintf( fp, "*\n" );
+	fprintf( fp, "012199  LOCAL TEST TEMPERATURE                      K            1          0  %4d\n", nbits );
+	fclose( fp );
+	}
+
+int main(int argc, char *argv[])
+   {
+	const char          *ltb = "test_registry.table_b";
+	int                  tbnos[1] = { 13 };
+	BUFR_TablesRegistry *reg;
+	BufrTablesSnapshot  *snap1, *snap2;
+	BUFR_Tables         *tbls1, *tbls2;
+	EntryTableB         *tb;
+
+   bufr_begin_api();
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_registry.DEBUG" );
+	bufr_set_output_file( "test_registry.OUTPUT" );
+
+	unsetenv( "WMO_BUFR_TABLES" );
+	assert( NULL == bufr_registry_acquire( NULL ) );
+
+	write_local_tableb( ltb, 12 );
+
+	reg = bufr_create_tables_registry( "../Tables", tbnos, 1 );
+	assert( reg != NULL );
+	assert( bufr_registry_generation( reg ) == 1 );
+
+	bufr_registry_set_local( reg, ltb, NULL );
+	assert( bufr_registry_reload( reg ) == 2 );
+
+	snap1 = bufr_registry_acquire( reg );
+	assert( snap1 != NULL );
+	assert( snap1->generation == 2 );
+	tbls1 = bufr_use_tables_list( snap1->tables_list, 13 );
+	assert( tbls1 != NULL );
+	tb = bufr_fetch_tableB( tbls1, 12199 );
+	assert( tb != NULL );
+	assert( tb->encoding.nbits == 12 );
+
+	/* a reload publishes new tables, the old snapshot stays usable */
+	write_local_tableb( ltb, 16 );
+	assert( bufr_registry_reload( reg ) == 3 );
+
+	snap2 = bufr_registry_acquire( reg );
+	assert( snap2 != NULL );
+	assert( snap2 != snap1 );
+	assert( snap2->generation == 3 );
+	tbls2 = bufr_use_tables_list( snap2->tables_list, 13 );
+	tb = bufr_fetch_tableB( tbls2, 12199 );
+	assert( tb != NULL );
+	assert( tb->encoding.nbits == 16 );
+
+	tb = bufr_fetch_tableB( tbls1, 12199 );
+	assert( tb != NULL );
+	assert( tb->encoding.nbits == 12 );
+	assert( bufr_fetch_tableB( tbls1, 1001 ) != NULL );
+
+	/* a failed reload keeps the current generation */
+	reg->nb_tbnos = 0;
+	assert( bufr_registry_reload( reg ) == -1 );
+	assert( bufr_registry_generation( reg ) == 3 );
+	reg->nb_tbnos = 1;
+
+	bufr_registry_release( reg, snap1 );
+
+	/* the current snapshot outlives the registry while it is held */
+	bufr_free_tables_registry( reg );
+	tb = bufr_fetch_tableB( tbls2, 12199 );
+	assert( tb != NULL );
+	assert( tb->encoding.nbits == 16 );
+	bufr_registry_release( NULL, snap2 );
+	unlink( ltb );
+
+	bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,144 @@
+/*
+Unit test for scaled integer values. Values set and read as scaled
+integers must encode and decode without going through floating point, and
+out of range values are refused.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	char msgstr[4096];
+	ssize_t msglen = 0;
+	int64_t temps[3] = { 27315, 29815, 25315 };
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_scaled.DEBUG" );
+	bufr_set_output_file( "test_scaled.OUTPUT" );
+
+	/* encode three subsets from scaled integers only */
+	{
+		int i, n;
+		BUFR_Message* msg;
+		BUFR_Dataset* dts;
+		BufrDescValue bdv;
+		DataSubset    *dss;
+		BufrDescriptor *bcv;
+		int64_t        scaled;
+		BUFR_Template* tmpl = bufr_create_template( NULL, 0, tables, 4 );
+		assert( tmpl != NULL );
+		
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = 12101;
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		bufr_finalize_template( tmpl );
+
+		dts = bufr_create_dataset(tmpl);
+		assert(dts != NULL);
+
+		for (i = 0; i < 3 ; i++)
+			{
+			n = bufr_create_datasubset(dts);
+			assert( n == i );
+			dss = bufr_get_datasubset( dts, n );
+			n = bufr_subset_find_descriptor( dss, 12101, 0 );
+			assert( n >= 0 );
+			bcv = bufr_datasubset_get_descriptor( dss, n );
+			assert( bufr_descriptor_set_scaled( bcv, temps[i] ) == 1 );
+			assert( bufr_descriptor_get_scaled( bcv, &scaled ) == 1 );
+			assert( scaled == temps[i] );
+			}
+
+		/* out of range values are refused */
+		assert( bufr_descriptor_set_scaled( bcv, -1 ) == -1 );
+		assert( bufr_descriptor_get_scaled( bcv, &scaled ) == 1 );
+		assert( scaled == temps[2] );
+
+		msg = bufr_encode_message(dts,0);
+		assert( msg != NULL );
+
+		msglen = bufr_memwrite_message( msgstr, sizeof(msgstr), msg);
+		assert( msglen >= 0 );
+
+		bufr_free_message( msg );
+		bufr_free_dataset( dts );
+		bufr_free_template( tmpl );
+	}
+
+	/* ...and read them back without floating point */
+	{
+		int i, n;
+		BUFR_Message* msg = NULL;
+		BUFR_Dataset* dts;
+		DataSubset    *dss;
+		BufrDescriptor *bcv;
+		int64_t        scaled, column[3];
+		uint64_t       bits;
+		assert( bufr_memread_message(msgstr,msglen,&msg) > 0 );
+
+		dts = bufr_decode_message( msg, tables ); 
+		assert( dts != NULL );
+		assert( bufr_count_datasubset( dts ) == 3 );
+
+		dss = bufr_get_datasubset( dts, 0 );
+		n = bufr_subset_find_descriptor( dss, 12101, 0 );
+		assert( n >= 0 );
+		bcv = bufr_datasubset_get_descriptor( dss, n );
+
+		assert( bufr_descriptor_get_scaled( bcv, &scaled ) == 1 );
+		assert( scaled == temps[0] );
+		assert( fabs( bufr_descriptor_get_dvalue( bcv ) - 273.15 ) < 1e-9 );
+		assert( bufr_descriptor_get_bitsvalue( bcv, &bits ) == 1 );
+		assert( (int64_t)bits == temps[0] - bcv->encoding.reference );
+
+		assert( bufr_dataset_get_scaled_column( dts, n, column, -1 ) == 3 );
+		for (i = 0; i < 3 ; i++)
+			assert( column[i] == temps[i] );
+
+		bufr_free_dataset( dts );
+		bufr_free_message( msg );
+	}
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
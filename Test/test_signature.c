@@ -0,0 +1,180 @@
+/*
+Unit test for datasubset signatures. Subsets with the same structure have
+the same signature and can be compressed together; a different replication
+count or data width changes the signature.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+#define NB_SUBSETS  12
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+/* two delayed replications of the same element, counts n1 and n2 */
+static void add_subset( BUFR_Dataset *dts, int n1, int n2 )
+	{
+	int            n, m;
+	DataSubset    *dss;
+	BufrDescriptor *bd;
+
+	n = bufr_create_datasubset( dts );
+	assert( n >= 0 );
+	bufr_expand_datasubset( dts, n );
+	dss = bufr_get_datasubset( dts, n );
+
+	m = bufr_subset_find_descriptor( dss, 31001, 0 );
+	assert( m >= 0 );
+	bd = bufr_datasubset_get_descriptor( dss, m );
+	bufr_descriptor_set_ivalue( bd, n1 );
+	bufr_expand_datasubset( dts, n );
+
+	m = bufr_subset_find_descriptor( dss, 31001, m + 1 );
+	assert( m >= 0 );
+	bd = bufr_datasubset_get_descriptor( dss, m );
+	bufr_descriptor_set_ivalue( bd, n2 );
+	assert( bufr_expand_datasubset( dts, n ) == 4 + n1 + n2 );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	int            i, m;
+	int            descs[6] = { 101000, 31001, 12101, 101000, 31001, 12101 };
+	int            groups[NB_SUBSETS];
+	BUFR_Dataset  *dts, *dts2;
+	BufrDescValue  bdv;
+	BUFR_Template *tmpl;
+	BUFR_Message  *msg;
+	DataSubset    *ss0, *ss1, *ss2;
+	BufrDescriptor *bd;
+	BufrValueEncoding be;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_signature.DEBUG" );
+	bufr_set_output_file( "test_signature.OUTPUT" );
+
+	tmpl = bufr_create_template( NULL, 0, tables, 4 );
+	assert( tmpl != NULL );
+	for (i = 0; i < 6 ; i++)
+		{
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = descs[i];
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		}
+	bufr_finalize_template( tmpl );
+
+	dts = bufr_create_dataset(tmpl);
+	assert(dts != NULL);
+
+	/* every subset has the same number of descriptors */
+	for (i = 0; i < NB_SUBSETS ; i++)
+		{
+		if (i % 3 == 1)
+			add_subset( dts, 3, 2 );
+		else
+			add_subset( dts, 2, 3 );
+		}
+
+	ss0 = bufr_get_datasubset( dts, 0 );
+	ss1 = bufr_get_datasubset( dts, 1 );
+	ss2 = bufr_get_datasubset( dts, 2 );
+	assert( bufr_datasubset_signature( ss0 ) != 0 );
+	assert( bufr_datasubset_signature( ss0 ) == bufr_datasubset_signature( ss2 ) );
+	assert( bufr_datasubset_signature( ss0 ) != bufr_datasubset_signature( ss1 ) );
+	assert( bufr_datasubset_same_structure( ss0, ss2 ) == 1 );
+	assert( bufr_datasubset_same_structure( ss0, ss1 ) == 0 );
+
+	/* same descriptor count but different replication counts */
+	assert( bufr_dataset_compressible( dts ) == 0 );
+	msg = bufr_encode_message( dts, 1 );
+	assert( msg != NULL );
+	assert( (msg->s3.flag & BUFR_FLAG_COMPRESSED) == 0 );
+	bufr_free_message( msg );
+
+	assert( bufr_dataset_group_subsets( dts, groups ) == 2 );
+	for (i = 0; i < NB_SUBSETS ; i++)
+		assert( groups[i] == ((i % 3 == 1) ? 1 : 0) );
+
+	/* a group copied out has the same signature and is compressible */
+	dts2 = bufr_create_dataset(tmpl);
+	for (i = 0; i < NB_SUBSETS ; i++)
+		{
+		if (groups[i] == 0)
+			assert( bufr_merge_dataset( dts2, bufr_count_datasubset( dts2 ), dts, i, 1 ) == 1 );
+		}
+	assert( bufr_count_datasubset( dts2 ) == 8 );
+	assert( bufr_datasubset_signature( bufr_get_datasubset( dts2, 0 ) ) == bufr_datasubset_signature( ss0 ) );
+	assert( bufr_dataset_compressible( dts2 ) == 1 );
+	msg = bufr_encode_message( dts2, 1 );
+	assert( msg != NULL );
+	assert( msg->s3.flag & BUFR_FLAG_COMPRESSED );
+	bufr_free_message( msg );
+
+	/* signatures are kept, a count or an encoding set without expanding changes them */
+	ss2 = bufr_get_datasubset( dts2, 1 );
+	assert( ss2->signature != 0 );
+	m = bufr_subset_find_descriptor( ss2, 31001, 0 );
+	assert( m >= 0 );
+	bd = bufr_datasubset_get_descriptor( ss2, m );
+	bufr_value_set_int32( bd->value, 3 );
+	assert( bufr_datasubset_signature( ss2 ) != bufr_datasubset_signature( ss0 ) );
+	assert( bufr_dataset_compressible( dts2 ) == 0 );
+	bufr_value_set_int32( bd->value, 2 );
+	assert( bufr_datasubset_signature( ss2 ) == bufr_datasubset_signature( ss0 ) );
+	assert( bufr_dataset_compressible( dts2 ) == 1 );
+	bd = bufr_datasubset_get_descriptor( ss2, m + 1 );
+	be = bd->encoding;
+	be.nbits += 1;
+	bufr_descriptor_set_encoding( bd, &be );
+	assert( bufr_dataset_compressible( dts2 ) == 0 );
+	be.nbits -= 1;
+	bufr_descriptor_set_encoding( bd, &be );
+	assert( bufr_dataset_compressible( dts2 ) == 1 );
+
+	/* expanding again keeps the same signature */
+	bufr_expand_datasubset( dts2, 0 );
+	assert( bufr_datasubset_signature( bufr_get_datasubset( dts2, 0 ) ) == bufr_datasubset_signature( ss0 ) );
+
+	bufr_free_dataset( dts2 );
+	bufr_free_dataset( dts );
+	bufr_free_template( tmpl );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
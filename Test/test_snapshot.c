@@ -0,0 +1,254 @@
+/*
+Unit test for dataset snapshots. A decoded dataset written to a snapshot
+and opened again must dump and encode exactly like the original, and a
+truncated snapshot is refused.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static const char *files[] = {
+	"BUFR/iuaa01_cwoa_1.bufr",
+	"BUFR/iobx12_kars_131338.bufr",
+	"BUFR/tableC_202YYY.bufr",
+	"BUFR/tableC_207YYYed3.bufr",
+	"BUFR/tableC_208YYY.bufr",
+	"BUFR/dpbm_fostats.bufr",
+	"BUFR/ismd01_okpr.bufr",
+	"BUFR/test_double2float.bufr",
+	"BUFR/AMDAR+2xUS-v15.bufr",
+	"BUFR/case_207-206_OMPS-TC_v2r0_j01_20220411.bufr",
+	NULL
+};
+
+static char *dump_dataset( BUFR_Dataset *dts, const char *filename, long *len )
+	{
+	FILE   *fp;
+	char   *str;
+
+	fp = fopen( filename, "w+" );
+	assert( fp != NULL );
+	bufr_fdump_dataset( dts, fp );
+	*len = ftell( fp );
+	str = (char *)malloc( *len + 1 );
+	rewind( fp );
+	assert( fread( str, 1, *len, fp ) == (size_t)*len );
+	str[*len] = '\0';
+	fclose( fp );
+	return str;
+	}
+
+static char *encode_dataset( BUFR_Dataset *dts, const char *filename, long *len )
+	{
+	FILE          *fp;
+	BUFR_Message  *msg;
+	char          *str;
+
+	msg = bufr_encode_message( dts, -1 );
+	assert( msg != NULL );
+	fp = fopen( filename, "w+b" );
+	assert( fp != NULL );
+	bufr_write_message( fp, msg );
+	bufr_free_message( msg );
+	*len = ftell( fp );
+	str = (char *)malloc( *len + 1 );
+	rewind( fp );
+	assert( fread( str, 1, *len, fp ) == (size_t)*len );
+	fclose( fp );
+	return str;
+	}
+
+static void check_file( const char *filename, BUFR_Tables *tables )
+	{
+	FILE           *fp;
+	BUFR_Message   *msg;
+	BUFR_Dataset   *dts[64], *dts2;
+	BufrSnapshot   *snap;
+	BufrSnapRecord *recs;
+	BufrDescriptor *bd;
+	char           *str1, *str2;
+	long            len1, len2;
+	int             i, j, count, nb, len, slen;
+
+	/* every dataset of a file in one snapshot */
+	fp = fopen( filename, "rb" );
+	assert( fp != NULL );
+	count = 0;
+	while ((count < 64)&&(bufr_read_message( fp, &msg ) > 0))
+		{
+		dts[count] = bufr_decode_message( msg, tables );
+		bufr_free_message( msg );
+		if (dts[count] != NULL) ++count;
+		}
+	fclose( fp );
+	assert( count > 0 );
+
+	fp = fopen( "test_snapshot.snap", "wb" );
+	assert( fp != NULL );
+	for (i = 0; i < count ; i++)
+		assert( bufr_write_snapshot( dts[i], fp ) == bufr_count_datasubset( dts[i] ) );
+	fclose( fp );
+
+	snap = bufr_open_snapshot( "test_snapshot.snap" );
+	assert( snap != NULL );
+	assert( snap->nb_datasets == count );
+
+	for (i = 0; i < count ; i++)
+		{
+		/* the records are there without making a dataset */
+		assert( snap->datasets[i].header->nb_subsets == bufr_count_datasubset( dts[i] ) );
+		recs = bufr_snapshot_records( &(snap->datasets[i]), 0, &nb );
+		assert( nb == bufr_datasubset_count_descriptor( bufr_get_datasubset( dts[i], 0 ) ) );
+		for (j = 0; j < nb ; j++)
+			{
+			bd = bufr_datasubset_get_descriptor( bufr_get_datasubset( dts[i], 0 ), j );
+			assert( recs[j].descriptor == bd->descriptor );
+			if (bd->value && (bd->value->type == VALTYPE_STRING))
+				{
+				str1 = (char *)bufr_value_get_string( bd->value, &len );
+				str2 = (char *)bufr_snapshot_string( &(snap->datasets[i]), recs + j, &slen );
+				assert( (str1 == NULL)||((len == slen)&&(memcmp( str1, str2, len ) == 0)) );
+				}
+			}
+
+		/* made again, it dumps and encodes the same */
+		dts2 = bufr_snapshot_to_dataset( &(snap->datasets[i]), tables );
+		assert( dts2 != NULL );
+		str1 = dump_dataset( dts[i], "test_snapshot.OUTPUT1", &len1 );
+		str2 = dump_dataset( dts2, "test_snapshot.OUTPUT2", &len2 );
+		assert( (len1 == len2)&&(strcmp( str1, str2 ) == 0) );
+		free( str1 );
+		free( str2 );
+
+		str1 = encode_dataset( dts[i], "test_snapshot.bufr1", &len1 );
+		str2 = encode_dataset( dts2, "test_snapshot.bufr2", &len2 );
+		assert( (len1 == len2)&&(memcmp( str1, str2, len1 ) == 0) );
+		free( str1 );
+		free( str2 );
+		bufr_free_dataset( dts2 );
+		bufr_free_dataset( dts[i] );
+		}
+	bufr_close_snapshot( snap );
+	}
+
+/* a snapshot whose header is patched opens or not */
+static int opens_with_header( const char *filename, BufrSnapshotHeader *hdr )
+	{
+	FILE          *fp;
+	BufrSnapshot  *snap;
+
+	fp = fopen( filename, "r+b" );
+	assert( fp != NULL );
+	assert( fwrite( hdr, sizeof(*hdr), 1, fp ) == 1 );
+	fclose( fp );
+	snap = bufr_open_snapshot( filename );
+	if (snap == NULL) return 0;
+	bufr_close_snapshot( snap );
+	return 1;
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+   FILE          *fp;
+   BUFR_Message  *msg;
+   BUFR_Dataset  *dts;
+   BufrSnapshotHeader hdr, bad;
+   BufrSnapRecord rec;
+   int            i;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_snapshot.DEBUG" );
+	bufr_set_output_file( "test_snapshot.OUTPUT" );
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	for (i = 0; files[i] ; i++)
+		check_file( files[i], tables );
+
+	/* a truncated snapshot is refused */
+	fp = fopen( "test_snapshot.snap", "wb" );
+	assert( fp != NULL );
+	fwrite( "BUFRSNP", 8, 1, fp );
+	fclose( fp );
+	assert( bufr_open_snapshot( "test_snapshot.snap" ) == NULL );
+
+	/* so is one whose records point past aux */
+	msg = read_first( files[0] );
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+	bufr_free_message( msg );
+	fp = fopen( "test_snapshot.snap", "wb" );
+	assert( bufr_write_snapshot( dts, fp ) > 0 );
+	fclose( fp );
+	bufr_free_dataset( dts );
+	fp = fopen( "test_snapshot.snap", "rb" );
+	assert( fread( &hdr, sizeof(hdr), 1, fp ) == 1 );
+	fclose( fp );
+	assert( hdr.nb_records > 0 );
+	assert( opens_with_header( "test_snapshot.snap", &hdr ) );
+
+	/* or whose parts are misplaced or too large to fit */
+	bad = hdr;
+	bad.records_offset = -8;
+	assert( !opens_with_header( "test_snapshot.snap", &bad ) );
+	bad = hdr;
+	bad.records_offset += 4;
+	assert( !opens_with_header( "test_snapshot.snap", &bad ) );
+	bad = hdr;
+	bad.nb_records = INT64_MAX / 16;
+	assert( !opens_with_header( "test_snapshot.snap", &bad ) );
+	bad = hdr;
+	bad.aux_len = INT64_MAX / 2;
+	assert( !opens_with_header( "test_snapshot.snap", &bad ) );
+	assert( opens_with_header( "test_snapshot.snap", &hdr ) );
+
+	fp = fopen( "test_snapshot.snap", "r+b" );
+	assert( fseek( fp, hdr.records_offset, SEEK_SET ) == 0 );
+	assert( fread( &rec, sizeof(rec), 1, fp ) == 1 );
+	rec.meta = hdr.aux_len;
+	assert( fseek( fp, hdr.records_offset, SEEK_SET ) == 0 );
+	assert( fwrite( &rec, sizeof(rec), 1, fp ) == 1 );
+	fclose( fp );
+	assert( bufr_open_snapshot( "test_snapshot.snap" ) == NULL );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
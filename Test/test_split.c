@@ -0,0 +1,205 @@
+/*
+Unit test for splitting messages. Subsets copied bit for bit out of a
+message, compressed or not, into smaller messages must decode to the same
+values as in the original.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+/* a message made of copied bits must decode to the same values */
+static void check_part( BUFR_Dataset *dts, BUFR_Message *part, BUFR_Tables *tables, int first )
+	{
+	BUFR_Dataset   *dts2;
+	DataSubset     *ss1, *ss2;
+	BufrDescriptor *bd1, *bd2;
+	int             i, j, count;
+
+	part->s4.current = part->s4.data;
+	part->s4.bitno = 0;
+	dts2 = bufr_decode_message( part, tables );
+	assert( dts2 != NULL );
+	assert( !(dts2->data_flag & BUFR_FLAG_INVALID) );
+	assert( bufr_count_datasubset( dts2 ) == part->s3.no_data_subsets );
+	for (i = 0; i < bufr_count_datasubset( dts2 ) ; i++)
+		{
+		ss1 = bufr_get_datasubset( dts, first - 1 + i );
+		ss2 = bufr_get_datasubset( dts2, i );
+		count = bufr_datasubset_count_descriptor( ss1 );
+		assert( count == bufr_datasubset_count_descriptor( ss2 ) );
+		for (j = 0; j < count ; j++)
+			{
+			bd1 = bufr_datasubset_get_descriptor( ss1, j );
+			bd2 = bufr_datasubset_get_descriptor( ss2, j );
+			assert( bd1->descriptor == bd2->descriptor );
+			if (bd1->value && bd2->value)
+				assert( bufr_compare_value( bd1->value, bd2->value, 1e-9 ) == 0 );
+			}
+		}
+	bufr_free_dataset( dts2 );
+	}
+
+static void check_message( BUFR_Message *msg, BUFR_Tables *tables, int compressed )
+	{
+	BUFR_Message  *part, **parts;
+	BUFR_Dataset  *dts;
+	uint64_t      *bitpos;
+	int            nbsubset, nb_parts, k;
+
+	nbsubset = msg->s3.no_data_subsets;
+	assert( nbsubset > 4 );
+	assert( (BUFR_IS_COMPRESSED( msg ) != 0) == compressed );
+
+	bitpos = (uint64_t *)malloc( (nbsubset + 1) * sizeof(uint64_t) );
+	if (compressed)
+		assert( bufr_subset_boundaries( msg, tables, bitpos ) == -1 );
+	else
+		{
+		assert( bufr_subset_boundaries( msg, tables, bitpos ) == nbsubset );
+		assert( bitpos[0] == 0 );
+		assert( bitpos[nbsubset] <= (uint64_t)msg->s4.max_data_len * 8 );
+		}
+	free( bitpos );
+
+	msg->s4.current = msg->s4.data;
+	msg->s4.bitno = 0;
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+
+	part = bufr_extract_subsets( msg, tables, 2, 4 );
+	assert( part != NULL );
+	assert( part->s3.no_data_subsets == 3 );
+	assert( (BUFR_IS_COMPRESSED( part ) != 0) == compressed );
+	assert( arr_count( part->s3.desc_list ) == arr_count( msg->s3.desc_list ) );
+	assert( part->s4.len < msg->s4.len );
+	check_part( dts, part, tables, 2 );
+	bufr_free_message( part );
+
+	assert( bufr_extract_subsets( msg, tables, 0, 1 ) == NULL );
+	assert( bufr_extract_subsets( msg, tables, nbsubset, nbsubset + 1 ) == NULL );
+
+	parts = bufr_split_message( msg, tables, 4, &nb_parts );
+	assert( parts != NULL );
+	assert( nb_parts == (nbsubset + 3) / 4 );
+	for (k = 0; k < nb_parts ; k++)
+		{
+		assert( parts[k]->s3.no_data_subsets == ((k < nb_parts - 1) ? 4 : nbsubset - 4 * k) );
+		check_part( dts, parts[k], tables, 4 * k + 1 );
+		bufr_free_message( parts[k] );
+		}
+	free( parts );
+
+	bufr_free_dataset( dts );
+	}
+
+static void check_file( const char *filename, BUFR_Tables *tables, int compressed )
+	{
+	BUFR_Message  *msg;
+
+	msg = read_first( filename );
+	check_message( msg, tables, compressed );
+	bufr_free_message( msg );
+	}
+
+/* subsets of different lengths, located by decoding the message */
+static void check_delayed( BUFR_Tables *tables )
+	{
+	int            i, n, m, k;
+	int            descs[3] = { 101000, 31001, 12101 };
+	BUFR_Template *tmpl;
+	BUFR_Dataset  *dts;
+	BUFR_Message  *msg;
+	BufrDescValue  bdv;
+	DataSubset    *dss;
+	BufrDescriptor *bd;
+
+	tmpl = bufr_create_template( NULL, 0, tables, 4 );
+	assert( tmpl != NULL );
+	for (i = 0; i < 3 ; i++)
+		{
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = descs[i];
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		}
+	assert( bufr_finalize_template( tmpl ) >= 0 );
+
+	dts = bufr_create_dataset( tmpl );
+	for (i = 0; i < 11 ; i++)
+		{
+		n = bufr_create_datasubset( dts );
+		bufr_expand_datasubset( dts, n );
+		dss = bufr_get_datasubset( dts, n );
+		m = bufr_subset_find_descriptor( dss, 31001, 0 );
+		bufr_descriptor_set_ivalue( bufr_datasubset_get_descriptor( dss, m ), i % 3 + 1 );
+		bufr_expand_datasubset( dts, n );
+		for (k = 0; k <= i % 3 ; k++)
+			{
+			bd = bufr_datasubset_get_descriptor( dss, m + 1 + k );
+			bufr_descriptor_set_dvalue( bd, 250.0 + i + k * 0.5 );
+			}
+		}
+	msg = bufr_encode_message( dts, 0 );
+	assert( msg != NULL );
+	check_message( msg, tables, 0 );
+
+	bufr_free_message( msg );
+	bufr_free_dataset( dts );
+	bufr_free_template( tmpl );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_split.DEBUG" );
+	bufr_set_output_file( "test_split.OUTPUT" );
+
+	check_file( "BUFR/iuaa01_cwoa_1.bufr", tables, 0 );
+	check_file( "BUFR/iobx12_kars_131338.bufr", tables, 0 );
+	check_delayed( tables );
+	/* compressed, with Table C operators in the second one */
+	check_file( "BUFR/dpbm_fostats.bufr", tables, 1 );
+	check_file( "BUFR/tableC_202YYY.bufr", tables, 1 );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
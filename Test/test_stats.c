@@ -0,0 +1,146 @@
+/*
+Unit test for element statistics. Count, minimum, maximum and mean of an
+element, read from the blocks of a compressed message, must be those of the
+decoded values; uncompressed messages are decoded.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "bufr_api.h"
+#include "test_helpers.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static int same_double( double d1, double d2 )
+	{
+	return fabs( d1 - d2 ) <= 1e-6 * (fabs( d1 ) + fabs( d2 ) + 1.0);
+	}
+
+/* statistics read from the blocks are those of the decoded values */
+static void check_compressed( const char *filename, BUFR_Tables *tables )
+	{
+	BUFR_Message      *msg;
+	BUFR_Dataset      *dts;
+	BufrStats         *st1, *st2;
+	BufrElementStats  *es1, *es2;
+	int                i, nbsubset;
+
+	msg = read_first( filename );
+	assert( BUFR_IS_COMPRESSED( msg ) );
+	nbsubset = msg->s3.no_data_subsets;
+
+	st1 = bufr_create_stats();
+	assert( bufr_stats_add_message( st1, msg, tables ) == nbsubset );
+	/* twice, the statistics accumulate */
+	assert( bufr_stats_add_message( st1, msg, tables ) == nbsubset );
+	assert( st1->nb_messages == 2 );
+	assert( st1->nb_subsets == 2 * nbsubset );
+
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+	st2 = bufr_create_stats();
+	assert( bufr_stats_add_dataset( st2, dts ) == nbsubset );
+	assert( bufr_stats_add_dataset( st2, dts ) == nbsubset );
+
+	assert( bufr_stats_count( st1 ) > 0 );
+	assert( bufr_stats_count( st1 ) == bufr_stats_count( st2 ) );
+	for (i = 0; i < bufr_stats_count( st1 ) ; i++)
+		{
+		es1 = bufr_stats_get( st1, i );
+		es2 = bufr_stats_find( st2, es1->descriptor );
+		assert( es2 != NULL );
+		assert( es1->count == es2->count );
+		assert( es1->nb_missing == es2->nb_missing );
+		assert( (es1->count + es1->nb_missing) % (2 * nbsubset) == 0 );
+		if (es1->count == 0) continue;
+		assert( same_double( es1->min, es2->min ) );
+		assert( same_double( es1->max, es2->max ) );
+		assert( same_double( es1->sum / es1->count, es2->sum / es2->count ) );
+		}
+	assert( bufr_stats_find( st1, 999999 ) == NULL );
+	assert( bufr_stats_get( st1, bufr_stats_count( st1 ) ) == NULL );
+
+	bufr_free_stats( st1 );
+	bufr_free_stats( st2 );
+	bufr_free_dataset( dts );
+	bufr_free_message( msg );
+	}
+
+/* uncompressed messages are decoded */
+static void check_uncompressed( const char *filename, BUFR_Tables *tables )
+	{
+	BUFR_Message      *msg;
+	BufrStats         *stats;
+	BufrElementStats  *es;
+	int                i;
+
+	msg = read_first( filename );
+	assert( !BUFR_IS_COMPRESSED( msg ) );
+
+	stats = bufr_create_stats();
+	assert( bufr_stats_add_message( stats, msg, tables ) == msg->s3.no_data_subsets );
+	assert( bufr_stats_count( stats ) > 0 );
+	for (i = 0; i < bufr_stats_count( stats ) ; i++)
+		{
+		es = bufr_stats_get( stats, i );
+		assert( es->count + es->nb_missing >= msg->s3.no_data_subsets );
+		if (es->count > 0)
+			assert( es->min <= es->max );
+		}
+	bufr_print_stats( stats, bufr_print_output );
+
+	bufr_free_stats( stats );
+	bufr_free_message( msg );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_stats.DEBUG" );
+	bufr_set_output_file( "test_stats.OUTPUT" );
+
+	check_compressed( "BUFR/dpbm_fostats.bufr", tables );
+	check_compressed( "BUFR/tableC_202YYY.bufr", tables );
+	check_uncompressed( "BUFR/iuaa01_cwoa_1.bufr", tables );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
@@ -0,0 +1,195 @@
+/*
+Unit test for the subset position index. Every search for a sequence of
+descriptor keys must answer the same with and without the index.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static BUFR_Dataset *decode_first( const char *filename, BUFR_Tables *tables )
+	{
+	FILE          *fp;
+	BUFR_Message  *msg=NULL;
+	BUFR_Dataset  *dts;
+
+	fp = fopen( filename, "r" );
+	assert( fp != NULL );
+	assert( bufr_read_message( fp, &msg ) > 0 );
+	fclose( fp );
+	dts = bufr_decode_message( msg, tables );
+	assert( dts != NULL );
+	bufr_free_message( msg );
+	return dts;
+	}
+
+/* a sequence of nbkey descriptor keys taken from the subset at pos, 0 if none */
+static int make_keys( DataSubset *dss, int pos, int nbkey, BufrDescValue *keys )
+	{
+	BufrDescriptor *bd;
+	int             k, ival;
+
+	/* keys on Table D descriptors would carry flag bits */
+	for (k = 0; k < nbkey ; k++)
+		{
+		if (!bufr_is_table_b( bufr_datasubset_get_descriptor( dss, pos + k )->descriptor ))
+			return 0;
+		}
+	for (k = 0; k < nbkey ; k++)
+		{
+		bd = bufr_datasubset_get_descriptor( dss, pos + k );
+		if ((k == 0)&&(bd->value != NULL)&&(bd->encoding.type == TYPE_NUMERIC)&&
+		    (bd->encoding.scale == 0)&&!bufr_value_is_missing( bd->value ))
+			{
+			ival = bufr_descriptor_get_ivalue( bd );
+			bufr_set_key_int32( &(keys[k]), bd->descriptor, &ival, 1 );
+			}
+		else
+			bufr_set_key_int32( &(keys[k]), bd->descriptor, NULL, 0 );
+		}
+	return nbkey;
+	}
+
+static void free_keys( BufrDescValue *keys, int nbkey )
+	{
+	int   k;
+
+	for (k = 0; k < nbkey ; k++)
+		bufr_vfree_DescValue( &(keys[k]) );
+	}
+
+/* every search answers the same with and without the index */
+static void check_dataset( BUFR_Dataset *dts, int nb_expected )
+	{
+	DataSubset     *dss;
+	BufrDescriptor *bd;
+	BufrDescValue   keys[3];
+	int             i, j, s, count, nbsubset, nbkey;
+	int           **found;
+	const int      *positions;
+
+	nbsubset = bufr_count_datasubset( dts );
+	found = (int **)malloc( nbsubset * sizeof(int *) );
+
+	/* answers of the linear scan */
+	for (i = 0; i < nbsubset ; i++)
+		{
+		dss = bufr_get_datasubset( dts, i );
+		count = bufr_datasubset_count_descriptor( dss );
+		assert( bufr_datasubset_find_positions( dss, 12101, 0, &positions ) == -1 );
+		found[i] = (int *)malloc( 2 * count * sizeof(int) );
+		for (j = 0; j < count ; j++)
+			{
+			bd = bufr_datasubset_get_descriptor( dss, j );
+			found[i][2*j] = bufr_subset_find_descriptor( dss, bd->descriptor, j / 2 );
+			nbkey = (j + 3 <= count) ? 3 : count - j;
+			if (make_keys( dss, j, nbkey, keys ) == 0) continue;
+			found[i][2*j+1] = bufr_subset_find_values( dss, keys, nbkey, 0 );
+			assert( bufr_subset_find_values( dss, keys, nbkey, j ) == j );
+			free_keys( keys, nbkey );
+			}
+		}
+
+	assert( bufr_dataset_build_index( dts ) == nb_expected );
+
+	for (i = 0; i < nbsubset ; i++)
+		{
+		dss = bufr_get_datasubset( dts, i );
+		count = bufr_datasubset_count_descriptor( dss );
+		assert( dss->index != NULL );
+		for (j = 0; j < count ; j++)
+			{
+			bd = bufr_datasubset_get_descriptor( dss, j );
+			assert( bufr_subset_find_descriptor( dss, bd->descriptor, j / 2 ) == found[i][2*j] );
+			nbkey = (j + 3 <= count) ? 3 : count - j;
+			if (make_keys( dss, j, nbkey, keys ) > 0)
+				{
+				assert( bufr_subset_find_values( dss, keys, nbkey, 0 ) == found[i][2*j+1] );
+				assert( bufr_subset_find_values( dss, keys, nbkey, j ) == j );
+				free_keys( keys, nbkey );
+				}
+
+			/* the positions are sorted and hold the descriptor */
+			s = bufr_datasubset_find_positions( dss, bd->descriptor, j, &positions );
+			assert( (s >= 1)&&(positions[0] == j) );
+			while (--s > 0)
+				{
+				assert( positions[s] > positions[s-1] );
+				assert( bufr_datasubset_get_descriptor( dss, positions[s] )->descriptor == bd->descriptor );
+				}
+			}
+		assert( bufr_subset_find_descriptor( dss, 999999, 0 ) == -1 );
+		assert( bufr_datasubset_find_positions( dss, 999999, 0, &positions ) == 0 );
+		free( found[i] );
+		}
+	free( found );
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+   BUFR_Dataset  *dts;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_subset_index.DEBUG" );
+	bufr_set_output_file( "test_subset_index.OUTPUT" );
+
+	/* fixed layout, one index shared by all subsets */
+	dts = decode_first( "BUFR/iobx12_kars_131338.bufr", tables );
+	assert( bufr_count_datasubset( dts ) > 1 );
+	check_dataset( dts, 1 );
+	assert( bufr_get_datasubset( dts, 0 )->index == bufr_get_datasubset( dts, 1 )->index );
+	assert( bufr_get_datasubset( dts, 0 )->index->refcount == bufr_count_datasubset( dts ) );
+
+	/* expanding drops the index of that subset only */
+	bufr_expand_datasubset( dts, 0 );
+	assert( bufr_get_datasubset( dts, 0 )->index == NULL );
+	assert( bufr_get_datasubset( dts, 1 )->index->refcount == bufr_count_datasubset( dts ) - 1 );
+	assert( bufr_datasubset_build_index( bufr_get_datasubset( dts, 0 ) ) > 0 );
+	bufr_free_dataset( dts );
+
+	/* a single subset */
+	dts = decode_first( "BUFR/iuaa01_cwoa_1.bufr", tables );
+	check_dataset( dts, 1 );
+	bufr_free_dataset( dts );
+
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
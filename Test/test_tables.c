@@ -127,6 +127,62 @@ int main(int argc, char *argv[])
 	desc[0] = 101015;
 	assert( NULL == bufr_match_tableD_sequence(tables, 3, desc) );
 
+	/* a second expansion of a sequence comes from the expansion cache */
+	{
+		BUFR_Sequence *bsq1, *bsq2;
+		ListNode      *n1, *n2;
+		int            errflg = 0;
+
+		bsq1 = bufr_expand_descriptor( 311001, OP_RM_XPNDBL_DESC, tables, &errflg );
+		assert( bsq1 != NULL && errflg == 0 );
+		assert( tables->tableD_expansions != NULL );
+		bsq2 = bufr_expand_descriptor( 311001, OP_RM_XPNDBL_DESC, tables, &errflg );
+		assert( bsq2 != NULL && errflg == 0 );
+		assert( lst_count( bsq1->list ) == lst_count( bsq2->list ) );
+		n1 = lst_firstnode( bsq1->list );
+		n2 = lst_firstnode( bsq2->list );
+		while ( n1 && n2 )
+			{
+			BufrDescriptor *d1 = (BufrDescriptor *)n1->data;
+			BufrDescriptor *d2 = (BufrDescriptor *)n2->data;
+			assert( d1 != d2 );
+			assert( d1->descriptor == d2->descriptor );
+			assert( d1->encoding.nbits == d2->encoding.nbits );
+			n1 = lst_nextnode( n1 );
+			n2 = lst_nextnode( n2 );
+			}
+		bufr_free_sequence( bsq1 );
+		bufr_free_sequence( bsq2 );
+
+		bufr_clear_tabled_expansions( tables );
+		assert( tables->tableD_expansions == NULL );
+	}
+
+	/* array conversions give the same results as one value at a time */
+	{
+		EntryTableB *tb;
+		int64_t      ivals[4] = { 0, 1234, 27315, -1 };
+		double       dvals[4];
+		uint64_t     bits[4];
+		int          i;
+
+		assert( bufr_pow10( 0 ) == 1.0 );
+		assert( bufr_pow10( 3 ) == 1000.0 );
+		assert( bufr_pow10( -2 ) == 0.01 );
+
+		tb = bufr_fetch_tableB( tables, 12101 );
+		assert( tb != NULL );
+		ivals[3] = bufr_missing_ivalue( tb->encoding.nbits );
+		assert( bufr_cvt_i64_to_dval_array( &(tb->encoding), ivals, dvals, 4 ) == 1 );
+		for (i = 0; i < 4 ; i++)
+			assert( dvals[i] == bufr_cvt_i64_to_dval( &(tb->encoding), ivals[i] ) );
+		assert( bufr_is_missing_double( dvals[3] ) );
+
+		assert( bufr_cvt_dval_to_i64_array( 12101, &(tb->encoding), dvals, bits, 4 ) == 1 );
+		for (i = 0; i < 4 ; i++)
+			assert( bits[i] == (uint64_t)ivals[i] );
+	}
+
    bufr_free_tables( tables );
 	exit(0);
    }
@@ -0,0 +1,133 @@
+/*
+Unit test for threaded encoding. A dataset encoded with several threads,
+compressed or not, must be bit identical to the one encoded serially.
+*/
+
+/***
+Copyright Her Majesty The Queen in Right of Canada, Environment Canada, 2009-2010.
+Copyright Sa Majest la Reine du Chef du Canada, Environnement Canada, 2009-2010.
+
+This file is part of libECBUFR.
+
+    libECBUFR is free software: you can redistribute it and/or modify
+    it under the terms of the Lesser GNU General Public License,
+    version 3, as published by the Free Software Foundation.
+
+    libECBUFR is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    Lesser GNU General Public License for more details.
+
+    You should have received a copy of the Lesser GNU General Public
+    License along with libECBUFR.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bufr_api.h"
+
+/* subsets and compressed blocks do not end on octet boundaries */
+#define NB_SUBSETS  997
+#define NB_DESCS    14
+
+static void my_abort( const char* msg ) {
+	fprintf(stderr,"%s\n", msg );
+	exit(0);
+}
+
+static ssize_t encode( BUFR_Dataset *dts, int x_compress, int nb_threads, char *mem, size_t len )
+	{
+	BUFR_Message *msg;
+	ssize_t       msglen;
+
+	bufr_set_threads( nb_threads );
+	msg = bufr_encode_message( dts, x_compress );
+	assert( msg != NULL );
+	msglen = bufr_memwrite_message( mem, len, msg );
+	assert( msglen > 0 );
+	bufr_free_message( msg );
+	bufr_set_threads( 1 );
+	return msglen;
+	}
+
+int main(int argc, char *argv[])
+   {
+   BUFR_Tables   *tables=NULL;
+	static char    serial[NB_SUBSETS*64], threaded[NB_SUBSETS*64];
+	ssize_t        serial_len, threaded_len;
+	int            i, j, nb_threads, x_compress;
+	int            descs[NB_DESCS] = { 12101, 20011, 1015, 4001, 4002, 4003, 4004,
+	                                   5001, 6001, 7030, 10004, 11001, 11002, 12103 };
+	double         temps[NB_SUBSETS], dvals[NB_SUBSETS];
+	int32_t        clouds[NB_SUBSETS];
+	char           names[NB_SUBSETS][21];
+	const char    *pnames[NB_SUBSETS];
+	BUFR_Dataset  *dts;
+	BufrDescValue  bdv;
+	BUFR_Template *tmpl;
+
+   bufr_begin_api();
+
+	putenv("BUFR_TABLES=../Tables/");
+
+   tables = bufr_create_tables();
+   bufr_load_cmc_tables( tables );  
+
+	bufr_set_abort( my_abort );
+	bufr_set_debug_file( "test_threads.DEBUG" );
+	bufr_set_output_file( "test_threads.OUTPUT" );
+
+	tmpl = bufr_create_template( NULL, 0, tables, 4 );
+	assert( tmpl != NULL );
+	for (i = 0; i < NB_DESCS ; i++)
+		{
+		bufr_init_DescValue( &bdv );
+		bdv.descriptor = descs[i];
+		bufr_template_add_DescValue( tmpl, &bdv, 1 );
+		}
+	bufr_finalize_template( tmpl );
+
+	dts = bufr_create_dataset(tmpl);
+	assert(dts != NULL);
+
+	for (i = 0; i < NB_SUBSETS ; i++)
+		{
+		assert( bufr_create_datasubset(dts) == i );
+		temps[i] = 250.0 + (i % 500) * 0.1;
+		clouds[i] = (i % 7 == 0) ? -1 : i % 9;
+		sprintf( names[i], "STATION %d", i );
+		pnames[i] = (i % 11 == 0) ? NULL : names[i];
+		}
+	assert( bufr_dataset_set_dvalue_column( dts, 0, temps, NULL ) == 0 );
+	assert( bufr_dataset_set_ivalue_column( dts, 1, clouds, NULL ) == 0 );
+	assert( bufr_dataset_set_svalue_column( dts, 2, pnames, NULL ) == 0 );
+	for (j = 3; j < NB_DESCS ; j++)
+		{
+		/* the constant year gives a block without increments */
+		for (i = 0; i < NB_SUBSETS ; i++)
+			dvals[i] = (j == 3) ? 2024 : (j < 7) ? 1 + (i * j) % 4 : 10.0 + ((i * j) % 300) * 0.5;
+		assert( bufr_dataset_set_dvalue_column( dts, j, dvals, NULL ) == 0 );
+		}
+
+	/* the threaded encoding must be bit identical to the serial one */
+	for (x_compress = 0; x_compress <= 1 ; x_compress++)
+		{
+		serial_len = encode( dts, x_compress, 1, serial, sizeof(serial) );
+		for (nb_threads = 2; nb_threads <= 5 ; nb_threads++)
+			{
+			threaded_len = encode( dts, x_compress, nb_threads, threaded, sizeof(threaded) );
+			assert( threaded_len == serial_len );
+			assert( memcmp( serial, threaded, serial_len ) == 0 );
+			}
+		}
+
+	bufr_free_dataset( dts );
+	bufr_free_template( tmpl );
+   bufr_free_tables( tables );
+   bufr_end_api();
+	exit(0);
+   }
@@ -21,6 +21,10 @@ This generates multiple OUTPUT-n.bufr files
 
 #define   EXIT_ERROR    5
 
+#define   KEY_IN_SEQUENCE  0
+#define   KEY_AND          1
+#define   KEY_OR           2
+
 static  char *str_ltableb = NULL;
 static  char *str_ltabled = NULL;
 static  char *str_ibufr   = NULL;
@@ -28,14 +32,20 @@ static  char *str_obufr   = NULL;
 
 static  BufrDescValue srchkey[100];
 static  int           nb_key=0;
+static  int           srchsep[100];   /* HOW EACH KEY JOINS THE PREVIOUS ONES */
+static  int           next_sep=KEY_IN_SEQUENCE;
 static  int           use_compress=0;
+static  int           max_subsets=0;
+static  int           max_octets=0;
 static  BufrSection1  section1;
 
 static int  read_cmdline( int argc, const char *argv[] );
 static void abort_usage(const char *pgrmname);
 static int  bundle_file (BufrDescValue *dvalues, int nbdv);
-static int  match_search_pattern( DataSubset *subset, BufrDescValue *dvalues, int nb );
+static int  match_search_pattern( DataSubset *subset, BufrQuery *query );
+static BufrQuery *build_query( BufrDescValue *dvalues, int nb );
 static int  resolve_search_values( BufrDescValue *dvalues, int nb, BUFR_Tables *tbls );
+static void write_bundle( BUFR_Message *msg, void *client_data );
 
 
 /*
@@ -63,7 +73,11 @@ static void abort_usage(const char *pgrmname)
    fprintf( stderr, _("          [-ltableb    <filename>]    local table B to use for decoding\n") );
    fprintf( stderr, _("          [-ltabled    <filename>]    local table D to use for decoding\n") );
    fprintf( stderr, _("          [-compress] compress datasubsets if possible\n") );
+   fprintf( stderr, _("          [-max_subsets value]  maximum number of subsets per message\n") );
+   fprintf( stderr, _("          [-max_octets value]   section 4 size at which a message is written\n") );
    fprintf( stderr, _("          [-srchkey descriptor value] descriptor value pair(s) search key\n") );
+   fprintf( stderr, _("          [-and] next search keys may be anywhere in the subset\n") );
+   fprintf( stderr, _("          [-or]  next search keys are an alternative to the previous ones\n") );
    exit(EXIT_ERROR);
 }
 
@@ -107,6 +121,16 @@ static int read_cmdline( int argc, const char *argv[] )
        {
        use_compress = 1;
        }
+     else if (strcmp(argv[i],"-max_subsets")==0)
+       {
+        ++i; if (i >= argc) abort_usage(argv[0]);
+       max_subsets = atoi(argv[i]);
+       }
+     else if (strcmp(argv[i],"-max_octets")==0)
+       {
+        ++i; if (i >= argc) abort_usage(argv[0]);
+       max_octets = atoi(argv[i]);
+       }
      else if (strcmp(argv[i],"-category")==0)
        {
         ++i; if (i >= argc) abort_usage(argv[0]);
@@ -126,12 +150,22 @@ static int read_cmdline( int argc, const char *argv[] )
        {
        int desc;
        ++i; if (i >= argc) abort_usage(argv[0]);
+       srchsep[nb_key] = next_sep;
+       next_sep = KEY_IN_SEQUENCE;
        bufr_init_DescValue( &(srchkey[nb_key]) );
        desc = atoi( argv[i] );
        ++i; if (i >= argc) abort_usage(argv[0]);
        bufr_set_key_string( &(srchkey[nb_key]), desc, &(argv[i]), 1 );
        ++nb_key; 
        }
+     else if (strcmp(argv[i],"-and")==0)
+       {
+       if (next_sep != KEY_OR) next_sep = KEY_AND;
+       }
+     else if (strcmp(argv[i],"-or")==0)
+       {
+       next_sep = KEY_OR;
+       }
    }
 
    return 0;
@@ -211,25 +245,25 @@ int main(int argc, const char *argv[])
 
 static int bundle_file (BufrDescValue *dvalues, int nbdv)
    {
-   BUFR_Dataset  *dts, *dts2;
+   BUFR_Dataset  *dts;
+   BUFR_Template *tmplt=NULL;
+   BufrSection1   s1;
+   int            data_flag=0;
+   BUFR_Bundler  *bundler;
    int           sscount;
    FILE          *fp, *fpO;
    char           buf[256];
    BUFR_Message  *msg;
    int            rtrn;
    int            count;
-   int            pos;
    char           filename[512];
    char           prefix[512], *str;
    BUFR_Tables   *file_tables=NULL;
    BUFR_Tables   *useTables=NULL;
    LinkedList    *tables_list=NULL;
    int            tablenos[2];
-/*
-   BUFR_Template *tmplt=NULL;
-   BUFR_Template *tmplt2=NULL;
-*/
    DataSubset    *subset;
+   BufrQuery     *query;
    int            i;
 /*
  * load CMC Table B and D, currently version 14
@@ -274,11 +308,19 @@ static int bundle_file (BufrDescValue *dvalues, int nbdv)
       }
 
    resolve_search_values( dvalues, nbdv, file_tables );
+   query = build_query( dvalues, nbdv );
+/*
+ * subsets are appended to messages as they are read, a message is written
+ * whenever it is full, the rest at the end; with -compress, subsets that
+ * differ in structure (delayed replications, operators) go to separate
+ * messages so that each one can be compressed
+ */
+   bundler = bufr_create_bundler( use_compress, write_bundle, fpO );
+   bufr_bundler_set_limits( bundler, max_subsets, max_octets, 0 );
 /*
  * read all messages from the input file
  */
    count = 0;
-   dts2 = NULL;
 /*
  * go through every report in the file and merge those that fit the pattern into a single bundle
  */
@@ -303,27 +345,32 @@ static int bundle_file (BufrDescValue *dvalues, int nbdv)
          if (useTables->master.version != msg->s1.master_table_version)
             useTables = bufr_use_tables_list( tables_list, msg->s1.master_table_version );
    
-         if (useTables != NULL)
-            dts = bufr_decode_message( msg, useTables );
-         else 
+/*
+ * once the template is known, messages that cannot match are not decoded
+ */
+         if ((useTables == NULL)||
+             (tmplt && !bufr_message_may_match( msg, useTables, query )))
             dts = NULL;
+         else
+            dts = bufr_decode_message( msg, useTables );
    
          if (dts != NULL)
             {
-            if (dts2 == NULL)
+            if (tmplt == NULL)
                {
-               dts2 = bufr_create_dataset( dts->tmplte );
-/*
- * transfer section 1 and flag from origin message
- */
-               bufr_copy_sect1( &(dts2->s1), &(msg->s1) );
-               dts2->data_flag |= msg->s3.flag;
+               tmplt = bufr_copy_template( dts->tmplte );
+               bufr_copy_sect1( &s1, &(msg->s1) );
+               data_flag = dts->data_flag | msg->s3.flag;
                }
 /*
- * only report with same template can be bundled together
+ * only report with same template can be bundled together,
+ * section 1 and flag are those of the first message, as they always were,
+ * so that all subsets go into the same bundle
  */
-            if (bufr_compare_template( dts->tmplte, dts2->tmplte ) == 0)
+            if (bufr_compare_template( dts->tmplte, tmplt ) == 0)
                {
+               bufr_copy_sect1( &(dts->s1), &s1 );
+               dts->data_flag = data_flag;
                sscount = bufr_count_datasubset( dts );
                for (i = 0; i < sscount ; i++)
                   {
@@ -331,11 +378,8 @@ static int bundle_file (BufrDescValue *dvalues, int nbdv)
 /* 
  * apply descriptor=value  filter if any, otherwise accept everything
  */
-                  if (match_search_pattern( subset, dvalues, nbdv ))
-                     {
-                     pos = bufr_create_datasubset( dts2 );
-                     bufr_merge_dataset( dts2, pos, dts, i, 1 );
-                     }
+                  if (match_search_pattern( subset, query ))
+                     bufr_bundler_add_subset( bundler, dts, i );
                   }
                }
             bufr_free_dataset( dts );
@@ -348,21 +392,16 @@ static int bundle_file (BufrDescValue *dvalues, int nbdv)
       }
 
 /*
- * write the content of cumulated dataset into a file
+ * write what remains of the bundles into the file
  */
-   if (dts2) 
-      {
-      if (bufr_count_datasubset( dts2 ) > 0)
-         {
-         BUFR_Message  *msg2 = bufr_encode_message ( dts2, use_compress );
-         bufr_write_message( fpO, msg2 ); 
-         bufr_free_message( msg2 );
-         }
-      bufr_free_dataset( dts2 );
-      }
+   bufr_bundler_flush( bundler );
+   bufr_free_bundler( bundler );
+   bufr_free_template( tmplt );
 /*
  * close all file and cleanup
  */
+   bufr_free_query( query );
+
    if (str_ibufr != NULL)
       fclose( fp );
 
@@ -372,6 +411,20 @@ static int bundle_file (BufrDescValue *dvalues, int nbdv)
    bufr_free_tables_list( tables_list );
    }
 
+/*
+ * nom: write_bundle
+ *
+ * fonction: ecrire un message complete par le bundler
+ *
+ * parametres:  
+ *        msg  : le message
+ *        client_data : le fichier de sortie
+ */
+static void write_bundle( BUFR_Message *msg, void *client_data )
+   {
+   bufr_write_message( (FILE *)client_data, msg );
+   }
+
 static int resolve_search_values( BufrDescValue *dvalues, int nb, BUFR_Tables *tbls )
    {
    int i;
@@ -443,11 +496,40 @@ static int resolve_search_values( BufrDescValue *dvalues, int nb, BUFR_Tables *t
    return nb;
    }
 
-static int match_search_pattern ( DataSubset *subset, BufrDescValue *dvalues, int nb )
+/*
+ * nom: build_query
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: compiler les cles de recherche en une requete
+ *
+ * Consecutive keys form a sequence as found by bufr_subset_find_values,
+ * -and starts another sequence that must also be found, -or starts an
+ * alternative.
+ *
+ * parametres:  
+ *        dvalues, nb
+ */
+static BufrQuery *build_query( BufrDescValue *dvalues, int nb )
    {
-   int pos;
+   BufrQuery *query;
+   int        i, first;
 
-   if (nb <= 0) return 1;
-   pos = bufr_subset_find_values ( subset, dvalues, nb, 0 );
-   return ((pos >= 0) ? 1 : 0);
+   query = bufr_create_query();
+   first = 0;
+   for (i = 1; i <= nb ; i++)
+      {
+      if ((i < nb)&&(srchsep[i] == KEY_IN_SEQUENCE)) continue;
+
+      bufr_query_add_term( query, &(dvalues[first]), i - first );
+      if ((i < nb)&&(srchsep[i] == KEY_OR))
+         bufr_query_or( query );
+      first = i;
+      }
+   return query;
+   }
+
+static int match_search_pattern ( DataSubset *subset, BufrQuery *query )
+   {
+   return bufr_query_match( query, subset );
    }
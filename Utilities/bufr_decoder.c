@@ -23,6 +23,7 @@ This file is part of libECBUFR.
 #include <math.h>
 #include <time.h>
 #include <locale.h>
+#include <pthread.h>
 
 #include "bufr_i18n.h"
 #include "bufr_api.h"
@@ -59,11 +60,18 @@ static  char *str_ibufr = NULL;
 static  char *str_output= NULL;
 static  char *str_debug = "DEBUG.decoder";
 static  char *str_template= NULL;
+static  char *str_sidecar = NULL;
+static  char *str_make_sidecar = NULL;
+static  char *str_snapshot = NULL;
+static  char *str_station = NULL;
+static  int64_t  srch_hour = BLOOM_ANY_TIME;
 
 static int   stop_count=0;
 static int   subset_from=0;
 static int   subset_to=0;
 static int   dumpmode=0;
+static int   statsmode=0;
+static int   dedupmode=0;
 static int   show_unitdesc=0;
 static int   show_loctime=0;
 static int   show_meta=1;
@@ -72,9 +80,49 @@ static int   format_ouput=1;
 static int   trim_zero=1;
 
 static BUFR_Enforcement  enforce=BUFR_WARN_ALLOW;
+static int   nb_threads=1;
 /*
  * data structures
  */
+static BUFR_Tables      *file_tables=NULL;
+static LinkedList       *tables_list=NULL;
+static BufrStats        *stats=NULL;
+static FILE             *fpSnap=NULL;
+static FILE             *fpOutput=NULL;
+
+/*
+ * a message decoded by one of the threads of -threads, with its output
+ * kept in chunks going either to the output or to the dump
+ */
+typedef struct
+   {
+   BUFR_Message     *msg;
+   char             *out;
+   size_t            len, max;
+   BUFR_Dataset     *dts;      /* ITS TEMPLATE TO SAVE, IN MESSAGE ORDER */
+   int               stop;     /* DECODING STOPS IF IT IS THE LAST ONE ASKED */
+   int               done;
+   } DecodeJob;
+
+/*
+ * messages between the reading thread, the decoding threads and the
+ * writing one, within a ring of nb_jobs
+ */
+typedef struct
+   {
+   DecodeJob        *jobs;
+   int               nb_jobs;
+   long              nb_read, nb_taken, nb_written;
+   int               eof;
+   FILE             *fpBufr;
+   BufrDedup        *dedup;
+   BufrBloomSidecar *sidecar;
+   FILE             *fp;
+   pthread_mutex_t   lock;
+   pthread_cond_t    cond;
+   } DecodePipeline;
+
+static pthread_key_t  job_key;
 
 static void abort_usage(char *pgrmname);
 static void cleanup(void);
@@ -83,6 +131,16 @@ static void bufr_show_dataset( BUFR_Dataset *dts, BUFR_Tables *, int isubset );
 static void bufr_show_dataset_formatted( BUFR_Dataset *dts, BUFR_Tables *, int isubset );
 
 static void run_decoder(void);
+static int  decode_message( BUFR_Message *msg, FILE *fp, BUFR_Dataset **keep_dts );
+static void make_sidecar(void);
+static int  threads_usable(void);
+static void output_handler( const char *str );
+static void write_output( const char *str, size_t len );
+static void job_append( DecodeJob *job, char dest, const char *str, size_t len );
+static void run_job( DecodeJob *job, FILE *fp );
+static void *pipeline_reader( void *data );
+static void *pipeline_worker( void *data );
+static int  decode_threaded( FILE *fpBufr, BufrDedup *dedup, BufrBloomSidecar *sidecar, FILE *fp );
 
 void bufr_summarize_repl( BUFR_Dataset *dts );
 
@@ -110,6 +168,7 @@ static void abort_usage(char *pgrmname)
    fprintf( stderr, _("          [-debug]                    debug mode (put the messages into file) \n") );
    fprintf( stderr, _("          [-nometa]                   dont show meta info\n") );
    fprintf( stderr, _("          [-dump]                     dump template and data in ASCII file suitable for re-encoding\n") );
+   fprintf( stderr, _("          [-stats]                    show count, min, max and mean of each element instead of values\n") );
    fprintf( stderr, _("          [-describe]                 show description and unit\n") );
    fprintf( stderr, _("          [-location]                 show implicit location or time\n") );
    fprintf( stderr, _("          [-locdesc    <descriptor>]  show RTMD of the location descriptors\n") );
@@ -122,6 +181,13 @@ static void abort_usage(char *pgrmname)
    fprintf( stderr, _("          [-strict]                   enforce BUFR rules compliance\n") );
    fprintf( stderr, _("          [-keep_zero]                keep all trailing zeroes\n") );
    fprintf( stderr, _("          [-trim_zero]                trim all trailing zeroes (default)\n") );
+   fprintf( stderr, _("          [-make_sidecar <filename>]  write the bloom filters of stations and hours\n") );
+   fprintf( stderr, _("          [-sidecar    <filename>]    bloom filters used to skip messages\n") );
+   fprintf( stderr, _("          [-station    <id>]          with -sidecar, only messages that may hold the station\n") );
+   fprintf( stderr, _("          [-hour       <YYYYMMDDHH>]  with -sidecar, only messages that may hold the hour\n") );
+   fprintf( stderr, _("          [-dedup]                    drop duplicate and superseded bulletins before decoding\n") );
+   fprintf( stderr, _("          [-snapshot   <filename>]    write the decoded datasets as a binary snapshot\n") );
+   fprintf( stderr, _("          [-threads    <number>]      threads decoding messages, output kept in order\n") );
    exit(EXIT_ERROR);
 }
 
@@ -161,6 +227,10 @@ static int read_cmdline( int argc, char *argv[] )
        bufr_set_debug( 1 );
      } else if (strcmp(argv[i],"-dump")==0) {
        dumpmode = 1;
+     } else if (strcmp(argv[i],"-stats")==0) {
+       statsmode = 1;
+     } else if (strcmp(argv[i],"-dedup")==0) {
+       dedupmode = 1;
      } else if (strcmp(argv[i],"-stop")==0) {
        ++i; if (i >= argc) abort_usage(argv[0]);
        stop_count = atoi(argv[i]);
@@ -191,6 +261,24 @@ static int read_cmdline( int argc, char *argv[] )
         trim_zero = 0;
      } else if (strcmp(argv[i],"-trim_zero")==0) {
         trim_zero = 1;
+     } else if (strcmp(argv[i],"-make_sidecar")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_make_sidecar = strdup(argv[i]);
+     } else if (strcmp(argv[i],"-sidecar")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_sidecar = strdup(argv[i]);
+     } else if (strcmp(argv[i],"-station")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_station = strdup(argv[i]);
+     } else if (strcmp(argv[i],"-hour")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       srch_hour = bufr_archive_hour( argv[i] );
+     } else if (strcmp(argv[i],"-snapshot")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_snapshot = strdup(argv[i]);
+     } else if (strcmp(argv[i],"-threads")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       nb_threads = atoi(argv[i]);
      }
    }
 
@@ -213,6 +301,10 @@ static void cleanup(void)
    if (str_ltabled != NULL) free(str_ltabled);
    if (str_ibufr!= NULL) free(str_ibufr);
    if (str_output != NULL) free(str_output);
+   if (str_sidecar != NULL) free(str_sidecar);
+   if (str_make_sidecar != NULL) free(str_make_sidecar);
+   if (str_station != NULL) free(str_station);
+   if (str_snapshot != NULL) free(str_snapshot);
 
 }
 
@@ -243,13 +335,32 @@ int main(int argc,char *argv[])
       abort_usage( argv[0] );
 
    bufr_set_trimzero( trim_zero );
-   if (str_output && !dumpmode)
-      bufr_set_output_file( str_output );
+/*
+ * with threads, the output of each message is caught in memory
+ */
+   if (threads_usable())
+      {
+      pthread_key_create( &job_key, NULL );
+      if (str_output && !dumpmode)
+         fpOutput = fopen( str_output, "w" );
+      bufr_set_output_handler( output_handler );
+      }
+   else
+      {
+      nb_threads = 1;
+      if (str_output && !dumpmode)
+         bufr_set_output_file( str_output );
+      }
 /*
  * charger les tables en memoire
  */
    run_decoder();
 
+   if (nb_threads > 1)
+      {
+      bufr_set_output_handler( NULL );
+      if (fpOutput) fclose( fpOutput );
+      }
    cleanup();
    bufr_end_api();
    exit(0);
@@ -257,18 +368,16 @@ int main(int argc,char *argv[])
 
 static void run_decoder(void)
    {
-   BUFR_Dataset   *dts;
    FILE         *fpBufr;
-   BUFR_Tables   *file_tables=NULL;
-   BUFR_Tables   *useTables=NULL;
    char           buf[256];
    BUFR_Message  *msg;
    int            rtrn;
    int            count;
-   LinkedList    *tables_list=NULL;
    FILE          *fp = NULL;
-   int            tablenos[2];
+   int            tablenos[6];
    int            cnt;
+   BufrBloomSidecar *sidecar=NULL;
+   BufrDedup     *dedup=NULL;
 
    if (bufr_is_verbose())
       {
@@ -304,6 +413,32 @@ static void run_decoder(void)
  * load local tables if any to list of tables
  */
    bufr_tables_list_addlocal( tables_list, str_ltableb, str_ltabled );
+/*
+ * bloom filters of the file and of each of its messages
+ */
+   if (str_make_sidecar)
+      make_sidecar();
+/*
+ * the bloom filters can tell that the file holds nothing to decode
+ */
+   if (str_sidecar && (str_station || (srch_hour != BLOOM_ANY_TIME)))
+      {
+      fp = fopen( str_sidecar, "rb" );
+      if (fp != NULL)
+         {
+         sidecar = bufr_read_bloom_sidecar( fp );
+         fclose( fp );
+         fp = NULL;
+         }
+      if (sidecar && !bufr_sidecar_may_hold( sidecar, -1, str_station, srch_hour ))
+         {
+         if (bufr_is_verbose())
+            bufr_print_debug( _("No station nor hour to decode in this file\n") );
+         bufr_free_bloom_sidecar( sidecar );
+         bufr_free_tables_list( tables_list );
+         return;
+         }
+      }
 /*
  * open a file for reading
  */
@@ -335,107 +470,606 @@ static void run_decoder(void)
       fp = stdout;
       }
 
-   count = 0;
-   while ( (rtrn = bufr_read_message( fpBufr, &msg )) > 0 )
+   if (statsmode)
+      stats = bufr_create_stats();
+   if (dedupmode)
+      dedup = bufr_create_dedup( 0, 0 );
+   if (str_snapshot)
       {
-      ++count;
-      if (!dumpmode && (format_ouput >= 0))
-         bufr_print_message( msg, bufr_print_output );
+      fpSnap = fopen( str_snapshot, "wb" );
+      if (fpSnap == NULL)
+         {
+         sprintf( buf, _("Error: can't open file \"%s\"\n"), str_snapshot );
+         bufr_print_debug( buf );
+         exit(EXIT_ERROR);
+         }
+      }
+
+   if ((nb_threads <= 1)||!decode_threaded( fpBufr, dedup, sidecar, fp ))
+      {
+      count = 0;
+      while ( (rtrn = (dedup ? bufr_dedup_read_message( dedup, fpBufr, &msg )
+                             : bufr_read_message( fpBufr, &msg ))) > 0 )
+         {
 /*
- * fallback on default Tables first
+ * messages that cannot hold the station or hour are skipped
+ */
+         if (sidecar && (msg->offset >= 0)&&!bufr_sidecar_may_hold( sidecar, msg->offset, str_station, srch_hour ))
+            {
+            bufr_free_message( msg );
+            continue;
+            }
+         ++count;
+         if (decode_message( msg, fp, NULL ) && (count == stop_count)) break;
+         }
+      }
+   if (statsmode)
+      {
+      bufr_print_stats( stats, bufr_print_output );
+      bufr_free_stats( stats );
+      }
+   bufr_free_bloom_sidecar( sidecar );
+   if (dedup)
+      {
+      if (bufr_is_verbose())
+         {
+         sprintf( buf, _("Duplicates: %ld, superseded: %ld, corrections: %ld\n"),
+                  dedup->nb_duplicates, dedup->nb_stale, dedup->nb_corrections );
+         bufr_print_debug( buf );
+         }
+      bufr_free_dedup( dedup );
+      }
+/*
+ * close all file and cleanup
+ */
+   if (str_ibufr != NULL)
+      fclose( fpBufr );
+
+   
+   if (str_output) 
+      fclose( fp );
+   if (fpSnap)
+      fclose( fpSnap );
+   bufr_free_tables_list( tables_list );
+   }
+
+/*
+ * nom: make_sidecar
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: ecrire les filtres de Bloom du fichier et de chacun de ses messages
+ *
+ * Every message of the file is indexed on its own pass, whatever -subset,
+ * -sidecar, -dedup or -stop leave out of the decoding, so that the filters
+ * never rule out a message that holds a station or an hour.
+ *
+ * parametres:  
  */
+static void make_sidecar(void)
+   {
+   BufrArchiveIndex *archive;
+   BufrBloomSidecar *sc;
+   BUFR_Message     *msg;
+   BUFR_Tables      *useTables;
+   FILE             *fpBufr, *fpS;
+   char              buf[256];
+
+   fpBufr = (str_ibufr != NULL) ? fopen( str_ibufr, "rb" ) : NULL;
+   if (fpBufr == NULL)
+      {
+      sprintf( buf, _("Error: -make_sidecar needs an input file that can be read again\n") );
+      bufr_print_debug( buf );
+      return;
+      }
+
+   archive = bufr_create_archive_index();
+   while (bufr_read_message( fpBufr, &msg ) > 0)
+      {
       useTables = file_tables;
+      if (useTables->master.version != msg->s1.master_table_version)
+         useTables = bufr_use_tables_list( tables_list, msg->s1.master_table_version );
+      if (useTables != NULL)
+         {
+         bufr_set_enforcement( msg, enforce );
+         bufr_archive_index_add_message( archive, msg, useTables, msg->offset );
+         }
+      else
+         {
+         bufr_archive_index_add_dataset( archive, msg, NULL, msg->offset );
+         }
+      bufr_free_message( msg );
+      }
+   fclose( fpBufr );
+
+   fpS = fopen( str_make_sidecar, "wb" );
+   if (fpS == NULL)
+      {
+      sprintf( buf, _("Error: can't open file \"%s\"\n"), str_make_sidecar );
+      bufr_print_debug( buf );
+      }
+   else
+      {
+      sc = bufr_archive_index_sidecar( archive, 1, 0.01 );
+      bufr_write_bloom_sidecar( sc, fpS );
+      bufr_free_bloom_sidecar( sc );
+      fclose( fpS );
+      }
+   bufr_free_archive_index( archive );
+   }
+
+/*
+ * nom: decode_message
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: decoder un message et en afficher le contenu
+ *
+ * parametres:  
+ *        msg      : le message, libere
+ *        count    : son numero
+ *        fp       : fichier du dump
+ *        keep_dts : si non NULL, recoit le dataset dont le gabarit reste a sauver
+ *
+ * retour: 1 si le decodage doit s'arreter au nombre de messages demande
+ */
+static int decode_message( BUFR_Message *msg, FILE *fp, BUFR_Dataset **keep_dts )
+   {
+   BUFR_Dataset   *dts;
+   BUFR_Tables    *useTables;
+   char            buf[256];
+
+   if (!dumpmode && !statsmode && (format_ouput >= 0))
+      bufr_print_message( msg, bufr_print_output );
+/*
+ * fallback on default Tables first
+ */
+   useTables = file_tables;
 /* 
  * try to find another if not compatible
  */
-      if (useTables->master.version != msg->s1.master_table_version)
-         useTables = bufr_use_tables_list( tables_list, msg->s1.master_table_version );
+   if (useTables->master.version != msg->s1.master_table_version)
+      useTables = bufr_use_tables_list( tables_list, msg->s1.master_table_version );
 /* 
  * BUFR_Message ==> BUFR_Dataset 
  */
-      if (useTables == NULL) 
+   if (useTables == NULL) 
+      {
+      dts = NULL;
+      sprintf( buf, _("Error: no BUFR tables version %d\n"), msg->s1.master_table_version );
+      bufr_print_output( buf );
+      bufr_print_debug( buf );
+      }
+   else
+      { 
+      if (bufr_is_verbose())
          {
-         dts = NULL;
-         sprintf( buf, _("Error: no BUFR tables version %d\n"), msg->s1.master_table_version );
-         bufr_print_output( buf );
+         sprintf( buf, _("Decoding message version %d with BUFR tables version %d\n"), msg->s1.master_table_version, useTables->master.version );
          bufr_print_debug( buf );
          }
-      else
-         { 
-         if (bufr_is_verbose())
+      bufr_set_enforcement( msg, enforce );
+/*
+ * compressed messages are summarized without being decoded
+ */
+      if (statsmode)
+         {
+         if (bufr_stats_add_message( stats, msg, useTables ) < 0)
             {
-            sprintf( buf, _("Decoding message version %d with BUFR tables version %d\n"), msg->s1.master_table_version, useTables->master.version );
+            strcpy( buf, _("Error: can't decode messages\n") );
             bufr_print_debug( buf );
             }
-         bufr_set_enforcement( msg, enforce );
-         dts = bufr_decode_message_subsets( msg, useTables, subset_from, subset_to ); 
+         bufr_free_message( msg );
+         return 1;
+         }
+      dts = bufr_decode_message_subsets( msg, useTables, subset_from, subset_to ); 
+      }
+   if (dts == NULL) 
+      {
+      strcpy( buf, _("Error: can't decode messages\n") );
+      bufr_print_output( buf );
+      bufr_print_debug( buf );
+      bufr_free_message( msg );
+      return 0;
+      }
+/*
+   bufr_summarize_repl( dts );
+*/
+   if (dts->data_flag & BUFR_FLAG_INVALID)
+      {
+      strcpy( buf, _("# *** Warning: invalid message coding ***\n") );
+      bufr_print_output( buf );
+      strcpy( buf, _("*** Warning: invalid message coding ***\n") );
+      bufr_print_debug( buf );
+      }
+/*
+ * see if the Message contains Local Table Update
+ */
+   if (bufr_contains_tables( dts ))
+      {
+      BUFR_Tables   *tbls;
+
+      tbls = bufr_extract_tables( dts );
+      if (tbls)
+         {
+         bufr_tables_list_merge( tables_list, tbls );
+         bufr_free_tables( tbls );
          }
+      if (dumpmode)
+         {
+         bufr_free_dataset( dts );
+         bufr_free_message( msg );
+         return 0;
+         }
+      }
 
-      if (dts == NULL) 
+   if (fpSnap)
+      bufr_write_snapshot( dts, fpSnap );
+
+   if (dumpmode && fp)
+      {
+      if (str_template && (keep_dts == NULL))
+         bufr_save_template( str_template, bufr_get_dataset_template(dts) );
+      bufr_fdump_dataset( dts, fp );
+/*
+ * the template is saved by the writing thread, in message order
+ */
+      if (str_template && keep_dts)
          {
-         strcpy( buf, _("Error: can't decode messages\n") );
-         bufr_print_output( buf );
-         bufr_print_debug( buf );
+         *keep_dts = dts;
+         dts = NULL;
+         }
+      }
+   else if (format_ouput == 1)
+      bufr_show_dataset_formatted( dts, file_tables, subset_from );
+   else if (format_ouput == 0)
+      bufr_show_dataset( dts, file_tables, subset_from );
+
+   bufr_free_dataset( dts );
+   bufr_free_message( msg );
+   return 1;
+   }
+
+/*
+ * nom: threads_usable
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: dire si le decodage peut se faire avec plusieurs threads
+ *
+ * parametres:  
+ *
+ * retour: 1 si oui; les statistiques, le snapshot et le mode debug
+ *         demandent un seul thread
+ */
+static int threads_usable(void)
+   {
+   if (nb_threads <= 1) return 0;
+   if (statsmode || str_snapshot || bufr_is_debug()) return 0;
+#if !HAVE_OPEN_MEMSTREAM
+   if (dumpmode) return 0;
+#endif
+   return 1;
+   }
+
+/*
+ * nom: output_handler
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: recevoir la sortie de bufr_print_output avec plusieurs threads,
+ *           gardee avec le message en cours de decodage s'il y en a un
+ *
+ * parametres:  
+ *        str  : texte a afficher
+ */
+static void output_handler( const char *str )
+   {
+   DecodeJob  *job;
+
+   job = (DecodeJob *)pthread_getspecific( job_key );
+   if (job)
+      job_append( job, 'o', str, strlen( str ) );
+   else
+      write_output( str, strlen( str ) );
+   }
+
+/*
+ * nom: write_output
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: ecrire la sortie la ou bufr_print_output l'aurait ecrite
+ *
+ * parametres:  
+ *        str  : texte a afficher
+ *        len  : sa longueur
+ */
+static void write_output( const char *str, size_t len )
+   {
+   if (fpOutput)
+      fwrite( str, 1, len, fpOutput );
+   else if ((str_output == NULL)||dumpmode)
+      fwrite( str, 1, len, stdout );
+   }
+
+/*
+ * nom: job_append
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: ajouter un morceau de la sortie d'un message
+ *
+ * parametres:  
+ *        job   : le message
+ *        dest  : 'o' pour la sortie, 'd' pour le dump
+ *        str   : le texte
+ *        len   : sa longueur
+ */
+static void job_append( DecodeJob *job, char dest, const char *str, size_t len )
+   {
+   size_t  need;
+
+   need = job->len + 1 + sizeof(size_t) + len;
+   if (need > job->max)
+      {
+      job->max = (need > 2 * job->max) ? need : 2 * job->max;
+      job->out = (char *)realloc( job->out, job->max );
+      }
+   job->out[job->len] = dest;
+   memcpy( job->out + job->len + 1, &len, sizeof(size_t) );
+   memcpy( job->out + job->len + 1 + sizeof(size_t), str, len );
+   job->len = need;
+   }
+
+/*
+ * nom: run_job
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: decoder un message en gardant sa sortie en memoire
+ *
+ * parametres:  
+ *        job  : le message
+ *        fp   : fichier du dump, NULL s'il n'y en a pas
+ */
+static void run_job( DecodeJob *job, FILE *fp )
+   {
+   FILE    *mem=NULL;
+   char    *text=NULL;
+   size_t   size=0;
+
+   pthread_setspecific( job_key, job );
+#if HAVE_OPEN_MEMSTREAM
+   if (dumpmode && fp)
+      mem = open_memstream( &text, &size );
+#endif
+   job->stop = decode_message( job->msg, mem, &job->dts );
+   job->msg = NULL;
+   if (mem)
+      {
+      fclose( mem );
+      job_append( job, 'd', text, size );
+      free( text );
+      }
+   pthread_setspecific( job_key, NULL );
+   }
+
+/*
+ * nom: pipeline_reader
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: thread qui lit les messages et les met en file pour les
+ *           threads de decodage, sans depasser la taille de la file
+ *
+ * parametres:  
+ *        data  : le DecodePipeline
+ */
+static void *pipeline_reader( void *data )
+   {
+   DecodePipeline *pl = (DecodePipeline *)data;
+   DecodeJob      *job;
+   BUFR_Message   *msg;
+   int             count=0;
+   int             barrier, stop;
+
+   while ( (pl->dedup ? bufr_dedup_read_message( pl->dedup, pl->fpBufr, &msg )
+                      : bufr_read_message( pl->fpBufr, &msg )) > 0 )
+      {
+      if (pl->sidecar && (msg->offset >= 0)&&!bufr_sidecar_may_hold( pl->sidecar, msg->offset, str_station, srch_hour ))
+         {
+         bufr_free_message( msg );
          continue;
          }
+      ++count;
 /*
-      bufr_summarize_repl( dts );
-*/
-      if (dts->data_flag & BUFR_FLAG_INVALID)
+ * a message of local tables changes the decoding of those that follow:
+ * it is decoded here once all those before are written
+ */
+      barrier = (msg->s1.msg_type == MSGDTYPE_TABLES_REPLACE_UPDATE);
+
+      pthread_mutex_lock( &pl->lock );
+      while ((pl->nb_read - pl->nb_written >= pl->nb_jobs)||
+             (barrier && (pl->nb_written < pl->nb_read)))
+         pthread_cond_wait( &pl->cond, &pl->lock );
+      job = &pl->jobs[pl->nb_read % pl->nb_jobs];
+      memset( job, 0, sizeof(DecodeJob) );
+      job->msg = msg;
+      pthread_mutex_unlock( &pl->lock );
+
+      if (barrier)
+         run_job( job, pl->fp );
+
+      pthread_mutex_lock( &pl->lock );
+      if (barrier)
          {
-         strcpy( buf, _("# *** Warning: invalid message coding ***\n") );
-         bufr_print_output( buf );
-         strcpy( buf, _("*** Warning: invalid message coding ***\n") );
-         bufr_print_debug( buf );
+         job->done = 1;
+         pl->nb_taken++;
          }
+      pl->nb_read++;
+      pthread_cond_broadcast( &pl->cond );
 /*
- * see if the Message contains Local Table Update
+ * stop after the given number of messages, as the serial decoding would
  */
-      if (bufr_contains_tables( dts ))
+      stop = 0;
+      if (count == stop_count)
          {
-         BUFR_Tables   *tbls;
-
-         tbls = bufr_extract_tables( dts );
-         if (tbls)
-            {
-            bufr_tables_list_merge( tables_list, tbls );
-            bufr_free_tables( tbls );
-            }
-         if (dumpmode)
-            {
-            bufr_free_dataset( dts );
-            dts = NULL;
-            continue;
-            }
+         while (!job->done)
+            pthread_cond_wait( &pl->cond, &pl->lock );
+         stop = job->stop;
          }
+      pthread_mutex_unlock( &pl->lock );
+      if (stop) break;
+      }
+
+   pthread_mutex_lock( &pl->lock );
+   pl->eof = 1;
+   pthread_cond_broadcast( &pl->cond );
+   pthread_mutex_unlock( &pl->lock );
+   return NULL;
+   }
 
-      if (dumpmode && fp)
+/*
+ * nom: pipeline_worker
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: thread qui decode les messages de la file
+ *
+ * parametres:  
+ *        data  : le DecodePipeline
+ */
+static void *pipeline_worker( void *data )
+   {
+   DecodePipeline *pl = (DecodePipeline *)data;
+   DecodeJob      *job;
+
+   for (;;)
+      {
+      pthread_mutex_lock( &pl->lock );
+      while ((pl->nb_taken == pl->nb_read) && !pl->eof)
+         pthread_cond_wait( &pl->cond, &pl->lock );
+      if (pl->nb_taken == pl->nb_read)
          {
-         if (str_template)
-            {
-            bufr_save_template( str_template, bufr_get_dataset_template(dts) );
-            }
-         bufr_fdump_dataset( dts, fp );
+         pthread_mutex_unlock( &pl->lock );
+         break;
          }
-      else if (format_ouput == 1)
-         bufr_show_dataset_formatted( dts, file_tables, subset_from );
-      else if (format_ouput == 0)
-         bufr_show_dataset( dts, file_tables, subset_from );
+      job = &pl->jobs[pl->nb_taken++ % pl->nb_jobs];
+      pthread_mutex_unlock( &pl->lock );
 
-      bufr_free_dataset( dts );
-      bufr_free_message( msg );
-      if (count == stop_count) break;
+      run_job( job, pl->fp );
+
+      pthread_mutex_lock( &pl->lock );
+      job->done = 1;
+      pthread_cond_broadcast( &pl->cond );
+      pthread_mutex_unlock( &pl->lock );
       }
+   return NULL;
+   }
+
 /*
- * close all file and cleanup
+ * nom: decode_threaded
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: decoder les messages avec un thread de lecture, nb_threads
+ *           threads de decodage, et ecrire leur sortie dans l'ordre
+ *           des messages, la meme qu'avec un seul thread
+ *
+ * parametres:  
+ *        fpBufr  : fichier BUFR
+ *        dedup   : pour enlever les doublons, ou NULL
+ *        sidecar : filtres de Bloom, ou NULL
+ *        fp      : fichier du dump
+ *
+ * retour: 0 si les threads n'ont pu etre crees, rien n'a ete lu
  */
-   if (str_ibufr != NULL)
-      fclose( fpBufr );
+static int decode_threaded( FILE *fpBufr, BufrDedup *dedup, BufrBloomSidecar *sidecar, FILE *fp )
+   {
+   DecodePipeline  pl;
+   DecodeJob      *job;
+   pthread_t       reader;
+   pthread_t      *tids;
+   int             i, started;
+   char           *ptr, *end;
+   size_t          len;
+
+   memset( &pl, 0, sizeof(pl) );
+   pl.nb_jobs = nb_threads * 4;
+   pl.jobs = (DecodeJob *)calloc( pl.nb_jobs, sizeof(DecodeJob) );
+   pl.fpBufr = fpBufr;
+   pl.dedup = dedup;
+   pl.sidecar = sidecar;
+   pl.fp = fp;
+   pthread_mutex_init( &pl.lock, NULL );
+   pthread_cond_init( &pl.cond, NULL );
+
+   tids = (pthread_t *)malloc( nb_threads * sizeof(pthread_t) );
+   for (started = 0; started < nb_threads ; started++)
+      if (pthread_create( &tids[started], NULL, pipeline_worker, &pl ) != 0) break;
+   if ((started == 0)||(pthread_create( &reader, NULL, pipeline_reader, &pl ) != 0))
+      {
+      pthread_mutex_lock( &pl.lock );
+      pl.eof = 1;
+      pthread_cond_broadcast( &pl.cond );
+      pthread_mutex_unlock( &pl.lock );
+      for (i = 0; i < started ; i++)
+         pthread_join( tids[i], NULL );
+      free( tids );
+      pthread_cond_destroy( &pl.cond );
+      pthread_mutex_destroy( &pl.lock );
+      free( pl.jobs );
+      return 0;
+      }
+/*
+ * write the output of each message in turn
+ */
+   for (;;)
+      {
+      pthread_mutex_lock( &pl.lock );
+      while ((pl.nb_written == pl.nb_read) && !pl.eof)
+         pthread_cond_wait( &pl.cond, &pl.lock );
+      if (pl.nb_written == pl.nb_read)
+         {
+         pthread_mutex_unlock( &pl.lock );
+         break;
+         }
+      job = &pl.jobs[pl.nb_written % pl.nb_jobs];
+      while (!job->done)
+         pthread_cond_wait( &pl.cond, &pl.lock );
+      pthread_mutex_unlock( &pl.lock );
 
-   
-   if (str_output) 
-      fclose( fp );
-   bufr_free_tables_list( tables_list );
+      for (ptr = job->out, end = job->out + job->len; ptr < end ; ptr += 1 + sizeof(size_t) + len)
+         {
+         memcpy( &len, ptr + 1, sizeof(size_t) );
+         if (ptr[0] == 'd')
+            fwrite( ptr + 1 + sizeof(size_t), 1, len, fp );
+         else
+            write_output( ptr + 1 + sizeof(size_t), len );
+         }
+      if (job->dts)
+         {
+         bufr_save_template( str_template, bufr_get_dataset_template(job->dts) );
+         bufr_free_dataset( job->dts );
+         }
+      free( job->out );
+
+      pthread_mutex_lock( &pl.lock );
+      job->out = NULL;
+      job->dts = NULL;
+      pl.nb_written++;
+      pthread_cond_broadcast( &pl.cond );
+      pthread_mutex_unlock( &pl.lock );
+      }
+
+   pthread_join( reader, NULL );
+   for (i = 0; i < started ; i++)
+      pthread_join( tids[i], NULL );
+   free( tids );
+   pthread_cond_destroy( &pl.cond );
+   pthread_mutex_destroy( &pl.lock );
+   free( pl.jobs );
+   return 1;
    }
 
 static void bufr_show_dataset( BUFR_Dataset *dts, BUFR_Tables *tables, int isubset )
@@ -54,6 +54,7 @@ static  char *str_debug= "DEBUG.encoder";
 static  int   nb_subset=1;
 static  int   def_values=0;
 static  char *str_datafile = NULL;
+static  char *str_snapshot = NULL;
 
 static BUFR_Tables  *tables = NULL;
 /*
@@ -66,6 +67,7 @@ static void cleanup(void);
 static int  read_cmdline( int argc, char *argv[] );
 
 static void run_tests(void);
+static void encode_snapshot( const char *filename );
 static void make_test_dataset( BUFR_Dataset *dts );
 
 /*
@@ -86,6 +88,7 @@ static void abort_usage(char *pgrmname)
    fprintf( stderr, _("Usage: %s\n"), pgrmname );
    fprintf( stderr, _("          [-outbufr    <filename>]   encoded BUFR file (default=OUT.bufr)\n") );
    fprintf( stderr, _("          [-datafile   <filename>]   data file from the dumped output of the decoder\n") );
+   fprintf( stderr, _("          [-snapshot   <filename>]   binary snapshot written by the decoder (no template)\n") );
    fprintf( stderr, _("          [-template   <filename>]   template file to use for encoding\n") );
    fprintf( stderr, _("          [-ltableb    <filename>]   local table B to use for encoding\n") );
    fprintf( stderr, _("          [-ltabled    <filename>]   local table D to use for encoding\n") );
@@ -97,6 +100,7 @@ static void abort_usage(char *pgrmname)
    fprintf( stderr, _("          [-compress]                compress datasubsets if possible\n") );
    fprintf( stderr, _("          [-no_compress]             do not compress datasubsets\n") );
    fprintf( stderr, _("          [-debug]                   debug mode (put the messages into file)\n") );
+   fprintf( stderr, _("          [-threads    <number>]     threads for encoding the messages of a data file\n") );
    fprintf( stderr, _("          [-sequence   <descriptor>] sequence descriptor from table D\n") );
    fprintf( stderr, _("\n  Env. Variables:\n") );
    fprintf( stderr, _("     BUFR_TEMPLATE : specify template file\n") );
@@ -133,6 +137,9 @@ static int read_cmdline( int argc, char *argv[] )
      } else if (strcmp(argv[i],"-datafile")==0) {
        ++i; if (i >= argc) abort_usage(argv[0]);
        str_datafile = strdup(argv[i]);
+     } else if (strcmp(argv[i],"-snapshot")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_snapshot = strdup(argv[i]);
      } else if (strcmp(argv[i],"-template")==0) {
        ++i; if (i >= argc) abort_usage(argv[0]);
        str_template = strdup(argv[i]);
@@ -147,6 +154,9 @@ static int read_cmdline( int argc, char *argv[] )
        if (nb_subset <= 0) nb_subset = 1;
      } else if (strcmp(argv[i],"-debug")==0) {
        bufr_set_debug( 1 );
+     } else if (strcmp(argv[i],"-threads")==0) {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       bufr_set_threads( atoi(argv[i]) );
      } else if (strcmp(argv[i],"-compress")==0) {
        use_compress = 1;
      } else if (strcmp(argv[i],"-no_compress")==0) {
@@ -195,6 +205,7 @@ static void cleanup(void)
    if ((str_obufr!= NULL)&&(str_obufr!=def_str_obufr)) free(str_obufr);
    if (str_template != NULL) free(str_template);
    if (str_datafile != NULL) free( str_datafile );
+   if (str_snapshot != NULL) free( str_snapshot );
 
    bufr_free_tables( tables );
 }
@@ -265,6 +276,15 @@ static void run_tests(void)
       bufr_load_l_tableB( tables, str_ltableb );
    if (str_ltabled)
       bufr_load_l_tableD( tables, str_ltabled );
+/*
+ * a snapshot holds its own templates
+ */
+   if (str_snapshot)
+      {
+      encode_snapshot( str_snapshot );
+      bufr_print_debug( NULL );
+      return;
+      }
 
 /*
  * create a template
@@ -340,6 +360,56 @@ static void run_tests(void)
    bufr_print_debug( NULL );
    }
 
+/*
+ * nom: encode_snapshot
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: encoder les datasets d'une image binaire ecrite par le decodeur
+ *
+ * parametres:  
+ *        filename  : nom du fichier de l'image
+ */
+static void encode_snapshot( const char *filename )
+   {
+   BufrSnapshot  *snap;
+   BUFR_Dataset  *dts;
+   BUFR_Message  *msg;
+   FILE          *fpBufr;
+   int            i;
+
+   snap = bufr_open_snapshot( filename );
+   if (snap == NULL)
+      {
+      fprintf( stderr, _("Error: can't read snapshot \"%s\"\n"), filename );
+      exit(1);
+      }
+
+   fpBufr = fopen( str_obufr, "wb" );
+   if (fpBufr == NULL)
+      {
+      fprintf( stderr, _("Error: can't open file \"%s\"\n"), str_obufr );
+      exit(1);
+      }
+
+   for (i = 0; i < snap->nb_datasets ; i++)
+      {
+      dts = bufr_snapshot_to_dataset( &(snap->datasets[i]), tables );
+      if (dts == NULL) continue;
+
+      msg = bufr_encode_message( dts, use_compress );
+      if (msg != NULL)
+         {
+         bufr_write_message( fpBufr, msg );
+         bufr_free_message( msg );
+         }
+      bufr_free_dataset( dts );
+      }
+
+   fclose( fpBufr );
+   bufr_close_snapshot( snap );
+   }
+
 static void make_test_dataset( BUFR_Dataset *dts )
    {
    DataSubset    *subset;
@@ -21,6 +21,10 @@ This generates multiple OUTPUT-n.bufr files
 
 #define   EXIT_ERROR    5
 
+#define   KEY_IN_SEQUENCE  0
+#define   KEY_AND          1
+#define   KEY_OR           2
+
 static  char *str_ltableb = NULL;
 static  char *str_ltabled = NULL;
 static  char *str_ibufr   = NULL;
@@ -28,13 +32,19 @@ static  char *str_obufr   = NULL;
 
 static  BufrDescValue srchkey[100];
 static  int           nb_key=0;
+static  int           srchsep[100];   /* HOW EACH KEY JOINS THE PREVIOUS ONES */
+static  int           next_sep=KEY_IN_SEQUENCE;
 static  int           use_compress=0;
 static  BufrSection1  section1;
+static  char         *str_sidecar = NULL;
+static  char         *str_station = NULL;
+static  int64_t       srch_hour = BLOOM_ANY_TIME;
 
 static int  read_cmdline( int argc, const char *argv[] );
 static void abort_usage(const char *pgrmname);
 static int  filter_file (BufrDescValue *dvalues, int nbdv);
-static int  match_search_pattern( DataSubset *subset, BufrDescValue *dvalues, int nb );
+static int  match_search_pattern( DataSubset *subset, BufrQuery *query );
+static BufrQuery *build_query( BufrDescValue *dvalues, int nb );
 static int  resolve_search_values( BufrDescValue *dvalues, int nb, BUFR_Tables *tbls );
 
 
@@ -64,6 +74,11 @@ static void abort_usage(const char *pgrmname)
    fprintf( stderr, _("          [-ltabled    <filename>]    local table D to use for decoding\n") );
    fprintf( stderr, _("          [-compress] compress datasubsets if possible\n") );
    fprintf( stderr, _("          [-srchkey descriptor value] descriptor value pair(s) search key\n") );
+   fprintf( stderr, _("          [-and] next search keys may be anywhere in the subset\n") );
+   fprintf( stderr, _("          [-or]  next search keys are an alternative to the previous ones\n") );
+   fprintf( stderr, _("          [-sidecar <filename>] bloom filters written by bufr_decoder -make_sidecar\n") );
+   fprintf( stderr, _("          [-station <id>]       with -sidecar, only messages that may hold the station\n") );
+   fprintf( stderr, _("          [-hour <YYYYMMDDHH>]  with -sidecar, only messages that may hold the hour\n") );
    exit(EXIT_ERROR);
 }
 
@@ -126,12 +141,37 @@ static int read_cmdline( int argc, const char *argv[] )
        {
        int desc;
        ++i; if (i >= argc) abort_usage(argv[0]);
+       srchsep[nb_key] = next_sep;
+       next_sep = KEY_IN_SEQUENCE;
        bufr_init_DescValue( &(srchkey[nb_key]) );
        desc = atoi( argv[i] );
        ++i; if (i >= argc) abort_usage(argv[0]);
        bufr_set_key_string( &(srchkey[nb_key]), desc, &(argv[i]), 1 );
        ++nb_key; 
        }
+     else if (strcmp(argv[i],"-and")==0)
+       {
+       if (next_sep != KEY_OR) next_sep = KEY_AND;
+       }
+     else if (strcmp(argv[i],"-or")==0)
+       {
+       next_sep = KEY_OR;
+       }
+     else if (strcmp(argv[i],"-sidecar")==0)
+       {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_sidecar = strdup(argv[i]);
+       }
+     else if (strcmp(argv[i],"-station")==0)
+       {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       str_station = strdup(argv[i]);
+       }
+     else if (strcmp(argv[i],"-hour")==0)
+       {
+       ++i; if (i >= argc) abort_usage(argv[0]);
+       srch_hour = bufr_archive_hour( argv[i] );
+       }
    }
 
    return 0;
@@ -154,6 +194,8 @@ static void cleanup(void)
    if (str_ltabled != NULL) free(str_ltabled);
    if (str_ibufr!= NULL) free(str_ibufr);
    if (str_obufr!= NULL) free(str_obufr);
+   if (str_sidecar != NULL) free(str_sidecar);
+   if (str_station != NULL) free(str_station);
 
    for ( i = 0; i < nb_key ; i++ )
       bufr_vfree_DescValue( &(srchkey[i]) );
@@ -227,6 +269,9 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
    int            tablenos[2];
    BUFR_Template *tmplt=NULL;
    DataSubset    *subset;
+   BufrQuery     *query;
+   BufrBloomSidecar *sidecar=NULL;
+   long           offset;
    int            i;
 /*
  * load CMC Table B and D, currently version 14
@@ -247,6 +292,29 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
  * load local tables if any to list of tables
  */
    bufr_tables_list_addlocal( tables_list, str_ltableb, str_ltabled );
+/*
+ * the bloom filters can tell that the file holds nothing to keep
+ */
+   if (str_sidecar && (str_station || (srch_hour != BLOOM_ANY_TIME)))
+      {
+      fp = fopen( str_sidecar, "rb" );
+      if (fp != NULL)
+         {
+         sidecar = bufr_read_bloom_sidecar( fp );
+         fclose( fp );
+         }
+      if (sidecar && !bufr_sidecar_may_hold( sidecar, -1, str_station, srch_hour ))
+         {
+         bufr_free_bloom_sidecar( sidecar );
+         if (str_obufr != NULL)
+            {
+            fpO = fopen( str_obufr, "wb" );
+            if (fpO != NULL) fclose( fpO );
+            }
+         bufr_free_tables_list( tables_list );
+         return 0;
+         }
+      }
 /*
  * open a file for reading
  */
@@ -271,6 +339,7 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
       }
 
    resolve_search_values( dvalues, nbdv, file_tables );
+   query = build_query( dvalues, nbdv );
 /*
  * read all messages from the input file
  */
@@ -280,6 +349,16 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
  */
    while ( (rtrn = bufr_read_message( fp, &msg )) > 0 )
       {
+/*
+ * messages that cannot hold the station or hour are dropped
+ */
+      offset = msg->offset;
+      if (sidecar && (offset >= 0)&&
+          !bufr_sidecar_may_hold( sidecar, offset, str_station, srch_hour ))
+         {
+         bufr_free_message( msg );
+         continue;
+         }
       ++count;
 
       if (nbdv <= 0)
@@ -301,7 +380,7 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
          if (useTables->master.version != msg->s1.master_table_version)
             useTables = bufr_use_tables_list( tables_list, msg->s1.master_table_version );
    
-         if (useTables != NULL)
+         if ((useTables != NULL)&&bufr_message_may_match( msg, useTables, query ))
             dts = bufr_decode_message( msg, useTables );
          else 
             dts = NULL;
@@ -320,7 +399,7 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
             for (i = 0; i < sscount ; i++)
                {
                subset = bufr_get_datasubset( dts, i );
-               if (match_search_pattern( subset, dvalues, nbdv ))
+               if (match_search_pattern( subset, query ))
                   {
                   pos = bufr_create_datasubset( dts2 );
                   bufr_merge_dataset( dts2, pos, dts, i, 1 );
@@ -351,6 +430,9 @@ static int filter_file (BufrDescValue *dvalues, int nbdv)
 /*
  * close all file and cleanup
  */
+   bufr_free_query( query );
+   bufr_free_bloom_sidecar( sidecar );
+
    if (str_ibufr != NULL)
       fclose( fp );
 
@@ -429,11 +511,40 @@ static int resolve_search_values( BufrDescValue *dvalues, int nb, BUFR_Tables *t
    return nb;
    }
 
-static int match_search_pattern ( DataSubset *subset, BufrDescValue *dvalues, int nb )
+/*
+ * nom: build_query
+ *
+ * auteur:  Vanh Souvanlasy
+ *
+ * fonction: compiler les cles de recherche en une requete
+ *
+ * Consecutive keys form a sequence as found by bufr_subset_find_values,
+ * -and starts another sequence that must also be found, -or starts an
+ * alternative.
+ *
+ * parametres:  
+ *        dvalues, nb
+ */
+static BufrQuery *build_query( BufrDescValue *dvalues, int nb )
    {
-   int pos;
+   BufrQuery *query;
+   int        i, first;
+
+   query = bufr_create_query();
+   first = 0;
+   for (i = 1; i <= nb ; i++)
+      {
+      if ((i < nb)&&(srchsep[i] == KEY_IN_SEQUENCE)) continue;
 
-   if (nb <= 0) return 1;
-   pos = bufr_subset_find_values ( subset, dvalues, nb, 0 );
-   return ((pos >= 0) ? 1 : 0);
+      bufr_query_add_term( query, &(dvalues[first]), i - first );
+      if ((i < nb)&&(srchsep[i] == KEY_OR))
+         bufr_query_or( query );
+      first = i;
+      }
+   return query;
+   }
+
+static int match_search_pattern ( DataSubset *subset, BufrQuery *query )
+   {
+   return bufr_query_match( query, subset );
    }